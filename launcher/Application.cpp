@@ -45,12 +45,20 @@
 #include <QStringList>
 #include <QDebug>
 #include <QStyleFactory>
+#include <QTimer>
 
 #include "InstanceList.h"
 
 #include <minecraft/auth/AccountList.h>
 #include "icons/IconList.h"
 #include "net/HttpMetaCache.h"
+#include "net/Scheduler.h"
+#include "net/ConnectionWarmer.h"
+#include "net/MetaCacheCollector.h"
+#include "net/PeerCache.h"
+#include "minecraft/ProvisioningBundle.h"
+#include "ArtifactStore.h"
+#include "Hashing.h"
 
 #include "skins/CapeCache.h"
 #include "skins/SkinsModel.h"
@@ -74,6 +82,7 @@
 #include <FileSystem.h>
 #include <DesktopServices.h>
 #include <LocalPeer.h>
+#include <QtConcurrentRun>
 
 #include <sys.h>
 
@@ -90,6 +99,28 @@
 
 static const QLatin1String liveCheckFile("live.check");
 
+namespace {
+/// what the instances with these IDs use from the metacache, all of them if there are no IDs
+QList<MetaCacheCollector::ReferenceSource> cacheReferenceSources(InstanceList * instances, const QStringList & ids = QStringList())
+{
+    QList<MetaCacheCollector::ReferenceSource> sources;
+    for(int i = 0; i < instances->count(); i++)
+    {
+        std::weak_ptr<BaseInstance> weak = instances->at(i);
+        if(!ids.isEmpty() && !ids.contains(instances->at(i)->id()))
+        {
+            continue;
+        }
+        sources.append([weak](QList<MetaCacheCollector::Key> & entries)
+        {
+            auto instance = weak.lock();
+            return instance ? instance->usedCacheEntries(entries) : true;
+        });
+    }
+    return sources;
+}
+}
+
 using namespace Commandline;
 
 #define MACOS_HINT "If you are on macOS Sierra, you might have to move the app to your /Applications or ~/Applications folder. "\
@@ -257,6 +288,15 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         parser.addOption("import");
         parser.addShortOpt("import", 'I');
         parser.addDocumentation("import", "Import instance from specified zip (local path or URL)");
+        // --export-bundle
+        parser.addOption("export-bundle");
+        parser.addDocumentation("export-bundle", "Write everything the instances need to launch into a provisioning bundle and exit");
+        // --bundle-instances
+        parser.addOption("bundle-instances");
+        parser.addDocumentation("bundle-instances", "Comma separated IDs of the instances to export (only valid in combination with --export-bundle, all instances if not given)");
+        // --import-bundle
+        parser.addOption("import-bundle");
+        parser.addDocumentation("import-bundle", "Put the files of a provisioning bundle in place, so instances can launch without downloading them, and exit");
 
         // parse the arguments
         try
@@ -300,6 +340,16 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
     }
     m_liveCheck = args["alive"].toBool();
     m_zipToImport = args["import"].toUrl();
+    // relative to where the launcher was started, not the data folder
+    if(!args["export-bundle"].toString().isEmpty())
+    {
+        m_bundleToExport = QFileInfo(args["export-bundle"].toString()).absoluteFilePath();
+        m_bundleInstances = args["bundle-instances"].toString().split(',', QString::SkipEmptyParts);
+    }
+    if(!args["import-bundle"].toString().isEmpty())
+    {
+        m_bundleToImport = QFileInfo(args["import-bundle"].toString()).absoluteFilePath();
+    }
 
     QString origcwdPath = QDir::currentPath();
     QString binPath = applicationDirPath();
@@ -491,7 +541,9 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         // FIXME: you can run the same binaries with multiple data dirs and they won't clash. This could cause issues for updates.
         m_peerInstance = new LocalPeer(this, appID);
         connect(m_peerInstance, &LocalPeer::messageReceived, this, &Application::messageReceived);
-        if(m_peerInstance->isClient()) {
+        // bundles are handled right here, the metacache is safe to share with the running launcher
+        bool bundleCommand = !m_bundleToExport.isEmpty() || !m_bundleToImport.isEmpty();
+        if(m_peerInstance->isClient() && !bundleCommand) {
             int timeout = 2000;
 
             if(m_instanceIdToLaunch.isEmpty())
@@ -606,6 +658,8 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         }
         qDebug() << "Binary path                : " << binPath;
         qDebug() << "Application root path      : " << m_rootPath;
+        qDebug() << "Hashing backend            : " << Hashing::backendName(Hashing::backendFor(QCryptographicHash::Sha1))
+                 << "(bulk:" << Hashing::backendName(Hashing::bulkBackend()) << ")";
         if(!m_instanceIdToLaunch.isEmpty())
         {
             qDebug() << "ID of instance to launch   : " << m_instanceIdToLaunch;
@@ -715,6 +769,23 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         m_settings->registerSetting({"ProxyUser", "ProxyUsername"}, "");
         m_settings->registerSetting({"ProxyPass", "ProxyPassword"}, "");
 
+        // Download concurrency
+        m_settings->registerSetting("NetInitialConnectionsPerHost", 6);
+        m_settings->registerSetting("NetMinConnectionsPerHost", 2);
+        m_settings->registerSetting("NetMaxConnectionsPerHost", 6);
+        m_settings->registerSetting("NetMaxConnections", 32);
+        m_settings->registerSetting("NetSegmentsPerFile", 4);
+        m_settings->registerSetting("NetSegmentThresholdMiB", 16);
+
+        // Sharing downloads with other launchers on the local network, port 0 picks any free one
+        m_settings->registerSetting("PeerCacheEnabled", false);
+        m_settings->registerSetting("PeerCachePort", 0);
+
+        // Download cache size limits, 0 for no limit
+        m_settings->registerSetting("CacheLimitLibrariesMiB", 8192);
+        m_settings->registerSetting("CacheLimitModpacksMiB", 2048);
+        m_settings->registerSetting("CacheLimitGeneralMiB", 1024);
+
         // Memory
         m_settings->registerSetting({"MinMemAlloc", "MinMemoryAlloc"}, 512);
         m_settings->registerSetting({"MaxMemAlloc", "MaxMemoryAlloc"}, 1024);
@@ -801,12 +872,24 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
     // initialize network access and proxy setup
     {
         m_network = new QNetworkAccessManager();
+        m_downloadScheduler = new Net::Scheduler(m_network.get());
+        m_connectionWarmer = new Net::ConnectionWarmer(m_network.get());
+        // older versions kept the TLS session tickets in there
+        QFile::remove("tlssessions.json");
         QString proxyTypeStr = settings()->get("ProxyType").toString();
         QString addr = settings()->get("ProxyAddr").toString();
         int port = settings()->get("ProxyPort").value<qint16>();
         QString user = settings()->get("ProxyUser").toString();
         QString pass = settings()->get("ProxyPass").toString();
         updateProxySettings(proxyTypeStr, addr, port, user, pass);
+        updateConnectionLimits();
+        for(auto id: {"NetInitialConnectionsPerHost", "NetMinConnectionsPerHost", "NetMaxConnectionsPerHost", "NetMaxConnections", "NetSegmentsPerFile", "NetSegmentThresholdMiB"})
+        {
+            connect(m_settings->getSetting(id).get(), &Setting::SettingChanged, [this](const Setting &, QVariant)
+            {
+                updateConnectionLimits();
+            });
+        }
         qDebug() << "<> Network done.";
     }
 
@@ -929,10 +1012,55 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         m_metacache->addBase("translations", QDir("translations").absolutePath());
         m_metacache->addBase("icons", QDir("cache/icons").absolutePath());
         m_metacache->addBase("meta", QDir("meta").absolutePath());
+        m_metacache->addBase("natives", QDir("natives").absolutePath());
         m_metacache->Load();
+
+        // keep it from filling the disk, without touching what the instances use
+        m_cacheCollector = new MetaCacheCollector(m_metacache.get());
+        // the natives cache has an entry for the manifest of each folder
+        m_cacheCollector->setWholeFolders("natives");
+        updateCacheBudgets();
+        for(auto id: {"CacheLimitLibrariesMiB", "CacheLimitModpacksMiB", "CacheLimitGeneralMiB"})
+        {
+            connect(m_settings->getSetting(id).get(), &Setting::SettingChanged, [this](const Setting &, QVariant)
+            {
+                updateCacheBudgets();
+            });
+        }
+        m_cacheCollector->setReferenceSources([this]()
+        {
+            return cacheReferenceSources(m_instances.get());
+        });
+        m_cacheCollector->schedule(5 * 60 * 1000, 6 * 60 * 60 * 1000);
         qDebug() << "<> Cache initialized.";
     }
 
+    // init the artifact store and clean it up in the background
+    {
+        m_artifactStore = std::make_shared<ArtifactStore>(QDir("store").absolutePath());
+        auto store = m_artifactStore;
+        QtConcurrent::run(QThreadPool::globalInstance(), [store]()
+        {
+            store->collectGarbage();
+        });
+    }
+
+    // share what we have with other launchers nearby
+    {
+        m_peerCache = new Net::PeerCache(m_network.get());
+        m_peerCache->addContentAddressedFolder(QDir("assets/objects").absolutePath());
+        m_peerCache->addContentAddressedFolder(m_artifactStore->objectFolder(QCryptographicHash::Sha1));
+        updatePeerCache();
+        for(auto id: {"PeerCacheEnabled", "PeerCachePort"})
+        {
+            connect(m_settings->getSetting(id).get(), &Setting::SettingChanged, [this](const Setting &, QVariant)
+            {
+                updatePeerCache();
+            });
+        }
+        qDebug() << "<> Peer cache initialized.";
+    }
+
     // now we have network, download translation updates
     m_translations->downloadIndex();
 
@@ -969,6 +1097,12 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
         qDebug() << "<> Application theme set.";
     }
 
+    if(!m_bundleToExport.isEmpty() || !m_bundleToImport.isEmpty())
+    {
+        runBundleCommand();
+        return;
+    }
+
     if(createSetupWizard())
     {
         return;
@@ -976,6 +1110,51 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv)
     performMainStartupAction();
 }
 
+void Application::runBundleCommand()
+{
+    m_status = Application::Initialized;
+    Task * task = nullptr;
+    if(!m_bundleToExport.isEmpty())
+    {
+        for(auto & id: m_bundleInstances)
+        {
+            if(!m_instances->getInstanceById(id))
+            {
+                std::cerr << "There is no instance with the ID " << id.toStdString() << std::endl;
+                m_status = Application::Failed;
+                return;
+            }
+        }
+        qDebug() << "<> Exporting a provisioning bundle to" << m_bundleToExport;
+        task = new ProvisioningExportTask(m_metacache.get(), cacheReferenceSources(m_instances.get(), m_bundleInstances), m_bundleToExport);
+    }
+    else
+    {
+        qDebug() << "<> Importing the provisioning bundle" << m_bundleToImport;
+        task = new ProvisioningImportTask(m_metacache.get(), m_bundleToImport);
+    }
+    task->setParent(this);
+    connect(task, &Task::finished, this, [this, task]()
+    {
+        for(auto & warning: task->warnings())
+        {
+            std::cerr << "Warning: " << warning.toStdString() << std::endl;
+        }
+        if(!task->wasSuccessful())
+        {
+            std::cerr << "Failed: " << task->failReason().toStdString() << std::endl;
+            m_status = Application::Failed;
+            exit(1);
+            return;
+        }
+        std::cout << "Done." << std::endl;
+        m_status = Application::Succeeded;
+        exit(0);
+    });
+    // from the event loop, so it can be told to quit
+    QTimer::singleShot(0, task, &Task::start);
+}
+
 bool Application::createSetupWizard()
 {
     bool javaRequired = [&]()
@@ -1584,16 +1763,87 @@ void Application::updateProxySettings(QString proxyTypeStr, QString addr, int po
     qDebug() << proxyDesc;
 }
 
+void Application::updateConnectionLimits()
+{
+    Net::ConnectionLimiter::Limits limits;
+    limits.initialPerHost = m_settings->get("NetInitialConnectionsPerHost").toInt();
+    limits.minPerHost = m_settings->get("NetMinConnectionsPerHost").toInt();
+    limits.maxPerHost = m_settings->get("NetMaxConnectionsPerHost").toInt();
+    limits.maxTotal = m_settings->get("NetMaxConnections").toInt();
+    limits.segmentsPerFile = m_settings->get("NetSegmentsPerFile").toInt();
+    limits.segmentThreshold = m_settings->get("NetSegmentThresholdMiB").toLongLong() * 1024 * 1024;
+    m_downloadScheduler->setLimits(limits);
+}
+
+void Application::updateCacheBudgets()
+{
+    qint64 mib = 1024 * 1024;
+    for(auto base: {"libraries", "natives"})
+    {
+        m_cacheCollector->setBudget(base, m_settings->get("CacheLimitLibrariesMiB").toLongLong() * mib);
+    }
+    for(auto base: {"ATLauncherPacks", "FTBPacks", "TechnicPacks", "ModrinthPacks"})
+    {
+        m_cacheCollector->setBudget(base, m_settings->get("CacheLimitModpacksMiB").toLongLong() * mib);
+    }
+    for(auto base: {"general", "asset_indexes", "icons"})
+    {
+        m_cacheCollector->setBudget(base, m_settings->get("CacheLimitGeneralMiB").toLongLong() * mib);
+    }
+}
+
+void Application::updatePeerCache()
+{
+    // restart it, the port may have changed
+    m_peerCache->stop();
+    if(!m_settings->get("PeerCacheEnabled").toBool())
+    {
+        return;
+    }
+    if(!m_peerCacheListed)
+    {
+        // that reads the whole metacache, so only once it's needed. downloads made until it's done are added anyway.
+        m_peerCacheListed = true;
+        auto peerCache = m_peerCache;
+        auto librariesPath = m_metacache->getBasePath("libraries");
+        m_metacache->listDigests("libraries", QCryptographicHash::Sha1, peerCache,
+            [peerCache, librariesPath](QList<HttpMetaCache::DigestListing> libraries)
+            {
+                for(auto & library: libraries)
+                {
+                    peerCache->addFile(library.digest, FS::PathCombine(librariesPath, library.path),
+                                       library.etag.toLatin1(), library.remote_changed_timestamp.toLatin1());
+                }
+            });
+    }
+    m_peerCache->start(m_settings->get("PeerCachePort").toUInt());
+}
+
 shared_qobject_ptr< HttpMetaCache > Application::metacache()
 {
     return m_metacache;
 }
 
+std::shared_ptr<ArtifactStore> Application::artifactStore()
+{
+    return m_artifactStore;
+}
+
 shared_qobject_ptr<QNetworkAccessManager> Application::network()
 {
     return m_network;
 }
 
+Net::Scheduler * Application::downloadScheduler()
+{
+    return m_downloadScheduler;
+}
+
+Net::ConnectionWarmer * Application::connectionWarmer()
+{
+    return m_connectionWarmer;
+}
+
 shared_qobject_ptr<Meta::Index> Application::metadataIndex()
 {
     if (!m_metadataIndex)
@@ -21,6 +21,8 @@ class SetupWizard;
 class GenericPageProvider;
 class QFile;
 class HttpMetaCache;
+class MetaCacheCollector;
+class ArtifactStore;
 class SettingsObject;
 class InstanceList;
 class AccountList;
@@ -40,6 +42,12 @@ namespace Meta {
     class Index;
 }
 
+namespace Net {
+    class Scheduler;
+    class ConnectionWarmer;
+    class PeerCache;
+}
+
 #if defined(APPLICATION)
 #undef APPLICATION
 #endif
@@ -117,10 +125,24 @@ public:
 
     void updateProxySettings(QString proxyTypeStr, QString addr, int port, QString user, QString password);
 
+    void updateConnectionLimits();
+
+    void updateCacheBudgets();
+
+    void updatePeerCache();
+
     shared_qobject_ptr<QNetworkAccessManager> network();
 
+    /// schedules the parts of all NetJobs using network()
+    Net::Scheduler * downloadScheduler();
+
+    Net::ConnectionWarmer * connectionWarmer();
+
     shared_qobject_ptr<HttpMetaCache> metacache();
 
+    /// files shared between instances
+    std::shared_ptr<ArtifactStore> artifactStore();
+
     shared_qobject_ptr<Meta::Index> metadataIndex();
 
     shared_qobject_ptr<CapeCache> capeCache();
@@ -174,6 +196,8 @@ private slots:
 private:
     bool createSetupWizard();
     void performMainStartupAction();
+    /// export or import a provisioning bundle, then quit
+    void runBundleCommand();
 
     // sets the fatal error message and m_status to Failed.
     void showFatalErrorMessage(const QString & title, const QString & content);
@@ -187,11 +211,22 @@ private:
     QDateTime startTime;
 
     shared_qobject_ptr<QNetworkAccessManager> m_network;
+    // owned by m_network
+    Net::Scheduler * m_downloadScheduler = nullptr;
+    // owned by m_network
+    Net::ConnectionWarmer * m_connectionWarmer = nullptr;
+    // owned by m_network
+    Net::PeerCache * m_peerCache = nullptr;
+    // the metacache libraries were handed to m_peerCache
+    bool m_peerCacheListed = false;
 
     shared_qobject_ptr<UpdateChecker> m_updateChecker;
     shared_qobject_ptr<AccountList> m_accounts;
 
     shared_qobject_ptr<HttpMetaCache> m_metacache;
+    // owned by m_metacache
+    MetaCacheCollector * m_cacheCollector = nullptr;
+    std::shared_ptr<ArtifactStore> m_artifactStore;
     shared_qobject_ptr<Meta::Index> m_metadataIndex;
 
     shared_qobject_ptr<CapeCache> m_capeCache;
@@ -246,5 +281,8 @@ public:
     QString m_offlineName;
     bool m_liveCheck = false;
     QUrl m_zipToImport;
+    QString m_bundleToExport;
+    QStringList m_bundleInstances;
+    QString m_bundleToImport;
     std::unique_ptr<QFile> logFile;
 };
@@ -0,0 +1,312 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ArtifactStore.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QThread>
+
+#include "FileSystem.h"
+#include "Hashing.h"
+
+namespace {
+const char * refsSuffix = ".refs";
+const char * tmpSuffix = ".tmp";
+
+QString algorithmName(QCryptographicHash::Algorithm algorithm)
+{
+    switch(algorithm)
+    {
+        case QCryptographicHash::Sha1:
+            return "sha1";
+        case QCryptographicHash::Sha256:
+            return "sha256";
+        case QCryptographicHash::Sha512:
+            return "sha512";
+        default:
+            return QString();
+    }
+}
+
+QByteArray hashFile(const QString & path, QCryptographicHash::Algorithm algorithm)
+{
+    QFile input(path);
+    if(!input.open(QIODevice::ReadOnly))
+    {
+        return QByteArray();
+    }
+    Hashing::Hasher hash(algorithm);
+    if(!hash.addData(&input))
+    {
+        return QByteArray();
+    }
+    return hash.result();
+}
+
+QStringList readReferences(const QString & path)
+{
+    QFile refs(path);
+    if(!refs.open(QIODevice::ReadOnly))
+    {
+        return {};
+    }
+    return QString::fromUtf8(refs.readAll()).split('\n', QString::SkipEmptyParts);
+}
+}
+
+ArtifactStore::ArtifactStore(const QString& root) : m_root(root)
+{
+}
+
+bool ArtifactStore::supports(QCryptographicHash::Algorithm algorithm)
+{
+    return !algorithmName(algorithm).isEmpty();
+}
+
+QString ArtifactStore::objectFolder(QCryptographicHash::Algorithm algorithm) const
+{
+    auto name = algorithmName(algorithm);
+    if(name.isEmpty())
+    {
+        return QString();
+    }
+    return FS::PathCombine(m_root, name);
+}
+
+QString ArtifactStore::objectPath(QCryptographicHash::Algorithm algorithm, const QByteArray& hash) const
+{
+    auto name = algorithmName(algorithm);
+    if(name.isEmpty() || hash.isEmpty())
+    {
+        return QString();
+    }
+    auto hex = QString::fromLatin1(hash.toHex());
+    return FS::PathCombine(m_root, name, hex.left(2), hex);
+}
+
+bool ArtifactStore::contains(QCryptographicHash::Algorithm algorithm, const QByteArray& hash) const
+{
+    auto object = objectPath(algorithm, hash);
+    return !object.isEmpty() && QFileInfo(object).isFile();
+}
+
+bool ArtifactStore::placeFile(const QString& source, const QString& target)
+{
+    QFile::remove(target);
+    // never a hard link, the file would be the object and changes to it would go everywhere.
+    // no plain copy either, the caller can make that one without a detour through the store.
+    return FS::cloneFile(source, target);
+}
+
+void ArtifactStore::addReference(const QString& object, const QString& target)
+{
+    auto refsPath = object + refsSuffix;
+    if(readReferences(refsPath).contains(target))
+    {
+        // still counts as a use
+        FS::updateTimestamp(refsPath);
+        return;
+    }
+    QFile refs(refsPath);
+    if(!refs.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        qWarning() << "Could not record the use of" << object << ":" << refs.errorString();
+        return;
+    }
+    refs.write(target.toUtf8() + '\n');
+}
+
+QByteArray ArtifactStore::insert(const QString& source, QCryptographicHash::Algorithm algorithm, const QByteArray& expected)
+{
+    auto folder = objectFolder(algorithm);
+    if(folder.isEmpty() || !FS::ensureFolderPathExists(folder))
+    {
+        return QByteArray();
+    }
+    // the copy is what gets checked, the source could still change after that
+    auto tmp = FS::PathCombine(folder, QString("%1-%2%3")
+        .arg(QCoreApplication::applicationPid())
+        .arg(quintptr(QThread::currentThreadId()))
+        .arg(tmpSuffix));
+    if(!placeFile(source, tmp))
+    {
+        QFile::remove(tmp);
+        return QByteArray();
+    }
+    auto hash = hashFile(tmp, algorithm);
+    if(hash.isEmpty() || (!expected.isEmpty() && hash != expected))
+    {
+        qWarning() << "Not adding" << source << "to the artifact store, it doesn't have the expected hash";
+        QFile::remove(tmp);
+        return QByteArray();
+    }
+    auto object = objectPath(algorithm, hash);
+    QMutexLocker locker(&m_lock);
+    if(QFileInfo(object).isFile())
+    {
+        QFile::remove(tmp);
+    }
+    else if(!FS::ensureFilePathExists(object) || !FS::replaceFile(tmp, object))
+    {
+        qWarning() << "Could not add" << source << "to the artifact store";
+        QFile::remove(tmp);
+        return QByteArray();
+    }
+    addReference(object, QFileInfo(source).absoluteFilePath());
+    return hash;
+}
+
+bool ArtifactStore::add(const QString& source, QCryptographicHash::Algorithm algorithm, const QByteArray& hash)
+{
+    if(objectPath(algorithm, hash).isEmpty())
+    {
+        return false;
+    }
+    return !insert(source, algorithm, hash).isEmpty();
+}
+
+bool ArtifactStore::materialize(QCryptographicHash::Algorithm algorithm, const QByteArray& hash, const QString& target)
+{
+    auto object = objectPath(algorithm, hash);
+    if(object.isEmpty())
+    {
+        return false;
+    }
+    QMutexLocker locker(&m_lock);
+    if(!QFileInfo(object).isFile())
+    {
+        return false;
+    }
+    if(!FS::ensureFilePathExists(target))
+    {
+        qWarning() << "Could not create folder for" << target;
+        return false;
+    }
+    auto tmp = target + tmpSuffix;
+    if(!placeFile(object, tmp))
+    {
+        QFile::remove(tmp);
+        return false;
+    }
+    if(!FS::replaceFile(tmp, target))
+    {
+        qWarning() << "Could not put" << object << "at" << target;
+        QFile::remove(tmp);
+        return false;
+    }
+    addReference(object, QFileInfo(target).absoluteFilePath());
+    return true;
+}
+
+bool ArtifactStore::share(const QString& source, const QString& target)
+{
+    auto hash = insert(source, QCryptographicHash::Sha1, QByteArray());
+    if(hash.isEmpty())
+    {
+        return false;
+    }
+    return materialize(QCryptographicHash::Sha1, hash, target);
+}
+
+qint64 ArtifactStore::collectGarbage(int keepUnusedDays)
+{
+    // objects nothing refers to are kept for a while after their last use, so reinstalling a pack doesn't download it all again
+    auto cutoff = QDateTime::currentDateTimeUtc().addDays(-keepUnusedDays);
+    QStringList objects;
+    QDirIterator iter(m_root, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while(iter.hasNext())
+    {
+        auto path = iter.next();
+        if(path.endsWith(refsSuffix))
+        {
+            continue;
+        }
+        if(path.endsWith(tmpSuffix))
+        {
+            // left behind by a crash
+            if(iter.fileInfo().lastModified() < cutoff)
+            {
+                QFile::remove(path);
+            }
+            continue;
+        }
+        objects.append(path);
+    }
+
+    qint64 freed = 0;
+    int removed = 0;
+    for(auto & object: objects)
+    {
+        QMutexLocker locker(&m_lock);
+        QFileInfo objectInfo(object);
+        if(!objectInfo.isFile())
+        {
+            continue;
+        }
+        auto refsPath = object + refsSuffix;
+        auto refs = readReferences(refsPath);
+        QStringList live;
+        for(auto & ref: refs)
+        {
+            if(live.contains(ref))
+            {
+                continue;
+            }
+            // a file of the same size at the path is presumed to still be the object
+            QFileInfo refInfo(ref);
+            if(refInfo.isFile() && refInfo.size() == objectInfo.size())
+            {
+                live.append(ref);
+            }
+        }
+        if(!live.isEmpty())
+        {
+            if(live.size() != refs.size())
+            {
+                try
+                {
+                    FS::write(refsPath, live.join('\n').toUtf8() + '\n');
+                }
+                catch (const Exception &e)
+                {
+                    qWarning() << e.what();
+                }
+            }
+            continue;
+        }
+        QFileInfo refsInfo(refsPath);
+        if(refsInfo.exists() && refsInfo.lastModified() >= cutoff)
+        {
+            continue;
+        }
+        if(QFile::remove(object))
+        {
+            QFile::remove(refsPath);
+            freed += objectInfo.size();
+            removed++;
+        }
+    }
+    if(removed)
+    {
+        qDebug() << "Removed" << removed << "unused objects from the artifact store," << freed << "bytes freed";
+    }
+    return freed;
+}
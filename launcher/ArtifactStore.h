@@ -0,0 +1,77 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <memory>
+
+/*
+ * Content-addressed store for the files instances share - mods, resource packs, pack archives and the like.
+ *
+ * Objects live under <root>/<algorithm>/<first two hex digits>/<hex hash>. Only strong hashes (SHA-1 and up) are
+ * used as keys, and every file added is hashed by the store itself. Files only go into the store and out of it as
+ * copy-on-write clones, so changing a file in one instance never changes the object or the other instances. Where the
+ * filesystem can't clone, adding and placing files fails and callers copy them directly: going through the store would
+ * only make more copies.
+ *
+ * Next to every object is a `.refs` file with the paths it was put at, one per line.
+ * Garbage collection drops the references that don't exist anymore and deletes objects that have none left,
+ * unless they were used recently.
+ *
+ * All methods are safe to call from any thread.
+ */
+class ArtifactStore
+{
+public: /* con/des */
+    explicit ArtifactStore(const QString & root);
+
+public: /* methods */
+    /// true if objects can be stored under hashes of this kind
+    static bool supports(QCryptographicHash::Algorithm algorithm);
+
+    /// the folder with all the objects stored under hashes of this kind, empty if there can't be any
+    QString objectFolder(QCryptographicHash::Algorithm algorithm) const;
+    QString objectPath(QCryptographicHash::Algorithm algorithm, const QByteArray & hash) const;
+    bool contains(QCryptographicHash::Algorithm algorithm, const QByteArray & hash) const;
+
+    /// add the file as the object with this hash. Fails if the file doesn't have that hash, or can't be cloned.
+    bool add(const QString & source, QCryptographicHash::Algorithm algorithm, const QByteArray & hash);
+
+    /// replace `target` with the object. Fails if there is no such object, or it can't be cloned to `target`.
+    bool materialize(QCryptographicHash::Algorithm algorithm, const QByteArray & hash, const QString & target);
+
+    /// hash `source`, add it to the store and put the object at `target`
+    bool share(const QString & source, const QString & target);
+
+    /// delete the objects that are not used anywhere anymore and weren't for `keepUnusedDays`. Returns the number of bytes freed.
+    qint64 collectGarbage(int keepUnusedDays = 7);
+
+private: /* methods */
+    /// clone `source` to `target`, false if the filesystem can't do that
+    bool placeFile(const QString & source, const QString & target);
+    /// clone `source` into the store. Returns its hash, or nothing if that isn't `expected` (unless that is empty).
+    QByteArray insert(const QString & source, QCryptographicHash::Algorithm algorithm, const QByteArray & expected);
+    void addReference(const QString & object, const QString & target);
+
+private: /* data */
+    QString m_root;
+    QMutex m_lock;
+};
+
+typedef std::shared_ptr<ArtifactStore> ArtifactStorePtr;
@@ -0,0 +1,157 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QCryptographicHash>
+#include "TestUtil.h"
+
+#include "ArtifactStore.h"
+#include "FileSystem.h"
+
+namespace {
+QByteArray sha1(const QByteArray & data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+/// change the file in place, like a program that has it open would
+void overwrite(const QString & path, const QByteArray & data)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+
+/// the store only takes files it can clone, so most of these tests need a filesystem that does that
+bool canClone(const QString & folder)
+{
+    auto source = FS::PathCombine(folder, "probe");
+    FS::write(source, "probe");
+    bool cloned = FS::cloneFile(source, source + ".clone");
+    QFile::remove(source);
+    QFile::remove(source + ".clone");
+    return cloned;
+}
+}
+
+class ArtifactStoreTest : public QObject
+{
+    Q_OBJECT
+
+private
+slots:
+    void test_addAndMaterialize()
+    {
+        QTemporaryDir tempDir;
+        if(!canClone(tempDir.path()))
+        {
+            QSKIP("The filesystem can't clone files");
+        }
+        ArtifactStore store(FS::PathCombine(tempDir.path(), "store"));
+        auto source = FS::PathCombine(tempDir.path(), "a", "mod.jar");
+        FS::ensureFilePathExists(source);
+        FS::write(source, "mod contents");
+
+        QVERIFY(store.add(source, QCryptographicHash::Sha1, sha1("mod contents")));
+        QVERIFY(store.contains(QCryptographicHash::Sha1, sha1("mod contents")));
+        QCOMPARE(FS::read(store.objectPath(QCryptographicHash::Sha1, sha1("mod contents"))), QByteArray("mod contents"));
+
+        auto target = FS::PathCombine(tempDir.path(), "b", "mod.jar");
+        QVERIFY(store.materialize(QCryptographicHash::Sha1, sha1("mod contents"), target));
+        QCOMPARE(FS::read(target), QByteArray("mod contents"));
+        QVERIFY(!store.materialize(QCryptographicHash::Sha1, sha1("something else"), target));
+    }
+
+    void test_addChecksTheHash()
+    {
+        QTemporaryDir tempDir;
+        ArtifactStore store(FS::PathCombine(tempDir.path(), "store"));
+        auto source = FS::PathCombine(tempDir.path(), "mod.jar");
+        FS::write(source, "mod contents");
+
+        // the caller's word isn't enough to get a file into the store
+        QVERIFY(!store.add(source, QCryptographicHash::Sha1, sha1("other contents")));
+        QVERIFY(!store.contains(QCryptographicHash::Sha1, sha1("other contents")));
+        // and MD5 isn't good enough to tell files apart
+        auto md5 = QCryptographicHash::hash("mod contents", QCryptographicHash::Md5);
+        QVERIFY(!store.add(source, QCryptographicHash::Md5, md5));
+        QVERIFY(!store.contains(QCryptographicHash::Md5, md5));
+    }
+
+    void test_changesStayInTheInstance()
+    {
+        QTemporaryDir tempDir;
+        if(!canClone(tempDir.path()))
+        {
+            QSKIP("The filesystem can't clone files");
+        }
+        ArtifactStore store(FS::PathCombine(tempDir.path(), "store"));
+        auto source = FS::PathCombine(tempDir.path(), "a", "mod.jar");
+        auto target = FS::PathCombine(tempDir.path(), "b", "mod.jar");
+        FS::ensureFilePathExists(source);
+        FS::write(source, "mod contents");
+        QVERIFY(store.share(source, target));
+
+        // changing either copy leaves the object and the other copy alone
+        overwrite(target, "changed in b");
+        overwrite(source, "changed in a");
+        QCOMPARE(FS::read(store.objectPath(QCryptographicHash::Sha1, sha1("mod contents"))), QByteArray("mod contents"));
+        QCOMPARE(FS::read(target), QByteArray("changed in b"));
+
+        auto third = FS::PathCombine(tempDir.path(), "c", "mod.jar");
+        QVERIFY(store.materialize(QCryptographicHash::Sha1, sha1("mod contents"), third));
+        QCOMPARE(FS::read(third), QByteArray("mod contents"));
+    }
+
+    void test_noCopiesWithoutClones()
+    {
+        QTemporaryDir tempDir;
+        if(canClone(tempDir.path()))
+        {
+            QSKIP("The filesystem can clone files");
+        }
+        ArtifactStore store(FS::PathCombine(tempDir.path(), "store"));
+        auto source = FS::PathCombine(tempDir.path(), "a", "mod.jar");
+        auto target = FS::PathCombine(tempDir.path(), "b", "mod.jar");
+        FS::ensureFilePathExists(source);
+        FS::ensureFilePathExists(target);
+        FS::write(source, "mod contents");
+
+        // a plain copy in the store would be one more copy on disk, the caller copies the file itself instead
+        QVERIFY(!store.add(source, QCryptographicHash::Sha1, sha1("mod contents")));
+        QVERIFY(!store.share(source, target));
+        QVERIFY(!store.contains(QCryptographicHash::Sha1, sha1("mod contents")));
+        QVERIFY(!QFile::exists(target));
+        QCOMPARE(FS::read(source), QByteArray("mod contents"));
+    }
+
+    void test_collectGarbage()
+    {
+        QTemporaryDir tempDir;
+        if(!canClone(tempDir.path()))
+        {
+            QSKIP("The filesystem can't clone files");
+        }
+        ArtifactStore store(FS::PathCombine(tempDir.path(), "store"));
+        auto used = FS::PathCombine(tempDir.path(), "a", "used.jar");
+        auto unused = FS::PathCombine(tempDir.path(), "a", "unused.jar");
+        FS::ensureFilePathExists(used);
+        FS::write(used, "used");
+        FS::write(unused, "unused");
+        QVERIFY(store.add(used, QCryptographicHash::Sha1, sha1("used")));
+        QVERIFY(store.add(unused, QCryptographicHash::Sha1, sha1("unused")));
+
+        // recently used objects are kept even if nothing refers to them anymore
+        QFile::remove(unused);
+        QCOMPARE(store.collectGarbage(), qint64(0));
+        QVERIFY(store.contains(QCryptographicHash::Sha1, sha1("unused")));
+
+        // once that time is up, they go. The ones still in use stay.
+        QTest::qSleep(10);
+        QCOMPARE(store.collectGarbage(0), qint64(6));
+        QVERIFY(!store.contains(QCryptographicHash::Sha1, sha1("unused")));
+        QVERIFY(store.contains(QCryptographicHash::Sha1, sha1("used")));
+    }
+};
+
+QTEST_GUILESS_MAIN(ArtifactStoreTest)
+
+#include "ArtifactStore_test.moc"
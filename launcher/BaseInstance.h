@@ -22,6 +22,8 @@
 #include <QDateTime>
 #include <QSet>
 #include <QProcess>
+#include <QUrl>
+#include <QPair>
 
 #include "settings/SettingsObject.h"
 
@@ -159,6 +161,18 @@ public:
     /// returns a valid update task
     virtual Task::Ptr createUpdateTask(Net::Mode mode) = 0;
 
+    /// the servers an update talks to, so connections to them can be opened ahead of time
+    virtual QList<QUrl> updateServers()
+    {
+        return {};
+    }
+
+    /// add the metacache entries (base, path) the instance needs to `entries`. Returns false if it can't tell yet.
+    virtual bool usedCacheEntries(QList<QPair<QString, QString>> &)
+    {
+        return true;
+    }
+
     /// returns a valid launcher (task container)
     virtual shared_qobject_ptr<LaunchTask> createLaunchTask(
             AuthSessionPtr account, QuickPlayTargetPtr quickPlayTarget) = 0;
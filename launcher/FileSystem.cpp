@@ -21,8 +21,20 @@
     #include <objidl.h>
     #include <shlguid.h>
     #include <shlobj.h>
+    #include <io.h>
 #else
     #include <utime.h>
+    #include <cstdio>
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#endif
+
+#if defined Q_OS_LINUX
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
+#elif defined Q_OS_MACOS
+    #include <sys/clonefile.h>
 #endif
 
 namespace FS {
@@ -105,6 +117,117 @@ bool ensureFolderPathExists(QString foldernamepath)
     return success;
 }
 
+bool replaceFile(const QString &source, const QString &target)
+{
+#if defined Q_OS_WIN32
+    std::wstring source_utf_16 = source.toStdWString();
+    std::wstring target_utf_16 = target.toStdWString();
+    return MoveFileExW(source_utf_16.c_str(), target_utf_16.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return ::rename(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+#endif
+}
+
+bool cloneFile(const QString &source, const QString &target)
+{
+#if defined Q_OS_LINUX && defined FICLONE
+    int source_fd = ::open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0)
+    {
+        return false;
+    }
+    int target_fd = ::open(QFile::encodeName(target).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (target_fd < 0)
+    {
+        ::close(source_fd);
+        return false;
+    }
+    bool success = ::ioctl(target_fd, FICLONE, source_fd) == 0;
+    ::close(target_fd);
+    ::close(source_fd);
+    if (!success)
+    {
+        ::unlink(QFile::encodeName(target).constData());
+    }
+    return success;
+#elif defined Q_OS_MACOS
+    return ::clonefile(QFile::encodeName(source).constData(), QFile::encodeName(target).constData(), 0) == 0;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(target);
+    return false;
+#endif
+}
+
+bool preallocate(QFile &file, qint64 size)
+{
+    if (!file.isOpen() || size <= 0)
+    {
+        return false;
+    }
+#if defined Q_OS_LINUX
+    return ::fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, size) == 0;
+#elif defined Q_OS_MACOS
+    fstore_t store = {F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, size, 0};
+    if (::fcntl(file.handle(), F_PREALLOCATE, &store) == 0)
+    {
+        return true;
+    }
+    // no contiguous space, take whatever there is
+    store.fst_flags = F_ALLOCATEALL;
+    return ::fcntl(file.handle(), F_PREALLOCATE, &store) == 0;
+#elif defined Q_OS_WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = size;
+    return SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info)) != 0;
+#else
+    return false;
+#endif
+}
+
+bool syncFiles(const QStringList &paths)
+{
+    // each file on its own. syncfs would also flush everything else that happens to be written to the same disk.
+    bool success = true;
+    for (auto &path : paths)
+    {
+#if defined Q_OS_WIN32
+        std::wstring path_utf_16 = path.toStdWString();
+        HANDLE handle = CreateFileW(path_utf_16.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            success = false;
+            continue;
+        }
+        success &= FlushFileBuffers(handle) != 0;
+        CloseHandle(handle);
+#else
+        int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            success = false;
+            continue;
+        }
+#if defined Q_OS_LINUX
+        success &= ::fdatasync(fd) == 0;
+#elif defined Q_OS_MACOS
+        // plain fsync leaves the data in the drive's cache on macOS
+        success &= ::fcntl(fd, F_FULLFSYNC) == 0 || ::fsync(fd) == 0;
+#else
+        success &= ::fsync(fd) == 0;
+#endif
+        ::close(fd);
+#endif
+    }
+    return success;
+}
+
 bool copy::operator()(const QString &offset)
 {
     //NOTE always deep copy on windows. the alternatives are too messy.
@@ -137,6 +260,10 @@ bool copy::operator()(const QString &offset)
             qWarning() << "Cannot create path!";
             return false;
         }
+        if (m_fileCopier && m_fileCopier(src, dst))
+        {
+            return true;
+        }
         return QFile::copy(src, dst);
     }
     else if(currentSrc.isDir())
@@ -7,6 +7,9 @@
 
 #include <QDir>
 #include <QFlags>
+#include <functional>
+
+class QFile;
 
 namespace FS
 {
@@ -62,6 +65,12 @@ public:
         m_blacklist = filter;
         return *this;
     }
+    /// use `copier` for files. if it returns false, the file is copied normally.
+    copy & fileCopier(std::function<bool(const QString & src, const QString & dst)> copier)
+    {
+        m_fileCopier = copier;
+        return *this;
+    }
     bool operator()()
     {
         return operator()(QString());
@@ -73,10 +82,32 @@ private:
 private:
     bool m_followSymlinks = true;
     const IPathMatcher * m_blacklist = nullptr;
+    std::function<bool(const QString &, const QString &)> m_fileCopier;
     QDir m_src;
     QDir m_dst;
 };
 
+/**
+ * Move a file over another one, replacing it atomically where the platform allows it
+ */
+bool replaceFile(const QString &source, const QString &target);
+
+/**
+ * Create `target` as a copy-on-write clone of `source`. Fails if the filesystem can't do that.
+ */
+bool cloneFile(const QString &source, const QString &target);
+
+/**
+ * Reserve disk space for `size` bytes of the open file, without changing its size.
+ * Fails if the platform or filesystem can't do that - it's only a hint, writing works either way.
+ */
+bool preallocate(QFile &file, qint64 size);
+
+/**
+ * Make sure the contents of the files are on the disk. Fails if any of them can't be synced.
+ */
+bool syncFiles(const QStringList &paths);
+
 /**
  * Delete a folder recursively
  */
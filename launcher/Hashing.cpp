@@ -0,0 +1,284 @@
+// Licensed under the Apache-2.0 license. See README.md for details.
+
+#include "Hashing.h"
+#include "HashingX86.h"
+
+#include <QIODevice>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const int readChunkSize = 1024 * 1024;
+
+const uint32_t sha1Initial[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+const uint32_t sha256Initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+void compress(QCryptographicHash::Algorithm algorithm, uint32_t * state, const uint8_t * data, size_t blocks)
+{
+    if(algorithm == QCryptographicHash::Sha1)
+    {
+        Hashing::X86::sha1Blocks(state, data, blocks);
+    }
+    else
+    {
+        Hashing::X86::sha256Blocks(state, data, blocks);
+    }
+}
+
+int stateWords(QCryptographicHash::Algorithm algorithm)
+{
+    return algorithm == QCryptographicHash::Sha1 ? 5 : 8;
+}
+}
+
+namespace Hashing
+{
+bool isAvailable(Backend backend)
+{
+    switch(backend)
+    {
+        case Backend::Qt:
+            return true;
+        case Backend::ShaExtensions:
+            return X86::hasShaExtensions();
+        case Backend::Avx2MultiBuffer:
+            return X86::hasAvx2();
+    }
+    return false;
+}
+
+Backend backendFor(QCryptographicHash::Algorithm algorithm)
+{
+    if(algorithm != QCryptographicHash::Sha1 && algorithm != QCryptographicHash::Sha256)
+    {
+        return Backend::Qt;
+    }
+    return isAvailable(Backend::ShaExtensions) ? Backend::ShaExtensions : Backend::Qt;
+}
+
+Backend bulkBackend()
+{
+    // the SHA extensions beat eight AVX2 lanes wherever both exist, and don't need the work split into equal parts
+    if(isAvailable(Backend::ShaExtensions))
+    {
+        return Backend::ShaExtensions;
+    }
+    if(isAvailable(Backend::Avx2MultiBuffer))
+    {
+        return Backend::Avx2MultiBuffer;
+    }
+    return Backend::Qt;
+}
+
+QString backendName(Backend backend)
+{
+    switch(backend)
+    {
+        case Backend::Qt:
+            return "Qt";
+        case Backend::ShaExtensions:
+            return "SHA extensions";
+        case Backend::Avx2MultiBuffer:
+            return "AVX2 multi-buffer";
+    }
+    return QString();
+}
+
+Hasher::Hasher(QCryptographicHash::Algorithm algorithm) : m_algorithm(algorithm)
+{
+    if(backendFor(algorithm) == Backend::Qt)
+    {
+        m_fallback.reset(new QCryptographicHash(algorithm));
+    }
+    reset();
+}
+
+Hasher::~Hasher()
+{
+}
+
+void Hasher::reset()
+{
+    if(m_fallback)
+    {
+        m_fallback->reset();
+        return;
+    }
+    if(m_algorithm == QCryptographicHash::Sha1)
+    {
+        memcpy(m_state, sha1Initial, sizeof(sha1Initial));
+    }
+    else
+    {
+        memcpy(m_state, sha256Initial, sizeof(sha256Initial));
+    }
+    m_buffered = 0;
+    m_length = 0;
+}
+
+void Hasher::addData(const char * data, int length)
+{
+    if(m_fallback)
+    {
+        m_fallback->addData(data, length);
+        return;
+    }
+    if(length <= 0)
+    {
+        return;
+    }
+    auto bytes = reinterpret_cast<const uint8_t *>(data);
+    size_t remaining = length;
+    m_length += remaining;
+    if(m_buffered)
+    {
+        size_t take = std::min(remaining, size_t(64 - m_buffered));
+        memcpy(m_buffer + m_buffered, bytes, take);
+        m_buffered += take;
+        bytes += take;
+        remaining -= take;
+        if(m_buffered < 64)
+        {
+            return;
+        }
+        compress(m_algorithm, m_state, m_buffer, 1);
+        m_buffered = 0;
+    }
+    size_t blocks = remaining / 64;
+    if(blocks)
+    {
+        compress(m_algorithm, m_state, bytes, blocks);
+        bytes += blocks * 64;
+        remaining -= blocks * 64;
+    }
+    if(remaining)
+    {
+        memcpy(m_buffer, bytes, remaining);
+        m_buffered = remaining;
+    }
+}
+
+void Hasher::addData(const QByteArray & data)
+{
+    addData(data.constData(), data.size());
+}
+
+bool Hasher::addData(QIODevice * device)
+{
+    if(!device->isReadable())
+    {
+        return false;
+    }
+    QByteArray chunk(readChunkSize, Qt::Uninitialized);
+    qint64 length;
+    while((length = device->read(chunk.data(), chunk.size())) > 0)
+    {
+        addData(chunk.constData(), int(length));
+    }
+    return device->atEnd();
+}
+
+QByteArray Hasher::result() const
+{
+    if(m_fallback)
+    {
+        return m_fallback->result();
+    }
+    // padding goes into a copy, so more data can still be added after this
+    uint32_t state[8];
+    memcpy(state, m_state, sizeof(state));
+    uint8_t tail[128] = {};
+    memcpy(tail, m_buffer, m_buffered);
+    tail[m_buffered] = 0x80;
+    size_t tailBlocks = m_buffered + 9 <= 64 ? 1 : 2;
+    quint64 bits = m_length * 8;
+    uint8_t * end = tail + tailBlocks * 64;
+    for(int i = 1; i <= 8; i++)
+    {
+        end[-i] = uint8_t(bits >> (8 * (i - 1)));
+    }
+    compress(m_algorithm, state, tail, tailBlocks);
+
+    int words = stateWords(m_algorithm);
+    QByteArray digest(words * 4, Qt::Uninitialized);
+    for(int i = 0; i < words; i++)
+    {
+        digest[4 * i + 0] = char(state[i] >> 24);
+        digest[4 * i + 1] = char(state[i] >> 16);
+        digest[4 * i + 2] = char(state[i] >> 8);
+        digest[4 * i + 3] = char(state[i]);
+    }
+    return digest;
+}
+
+QByteArray Hasher::hash(const QByteArray & data, QCryptographicHash::Algorithm algorithm)
+{
+    Hasher hasher(algorithm);
+    hasher.addData(data);
+    return hasher.result();
+}
+
+QVector<QByteArray> sha1Many(const QVector<QByteArray> & messages)
+{
+    return sha1Many(messages, bulkBackend());
+}
+
+QVector<QByteArray> sha1Many(const QVector<QByteArray> & messages, Backend backend)
+{
+    QVector<QByteArray> result(messages.size());
+    switch(backend)
+    {
+        case Backend::Qt:
+        {
+            for(int i = 0; i < messages.size(); i++)
+            {
+                result[i] = QCryptographicHash::hash(messages[i], QCryptographicHash::Sha1);
+            }
+            break;
+        }
+        case Backend::ShaExtensions:
+        {
+            for(int i = 0; i < messages.size(); i++)
+            {
+                result[i] = Hasher::hash(messages[i], QCryptographicHash::Sha1);
+            }
+            break;
+        }
+        case Backend::Avx2MultiBuffer:
+        {
+            // lanes only finish together when the messages are about the same length, so go from the longest down
+            QVector<int> order(messages.size());
+            for(int i = 0; i < order.size(); i++)
+            {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](int left, int right)
+            {
+                return messages[left].size() > messages[right].size();
+            });
+            for(int first = 0; first < order.size(); first += int(X86::lanes))
+            {
+                size_t count = std::min(X86::lanes, size_t(order.size() - first));
+                const uint8_t * data[X86::lanes];
+                size_t lengths[X86::lanes];
+                uint8_t digests[X86::lanes][20];
+                for(size_t lane = 0; lane < count; lane++)
+                {
+                    auto & message = messages[order[first + lane]];
+                    data[lane] = reinterpret_cast<const uint8_t *>(message.constData());
+                    lengths[lane] = message.size();
+                }
+                X86::sha1Lanes(data, lengths, count, digests);
+                for(size_t lane = 0; lane < count; lane++)
+                {
+                    result[order[first + lane]] = QByteArray(reinterpret_cast<const char *>(digests[lane]), 20);
+                }
+            }
+            break;
+        }
+    }
+    return result;
+}
+}
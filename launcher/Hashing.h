@@ -0,0 +1,74 @@
+// Licensed under the Apache-2.0 license. See README.md for details.
+
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+#include <memory>
+
+class QIODevice;
+
+/*
+ * Hashing with whatever the CPU is good at, picked at runtime.
+ *
+ * SHA-1 and SHA-256 use the x86 SHA extensions when the CPU has them. SHA-1 of many buffers at once can also run
+ * eight at a time in AVX2 lanes, for CPUs that have AVX2 but no SHA extensions. Everything else is QCryptographicHash.
+ */
+namespace Hashing
+{
+enum class Backend
+{
+    Qt,
+    ShaExtensions,
+    Avx2MultiBuffer
+};
+
+/// true if the backend can run on this machine
+bool isAvailable(Backend backend);
+/// the backend Hasher uses for the algorithm
+Backend backendFor(QCryptographicHash::Algorithm algorithm);
+/// the backend sha1Many uses
+Backend bulkBackend();
+QString backendName(Backend backend);
+
+/*
+ * Same interface as QCryptographicHash, for the algorithms it does faster.
+ */
+class Hasher
+{
+public: /* con/des */
+    explicit Hasher(QCryptographicHash::Algorithm algorithm);
+    ~Hasher();
+
+public: /* methods */
+    void addData(const char * data, int length);
+    void addData(const QByteArray & data);
+    /// read the device to the end. Returns false if reading failed.
+    bool addData(QIODevice * device);
+    void reset();
+    QByteArray result() const;
+
+    QCryptographicHash::Algorithm algorithm() const
+    {
+        return m_algorithm;
+    }
+
+    static QByteArray hash(const QByteArray & data, QCryptographicHash::Algorithm algorithm);
+
+private: /* data */
+    QCryptographicHash::Algorithm m_algorithm;
+    std::unique_ptr<QCryptographicHash> m_fallback;
+    uint32_t m_state[8];
+    uint8_t m_buffer[64];
+    int m_buffered = 0;
+    quint64 m_length = 0;
+};
+
+/// SHA-1 of every buffer, in the same order
+QVector<QByteArray> sha1Many(const QVector<QByteArray> & messages);
+/// same, with a specific backend. It has to be available.
+QVector<QByteArray> sha1Many(const QVector<QByteArray> & messages, Backend backend);
+}
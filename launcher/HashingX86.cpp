@@ -0,0 +1,447 @@
+// Licensed under the Apache-2.0 license. See README.md for details.
+
+#include "HashingX86.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define HASHING_X86 1
+    #include <cpuid.h>
+    #include <immintrin.h>
+    #define HASHING_TARGET(features) __attribute__((target(features)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define HASHING_X86 1
+    #include <intrin.h>
+    #include <immintrin.h>
+    #define HASHING_TARGET(features)
+#endif
+
+#ifdef HASHING_X86
+
+namespace {
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for(int i = 0; i < 4; i++)
+    {
+        regs[i] = info[i];
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint32_t maxLeaf()
+{
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    return regs[0];
+}
+
+HASHING_TARGET("xsave")
+uint64_t enabledStateComponents()
+{
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    // OSXSAVE - without it, xgetbv is not allowed
+    if(!(regs[2] & (1u << 27)))
+    {
+        return 0;
+    }
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t low, high;
+    __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (uint64_t(high) << 32) | low;
+#endif
+}
+
+bool detectShaExtensions()
+{
+    if(maxLeaf() < 7)
+    {
+        return false;
+    }
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    bool ssse3 = regs[2] & (1u << 9);
+    bool sse41 = regs[2] & (1u << 19);
+    cpuid(7, 0, regs);
+    bool sha = regs[1] & (1u << 29);
+    return ssse3 && sse41 && sha;
+}
+
+bool detectAvx2()
+{
+    if(maxLeaf() < 7)
+    {
+        return false;
+    }
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    bool avx = regs[2] & (1u << 28);
+    // the OS has to save the SSE and AVX registers on context switches
+    if(!avx || (enabledStateComponents() & 0x6) != 0x6)
+    {
+        return false;
+    }
+    cpuid(7, 0, regs);
+    return regs[1] & (1u << 5);
+}
+
+const uint32_t sha256RoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/*
+ * SHA-1 with the SHA extensions.
+ *
+ * Every sha1rnds4 does four rounds. The message schedule for the next four rounds is computed from the previous 16
+ * words with sha1msg1/sha1msg2, and sha1nexte derives the E value for the next group from the A of the previous one.
+ */
+template <int Function>
+HASHING_TARGET("sha,sse4.1,ssse3")
+inline void sha1Group(__m128i & abcd, __m128i & e, __m128i schedule[4], int group)
+{
+    __m128i & current = schedule[group & 3];
+    if(group >= 4)
+    {
+        current = _mm_sha1msg1_epu32(current, schedule[(group + 1) & 3]);
+        current = _mm_xor_si128(current, schedule[(group + 2) & 3]);
+        current = _mm_sha1msg2_epu32(current, schedule[(group + 3) & 3]);
+    }
+    __m128i next = group == 0 ? _mm_add_epi32(e, current) : _mm_sha1nexte_epu32(e, current);
+    e = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, next, Function);
+}
+
+HASHING_TARGET("sha,sse4.1,ssse3")
+void sha1BlocksShaNi(uint32_t state[5], const uint8_t * data, size_t blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1B);
+    __m128i e = _mm_set_epi32(int(state[4]), 0, 0, 0);
+
+    for(size_t block = 0; block < blocks; block++, data += 64)
+    {
+        const __m128i abcdSaved = abcd;
+        const __m128i eSaved = e;
+        __m128i schedule[4];
+        for(int i = 0; i < 4; i++)
+        {
+            schedule[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i)), byteSwap);
+        }
+        int group = 0;
+        for(; group < 5; group++)
+        {
+            sha1Group<0>(abcd, e, schedule, group);
+        }
+        for(; group < 10; group++)
+        {
+            sha1Group<1>(abcd, e, schedule, group);
+        }
+        for(; group < 15; group++)
+        {
+            sha1Group<2>(abcd, e, schedule, group);
+        }
+        for(; group < 20; group++)
+        {
+            sha1Group<3>(abcd, e, schedule, group);
+        }
+        e = _mm_sha1nexte_epu32(e, eSaved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e, 3);
+}
+
+/*
+ * SHA-256 with the SHA extensions.
+ *
+ * The state is kept as ABEF and CDGH, the layout sha256rnds2 wants. Every sha256rnds2 does two rounds.
+ */
+HASHING_TARGET("sha,sse4.1,ssse3")
+void sha256BlocksShaNi(uint32_t state[8], const uint8_t * data, size_t blocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for(size_t block = 0; block < blocks; block++, data += 64)
+    {
+        const __m128i abefSaved = abef;
+        const __m128i cdghSaved = cdgh;
+        __m128i schedule[4];
+        for(int group = 0; group < 16; group++)
+        {
+            __m128i & current = schedule[group & 3];
+            if(group < 4)
+            {
+                current = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * group)), byteSwap);
+            }
+            else
+            {
+                const __m128i & previous = schedule[(group + 3) & 3];
+                current = _mm_sha256msg1_epu32(current, schedule[(group + 1) & 3]);
+                current = _mm_add_epi32(current, _mm_alignr_epi8(previous, schedule[(group + 2) & 3], 4));
+                current = _mm_sha256msg2_epu32(current, previous);
+            }
+            __m128i words = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i *>(sha256RoundConstants + 4 * group)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(words, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, abefSaved);
+        cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+/*
+ * Multi-buffer SHA-1 with AVX2: eight independent messages, one per 32 bit lane, all going through the rounds together.
+ * Wins over plain SHA-1 where there are no SHA extensions and many small files to hash.
+ *
+ * Whole blocks are read straight from the messages, the padded tail of each message is built in a small buffer.
+ * Lanes that ran out of blocks hash a zero block and keep their state.
+ */
+struct Lane
+{
+    const uint8_t * data = nullptr;
+    size_t wholeBlocks = 0;
+    size_t blocks = 0;
+    uint8_t tail[128];
+
+    void setup(const uint8_t * message, size_t length)
+    {
+        data = message;
+        wholeBlocks = length / 64;
+        size_t rest = length % 64;
+        size_t tailBlocks = rest + 9 <= 64 ? 1 : 2;
+        blocks = wholeBlocks + tailBlocks;
+        memset(tail, 0, sizeof(tail));
+        if(rest)
+        {
+            memcpy(tail, message + wholeBlocks * 64, rest);
+        }
+        tail[rest] = 0x80;
+        uint64_t bits = uint64_t(length) * 8;
+        uint8_t * end = tail + tailBlocks * 64;
+        for(int i = 1; i <= 8; i++)
+        {
+            end[-i] = uint8_t(bits >> (8 * (i - 1)));
+        }
+    }
+    const uint8_t * block(size_t index) const
+    {
+        if(index < wholeBlocks)
+        {
+            return data + index * 64;
+        }
+        return tail + (index - wholeBlocks) * 64;
+    }
+};
+
+const uint8_t zeroBlock[64] = {};
+
+HASHING_TARGET("avx2")
+inline __m256i rotateLeft(__m256i value, int bits)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(value, bits), _mm256_srli_epi32(value, 32 - bits));
+}
+
+inline uint32_t loadBigEndian(const uint8_t * data)
+{
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+
+HASHING_TARGET("avx2")
+void sha1LanesAvx2(const uint8_t * const * messages, const size_t * lengths, size_t count, uint8_t (*digests)[20])
+{
+    const size_t lanes = Hashing::X86::lanes;
+    Lane lane[lanes];
+    size_t maxBlocks = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        lane[i].setup(messages[i], lengths[i]);
+        if(lane[i].blocks > maxBlocks)
+        {
+            maxBlocks = lane[i].blocks;
+        }
+    }
+
+    __m256i a = _mm256_set1_epi32(0x67452301);
+    __m256i b = _mm256_set1_epi32(0xEFCDAB89);
+    __m256i c = _mm256_set1_epi32(0x98BADCFE);
+    __m256i d = _mm256_set1_epi32(0x10325476);
+    __m256i e = _mm256_set1_epi32(0xC3D2E1F0);
+    const __m256i roundConstants[4] = {
+        _mm256_set1_epi32(0x5A827999),
+        _mm256_set1_epi32(0x6ED9EBA1),
+        _mm256_set1_epi32(0x8F1BBCDC),
+        _mm256_set1_epi32(0xCA62C1D6)
+    };
+
+    for(size_t block = 0; block < maxBlocks; block++)
+    {
+        const uint8_t * data[lanes];
+        alignas(32) uint32_t active[lanes];
+        for(size_t i = 0; i < lanes; i++)
+        {
+            bool hasBlock = i < count && block < lane[i].blocks;
+            data[i] = hasBlock ? lane[i].block(block) : zeroBlock;
+            active[i] = hasBlock ? 0xFFFFFFFF : 0;
+        }
+        const __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i *>(active));
+
+        __m256i w[16];
+        for(int t = 0; t < 16; t++)
+        {
+            w[t] = _mm256_setr_epi32(
+                loadBigEndian(data[0] + 4 * t), loadBigEndian(data[1] + 4 * t),
+                loadBigEndian(data[2] + 4 * t), loadBigEndian(data[3] + 4 * t),
+                loadBigEndian(data[4] + 4 * t), loadBigEndian(data[5] + 4 * t),
+                loadBigEndian(data[6] + 4 * t), loadBigEndian(data[7] + 4 * t)
+            );
+        }
+
+        __m256i aa = a, bb = b, cc = c, dd = d, ee = e;
+        for(int t = 0; t < 80; t++)
+        {
+            if(t >= 16)
+            {
+                __m256i mixed = _mm256_xor_si256(_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]),
+                                                 _mm256_xor_si256(w[(t - 14) & 15], w[t & 15]));
+                w[t & 15] = rotateLeft(mixed, 1);
+            }
+            __m256i f;
+            if(t < 20)
+            {
+                // (b & c) | (~b & d)
+                f = _mm256_xor_si256(dd, _mm256_and_si256(bb, _mm256_xor_si256(cc, dd)));
+            }
+            else if(t < 40 || t >= 60)
+            {
+                f = _mm256_xor_si256(_mm256_xor_si256(bb, cc), dd);
+            }
+            else
+            {
+                // majority
+                f = _mm256_or_si256(_mm256_and_si256(bb, cc), _mm256_and_si256(dd, _mm256_or_si256(bb, cc)));
+            }
+            __m256i temp = _mm256_add_epi32(_mm256_add_epi32(rotateLeft(aa, 5), f),
+                                            _mm256_add_epi32(_mm256_add_epi32(ee, roundConstants[t / 20]), w[t & 15]));
+            ee = dd;
+            dd = cc;
+            cc = rotateLeft(bb, 30);
+            bb = aa;
+            aa = temp;
+        }
+
+        a = _mm256_blendv_epi8(a, _mm256_add_epi32(a, aa), mask);
+        b = _mm256_blendv_epi8(b, _mm256_add_epi32(b, bb), mask);
+        c = _mm256_blendv_epi8(c, _mm256_add_epi32(c, cc), mask);
+        d = _mm256_blendv_epi8(d, _mm256_add_epi32(d, dd), mask);
+        e = _mm256_blendv_epi8(e, _mm256_add_epi32(e, ee), mask);
+    }
+
+    alignas(32) uint32_t state[5][lanes];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(state[0]), a);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(state[1]), b);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(state[2]), c);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(state[3]), d);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(state[4]), e);
+    for(size_t i = 0; i < count; i++)
+    {
+        for(int word = 0; word < 5; word++)
+        {
+            uint32_t value = state[word][i];
+            digests[i][4 * word + 0] = uint8_t(value >> 24);
+            digests[i][4 * word + 1] = uint8_t(value >> 16);
+            digests[i][4 * word + 2] = uint8_t(value >> 8);
+            digests[i][4 * word + 3] = uint8_t(value);
+        }
+    }
+}
+}
+
+namespace Hashing
+{
+namespace X86
+{
+bool hasShaExtensions()
+{
+    static const bool result = detectShaExtensions();
+    return result;
+}
+
+bool hasAvx2()
+{
+    static const bool result = detectAvx2();
+    return result;
+}
+
+void sha1Blocks(uint32_t state[5], const uint8_t * data, size_t blocks)
+{
+    sha1BlocksShaNi(state, data, blocks);
+}
+
+void sha256Blocks(uint32_t state[8], const uint8_t * data, size_t blocks)
+{
+    sha256BlocksShaNi(state, data, blocks);
+}
+
+void sha1Lanes(const uint8_t * const * messages, const size_t * lengths, size_t count, uint8_t (*digests)[20])
+{
+    sha1LanesAvx2(messages, lengths, count, digests);
+}
+}
+}
+
+#else
+
+// not x86, nothing is supported and the kernels are never called
+namespace Hashing
+{
+namespace X86
+{
+bool hasShaExtensions()
+{
+    return false;
+}
+
+bool hasAvx2()
+{
+    return false;
+}
+
+void sha1Blocks(uint32_t *, const uint8_t *, size_t)
+{
+}
+
+void sha256Blocks(uint32_t *, const uint8_t *, size_t)
+{
+}
+
+void sha1Lanes(const uint8_t * const *, const size_t *, size_t, uint8_t (*)[20])
+{
+}
+}
+}
+
+#endif
@@ -0,0 +1,32 @@
+// Licensed under the Apache-2.0 license. See README.md for details.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * x86 SHA kernels, see Hashing.h for the interface everything else should use.
+ *
+ * Callers have to check the CPU support first, the kernels crash on CPUs without the instructions they use.
+ */
+namespace Hashing
+{
+namespace X86
+{
+/// SHA extensions (SHA-NI) with the SSE4.1 they depend on
+bool hasShaExtensions();
+/// AVX2, enabled by the OS
+bool hasAvx2();
+
+/// run the SHA-1 compression function over `blocks` 64 byte blocks
+void sha1Blocks(uint32_t state[5], const uint8_t * data, size_t blocks);
+/// run the SHA-256 compression function over `blocks` 64 byte blocks
+void sha256Blocks(uint32_t state[8], const uint8_t * data, size_t blocks);
+
+/// number of messages sha1Lanes hashes at once
+const size_t lanes = 8;
+/// SHA-1 of up to `lanes` whole messages at once, one per AVX2 lane
+void sha1Lanes(const uint8_t * const * messages, const size_t * lengths, size_t count, uint8_t (*digests)[20]);
+}
+}
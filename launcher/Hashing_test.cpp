@@ -0,0 +1,172 @@
+#include <QTest>
+#include <QBuffer>
+#include "TestUtil.h"
+
+#include "Hashing.h"
+#include <random>
+
+namespace {
+QByteArray randomBytes(int size, std::default_random_engine & engine)
+{
+    std::uniform_int_distribution<int> distribution(0, 255);
+    QByteArray result(size, Qt::Uninitialized);
+    for(int i = 0; i < size; i++)
+    {
+        result[i] = char(distribution(engine));
+    }
+    return result;
+}
+
+// sizes around the block and padding boundaries, plus some bigger ones
+const int interestingSizes[] = {0, 1, 3, 55, 56, 57, 63, 64, 65, 119, 120, 127, 128, 129, 1000, 4096, 100003};
+}
+
+class HashingTest : public QObject
+{
+    Q_OBJECT
+private
+slots:
+    void test_matchesQt_data()
+    {
+        QTest::addColumn<int>("algorithm");
+        QTest::newRow("sha1") << int(QCryptographicHash::Sha1);
+        QTest::newRow("sha256") << int(QCryptographicHash::Sha256);
+        QTest::newRow("sha512") << int(QCryptographicHash::Sha512);
+        QTest::newRow("md5") << int(QCryptographicHash::Md5);
+    }
+    void test_matchesQt()
+    {
+        QFETCH(int, algorithm);
+        auto alg = QCryptographicHash::Algorithm(algorithm);
+        std::default_random_engine engine(1234);
+        for(int size: interestingSizes)
+        {
+            auto data = randomBytes(size, engine);
+            QCOMPARE(Hashing::Hasher::hash(data, alg), QCryptographicHash::hash(data, alg));
+        }
+    }
+
+    void test_incremental()
+    {
+        std::default_random_engine engine(42);
+        auto data = randomBytes(10000, engine);
+        auto expected = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+        for(int step: {1, 7, 63, 64, 65, 1000})
+        {
+            Hashing::Hasher hasher(QCryptographicHash::Sha256);
+            for(int offset = 0; offset < data.size(); offset += step)
+            {
+                hasher.addData(data.mid(offset, step));
+            }
+            QCOMPARE(hasher.result(), expected);
+            // asking for the result doesn't end the hash
+            QCOMPARE(hasher.result(), expected);
+            hasher.reset();
+            hasher.addData(data);
+            QCOMPARE(hasher.result(), expected);
+        }
+    }
+
+    void test_device()
+    {
+        std::default_random_engine engine(7);
+        auto data = randomBytes(3 * 1024 * 1024 + 5, engine);
+        QBuffer buffer(&data);
+        QVERIFY(buffer.open(QIODevice::ReadOnly));
+        Hashing::Hasher hasher(QCryptographicHash::Sha1);
+        QVERIFY(hasher.addData(&buffer));
+        QCOMPARE(hasher.result(), QCryptographicHash::hash(data, QCryptographicHash::Sha1));
+    }
+
+    void test_sha1Many()
+    {
+        std::default_random_engine engine(99);
+        QVector<QByteArray> messages;
+        QVector<QByteArray> expected;
+        // not a multiple of the lane count, so the last group is partial
+        for(int i = 0; i < 3; i++)
+        {
+            for(int size: interestingSizes)
+            {
+                messages.append(randomBytes(size, engine));
+                expected.append(QCryptographicHash::hash(messages.last(), QCryptographicHash::Sha1));
+            }
+        }
+        for(auto backend: {Hashing::Backend::Qt, Hashing::Backend::ShaExtensions, Hashing::Backend::Avx2MultiBuffer})
+        {
+            if(!Hashing::isAvailable(backend))
+            {
+                qDebug() << "Skipping" << Hashing::backendName(backend) << "- not supported here";
+                continue;
+            }
+            QCOMPARE(Hashing::sha1Many(messages, backend), expected);
+        }
+        QCOMPARE(Hashing::sha1Many(messages), expected);
+    }
+
+    void benchmark_stream_data()
+    {
+        QTest::addColumn<int>("algorithm");
+        QTest::addColumn<bool>("qt");
+        QTest::newRow("sha1 qt") << int(QCryptographicHash::Sha1) << true;
+        QTest::newRow("sha1 hashing") << int(QCryptographicHash::Sha1) << false;
+        QTest::newRow("sha256 qt") << int(QCryptographicHash::Sha256) << true;
+        QTest::newRow("sha256 hashing") << int(QCryptographicHash::Sha256) << false;
+    }
+    void benchmark_stream()
+    {
+        QFETCH(int, algorithm);
+        QFETCH(bool, qt);
+        auto alg = QCryptographicHash::Algorithm(algorithm);
+        std::default_random_engine engine(1);
+        auto data = randomBytes(16 * 1024 * 1024, engine);
+        if(!qt)
+        {
+            qDebug() << "Using" << Hashing::backendName(Hashing::backendFor(alg));
+        }
+        QBENCHMARK
+        {
+            if(qt)
+            {
+                QCryptographicHash::hash(data, alg);
+            }
+            else
+            {
+                Hashing::Hasher::hash(data, alg);
+            }
+        }
+    }
+
+    void benchmark_manySmall_data()
+    {
+        QTest::addColumn<int>("backend");
+        QTest::newRow("qt") << int(Hashing::Backend::Qt);
+        QTest::newRow("sha extensions") << int(Hashing::Backend::ShaExtensions);
+        QTest::newRow("avx2") << int(Hashing::Backend::Avx2MultiBuffer);
+    }
+    void benchmark_manySmall()
+    {
+        QFETCH(int, backend);
+        auto chosen = Hashing::Backend(backend);
+        if(!Hashing::isAvailable(chosen))
+        {
+            QSKIP("Not supported on this CPU");
+        }
+        // roughly what an asset store looks like: lots of files, most of them a few KiB
+        std::default_random_engine engine(2);
+        std::uniform_int_distribution<int> sizes(512, 16 * 1024);
+        QVector<QByteArray> messages;
+        for(int i = 0; i < 2000; i++)
+        {
+            messages.append(randomBytes(sizes(engine), engine));
+        }
+        QBENCHMARK
+        {
+            Hashing::sha1Many(messages, chosen);
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(HashingTest)
+
+#include "Hashing_test.moc"
@@ -3,8 +3,16 @@
 #include "FileSystem.h"
 #include "NullInstance.h"
 #include "pathmatcher/RegexpMatcher.h"
+#include "ArtifactStore.h"
+#include "Application.h"
 #include <QtConcurrentRun>
 
+namespace {
+// smaller files are not worth hashing, just copy them
+const qint64 minSharedFileSize = 64 * 1024;
+const QStringList sharedFileSuffixes = {"jar", "zip", "litemod"};
+}
+
 InstanceCopyTask::InstanceCopyTask(InstancePtr origInstance, bool copySaves, bool keepPlaytime)
 {
     m_origInstance = origInstance;
@@ -23,8 +31,21 @@ void InstanceCopyTask::executeTask()
 {
     setStatus(tr("Copying instance %1").arg(m_origInstance->name()));
 
+    // big archives (mods, resource packs...) go through the artifact store, so both instances share them.
+    // where the filesystem can't clone them, the store turns them down and they are copied like everything else.
+    auto store = APPLICATION->artifactStore();
+    auto shareFile = [store](const QString & src, const QString & dst)
+    {
+        QFileInfo info(src);
+        if(info.size() < minSharedFileSize || !sharedFileSuffixes.contains(info.suffix().toLower()))
+        {
+            return false;
+        }
+        return store->share(src, dst);
+    };
+
     FS::copy folderCopy(m_origInstance->instanceRoot(), m_stagingPath);
-    folderCopy.followSymlinks(false).blacklist(m_matcher.get());
+    folderCopy.followSymlinks(false).blacklist(m_matcher.get()).fileCopier(shareFile);
 
     m_copyFuture = QtConcurrent::run(QThreadPool::globalInstance(), folderCopy);
     connect(&m_copyFutureWatcher, &QFutureWatcher<bool>::finished, this, &InstanceCopyTask::copyFinished);
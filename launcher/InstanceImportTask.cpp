@@ -33,7 +33,7 @@
 
 #include "icons/IconList.h"
 #include "Application.h"
-#include "net/ChecksumValidator.h"
+#include "ArtifactStore.h"
 
 #include <algorithm>
 #include <iterator>
@@ -337,12 +337,13 @@ void InstanceImportTask::processModrinth() {
                 QJsonObject hashes = Json::requireObject(obj, "hashes");
                 QString hash;
                 QCryptographicHash::Algorithm hashAlgorithm;
-                hash = Json::ensureString(hashes, "sha256");
-                hashAlgorithm = QCryptographicHash::Sha256;
+                // prefer sha512, that's what the artifact store knows Modrinth files by
+                hash = Json::ensureString(hashes, "sha512");
+                hashAlgorithm = QCryptographicHash::Sha512;
                 if (hash.isEmpty())
                 {
-                    hash = Json::ensureString(hashes, "sha512");
-                    hashAlgorithm = QCryptographicHash::Sha512;
+                    hash = Json::ensureString(hashes, "sha256");
+                    hashAlgorithm = QCryptographicHash::Sha256;
                     if (hash.isEmpty())
                     {
                         hash = Json::ensureString(hashes, "sha1");
@@ -461,19 +462,39 @@ void InstanceImportTask::processModrinth() {
     instance.setName(m_instName);
     instance.saveNow();
 
+    auto store = APPLICATION->artifactStore();
+    std::vector<Modrinth::File> downloaded;
     m_filesNetJob = new NetJob(tr("Mod download"), APPLICATION->network());
     for (auto &file : files)
     {
         auto path = FS::PathCombine(m_stagingPath, ".minecraft", file.path);
+        if (store->materialize(file.hashAlgorithm, file.hash, path))
+        {
+            qDebug() << "Using stored" << file.path;
+            continue;
+        }
         qDebug() << "Will download" << file.download << "to" << path;
         auto dl = Net::Download::makeFile(file.download, path);
-        dl->addValidator(new Net::ChecksumValidator(file.hashAlgorithm, file.hash));
+        dl->addDigest(file.hashAlgorithm, file.hash);
         m_filesNetJob->addNetAction(dl);
+        downloaded.push_back(file);
     }
-    connect(m_filesNetJob.get(), &NetJob::succeeded, this, [&]()
+    connect(m_filesNetJob.get(), &NetJob::succeeded, this, [this, store, downloaded]()
     {
         m_filesNetJob.reset();
-        emitSucceeded();
+        // share the downloads with other instances. The store hashes them again, so not on this thread.
+        m_storeFuture = QtConcurrent::run(QThreadPool::globalInstance(), [this, store, downloaded]()
+        {
+            for (auto &file : downloaded)
+            {
+                store->add(FS::PathCombine(m_stagingPath, ".minecraft", file.path), file.hashAlgorithm, file.hash);
+            }
+        });
+        connect(&m_storeFutureWatcher, &QFutureWatcher<void>::finished, this, [this]()
+        {
+            emitSucceeded();
+        });
+        m_storeFutureWatcher.setFuture(m_storeFuture);
     });
     connect(m_filesNetJob.get(), &NetJob::failed, [&](const QString &reason)
     {
@@ -64,6 +64,8 @@ private: /* data */
     std::unique_ptr<QuaZip> m_packZip;
     QFuture<nonstd::optional<QStringList>> m_extractFuture;
     QFutureWatcher<nonstd::optional<QStringList>> m_extractFutureWatcher;
+    QFuture<void> m_storeFuture;
+    QFutureWatcher<void> m_storeFutureWatcher;
     enum class ModpackType{
         Unknown,
         MultiMC,
@@ -19,9 +19,34 @@
 void LaunchStep::bind(LaunchTask *parent)
 {
     m_parent = parent;
-    connect(this, &LaunchStep::readyForLaunch, parent, &LaunchTask::onReadyForLaunch);
-    connect(this, &LaunchStep::logLine, parent, &LaunchTask::onLogLine);
-    connect(this, &LaunchStep::logLines, parent, &LaunchTask::onLogLines);
-    connect(this, &LaunchStep::finished, parent, &LaunchTask::onStepFinished);
-    connect(this, &LaunchStep::progressReportingRequest, parent, &LaunchTask::onProgressReportingRequested);
+    connect(this, &LaunchStep::readyForLaunch, parent, [this, parent]()
+    {
+        parent->onReadyForLaunch(this);
+    });
+    connect(this, &LaunchStep::logLine, parent, [this, parent](QString line, MessageLevel::Enum level)
+    {
+        parent->onStepLogLines(this, QStringList(line), level);
+    });
+    connect(this, &LaunchStep::logLines, parent, [this, parent](QStringList lines, MessageLevel::Enum level)
+    {
+        parent->onStepLogLines(this, lines, level);
+    });
+    connect(this, &LaunchStep::finished, parent, [this, parent]()
+    {
+        parent->onStepFinished(this);
+    });
+    connect(this, &LaunchStep::progressReportingRequest, parent, [this, parent]()
+    {
+        parent->onProgressReportingRequested(this);
+    });
+}
+
+bool LaunchStep::dependsOn(const LaunchStep &earlier) const
+{
+    if(isExclusive() || earlier.isExclusive())
+    {
+        return true;
+    }
+    // reading the same thing at the same time is fine, anything else has to wait
+    return (m_reads & earlier.m_writes) || (m_writes & (earlier.m_reads | earlier.m_writes));
 }
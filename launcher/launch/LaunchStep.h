@@ -24,6 +24,37 @@ class LaunchTask;
 class LaunchStep: public Task
 {
     Q_OBJECT
+public: /* types */
+    /**
+     * What launch steps work with.
+     *
+     * Steps declare which of these they read and which they write. A step waits for the steps added before it that
+     * write what it reads, or that touch anything it writes. Steps that declare nothing wait for all the steps before
+     * them, and all the steps after them wait for them.
+     */
+    enum Resource
+    {
+        /// the Java installation, and what is known about it
+        Java = 1 << 0,
+        /// the account the game is launched with
+        Account = 1 << 1,
+        /// the game folder and the folders in it
+        GameFolder = 1 << 2,
+        /// the resolved components and the files they need: libraries, the game jar, the asset index and objects
+        GameFiles = 1 << 3,
+        /// the mod lists of the instance
+        Mods = 1 << 4,
+        /// the address of the server the game joins once it starts
+        ServerAddress = 1 << 5,
+        /// the native libraries, extracted for the game
+        Natives = 1 << 6,
+        /// the game jar with the jar mods applied
+        ModdedJar = 1 << 7,
+        /// the assets, laid out the way old game versions look for them
+        LegacyAssets = 1 << 8
+    };
+    Q_DECLARE_FLAGS(Resources, Resource)
+
 public: /* methods */
     explicit LaunchStep(LaunchTask *parent):Task(nullptr), m_parent(parent)
     {
@@ -31,6 +62,29 @@ public: /* methods */
     };
     virtual ~LaunchStep() {};
 
+    Resources reads() const
+    {
+        return m_reads;
+    }
+    Resources writes() const
+    {
+        return m_writes;
+    }
+    /// true if the step runs alone, see Resource
+    bool isExclusive() const
+    {
+        return !m_reads && !m_writes;
+    }
+    /// true if the step has to wait for `earlier`, a step that was added before it
+    bool dependsOn(const LaunchStep &earlier) const;
+
+protected: /* methods */
+    void declareResources(Resources reads, Resources writes)
+    {
+        m_reads = reads;
+        m_writes = writes;
+    }
+
 private: /* methods */
     void bind(LaunchTask *parent);
 
@@ -47,4 +101,10 @@ public slots:
 
 protected: /* data */
     LaunchTask *m_parent;
+
+private: /* data */
+    Resources m_reads;
+    Resources m_writes;
 };
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(LaunchStep::Resources)
@@ -61,68 +61,219 @@ void LaunchTask::executeTask()
     {
         state = LaunchTask::Finished;
         emitSucceeded();
+        return;
     }
+    m_dependencies = QVector<QVector<int>>(m_steps.size());
+    for(int i = 0; i < m_steps.size(); i++)
+    {
+        for(int earlier = 0; earlier < i; earlier++)
+        {
+            if(m_steps[i]->dependsOn(*m_steps[earlier]))
+            {
+                m_dependencies[i].append(earlier);
+            }
+        }
+    }
+    m_stepStates = QVector<StepState>(m_steps.size(), StepPending);
+    m_stepLogs = QVector<QList<StepLogLines>>(m_steps.size());
+    m_logFront = 0;
     state = LaunchTask::Running;
-    onStepFinished();
+    startReadySteps();
+}
+
+void LaunchTask::startReadySteps()
+{
+    bool running = false;
+    for(int i = 0; i < m_steps.size(); i++)
+    {
+        // steps that finish right away go on to start the others themselves, the launch may be over already
+        if(!isRunning())
+        {
+            return;
+        }
+        if(m_stepStates[i] == StepRunning)
+        {
+            running = true;
+            continue;
+        }
+        if(m_stepStates[i] != StepPending || m_failing)
+        {
+            continue;
+        }
+        bool ready = true;
+        for(auto dependency: m_dependencies[i])
+        {
+            if(m_stepStates[dependency] != StepDone)
+            {
+                ready = false;
+                break;
+            }
+        }
+        if(!ready)
+        {
+            continue;
+        }
+        m_stepStates[i] = StepRunning;
+        m_steps[i]->start();
+        if(m_stepStates[i] == StepRunning)
+        {
+            running = true;
+        }
+    }
+    if(running || !isRunning())
+    {
+        return;
+    }
+    // nothing runs, so nothing more is going to start either
+    if(m_failing)
+    {
+        finalizeSteps(false, m_failReason.isEmpty() ? QString("Aborted") : m_failReason);
+    }
+    else
+    {
+        finalizeSteps(true, QString());
+    }
 }
 
-void LaunchTask::onReadyForLaunch()
+void LaunchTask::onReadyForLaunch(LaunchStep *step)
 {
     state = LaunchTask::Waiting;
+    m_waitingStep = step;
     emit readyForLaunch();
 }
 
-void LaunchTask::onStepFinished()
+void LaunchTask::onStepFinished(LaunchStep *step)
+{
+    int index = -1;
+    for(int i = 0; i < m_steps.size(); i++)
+    {
+        if(m_steps[i].get() == step)
+        {
+            index = i;
+            break;
+        }
+    }
+    if(index < 0 || index >= m_stepStates.size() || m_stepStates[index] != StepRunning)
+    {
+        return;
+    }
+    m_stepStates[index] = StepDone;
+    if(m_waitingStep == step)
+    {
+        m_waitingStep = nullptr;
+    }
+    if(!step->wasSuccessful())
+    {
+        if(m_failReason.isEmpty())
+        {
+            m_failReason = step->failReason();
+        }
+        if(!m_failing)
+        {
+            m_failing = true;
+            // the steps running next to it are of no use anymore
+            for(auto & other: runningSteps())
+            {
+                if(other->canAbort())
+                {
+                    other->abort();
+                }
+            }
+        }
+    }
+    flushStepLogs();
+    startReadySteps();
+}
+
+void LaunchTask::onStepLogLines(LaunchStep *step, const QStringList &lines, MessageLevel::Enum level)
 {
-    // initial -> just start the first step
-    if(currentStep == -1)
+    int index = -1;
+    for(int i = m_logFront + 1; i < m_stepLogs.size(); i++)
+    {
+        if(m_steps[i].get() == step)
+        {
+            index = i;
+            break;
+        }
+    }
+    // steps that run next to the ones before them wait with their output, so the log reads as if they ran one by one
+    if(index > m_logFront)
     {
-        currentStep ++;
-        m_steps[currentStep]->start();
+        m_stepLogs[index].append({lines, level});
         return;
     }
+    onLogLines(lines, level);
+}
 
-    auto step = m_steps[currentStep];
-    if(step->wasSuccessful())
+void LaunchTask::flushStepLogs()
+{
+    while(m_logFront < m_stepLogs.size())
     {
-        // end?
-        if(currentStep == m_steps.size() - 1)
+        for(auto & logged: m_stepLogs[m_logFront])
         {
-            finalizeSteps(true, QString());
+            onLogLines(logged.lines, logged.level);
         }
-        else
+        m_stepLogs[m_logFront].clear();
+        if(m_stepStates[m_logFront] != StepDone)
         {
-            currentStep ++;
-            step = m_steps[currentStep];
-            step->start();
+            break;
         }
+        m_logFront++;
     }
-    else
+}
+
+QList<shared_qobject_ptr<LaunchStep>> LaunchTask::runningSteps() const
+{
+    QList<shared_qobject_ptr<LaunchStep>> out;
+    for(int i = 0; i < m_stepStates.size(); i++)
     {
-        finalizeSteps(false, step->failReason());
+        if(m_stepStates[i] == StepRunning)
+        {
+            out.append(m_steps[i]);
+        }
     }
+    return out;
 }
 
 void LaunchTask::finalizeSteps(bool successful, const QString& error)
 {
-    for(auto step = currentStep; step >= 0; step--)
+    // whatever the steps still had to say
+    for(int i = m_logFront; i < m_stepLogs.size(); i++)
     {
-        m_steps[step]->finalize();
+        for(auto & logged: m_stepLogs[i])
+        {
+            onLogLines(logged.lines, logged.level);
+        }
+        m_stepLogs[i].clear();
+    }
+    m_logFront = m_stepLogs.size();
+    for(auto step = m_stepStates.size() - 1; step >= 0; step--)
+    {
+        if(m_stepStates[step] != StepPending)
+        {
+            m_steps[step]->finalize();
+        }
     }
     if(successful)
     {
+        state = LaunchTask::Finished;
         emitSucceeded();
     }
     else
     {
+        if(state != LaunchTask::Aborted)
+        {
+            state = LaunchTask::Failed;
+        }
         emitFailed(error);
     }
 }
 
-void LaunchTask::onProgressReportingRequested()
+void LaunchTask::onProgressReportingRequested(LaunchStep *step)
 {
     state = LaunchTask::Waiting;
-    emit requestProgress(m_steps[currentStep].get());
+    m_waitingStep = step;
+    emit requestProgress(step);
 }
 
 void LaunchTask::setCensorFilter(QMap<QString, QString> filter)
@@ -143,11 +294,14 @@ QString LaunchTask::censorPrivateInfo(QString in)
 
 void LaunchTask::proceed()
 {
-    if(state != LaunchTask::Waiting)
+    if(state != LaunchTask::Waiting || !m_waitingStep)
     {
         return;
     }
-    m_steps[currentStep]->proceed();
+    auto step = m_waitingStep;
+    m_waitingStep = nullptr;
+    state = LaunchTask::Running;
+    step->proceed();
 }
 
 bool LaunchTask::canAbort() const
@@ -163,8 +317,14 @@ bool LaunchTask::canAbort() const
         case LaunchTask::Running:
         case LaunchTask::Waiting:
         {
-            auto step = m_steps[currentStep];
-            return step->canAbort();
+            for(auto & step: runningSteps())
+            {
+                if(!step->canAbort())
+                {
+                    return false;
+                }
+            }
+            return true;
         }
     }
     return false;
@@ -187,16 +347,27 @@ bool LaunchTask::abort()
         case LaunchTask::Running:
         case LaunchTask::Waiting:
         {
-            auto step = m_steps[currentStep];
-            if(!step->canAbort())
+            auto running = runningSteps();
+            for(auto & step: running)
             {
-                return false;
+                if(!step->canAbort())
+                {
+                    return false;
+                }
             }
-            if(step->abort())
+            state = LaunchTask::Aborted;
+            m_failing = true;
+            bool aborted = true;
+            for(auto & step: running)
             {
-                state = LaunchTask::Aborted;
-                return true;
+                if(!step->abort())
+                {
+                    aborted = false;
+                }
             }
+            // the launch ends once the aborted steps are done
+            startReadySteps();
+            return aborted;
         }
         default:
             break;
@@ -17,6 +17,7 @@
 
 #pragma once
 #include <QProcess>
+#include <QVector>
 #include <QObjectPtr.h>
 #include "LogModel.h"
 #include "BaseInstance.h"
@@ -105,19 +106,53 @@ signals:
 public slots:
     void onLogLines(const QStringList& lines, MessageLevel::Enum defaultLevel = MessageLevel::Launcher);
     void onLogLine(QString line, MessageLevel::Enum defaultLevel = MessageLevel::Launcher);
-    void onReadyForLaunch();
-    void onStepFinished();
-    void onProgressReportingRequested();
+
+public: /* step callbacks, see LaunchStep::bind */
+    void onStepLogLines(LaunchStep *step, const QStringList &lines, MessageLevel::Enum level);
+    void onReadyForLaunch(LaunchStep *step);
+    void onStepFinished(LaunchStep *step);
+    void onProgressReportingRequested(LaunchStep *step);
 
 private: /*methods */
+    /// starts every step whose dependencies are done, or finalizes the launch once nothing is left to wait for
+    void startReadySteps();
+    /// logs what the steps wrote while they were waiting for the steps before them to finish
+    void flushStepLogs();
     void finalizeSteps(bool successful, const QString & error);
+    QList<shared_qobject_ptr<LaunchStep>> runningSteps() const;
+
+private: /* types */
+    enum StepState
+    {
+        StepPending,
+        StepRunning,
+        StepDone
+    };
+    struct StepLogLines
+    {
+        QStringList lines;
+        MessageLevel::Enum level;
+    };
 
 protected: /* data */
     InstancePtr m_instance;
     shared_qobject_ptr<LogModel> m_logModel;
     QList <shared_qobject_ptr<LaunchStep>> m_steps;
     QMap<QString, QString> m_censorFilter;
-    int currentStep = -1;
     State state = NotStarted;
     qint64 m_pid = -1;
+
+private: /* data */
+    /// for each step, the steps before it that it waits for
+    QVector<QVector<int>> m_dependencies;
+    QVector<StepState> m_stepStates;
+    /// log lines of steps that finished, or still run, while the ones before them still run
+    QVector<QList<StepLogLines>> m_stepLogs;
+    /// the first step that isn't done. Its log lines are shown as they come.
+    int m_logFront = 0;
+    /// the step that waits for proceed()
+    LaunchStep *m_waitingStep = nullptr;
+    /// why the launch failed, the steps that still run are waited for before it is reported
+    QString m_failReason;
+    bool m_failing = false;
 };
@@ -0,0 +1,200 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QTimer>
+#include <algorithm>
+#include "TestUtil.h"
+
+#include "FileSystem.h"
+#include "NullInstance.h"
+#include "launch/LaunchTask.h"
+#include "launch/LaunchStep.h"
+#include "settings/INISettingsObject.h"
+
+namespace {
+/// what the steps of one launch did
+struct Record
+{
+    int running = 0;
+    int maxRunning = 0;
+    QStringList started;
+    QStringList finalized;
+};
+}
+
+class TestStep: public LaunchStep
+{
+    Q_OBJECT
+public:
+    TestStep(LaunchTask *parent, Record *record, const QString &name, Resources reads, Resources writes, int delay,
+             bool fail = false)
+        : LaunchStep(parent), m_record(record), m_name(name), m_delay(delay), m_fail(fail)
+    {
+        declareResources(reads, writes);
+    }
+
+    void executeTask() override
+    {
+        m_record->started.append(m_name);
+        m_record->running++;
+        m_record->maxRunning = std::max(m_record->maxRunning, m_record->running);
+        emit logLine(m_name + " started", MessageLevel::Launcher);
+        QTimer::singleShot(m_delay, this, [this]()
+        {
+            if(!isRunning())
+            {
+                return;
+            }
+            m_record->running--;
+            emit logLine(m_name + " done", MessageLevel::Launcher);
+            if(m_fail)
+            {
+                emitFailed(m_name);
+            }
+            else
+            {
+                emitSucceeded();
+            }
+        });
+    }
+    bool canAbort() const override
+    {
+        return true;
+    }
+    bool abort() override
+    {
+        if(isRunning())
+        {
+            m_record->running--;
+            emitFailed(m_name + " aborted");
+        }
+        return true;
+    }
+    void finalize() override
+    {
+        m_record->finalized.append(m_name);
+    }
+
+private:
+    Record *m_record;
+    QString m_name;
+    int m_delay;
+    bool m_fail;
+};
+
+class LaunchTaskTest : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+    SettingsObjectPtr m_globalSettings;
+
+    InstancePtr makeInstance()
+    {
+        auto settings = std::make_shared<INISettingsObject>(FS::PathCombine(m_dir.path(), "instance.cfg"));
+        return std::make_shared<NullInstance>(m_globalSettings, settings, m_dir.path());
+    }
+
+    static QStringList logOf(LaunchTask &task)
+    {
+        QStringList out;
+        auto model = task.getLogModel();
+        for(int i = 0; i < model->rowCount(); i++)
+        {
+            out.append(model->data(model->index(i), Qt::DisplayRole).toString());
+        }
+        return out;
+    }
+
+    static bool run(LaunchTask &task)
+    {
+        QSignalSpy spy(&task, &Task::finished);
+        task.start();
+        return spy.count() || spy.wait(10000);
+    }
+
+private
+slots:
+    void initTestCase()
+    {
+        m_globalSettings = std::make_shared<INISettingsObject>(FS::PathCombine(m_dir.path(), "global.cfg"));
+        for(auto & id: {"PreLaunchCommand", "WrapperCommand", "PostExitCommand"})
+        {
+            m_globalSettings->registerSetting(id, "");
+        }
+        for(auto & id: {"ShowConsole", "AutoCloseConsole", "ShowConsoleOnError", "LogPrePostOutput", "ConsoleOverflowStop"})
+        {
+            m_globalSettings->registerSetting(id, false);
+        }
+        m_globalSettings->registerSetting("ConsoleMaxLines", 100000);
+    }
+
+    void test_independentStepsRunTogether()
+    {
+        Record record;
+        auto task = LaunchTask::create(makeInstance());
+        task->appendStep(new TestStep(task.get(), &record, "a", {}, LaunchStep::GameFolder, 100));
+        // finishes before a does, but its log comes after a's
+        task->appendStep(new TestStep(task.get(), &record, "b", {}, LaunchStep::Mods, 10));
+        task->appendStep(new TestStep(task.get(), &record, "c", LaunchStep::GameFolder | LaunchStep::Mods, {}, 0));
+        QVERIFY(run(*task));
+        QVERIFY(task->wasSuccessful());
+        QCOMPARE(record.maxRunning, 2);
+        QCOMPARE(record.started, QStringList({"a", "b", "c"}));
+        QCOMPARE(logOf(*task), QStringList({"a started", "a done", "b started", "b done", "c started", "c done"}));
+        QCOMPARE(record.finalized, QStringList({"c", "b", "a"}));
+    }
+
+    void test_sharedResourcesKeepOrder()
+    {
+        Record record;
+        auto task = LaunchTask::create(makeInstance());
+        task->appendStep(new TestStep(task.get(), &record, "a", {}, LaunchStep::GameFiles, 50));
+        task->appendStep(new TestStep(task.get(), &record, "b", LaunchStep::GameFiles, LaunchStep::Natives, 0));
+        task->appendStep(new TestStep(task.get(), &record, "c", LaunchStep::GameFiles, LaunchStep::ModdedJar, 0));
+        // declares nothing, so it waits for everything before it, and everything after it waits for it
+        task->appendStep(new TestStep(task.get(), &record, "d", {}, {}, 0));
+        task->appendStep(new TestStep(task.get(), &record, "e", {}, LaunchStep::Mods, 0));
+        QVERIFY(run(*task));
+        QVERIFY(task->wasSuccessful());
+        QCOMPARE(record.maxRunning, 2);
+        QCOMPARE(record.started, QStringList({"a", "b", "c", "d", "e"}));
+    }
+
+    void test_failure()
+    {
+        Record record;
+        auto task = LaunchTask::create(makeInstance());
+        task->appendStep(new TestStep(task.get(), &record, "a", {}, LaunchStep::GameFolder, 5000));
+        task->appendStep(new TestStep(task.get(), &record, "b", {}, LaunchStep::Mods, 10, true));
+        task->appendStep(new TestStep(task.get(), &record, "c", LaunchStep::Mods, {}, 0));
+        QVERIFY(run(*task));
+        QVERIFY(!task->wasSuccessful());
+        QCOMPARE(task->failReason(), QString("b"));
+        // a gets aborted instead of waited for, c never starts
+        QCOMPARE(record.started, QStringList({"a", "b"}));
+        QCOMPARE(record.finalized, QStringList({"b", "a"}));
+    }
+
+    void test_abort()
+    {
+        Record record;
+        auto task = LaunchTask::create(makeInstance());
+        task->appendStep(new TestStep(task.get(), &record, "a", {}, LaunchStep::GameFolder, 5000));
+        task->appendStep(new TestStep(task.get(), &record, "b", {}, LaunchStep::Mods, 5000));
+        task->appendStep(new TestStep(task.get(), &record, "c", {}, {}, 0));
+        QSignalSpy spy(task.get(), &Task::finished);
+        task->start();
+        QCOMPARE(record.running, 2);
+        QVERIFY(task->canAbort());
+        QVERIFY(task->abort());
+        QCOMPARE(spy.count(), 1);
+        QVERIFY(!task->wasSuccessful());
+        QCOMPARE(record.started, QStringList({"a", "b"}));
+        QCOMPARE(record.running, 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(LaunchTaskTest)
+
+#include "LaunchTask_test.moc"
@@ -24,7 +24,10 @@ class CheckJava: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit CheckJava(LaunchTask *parent) :LaunchStep(parent){};
+    explicit CheckJava(LaunchTask *parent) :LaunchStep(parent)
+    {
+        declareResources({}, Java);
+    };
     virtual ~CheckJava() {};
 
     virtual void executeTask();
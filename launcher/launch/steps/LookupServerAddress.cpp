@@ -21,6 +21,7 @@
 LookupServerAddress::LookupServerAddress(LaunchTask *parent) :
     LaunchStep(parent), m_dnsLookup(new QDnsLookup(this))
 {
+    declareResources({}, ServerAddress);
     connect(m_dnsLookup, &QDnsLookup::finished, this, &LookupServerAddress::on_dnsLookupFinished);
 
     m_dnsLookup->setType(QDnsLookup::SRV);
@@ -26,7 +26,10 @@ class Update: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit Update(LaunchTask *parent, Net::Mode mode):LaunchStep(parent), m_mode(mode) {};
+    explicit Update(LaunchTask *parent, Net::Mode mode):LaunchStep(parent), m_mode(mode)
+    {
+        declareResources(GameFolder, GameFiles);
+    };
     virtual ~Update() {};
 
     void executeTask() override;
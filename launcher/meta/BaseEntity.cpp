@@ -47,6 +47,10 @@ public: /* methods */
     {
         return true;
     }
+    bool canWriteInBackground() const override
+    {
+        return true;
+    }
     bool validate(QNetworkReply &) override
     {
         auto fname = m_entity->localFilename();
@@ -102,7 +106,7 @@ bool Meta::BaseEntity::loadLocalFile()
     }
 }
 
-void Meta::BaseEntity::load(Net::Mode loadType)
+void Meta::BaseEntity::loadLocal()
 {
     // load local file if nothing is loaded yet
     if(!isLoaded())
@@ -112,14 +116,30 @@ void Meta::BaseEntity::load(Net::Mode loadType)
             m_loadStatus = LoadStatus::Local;
         }
     }
+}
+
+void Meta::BaseEntity::load(Net::Mode loadType)
+{
+    loadLocal();
     // if we need remote update, run the update task
     if(loadType == Net::Mode::Offline || !shouldStartRemoteUpdate())
     {
         return;
     }
-    m_updateTask = new NetJob(QObject::tr("Download of meta file %1").arg(localFilename()), APPLICATION->network());
-    auto url = this->url();
-    auto entry = APPLICATION->metacache()->resolveEntry("meta", localFilename());
+    NetJob::Ptr job = new NetJob(QObject::tr("Download of meta file %1").arg(localFilename()), APPLICATION->network());
+    // with a local copy, nothing waits for this. Newer data is merged in when it arrives.
+    job->setPriority(isLoaded() ? Net::Priority::Background : Net::Priority::LaunchCritical);
+    addRemoteUpdate(job, APPLICATION->metacache().get(), url());
+    job->start();
+}
+
+Net::Download::Ptr Meta::BaseEntity::addRemoteUpdate(const NetJob::Ptr &job, HttpMetaCache *cache, const QUrl &url)
+{
+    if(!shouldStartRemoteUpdate())
+    {
+        return nullptr;
+    }
+    auto entry = cache->resolveEntry("meta", localFilename());
     entry->setStale(true);
     auto dl = Net::Download::makeCached(url, entry);
     /*
@@ -127,20 +147,34 @@ void Meta::BaseEntity::load(Net::Mode loadType)
      * If that fails, the file is not written to storage.
      */
     dl->addValidator(new ParsingValidator(this));
-    m_updateTask->addNetAction(dl);
+    job->addNetAction(dl);
+    m_updateTask = job;
     m_updateStatus = UpdateStatus::InProgress;
-    QObject::connect(m_updateTask.get(), &NetJob::succeeded, [&]()
+    bool revalidating = isLoaded();
+    // the job may be shared with other entities, only this part matters here
+    auto finished = [this, dl, revalidating](const QString &reason)
     {
-        m_loadStatus = LoadStatus::Remote;
-        m_updateStatus = UpdateStatus::Succeeded;
+        if(dl->wasSuccessful())
+        {
+            m_loadStatus = LoadStatus::Remote;
+            m_updateStatus = UpdateStatus::Succeeded;
+        }
+        else
+        {
+            if(revalidating)
+            {
+                qWarning() << "Could not check for a newer" << localFilename() << ", keeping the local copy:" << reason;
+            }
+            m_updateStatus = UpdateStatus::Failed;
+        }
         m_updateTask.reset();
-    });
-    QObject::connect(m_updateTask.get(), &NetJob::failed, [&]()
+    };
+    QObject::connect(job.get(), &NetJob::succeeded, [finished]()
     {
-        m_updateStatus = UpdateStatus::Failed;
-        m_updateTask.reset();
+        finished(QString());
     });
-    m_updateTask->start();
+    QObject::connect(job.get(), &NetJob::failed, finished);
+    return dl;
 }
 
 bool Meta::BaseEntity::isLoaded() const
@@ -162,3 +196,12 @@ Task::Ptr Meta::BaseEntity::getCurrentTask()
     }
     return nullptr;
 }
+
+Task::Ptr Meta::BaseEntity::getBlockingTask()
+{
+    if(isLoaded())
+    {
+        return nullptr;
+    }
+    return getCurrentTask();
+}
@@ -53,8 +53,16 @@ public:
     bool isLoaded() const;
     bool shouldStartRemoteUpdate() const;
 
+    /// loads the local copy, if there is one and nothing is loaded yet
+    void loadLocal();
+    /// loads the local copy, if there is one, and starts a remote update. The local copy is used until the update is done.
     void load(Net::Mode loadType);
+    /// adds the remote update to `job`, which may update other entities too. The caller starts the job.
+    /// returns nullptr if an update is running already.
+    Net::Download::Ptr addRemoteUpdate(const NetJob::Ptr &job, HttpMetaCache *cache, const QUrl &url);
     Task::Ptr getCurrentTask();
+    /// the remote update, if there is nothing to use until it is done
+    Task::Ptr getBlockingTask();
 
 protected: /* methods */
     bool loadLocalFile();
@@ -106,35 +106,28 @@ void Index::parse(const QJsonObject& obj)
 void Index::merge(const std::shared_ptr<Index> &other)
 {
     const QVector<VersionListPtr> lists = std::dynamic_pointer_cast<Index>(other)->m_lists;
-    // initial load, no need to merge
-    if (m_lists.isEmpty())
+    // lists are only ever added, so a newer index never disturbs views of this one
+    for (const VersionListPtr &list : lists)
     {
-        beginResetModel();
-        m_lists = lists;
-        for (int i = 0; i < lists.size(); ++i)
+        // lists handed out by get() before the index was loaded are kept, but still need their row
+        VersionListPtr existing = m_uids.value(list->uid());
+        if (existing)
         {
-            m_uids.insert(lists.at(i)->uid(), lists.at(i));
-            connectVersionList(i, lists.at(i));
-        }
-        endResetModel();
-    }
-    else
-    {
-        for (const VersionListPtr &list : lists)
-        {
-            if (m_uids.contains(list->uid()))
+            existing->mergeFromIndex(list);
+            if (m_lists.contains(existing))
             {
-                m_uids[list->uid()]->mergeFromIndex(list);
-            }
-            else
-            {
-                beginInsertRows(QModelIndex(), m_lists.size(), m_lists.size());
-                connectVersionList(m_lists.size(), list);
-                m_lists.append(list);
-                m_uids.insert(list->uid(), list);
-                endInsertRows();
+                continue;
             }
         }
+        else
+        {
+            existing = list;
+            m_uids.insert(list->uid(), list);
+        }
+        beginInsertRows(QModelIndex(), m_lists.size(), m_lists.size());
+        connectVersionList(m_lists.size(), existing);
+        m_lists.append(existing);
+        endInsertRows();
     }
 }
 
@@ -1,8 +1,26 @@
 #include <QTest>
+#include <QSignalSpy>
 #include "TestUtil.h"
 
 #include "meta/Index.h"
 #include "meta/VersionList.h"
+#include "meta/Version.h"
+
+namespace {
+Meta::VersionPtr makeVersion(const QString & version, qint64 time)
+{
+    auto result = std::make_shared<Meta::Version>("list", version);
+    result->setTime(time);
+    return result;
+}
+
+Meta::VersionListPtr makeList(const QVector<Meta::VersionPtr> & versions)
+{
+    auto result = std::make_shared<Meta::VersionList>("list");
+    result->setVersions(versions);
+    return result;
+}
+}
 
 class IndexTest : public QObject
 {
@@ -30,6 +48,38 @@ slots:
         windex.merge(std::shared_ptr<Meta::Index>(new Meta::Index({std::make_shared<Meta::VersionList>("list6")})));
         QCOMPARE(windex.lists().size(), 6);
     }
+
+    void test_merge_keepsHandedOutLists()
+    {
+        Meta::Index windex;
+        auto list = windex.get("list1");
+        QCOMPARE(windex.rowCount(QModelIndex()), 0);
+        windex.merge(std::shared_ptr<Meta::Index>(new Meta::Index({std::make_shared<Meta::VersionList>("list1"), std::make_shared<Meta::VersionList>("list2")})));
+        QCOMPARE(windex.rowCount(QModelIndex()), 2);
+        QCOMPARE(windex.get("list1"), list);
+        QCOMPARE(windex.lists().first(), list);
+    }
+
+    void test_versionListMerge_isIncremental()
+    {
+        Meta::VersionList list("list");
+        auto handedOut = list.getVersion("1");
+        list.merge(makeList({makeVersion("1", 1), makeVersion("2", 2)}));
+        QCOMPARE(list.count(), 2);
+        QCOMPARE(list.versions().at(1), handedOut);
+        QCOMPARE(handedOut->rawTime(), qint64(1));
+
+        // a view is looking at version 1 while a newer list arrives
+        QPersistentModelIndex selected = list.index(1);
+        QSignalSpy resets(&list, &QAbstractItemModel::modelReset);
+        QSignalSpy removals(&list, &QAbstractItemModel::rowsRemoved);
+        list.merge(makeList({makeVersion("1", 1), makeVersion("3", 3)}));
+        QCOMPARE(resets.count(), 0);
+        QCOMPARE(removals.count(), 1);
+        QCOMPARE(list.count(), 2);
+        QCOMPARE(list.versions().at(0)->version(), QString("3"));
+        QCOMPARE(list.data(selected, Meta::VersionList::VersionPtrRole).value<Meta::VersionPtr>(), handedOut);
+    }
 };
 
 QTEST_GUILESS_MAIN(IndexTest)
@@ -0,0 +1,123 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LoadBatch.h"
+
+#include <QDebug>
+
+#include "Index.h"
+#include "Version.h"
+#include "JsonFormat.h"
+
+namespace Meta
+{
+LoadBatch::LoadBatch(Net::Mode mode, shared_qobject_ptr<QNetworkAccessManager> network, HttpMetaCache *cache, Index *index,
+                     const QUrl &baseUrl)
+    : m_data(std::make_shared<Data>())
+{
+    m_data->mode = mode;
+    m_data->network = network;
+    m_data->cache = cache;
+    m_data->index = index;
+    m_data->baseUrl = baseUrl;
+    m_data->blocking = new NetJob(QObject::tr("Download of meta files"), network);
+    m_data->blocking->setPriority(Net::Priority::LaunchCritical);
+    m_revalidation = new NetJob(QObject::tr("Update of meta files"), network);
+    m_revalidation->setPriority(Net::Priority::Background);
+}
+
+void LoadBatch::setRequirementPicker(RequirementPicker picker)
+{
+    m_data->picker = picker;
+}
+
+void LoadBatch::add(BaseEntity *entity)
+{
+    entity->loadLocal();
+    if(m_data->mode == Net::Mode::Offline)
+    {
+        return;
+    }
+    if(entity->isLoaded())
+    {
+        entity->addRemoteUpdate(m_revalidation, m_data->cache, m_data->baseUrl.resolved(entity->localFilename()));
+        return;
+    }
+    addBlocking(m_data, entity);
+}
+
+void LoadBatch::start()
+{
+    if(m_revalidation->size())
+    {
+        m_revalidation->start();
+    }
+    auto data = m_data;
+    if(!data->blocking->size())
+    {
+        data->blocking.reset();
+        return;
+    }
+    QObject::connect(data->blocking.get(), &Task::finished, [data]()
+    {
+        data->blocking.reset();
+    });
+    qDebug() << "Downloading" << data->blocking->size() << "meta files";
+    data->blocking->start();
+}
+
+void LoadBatch::addBlocking(const std::shared_ptr<Data> &data, BaseEntity *entity)
+{
+    auto dl = entity->addRemoteUpdate(data->blocking, data->cache, data->baseUrl.resolved(entity->localFilename()));
+    auto version = dynamic_cast<Version *>(entity);
+    if(!dl || !version || !data->picker)
+    {
+        return;
+    }
+    // connected before the job connects to it, so the requirements are in the job before it can finish
+    QObject::connect(dl.get(), &NetAction::succeeded, [data, version]()
+    {
+        addRequirements(data, version);
+    });
+}
+
+void LoadBatch::addRequirements(const std::shared_ptr<Data> &data, Version *version)
+{
+    if(!data->blocking)
+    {
+        return;
+    }
+    for(auto &require: version->depends())
+    {
+        auto wanted = data->picker(require);
+        if(wanted.isEmpty())
+        {
+            continue;
+        }
+        auto dependency = data->index->get(require.uid, wanted);
+        if(dependency->isLoaded())
+        {
+            continue;
+        }
+        dependency->loadLocal();
+        if(dependency->isLoaded())
+        {
+            continue;
+        }
+        qDebug() << version->uid() << version->version() << "brings along" << require.uid << wanted;
+        addBlocking(data, dependency.get());
+    }
+}
+}
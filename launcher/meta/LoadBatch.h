@@ -0,0 +1,87 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QUrl>
+#include <functional>
+#include <memory>
+
+#include "BaseEntity.h"
+#include "net/Mode.h"
+#include "net/NetJob.h"
+
+class HttpMetaCache;
+class QNetworkAccessManager;
+
+namespace Meta
+{
+class Index;
+class Version;
+struct Require;
+
+/*
+ * Loads meta entities together, instead of with a job each.
+ *
+ * Entities without a local copy share one job that has to finish before they can be used. The ones with a local copy
+ * are only revalidated, in a background job of their own, so nothing waits for them.
+ *
+ * Versions that arrive bring their requirements along, as far as the picker can tell which versions those will be.
+ * They go into the same job, so dependency resolution finds them loaded instead of going back to the server for each
+ * level of dependencies.
+ */
+class LoadBatch
+{
+public: /* types */
+    /// the version of a requirement that is going to be needed, empty if none
+    using RequirementPicker = std::function<QString(const Require &)>;
+
+public: /* con/des */
+    LoadBatch(Net::Mode mode, shared_qobject_ptr<QNetworkAccessManager> network, HttpMetaCache *cache, Index *index,
+              const QUrl &baseUrl);
+
+public: /* methods */
+    void setRequirementPicker(RequirementPicker picker);
+
+    /// loads the local copy of the entity and queues its remote update. See BaseEntity::getBlockingTask for what to wait for.
+    void add(BaseEntity *entity);
+
+    /// starts the jobs that got anything to do. Has to be called once everything is added.
+    void start();
+
+private: /* types */
+    struct Data
+    {
+        Net::Mode mode = Net::Mode::Online;
+        shared_qobject_ptr<QNetworkAccessManager> network;
+        HttpMetaCache *cache = nullptr;
+        Index *index = nullptr;
+        QUrl baseUrl;
+        RequirementPicker picker;
+        /// gone once the job finishes, the downloads in it would keep it alive otherwise
+        NetJob::Ptr blocking;
+    };
+
+private: /* methods */
+    static void addBlocking(const std::shared_ptr<Data> &data, BaseEntity *entity);
+    static void addRequirements(const std::shared_ptr<Data> &data, Version *version);
+
+private: /* data */
+    /// shared with the downloads, which add requirements after the batch itself is gone
+    std::shared_ptr<Data> m_data;
+    NetJob::Ptr m_revalidation;
+};
+}
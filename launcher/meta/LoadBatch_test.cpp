@@ -0,0 +1,193 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+#include "TestUtil.h"
+
+#include "net/TestHttpServer.h"
+#include "net/HttpMetaCache.h"
+#include "meta/LoadBatch.h"
+#include "meta/Index.h"
+#include "meta/Version.h"
+
+namespace {
+QByteArray versionFile(const QString & uid, const QString & version, const QString & requirements = QString())
+{
+    return QString("{\"formatVersion\": 1, \"uid\": \"%1\", \"version\": \"%2\", \"releaseTime\": \"2020-01-01T00:00:00+00:00\", "
+                   "\"requires\": [%3]}").arg(uid, version, requirements).toUtf8();
+}
+
+/// what resolving the dependencies picks for a profile without any of them
+QString pick(const Meta::Require & require)
+{
+    return require.equalsVersion.isEmpty() ? require.suggests : require.equalsVersion;
+}
+
+bool wait(Task::Ptr task)
+{
+    if(!task)
+    {
+        return true;
+    }
+    QEventLoop loop;
+    QObject::connect(task.get(), &Task::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+    loop.exec();
+    return task->wasSuccessful();
+}
+
+/// a meta server with a profile of two components, which need three more over two levels of dependencies
+void setUpServer(TestHttpServer & server)
+{
+    server.addFile("/f/1.json", versionFile("f", "1", "{\"uid\": \"m\", \"equals\": \"1\"}, {\"uid\": \"x\", \"suggests\": \"2\"}"));
+    server.addFile("/m/1.json", versionFile("m", "1", "{\"uid\": \"l\", \"suggests\": \"3\"}"));
+    server.addFile("/x/2.json", versionFile("x", "2", "{\"uid\": \"y\", \"equals\": \"1\"}"));
+    server.addFile("/l/3.json", versionFile("l", "3"));
+    server.addFile("/y/1.json", versionFile("y", "1"));
+}
+}
+
+class LoadBatchTest : public QObject
+{
+    Q_OBJECT
+
+    /// a fresh place for the local copies, they are kept relative to the working directory
+    void setUpCache(QTemporaryDir & dir, HttpMetaCache & cache)
+    {
+        QVERIFY(QDir::setCurrent(dir.path()));
+        cache.addBase("meta", QDir("meta").absolutePath());
+        cache.Load();
+    }
+
+private
+slots:
+    void cleanupTestCase()
+    {
+        QDir::setCurrent(QDir::tempPath());
+    }
+
+    void test_requirementsComeAlong()
+    {
+        TestHttpServer server;
+        setUpServer(server);
+        QVERIFY(server.listen());
+        QTemporaryDir dir;
+        HttpMetaCache cache(dir.filePath("metacache"));
+        setUpCache(dir, cache);
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        Meta::Index index;
+        Meta::LoadBatch batch(Net::Mode::Online, network, &cache, &index, server.url("/"));
+        batch.setRequirementPicker([](const Meta::Require & require) -> QString
+        {
+            // already in the profile, in the version that is asked for
+            return require.uid == "m" ? QString() : pick(require);
+        });
+        auto f = index.get("f", "1");
+        auto m = index.get("m", "1");
+        batch.add(f.get());
+        batch.add(m.get());
+        auto task = f->getBlockingTask();
+        QVERIFY(task);
+        QVERIFY(m->getBlockingTask() == task);
+        batch.start();
+        QVERIFY(wait(task));
+        for(auto & loaded: {index.get("l", "3"), index.get("x", "2"), index.get("y", "1")})
+        {
+            QVERIFY(loaded->isLoaded());
+        }
+        QCOMPARE(server.requests(), 5);
+
+        // served from the local copies now, the server is only asked if they are still current
+        Meta::Index fresh;
+        Meta::LoadBatch again(Net::Mode::Online, network, &cache, &fresh, server.url("/"));
+        auto localF = fresh.get("f", "1");
+        again.add(localF.get());
+        QVERIFY(localF->isLoaded());
+        QVERIFY(!localF->getBlockingTask());
+        auto revalidation = localF->getCurrentTask();
+        QVERIFY(revalidation);
+        again.start();
+        QVERIFY(wait(revalidation));
+        QCOMPARE(server.notModified(), 1);
+    }
+
+    void test_roundTrips()
+    {
+        TestHttpServer server;
+        server.setLatency(50);
+        setUpServer(server);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        // the way dependency resolution went without the picker: one level at a time
+        qint64 levelByLevel = 0;
+        int levels = 0;
+        {
+            QTemporaryDir dir;
+            HttpMetaCache cache(dir.filePath("metacache"));
+            setUpCache(dir, cache);
+            Meta::Index index;
+            QElapsedTimer timer;
+            timer.start();
+            QList<Meta::VersionPtr> pending = {index.get("f", "1"), index.get("m", "1")};
+            while(!pending.isEmpty())
+            {
+                levels++;
+                Meta::LoadBatch batch(Net::Mode::Online, network, &cache, &index, server.url("/"));
+                for(auto & version: pending)
+                {
+                    batch.add(version.get());
+                }
+                auto task = pending.first()->getBlockingTask();
+                batch.start();
+                QVERIFY(wait(task));
+                QList<Meta::VersionPtr> next;
+                for(auto & version: pending)
+                {
+                    for(auto & require: version->depends())
+                    {
+                        auto dependency = index.get(require.uid, pick(require));
+                        if(!dependency->isLoaded() && !next.contains(dependency))
+                        {
+                            next.append(dependency);
+                        }
+                    }
+                }
+                pending = next;
+            }
+            levelByLevel = timer.elapsed();
+        }
+        int requests = server.requests();
+        server.resetCounters();
+
+        qint64 batched = 0;
+        {
+            QTemporaryDir dir;
+            HttpMetaCache cache(dir.filePath("metacache"));
+            setUpCache(dir, cache);
+            Meta::Index index;
+            QElapsedTimer timer;
+            timer.start();
+            Meta::LoadBatch batch(Net::Mode::Online, network, &cache, &index, server.url("/"));
+            batch.setRequirementPicker(pick);
+            auto f = index.get("f", "1");
+            batch.add(f.get());
+            batch.add(index.get("m", "1").get());
+            auto task = f->getBlockingTask();
+            batch.start();
+            QVERIFY(wait(task));
+            QVERIFY(index.get("y", "1")->isLoaded());
+            batched = timer.elapsed();
+        }
+        // nothing extra is fetched
+        QCOMPARE(server.requests(), requests);
+        qInfo() << "meta files:" << requests << "- one level at a time:" << levels << "jobs," << levelByLevel
+                << "ms - batched: 1 job," << batched << "ms";
+    }
+};
+
+QTEST_GUILESS_MAIN(LoadBatchTest)
+
+#include "LoadBatch_test.moc"
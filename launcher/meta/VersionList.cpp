@@ -157,7 +157,7 @@ void VersionList::setVersions(const QVector<VersionPtr> &versions)
     for (int i = 0; i < m_versions.size(); ++i)
     {
         m_lookup.insert(m_versions.at(i)->version(), m_versions.at(i));
-        setupAddedVersion(i, m_versions.at(i));
+        setupAddedVersion(m_versions.at(i));
     }
 
     // FIXME: this is dumb, we have 'recommended' as part of the metadata already...
@@ -202,39 +202,112 @@ void VersionList::merge(const VersionListPtr &other)
         setName(other->m_name);
     }
 
-    // TODO: do not reset the whole model. maybe?
-    beginResetModel();
-    m_versions.clear();
     if(other->m_versions.isEmpty())
     {
         qWarning() << "Empty list loaded ...";
     }
+    // the model changes row by row, so views keep their selection when a newer list arrives while they show this one
+    QHash<QString, VersionPtr> incoming;
+    for (const VersionPtr &version : other->m_versions)
+    {
+        incoming.insert(version->version(), version);
+    }
+    for (int row = m_versions.size() - 1; row >= 0; row--)
+    {
+        if (!incoming.contains(m_versions.at(row)->version()))
+        {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_versions.removeAt(row);
+            endRemoveRows();
+        }
+    }
+    QVector<VersionPtr> ordered;
+    QVector<VersionPtr> added;
+    m_recommended.reset();
     for (const VersionPtr &version : other->m_versions)
     {
-        // we already have the version. merge the contents
-        if (m_lookup.contains(version->version()))
+        if (incoming.value(version->version()) != version)
+        {
+            // listed twice, the last one counts
+            continue;
+        }
+        // keep the objects we already handed out, they get the new contents
+        VersionPtr existing = m_lookup.value(version->version());
+        if (existing)
         {
-            m_lookup.value(version->version())->mergeFromList(version);
+            existing->mergeFromList(version);
+            if (!m_versions.contains(existing))
+            {
+                added.append(existing);
+            }
         }
         else
         {
-            m_lookup.insert(version->uid(), version);
+            existing = version;
+            m_lookup.insert(version->version(), version);
+            added.append(version);
         }
-        // connect it.
-        setupAddedVersion(m_versions.size(), version);
-        m_versions.append(version);
-        m_recommended = getBetterVersion(m_recommended, version);
+        ordered.append(existing);
+        m_recommended = getBetterVersion(m_recommended, existing);
+    }
+    if (!added.isEmpty())
+    {
+        beginInsertRows(QModelIndex(), m_versions.size(), m_versions.size() + added.size() - 1);
+        for (const VersionPtr &version : added)
+        {
+            setupAddedVersion(version);
+            m_versions.append(version);
+        }
+        endInsertRows();
+    }
+    if (ordered != m_versions)
+    {
+        emit layoutAboutToBeChanged();
+        QModelIndexList from = persistentIndexList();
+        QModelIndexList to;
+        for (const QModelIndex &index : from)
+        {
+            to.append(this->index(ordered.indexOf(m_versions.at(index.row())), index.column()));
+        }
+        m_versions = ordered;
+        changePersistentIndexList(from, to);
+        emit layoutChanged();
+    }
+    if (!m_versions.isEmpty())
+    {
+        // recommendations don't announce themselves
+        emit dataChanged(index(0), index(m_versions.size() - 1), QVector<int>() << RecommendedRole);
     }
-    endResetModel();
 }
 
-void VersionList::setupAddedVersion(const int row, const VersionPtr &version)
+void VersionList::setupAddedVersion(const VersionPtr &version)
 {
     // FIXME: do not disconnect from everythin, disconnect only the lambdas here
     version->disconnect();
-    connect(version.get(), &Version::requiresChanged, this, [this, row]() { emit dataChanged(index(row), index(row), QVector<int>() << RequiresRole); });
-    connect(version.get(), &Version::timeChanged, this, [this, row]() { emit dataChanged(index(row), index(row), QVector<int>() << TimeRole << SortRole); });
-    connect(version.get(), &Version::typeChanged, this, [this, row]() { emit dataChanged(index(row), index(row), QVector<int>() << TypeRole); });
+    // rows move when the list is merged, look the version up when it changes
+    Version * raw = version.get();
+    auto rowOf = [this, raw]() -> int
+    {
+        for (int i = 0; i < m_versions.size(); i++)
+        {
+            if (m_versions.at(i).get() == raw)
+            {
+                return i;
+            }
+        }
+        return -1;
+    };
+    auto changed = [this, rowOf](const QVector<int> &roles)
+    {
+        int row = rowOf();
+        if (row >= 0)
+        {
+            emit dataChanged(index(row), index(row), roles);
+        }
+    };
+    connect(raw, &Version::requiresChanged, this, [changed]() { changed(QVector<int>() << RequiresRole); });
+    connect(raw, &Version::timeChanged, this, [changed]() { changed(QVector<int>() << TimeRole << SortRole); });
+    connect(raw, &Version::typeChanged, this, [changed]() { changed(QVector<int>() << TypeRole); });
 }
 
 BaseVersionPtr VersionList::getRecommended() const
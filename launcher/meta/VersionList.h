@@ -95,7 +95,7 @@ private:
 
     VersionPtr m_recommended;
 
-    void setupAddedVersion(const int row, const VersionPtr &version);
+    void setupAddedVersion(const VersionPtr &version);
 };
 }
 Q_DECLARE_METATYPE(Meta::VersionListPtr)
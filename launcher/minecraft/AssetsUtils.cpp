@@ -26,7 +26,6 @@
 #include "AssetsUtils.h"
 #include "FileSystem.h"
 #include "net/Download.h"
-#include "net/ChecksumValidator.h"
 #include "BuildConfig.h"
 
 #include "Application.h"
@@ -287,15 +286,20 @@ bool reconstructAssets(QString assetsId, QString resourcesFolder)
 }
 
 NetAction::Ptr AssetObject::getDownloadAction()
+{
+    return getDownloadAction(BuildConfig.RESOURCE_BASE);
+}
+
+NetAction::Ptr AssetObject::getDownloadAction(const QString &resourceBase)
 {
     QFileInfo objectFile(getLocalPath());
     if ((!objectFile.isFile()) || (objectFile.size() != size))
     {
-        auto objectDL = Net::Download::makeFile(getUrl(), objectFile.filePath());
+        auto objectDL = Net::Download::makeFile(getUrl(resourceBase), objectFile.filePath());
         if(hash.size())
         {
             auto rawHash = QByteArray::fromHex(hash.toLatin1());
-            objectDL->addValidator(new Net::ChecksumValidator(QCryptographicHash::Sha1, rawHash));
+            objectDL->addDigest(QCryptographicHash::Sha1, rawHash);
         }
         objectDL->m_total_progress = size;
         return objectDL;
@@ -310,7 +314,12 @@ QString AssetObject::getLocalPath()
 
 QUrl AssetObject::getUrl()
 {
-    return BuildConfig.RESOURCE_BASE + getRelPath();
+    return getUrl(BuildConfig.RESOURCE_BASE);
+}
+
+QUrl AssetObject::getUrl(const QString &resourceBase)
+{
+    return resourceBase + getRelPath();
 }
 
 QString AssetObject::getRelPath()
@@ -320,10 +329,16 @@ QString AssetObject::getRelPath()
 
 NetJob::Ptr AssetsIndex::getDownloadJob()
 {
-    auto job = new NetJob(QObject::tr("Assets for %1").arg(id), APPLICATION->network());
+    return getDownloadJob(APPLICATION->network(), BuildConfig.RESOURCE_BASE);
+}
+
+NetJob::Ptr AssetsIndex::getDownloadJob(shared_qobject_ptr<QNetworkAccessManager> network, const QString &resourceBase)
+{
+    auto job = new NetJob(QObject::tr("Assets for %1").arg(id), network);
+    job->setPriority(Net::Priority::LaunchCritical);
     for (auto &object : objects.values())
     {
-        auto dl = object.getDownloadAction();
+        auto dl = object.getDownloadAction(resourceBase);
         if(dl)
         {
             job->addNetAction(dl);
@@ -24,8 +24,11 @@ struct AssetObject
 {
     QString getRelPath();
     QUrl getUrl();
+    /// where the object is on a server with the same layout as the Mojang one
+    QUrl getUrl(const QString &resourceBase);
     QString getLocalPath();
     NetAction::Ptr getDownloadAction();
+    NetAction::Ptr getDownloadAction(const QString &resourceBase);
 
     QString hash;
     qint64 size;
@@ -34,6 +37,8 @@ struct AssetObject
 struct AssetsIndex
 {
     NetJob::Ptr getDownloadJob();
+    /// same, from another server and through another network
+    NetJob::Ptr getDownloadJob(shared_qobject_ptr<QNetworkAccessManager> network, const QString &resourceBase);
 
     QString id;
     QMap<QString, AssetObject> objects;
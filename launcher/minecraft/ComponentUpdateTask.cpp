@@ -6,6 +6,7 @@
 #include "meta/Index.h"
 #include "meta/VersionList.h"
 #include "meta/Version.h"
+#include "meta/LoadBatch.h"
 #include "ComponentUpdateTask_p.h"
 #include "cassert"
 #include "Version.h"
@@ -13,6 +14,7 @@
 #include "OneSixVersionFormat.h"
 
 #include "Application.h"
+#include "BuildConfig.h"
 
 /*
  * This is responsible for loading the components of a component list AND resolving dependency issues between them
@@ -69,7 +71,7 @@ LoadResult composeLoadResult(LoadResult a, LoadResult b)
     return a;
 }
 
-static LoadResult loadComponent(ComponentPtr component, Task::Ptr& loadTask, Net::Mode netmode)
+static LoadResult loadComponent(ComponentPtr component, Task::Ptr& loadTask, Meta::LoadBatch & batch)
 {
     if(component->m_loaded)
     {
@@ -112,12 +114,16 @@ static LoadResult loadComponent(ComponentPtr component, Task::Ptr& loadTask, Net
         }
         else
         {
-            metaVersion->load(netmode);
-            loadTask = metaVersion->getCurrentTask();
+            // a local copy is used right away, a newer one only matters for the next launch
+            batch.add(metaVersion.get());
+            loadTask = metaVersion->getBlockingTask();
             if(loadTask)
                 result = LoadResult::RequiresRemote;
             else if (metaVersion->isLoaded())
+            {
+                component->m_loaded = true;
                 result = LoadResult::LoadedLocal;
+            }
             else
                 result = LoadResult::Failed;
         }
@@ -152,7 +158,7 @@ static LoadResult loadPackProfile(ComponentPtr component, Task::Ptr& loadTask, N
 }
 */
 
-static LoadResult loadIndex(Task::Ptr& loadTask, Net::Mode netmode)
+static LoadResult loadIndex(Task::Ptr& loadTask, Meta::LoadBatch & batch)
 {
     // FIXME: DECIDE. do we want to run the update task anyway?
     if(APPLICATION->metadataIndex()->isLoaded())
@@ -160,8 +166,8 @@ static LoadResult loadIndex(Task::Ptr& loadTask, Net::Mode netmode)
         qDebug() << "Index is already loaded";
         return LoadResult::LoadedLocal;
     }
-    APPLICATION->metadataIndex()->load(netmode);
-    loadTask = APPLICATION->metadataIndex()->getCurrentTask();
+    batch.add(APPLICATION->metadataIndex().get());
+    loadTask = APPLICATION->metadataIndex()->getBlockingTask();
     if(loadTask)
     {
         return LoadResult::RequiresRemote;
@@ -177,11 +183,31 @@ void ComponentUpdateTask::loadComponents()
     size_t taskIndex = 0;
     size_t componentIndex = 0;
     d->remoteLoadSuccessful = true;
+    // everything missing is downloaded by one job
+    Meta::LoadBatch batch(d->netmode, APPLICATION->network(), APPLICATION->metacache().get(), APPLICATION->metadataIndex().get(), QUrl(BuildConfig.META_URL));
+    if(d->mode == Mode::Resolution)
+    {
+        // what resolving the dependencies is going to add or change, see resolveDependencies()
+        QHash<QString, QString> installed;
+        for (auto component: d->m_list->d->components)
+        {
+            installed.insert(component->getID(), component->getVersion());
+        }
+        batch.setRequirementPicker([installed](const Meta::Require & require) -> QString
+        {
+            if(installed.contains(require.uid))
+            {
+                bool changes = !require.equalsVersion.isEmpty() && require.equalsVersion != installed.value(require.uid);
+                return changes ? require.equalsVersion : QString();
+            }
+            return require.equalsVersion.isEmpty() ? require.suggests : require.equalsVersion;
+        });
+    }
     // load the main index (it is needed to determine if components can revert)
     {
         // FIXME: tear out as a method? or lambda?
         Task::Ptr indexLoadTask;
-        auto singleResult = loadIndex(indexLoadTask, d->netmode);
+        auto singleResult = loadIndex(indexLoadTask, batch);
         result = composeLoadResult(result, singleResult);
         if(indexLoadTask)
         {
@@ -224,7 +250,7 @@ void ComponentUpdateTask::loadComponents()
             }
         }
 #else
-        singleResult = loadComponent(component, loadTask, d->netmode);
+        singleResult = loadComponent(component, loadTask, batch);
         loadType = RemoteLoadStatus::Type::Version;
 #endif
         if(singleResult == LoadResult::LoadedLocal)
@@ -252,6 +278,7 @@ void ComponentUpdateTask::loadComponents()
         componentIndex++;
     }
     d->remoteTasksInProgress = taskIndex;
+    batch.start();
     switch(result)
     {
         case LoadResult::LoadedLocal:
@@ -698,6 +725,8 @@ void ComponentUpdateTask::checkIfAllFinished()
                 allErrorsList.append(item.error);
             }
         }
+        // the loads share a job, and so its error
+        allErrorsList.removeDuplicates();
         auto allErrors = allErrorsList.join("\n");
         emitFailed(tr("Component metadata update task failed while downloading from remote server:\n%1").arg(allErrors));
         d->remoteLoadStatusList.clear();
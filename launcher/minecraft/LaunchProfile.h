@@ -6,6 +6,7 @@
 
 class LaunchProfile: public ProblemProvider
 {
+    friend class LaunchProfileCache;
 public:
     virtual ~LaunchProfile() {};
 
@@ -0,0 +1,187 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LaunchProfileCache.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QJsonArray>
+#include <QDebug>
+
+#include "LaunchProfile.h"
+#include "OneSixVersionFormat.h"
+#include "FileSystem.h"
+#include "Json.h"
+
+/*
+ * File layout, a QDataStream:
+ *     u32 magic "MMCP"
+ *     u32 version
+ *     QByteArray key
+ *     QString Minecraft version, version type, arguments, main class, applet class
+ *     QStringList tweakers
+ *     QSet<QString> traits
+ *     u8 problem severity
+ *     bool has assets, then QString id, url, sha1, path, i32 size, i32 total size, bool known
+ *     QByteArray all the libraries, as binary JSON in the format of the patch files
+ */
+namespace {
+// 'MMCP'
+const quint32 cacheMagic = 0x4D4D4350;
+const quint32 cacheVersion = 1;
+
+QJsonArray librariesToJson(const QList<LibraryPtr> &libraries)
+{
+    QJsonArray out;
+    for(auto & library: libraries)
+    {
+        out.append(OneSixVersionFormat::libraryToJson(library.get()));
+    }
+    return out;
+}
+
+/// @throw JsonException
+QList<LibraryPtr> librariesFromJson(ProblemContainer &problems, const QJsonObject &obj, const QString &key,
+                                    const QString &path)
+{
+    QList<LibraryPtr> out;
+    for(auto libVal: Json::ensureArray(obj, key))
+    {
+        out.append(OneSixVersionFormat::libraryFromJson(problems, Json::requireValueObject(libVal), path));
+    }
+    return out;
+}
+}
+
+std::shared_ptr<LaunchProfile> LaunchProfileCache::read(const QString &path, const QByteArray &key)
+{
+    return readProfile(path, &key);
+}
+
+std::shared_ptr<LaunchProfile> LaunchProfileCache::readLast(const QString &path)
+{
+    return readProfile(path, nullptr);
+}
+
+std::shared_ptr<LaunchProfile> LaunchProfileCache::readProfile(const QString &path, const QByteArray *key)
+{
+    QFile file(path);
+    if(!file.open(QFile::ReadOnly))
+    {
+        return nullptr;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray storedKey;
+    in >> magic >> version >> storedKey;
+    if(in.status() != QDataStream::Ok || magic != cacheMagic || version != cacheVersion || (key && storedKey != *key))
+    {
+        return nullptr;
+    }
+
+    auto profile = std::make_shared<LaunchProfile>();
+    quint8 severity = 0;
+    bool hasAssets = false;
+    in >> profile->m_minecraftVersion >> profile->m_minecraftVersionType >> profile->m_minecraftArguments
+       >> profile->m_mainClass >> profile->m_appletClass >> profile->m_tweakers >> profile->m_traits >> severity
+       >> hasAssets;
+    if(hasAssets)
+    {
+        auto assets = std::make_shared<MojangAssetIndexInfo>();
+        qint32 size = 0;
+        qint32 totalSize = 0;
+        in >> assets->id >> assets->url >> assets->sha1 >> assets->path >> size >> totalSize >> assets->known;
+        assets->size = size;
+        assets->totalSize = totalSize;
+        profile->m_minecraftAssets = assets;
+    }
+    QByteArray libraries;
+    in >> libraries;
+    if(in.status() != QDataStream::Ok || severity > quint8(ProblemSeverity::Error))
+    {
+        qWarning() << "Ignoring damaged launch profile cache" << path;
+        return nullptr;
+    }
+    profile->m_problemSeverity = ProblemSeverity(severity);
+
+    try
+    {
+        auto obj = Json::requireObject(Json::requireDocument(libraries, path), path);
+        ProblemContainer problems;
+        profile->m_libraries = librariesFromJson(problems, obj, "libraries", path);
+        profile->m_nativeLibraries = librariesFromJson(problems, obj, "nativeLibraries", path);
+        profile->m_mavenFiles = librariesFromJson(problems, obj, "mavenFiles", path);
+        profile->m_jarMods = librariesFromJson(problems, obj, "jarMods", path);
+        profile->m_mods = librariesFromJson(problems, obj, "mods", path);
+        if(obj.contains("mainJar"))
+        {
+            profile->m_mainJar = OneSixVersionFormat::libraryFromJson(problems, Json::requireObject(obj, "mainJar"), path);
+        }
+        if(problems.getProblemSeverity() == ProblemSeverity::Error)
+        {
+            qWarning() << "Ignoring damaged launch profile cache" << path;
+            return nullptr;
+        }
+    }
+    catch (const Exception &e)
+    {
+        qWarning() << "Ignoring damaged launch profile cache" << path << ":" << e.cause();
+        return nullptr;
+    }
+    return profile;
+}
+
+bool LaunchProfileCache::write(const QString &path, const QByteArray &key, const LaunchProfile &profile)
+{
+    QJsonObject libraries;
+    libraries.insert("libraries", librariesToJson(profile.m_libraries));
+    libraries.insert("nativeLibraries", librariesToJson(profile.m_nativeLibraries));
+    libraries.insert("mavenFiles", librariesToJson(profile.m_mavenFiles));
+    libraries.insert("jarMods", librariesToJson(profile.m_jarMods));
+    libraries.insert("mods", librariesToJson(profile.m_mods));
+    if(profile.m_mainJar)
+    {
+        libraries.insert("mainJar", OneSixVersionFormat::libraryToJson(profile.m_mainJar.get()));
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << cacheMagic << cacheVersion << key;
+    out << profile.m_minecraftVersion << profile.m_minecraftVersionType << profile.m_minecraftArguments
+        << profile.m_mainClass << profile.m_appletClass << profile.m_tweakers << profile.m_traits
+        << quint8(profile.m_problemSeverity);
+    auto assets = profile.m_minecraftAssets;
+    out << bool(assets);
+    if(assets)
+    {
+        out << assets->id << assets->url << assets->sha1 << assets->path << qint32(assets->size)
+            << qint32(assets->totalSize) << assets->known;
+    }
+    out << Json::toBinary(libraries);
+
+    try
+    {
+        FS::write(path, data);
+    }
+    catch (const Exception &e)
+    {
+        qWarning() << "Couldn't store the launch profile cache" << path << ":" << e.cause();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <memory>
+
+class LaunchProfile;
+
+/*
+ * The launch profile of an instance, as it was last put together from its components.
+ *
+ * Putting it together means going through every patch and meta file of the instance, so the result is kept next to
+ * them in a compact binary file. The file is only good for as long as the key it was written with matches, see
+ * PackProfile for what goes into the key.
+ */
+class LaunchProfileCache
+{
+public:
+    /// the profile stored in `path` with `key`. Null if there is none, or it was stored with another key.
+    static std::shared_ptr<LaunchProfile> read(const QString &path, const QByteArray &key);
+
+    /// the profile stored in `path`, whatever key it was stored with. It may not match the components anymore.
+    static std::shared_ptr<LaunchProfile> readLast(const QString &path);
+
+    /// stores the profile in `path`, to be read again with the same `key`
+    static bool write(const QString &path, const QByteArray &key, const LaunchProfile &profile);
+
+private:
+    /// checks the key if there is one
+    static std::shared_ptr<LaunchProfile> readProfile(const QString &path, const QByteArray *key);
+};
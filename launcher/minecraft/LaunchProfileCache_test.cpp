@@ -0,0 +1,120 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <algorithm>
+#include "TestUtil.h"
+
+#include "FileSystem.h"
+#include "minecraft/LaunchProfile.h"
+#include "minecraft/LaunchProfileCache.h"
+#include "minecraft/MojangVersionFormat.h"
+#include "minecraft/OneSixVersionFormat.h"
+#include "minecraft/VersionFile.h"
+
+namespace {
+QJsonArray librariesToJson(const QList<LibraryPtr> & libraries)
+{
+    QJsonArray out;
+    for(auto & library: libraries)
+    {
+        out.append(OneSixVersionFormat::libraryToJson(library.get()));
+    }
+    return out;
+}
+
+/// everything the profile can tell about itself, so two of them can be compared
+QJsonObject describe(const LaunchProfile & profile)
+{
+    QJsonObject out;
+    out.insert("minecraftVersion", profile.getMinecraftVersion());
+    out.insert("minecraftVersionType", profile.getMinecraftVersionType());
+    out.insert("minecraftArguments", profile.getMinecraftArguments());
+    out.insert("mainClass", profile.getMainClass());
+    out.insert("appletClass", profile.getAppletClass());
+    out.insert("tweakers", QJsonArray::fromStringList(profile.getTweakers()));
+    auto traits = profile.getTraits().toList();
+    std::sort(traits.begin(), traits.end());
+    out.insert("traits", QJsonArray::fromStringList(traits));
+    out.insert("assets", profile.getMinecraftAssets()->id);
+    out.insert("assetsUrl", profile.getMinecraftAssets()->url);
+    out.insert("libraries", librariesToJson(profile.getLibraries()));
+    out.insert("nativeLibraries", librariesToJson(profile.getNativeLibraries()));
+    out.insert("mavenFiles", librariesToJson(profile.getMavenFiles()));
+    out.insert("jarMods", librariesToJson(profile.getJarMods()));
+    out.insert("mainJar", OneSixVersionFormat::libraryToJson(profile.getMainJar().get()));
+    out.insert("problemSeverity", int(profile.getProblemSeverity()));
+    return out;
+}
+}
+
+class LaunchProfileCacheTest : public QObject
+{
+    Q_OBJECT
+
+    LaunchProfile makeProfile()
+    {
+        auto minecraft = MojangVersionFormat::versionFileFromJson(QJsonDocument::fromJson(FS::read(QFINDTESTDATA("data/1.9.json"))), "1.9.json");
+        minecraft->uid = "net.minecraft";
+        auto main = std::make_shared<Library>();
+        main->setRawName(GradleSpecifier("com.mojang:minecraft:1.9:client"));
+        minecraft->mainJar = main;
+        minecraft->traits.insert("FirstThreadOnMacOS");
+
+        auto loader = std::make_shared<VersionFile>();
+        loader->uid = "org.example.loader";
+        loader->mainClass = "org.example.Launch";
+        loader->addTweakers = QStringList{"org.example.Tweaker"};
+        auto jarMod = std::make_shared<Library>();
+        jarMod->setRawName(GradleSpecifier("org.multimc.jarmods:abc:1"));
+        jarMod->setFilename("abc.jar");
+        jarMod->setDisplayName("A jar mod");
+        jarMod->setHint("local");
+        loader->jarMods.append(jarMod);
+        loader->addProblem(ProblemSeverity::Warning, "just a warning");
+
+        LaunchProfile profile;
+        minecraft->applyTo(&profile);
+        loader->applyTo(&profile);
+        return profile;
+    }
+
+private
+slots:
+    void test_roundTrip()
+    {
+        QTemporaryDir tempDir;
+        auto path = FS::PathCombine(tempDir.path(), "launchprofile.cache");
+        auto profile = makeProfile();
+        QVERIFY(!profile.getLibraries().isEmpty());
+        QVERIFY(LaunchProfileCache::write(path, "key", profile));
+
+        auto read = LaunchProfileCache::read(path, "key");
+        QVERIFY(read);
+        QCOMPARE(describe(*read), describe(profile));
+        QCOMPARE(read->getProblemSeverity(), ProblemSeverity::Warning);
+
+        // a profile put together from something else
+        QVERIFY(!LaunchProfileCache::read(path, "other key"));
+        // unless the key doesn't matter
+        auto last = LaunchProfileCache::readLast(path);
+        QVERIFY(last);
+        QCOMPARE(describe(*last), describe(profile));
+    }
+
+    void test_damaged()
+    {
+        QTemporaryDir tempDir;
+        auto path = FS::PathCombine(tempDir.path(), "launchprofile.cache");
+        QVERIFY(!LaunchProfileCache::read(path, "key"));
+
+        QVERIFY(LaunchProfileCache::write(path, "key", makeProfile()));
+        auto data = FS::read(path);
+        FS::write(path, data.left(data.size() / 2));
+        QVERIFY(!LaunchProfileCache::read(path, "key"));
+        QVERIFY(!LaunchProfileCache::readLast(path));
+    }
+};
+
+QTEST_GUILESS_MAIN(LaunchProfileCacheTest)
+
+#include "LaunchProfileCache_test.moc"
@@ -2,7 +2,6 @@
 #include "MinecraftInstance.h"
 
 #include <net/Download.h>
-#include <net/ChecksumValidator.h>
 #include <FileSystem.h>
 #include <BuildConfig.h>
 
@@ -21,27 +20,39 @@ void Library::getApplicableFiles(OpSys system, QStringList& jar, QStringList& na
         }
         return out.absoluteFilePath();
     };
-    QString raw_storage = storageSuffix(system);
-    if(isNative())
+    for(auto & storage: storagePaths(system))
     {
-        if (raw_storage.contains("${arch}"))
+        if(!isNative())
+        {
+            jar += actualPath(storage.path);
+        }
+        else if(storage.arch == "32")
         {
-            auto nat32Storage = raw_storage;
-            nat32Storage.replace("${arch}", "32");
-            auto nat64Storage = raw_storage;
-            nat64Storage.replace("${arch}", "64");
-            native32 += actualPath(nat32Storage);
-            native64 += actualPath(nat64Storage);
+            native32 += actualPath(storage.path);
+        }
+        else if(storage.arch == "64")
+        {
+            native64 += actualPath(storage.path);
         }
         else
         {
-            native += actualPath(raw_storage);
+            native += actualPath(storage.path);
         }
     }
-    else
+}
+
+QStringList Library::getCachedFiles(OpSys system) const
+{
+    if(isLocal())
+    {
+        return {};
+    }
+    QStringList out;
+    for(auto & storage: storagePaths(system))
     {
-        jar += actualPath(raw_storage);
+        out.append(storage.path);
     }
+    return out;
 }
 
 QList<NetAction::Ptr> Library::getDownloads(
@@ -80,6 +91,15 @@ QList<NetAction::Ptr> Library::getDownloads(
         {
             entry->setStale(true);
         }
+        else if(sha1.size() && !entry->isStale())
+        {
+            // the metadata moved on to a different file, no need to hash ours to find out
+            auto knownSha1 = entry->getDigest(QCryptographicHash::Sha1);
+            if(knownSha1.size() && knownSha1.compare(sha1, Qt::CaseInsensitive) != 0)
+            {
+                entry->setStale(true);
+            }
+        }
         if (!entry->isStale())
             return true;
         Net::Download::Options options;
@@ -92,7 +112,13 @@ QList<NetAction::Ptr> Library::getDownloads(
         {
             auto rawSha1 = QByteArray::fromHex(sha1.toLatin1());
             auto dl = Net::Download::makeCached(url, entry, options);
-            dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Sha1, rawSha1));
+            dl->addDigest(QCryptographicHash::Sha1, rawSha1);
+            // the maven repository some libraries name next to their download can stand in for it
+            if(m_mojangDownloads && !m_repositoryURL.isEmpty())
+            {
+                auto base = m_repositoryURL.endsWith('/') ? m_repositoryURL : m_repositoryURL + '/';
+                dl->setMirrors({QUrl(base + storage)});
+            }
             qDebug() << "Checksummed Download for:" << rawName().serialize() << "storage:" << storage << "url:" << url;
             out.append(dl);
         }
@@ -111,34 +137,17 @@ QList<NetAction::Ptr> Library::getDownloads(
         {
             if(m_nativeClassifiers.contains(system))
             {
-                auto nativeClassifier = m_nativeClassifiers[system];
-                if(nativeClassifier.contains("${arch}"))
+                for(auto & storage: storagePaths(system))
                 {
-                    auto nat32Classifier = nativeClassifier;
-                    nat32Classifier.replace("${arch}", "32");
-                    auto nat64Classifier = nativeClassifier;
-                    nat64Classifier.replace("${arch}", "64");
-                    auto nat32info = m_mojangDownloads->getDownloadInfo(nat32Classifier);
-                    if(nat32info)
-                    {
-                        auto cooked_storage = raw_storage;
-                        cooked_storage.replace("${arch}", "32");
-                        add_download(cooked_storage, nat32info->url, nat32info->sha1);
-                    }
-                    auto nat64info = m_mojangDownloads->getDownloadInfo(nat64Classifier);
-                    if(nat64info)
+                    auto classifier = m_nativeClassifiers[system];
+                    if(!storage.arch.isEmpty())
                     {
-                        auto cooked_storage = raw_storage;
-                        cooked_storage.replace("${arch}", "64");
-                        add_download(cooked_storage, nat64info->url, nat64info->sha1);
+                        classifier.replace("${arch}", storage.arch);
                     }
-                }
-                else
-                {
-                    auto info = m_mojangDownloads->getDownloadInfo(nativeClassifier);
+                    auto info = m_mojangDownloads->getDownloadInfo(classifier);
                     if(info)
                     {
-                        add_download(raw_storage, info->url, info->sha1);
+                        add_download(storage.path, info->url, info->sha1);
                     }
                 }
             }
@@ -183,18 +192,14 @@ QList<NetAction::Ptr> Library::getDownloads(
                 return m_repositoryURL + QChar('/') + raw_storage;
             }
         }();
-        if (raw_storage.contains("${arch}"))
-        {
-            QString cooked_storage = raw_storage;
-            QString cooked_dl = raw_dl;
-            add_download(cooked_storage.replace("${arch}", "32"), cooked_dl.replace("${arch}", "32"), QString());
-            cooked_storage = raw_storage;
-            cooked_dl = raw_dl;
-            add_download(cooked_storage.replace("${arch}", "64"), cooked_dl.replace("${arch}", "64"), QString());
-        }
-        else
+        for(auto & storage: storagePaths(system))
         {
-            add_download(raw_storage, raw_dl, QString());
+            auto url = raw_dl;
+            if(!storage.arch.isEmpty())
+            {
+                url.replace("${arch}", storage.arch);
+            }
+            add_download(storage.path, url, QString());
         }
     }
     return out;
@@ -235,6 +240,33 @@ bool Library::isAlwaysStale() const
     return m_hint == "always-stale";
 }
 
+QUrl Library::serverUrl() const
+{
+    if(m_mojangDownloads)
+    {
+        if(m_mojangDownloads->artifact)
+        {
+            return QUrl(m_mojangDownloads->artifact->url);
+        }
+        for(auto & classifier: m_mojangDownloads->classifiers)
+        {
+            if(classifier)
+            {
+                return QUrl(classifier->url);
+            }
+        }
+    }
+    if(!m_absoluteURL.isEmpty())
+    {
+        return QUrl(m_absoluteURL);
+    }
+    if(!m_repositoryURL.isEmpty())
+    {
+        return QUrl(m_repositoryURL);
+    }
+    return QUrl(BuildConfig.LIBRARY_BASE);
+}
+
 void Library::setStoragePrefix(QString prefix)
 {
     m_storagePrefix = prefix;
@@ -306,3 +338,18 @@ QString Library::storageSuffix(OpSys system) const
     }
     return nativeSpec.toPath(m_filename);
 }
+
+QList<Library::StoragePath> Library::storagePaths(OpSys system) const
+{
+    QString raw_storage = storageSuffix(system);
+    if (!raw_storage.contains("${arch}"))
+    {
+        return {{QString(), raw_storage}};
+    }
+    QList<StoragePath> out;
+    for(auto arch: {QString("32"), QString("64")})
+    {
+        out.append({arch, QString(raw_storage).replace("${arch}", arch)});
+    }
+    return out;
+}
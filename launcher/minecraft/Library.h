@@ -155,6 +155,22 @@ public: /* methods */
     QList<NetAction::Ptr> getDownloads(OpSys system, class HttpMetaCache * cache,
                                      QStringList & failedLocalFiles, const QString & overridePath) const;
 
+    /// Get the paths of the files this library keeps in the metacache, relative to the "libraries" base
+    QStringList getCachedFiles(OpSys system) const;
+
+    /// A URL on the server the library's files come from. Only good for knowing which server that is.
+    QUrl serverUrl() const;
+
+private: /* types */
+    /// one of the files the library is stored as
+    struct StoragePath
+    {
+        /// "32" or "64" for natives that come in both variants, empty otherwise
+        QString arch;
+        /// relative to the storage prefix
+        QString path;
+    };
+
 private: /* methods */
     /// the default storage prefix used by MultiMC
     static QString defaultStoragePrefix();
@@ -165,6 +181,9 @@ private: /* methods */
     /// Get the relative file path where the library should be saved
     QString storageSuffix(OpSys system) const;
 
+    /// The storage suffix with "${arch}" expanded, once for each variant it stands for
+    QList<StoragePath> storagePaths(OpSys system) const;
+
     QString hint() const
     {
         return m_hint;
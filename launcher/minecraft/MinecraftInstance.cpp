@@ -5,11 +5,13 @@
 #include "settings/Setting.h"
 #include "settings/SettingsObject.h"
 #include "Application.h"
+#include "BuildConfig.h"
 
 #include "MMCStrings.h"
 #include "pathmatcher/RegexpMatcher.h"
 #include "pathmatcher/MultiMatcher.h"
 #include "FileSystem.h"
+#include "Json.h"
 #include "java/JavaVersion.h"
 #include "MMCTime.h"
 
@@ -43,6 +45,8 @@
 #include "WorldList.h"
 
 #include "PackProfile.h"
+#include "LaunchProfileCache.h"
+#include "NativesCache.h"
 #include "AssetsUtils.h"
 #include "MinecraftUpdate.h"
 #include "MinecraftLoadAndCheck.h"
@@ -190,10 +194,19 @@ QString MinecraftInstance::binRoot() const
 
 QString MinecraftInstance::getNativePath() const
 {
+    if(!m_nativePath.isEmpty())
+    {
+        return m_nativePath;
+    }
     QDir natives_dir(FS::PathCombine(instanceRoot(), "natives/"));
     return natives_dir.absolutePath();
 }
 
+void MinecraftInstance::setNativePath(const QString &path)
+{
+    m_nativePath = path;
+}
+
 QString MinecraftInstance::getLocalLibraryPath() const
 {
     QDir libraries_dir(FS::PathCombine(instanceRoot(), "libraries/"));
@@ -851,6 +864,133 @@ Task::Ptr MinecraftInstance::createUpdateTask(Net::Mode mode)
     return nullptr;
 }
 
+QList<QUrl> MinecraftInstance::updateServers()
+{
+    QList<QUrl> servers = {
+        QUrl(BuildConfig.META_URL),
+        QUrl(BuildConfig.LIBRARY_BASE),
+        QUrl(BuildConfig.RESOURCE_BASE)
+    };
+    // whatever else the current version uses, if it is loaded
+    auto profile = m_components ? m_components->getProfile() : nullptr;
+    if(profile)
+    {
+        auto assets = profile->getMinecraftAssets();
+        if(assets)
+        {
+            servers.append(QUrl(assets->url));
+        }
+        if(auto mainJar = profile->getMainJar())
+        {
+            servers.append(mainJar->serverUrl());
+        }
+        for(auto & library: profile->getLibraries())
+        {
+            servers.append(library->serverUrl());
+        }
+        for(auto & library: profile->getNativeLibraries())
+        {
+            servers.append(library->serverUrl());
+        }
+    }
+    return servers;
+}
+
+static void addLibraryCacheEntries(const LaunchProfile & profile, QList<QPair<QString, QString>> & entries)
+{
+    QList<LibraryPtr> pool;
+    pool.append(profile.getLibraries());
+    pool.append(profile.getNativeLibraries());
+    pool.append(profile.getMavenFiles());
+    pool.append(profile.getMainJar());
+    pool.append(profile.getJarMods());
+    for(auto & library: pool)
+    {
+        if(!library)
+        {
+            continue;
+        }
+        for(auto & storage: library->getCachedFiles(currentSystem))
+        {
+            entries.append(qMakePair(QString("libraries"), storage));
+        }
+    }
+    if(auto assets = profile.getMinecraftAssets())
+    {
+        entries.append(qMakePair(QString("asset_indexes"), assets->id + ".json"));
+    }
+}
+
+bool MinecraftInstance::usedCacheEntries(QList<QPair<QString, QString>> & entries)
+{
+    // the metadata the components were resolved from
+    entries.append(qMakePair(QString("meta"), QString("index.json")));
+    // the natives of a running launch, see ExtractNatives
+    if(!m_nativePath.isEmpty())
+    {
+        QDir cacheRoot(QFileInfo(m_nativePath).path());
+        entries.append(qMakePair(QString("natives"), cacheRoot.relativeFilePath(NativesCache::manifestPath(m_nativePath))));
+    }
+
+    // components somebody loaded already are used as they are
+    if(m_components && m_components->rowCount() != 0)
+    {
+        // the components are being resolved, the profile isn't complete yet
+        if(m_components->getCurrentTask())
+        {
+            return false;
+        }
+        if(auto profile = m_components->getProfile())
+        {
+            addLibraryCacheEntries(*profile, entries);
+        }
+        for(int i = 0; i < m_components->rowCount(); i++)
+        {
+            auto component = m_components->getComponent(i);
+            if(!component || component->isCustom())
+            {
+                continue;
+            }
+            entries.append(qMakePair(QString("meta"), component->getID() + "/index.json"));
+            entries.append(qMakePair(QString("meta"), component->getID() + '/' + component->getVersion() + ".json"));
+        }
+        return true;
+    }
+
+    // the others are not loaded for this, that would keep every instance in memory. The files they were saved to are
+    // enough: the launch profile as it was last put together, and the component list. An instance that wasn't
+    // launched since the launch profile is kept only holds on to its metadata, its libraries age out like anything
+    // else that isn't used.
+    if(auto profile = LaunchProfileCache::readLast(FS::PathCombine(instanceRoot(), "launchprofile.cache")))
+    {
+        addLibraryCacheEntries(*profile, entries);
+    }
+    QJsonArray components;
+    try
+    {
+        auto document = Json::requireDocument(FS::PathCombine(instanceRoot(), "mmc-pack.json"), "Component list");
+        components = Json::ensureArray(Json::requireObject(document), "components");
+    }
+    catch (const Exception &)
+    {
+        // an instance that can't be loaded doesn't need anything
+        return true;
+    }
+    for(auto value: components)
+    {
+        auto component = value.toObject();
+        auto uid = component.value("uid").toString();
+        // customized components have their own patch file instead of the metadata
+        if(uid.isEmpty() || QFile::exists(FS::PathCombine(instanceRoot(), "patches", uid + ".json")))
+        {
+            continue;
+        }
+        entries.append(qMakePair(QString("meta"), uid + "/index.json"));
+        entries.append(qMakePair(QString("meta"), uid + '/' + component.value("cachedVersion").toString() + ".json"));
+    }
+    return true;
+}
+
 shared_qobject_ptr<LaunchTask> MinecraftInstance::createLaunchTask(AuthSessionPtr session, QuickPlayTargetPtr quickPlayTarget)
 {
     // FIXME: get rid of shared_from_this ...
@@ -57,8 +57,10 @@ public:
     // Path to the instance's minecraft bin directory.
     QString binRoot() const;
 
-    // where to put the natives during/before launch
+    // where the natives are during launch, the instance's own folder unless they were put somewhere else
     QString getNativePath() const;
+    // used by the launch for natives it found in the shared cache, empty to go back to the instance's own folder
+    void setNativePath(const QString &path);
 
     // where the instance-local libraries should be
     QString getLocalLibraryPath() const;
@@ -78,6 +80,8 @@ public:
 
     //////  Launch stuff //////
     Task::Ptr createUpdateTask(Net::Mode mode) override;
+    QList<QUrl> updateServers() override;
+    bool usedCacheEntries(QList<QPair<QString, QString>> & entries) override;
     shared_qobject_ptr<LaunchTask> createLaunchTask(AuthSessionPtr account, QuickPlayTargetPtr quickPlayTarget) override;
     QStringList extraArguments() const override;
     QStringList verboseDescription(AuthSessionPtr session, QuickPlayTargetPtr quickPlayTarget) override;
@@ -127,6 +131,7 @@ protected: // data
     mutable std::shared_ptr<ModFolderModel> m_texture_pack_list;
     mutable std::shared_ptr<WorldList> m_world_list;
     mutable std::shared_ptr<GameOptions> m_game_options;
+    QString m_nativePath;
 };
 
 typedef std::shared_ptr<MinecraftInstance> MinecraftInstancePtr;
@@ -32,6 +32,8 @@
 #include "update/AssetUpdateTask.h"
 
 #include <meta/Index.h>
+#include "net/ConnectionWarmer.h"
+#include "Application.h"
 #include <meta/Version.h>
 
 MinecraftUpdate::MinecraftUpdate(MinecraftInstance *inst, QObject *parent) : Task(parent), m_inst(inst)
@@ -41,6 +43,8 @@ MinecraftUpdate::MinecraftUpdate(MinecraftInstance *inst, QObject *parent) : Tas
 void MinecraftUpdate::executeTask()
 {
     m_tasks.clear();
+    // the handshakes can happen while the folders and metadata are being looked at
+    APPLICATION->connectionWarmer()->warmUp(m_inst->updateServers());
     // create folders
     {
         m_tasks.append(std::make_shared<FoldersTask>(m_inst));
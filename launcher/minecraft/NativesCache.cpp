@@ -0,0 +1,262 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NativesCache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QUuid>
+#include <QDebug>
+
+#include <quazip.h>
+#include <quazipdir.h>
+#include "MMCZip.h"
+#include "FileSystem.h"
+
+namespace {
+// natives extracted by a version of this that did it differently end up in another folder
+const int cacheVersion = 1;
+const char *manifestName = "natives.manifest";
+
+QString replaceSuffix (QString target, const QString &suffix, const QString &replacement)
+{
+    if (!target.endsWith(suffix))
+    {
+        return target;
+    }
+    target.resize(target.length() - suffix.length());
+    return target + replacement;
+}
+
+bool unzipNatives(QString source, QString targetFolder, bool applyJnilibHack, bool nativeOpenAL, bool nativeGLFW)
+{
+    QuaZip zip(source);
+    if(!zip.open(QuaZip::mdUnzip))
+    {
+        return false;
+    }
+    QDir directory(targetFolder);
+    if (!zip.goToFirstFile())
+    {
+        return false;
+    }
+    do
+    {
+        QString name = zip.getCurrentFileName();
+        auto lowercase = name.toLower();
+        if (nativeGLFW && name.contains("glfw")) {
+            continue;
+        }
+        if (nativeOpenAL && name.contains("openal")) {
+            continue;
+        }
+        if(applyJnilibHack)
+        {
+            name = replaceSuffix(name, ".jnilib", ".dylib");
+        }
+        QString absFilePath = directory.absoluteFilePath(name);
+        if (!JlCompress::extractFile(&zip, "", absFilePath))
+        {
+            return false;
+        }
+    } while (zip.goToNextFile());
+    zip.close();
+    if(zip.getZipError()!=0)
+    {
+        return false;
+    }
+    return true;
+}
+
+/// names the folder for the jars, empty if one of them can't be read
+QString cacheKey(const QStringList &jars, const QHash<QString, QByteArray> &knownSha1,
+                 const NativesCache::Options &options, QString &failedJar)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QString("%1 %2 %3 %4").arg(cacheVersion).arg(options.jnilibHack).arg(options.useNativeOpenAL)
+                 .arg(options.useNativeGLFW).toUtf8());
+    for(auto & jar: jars)
+    {
+        auto known = knownSha1.value(jar);
+        if(!known.isEmpty())
+        {
+            hash.addData(known);
+            continue;
+        }
+        QFile file(jar);
+        QCryptographicHash jarHash(QCryptographicHash::Sha1);
+        if(!file.open(QFile::ReadOnly) || !jarHash.addData(&file))
+        {
+            failedJar = jar;
+            return QString();
+        }
+        // later jars overwrite what the earlier ones have in the same place, so the order matters too
+        hash.addData(jarHash.result());
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+/// list everything in the folder with its size, as the last thing done to it
+bool writeManifest(const QString &folder)
+{
+    QByteArray manifest;
+    QDir dir(folder);
+    QDirIterator iter(folder, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while(iter.hasNext())
+    {
+        iter.next();
+        manifest += QByteArray::number(iter.fileInfo().size()) + ' ' + dir.relativeFilePath(iter.filePath()).toUtf8()
+            + '\n';
+    }
+    try
+    {
+        FS::write(NativesCache::manifestPath(folder), manifest);
+    }
+    catch (const Exception &e)
+    {
+        qWarning() << "Couldn't write the natives manifest:" << e.cause();
+        return false;
+    }
+    return true;
+}
+
+/// the folder has a manifest and all the files in it
+bool isComplete(const QString &folder)
+{
+    QFile manifest(NativesCache::manifestPath(folder));
+    if(!manifest.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+    for(auto & line: manifest.readAll().split('\n'))
+    {
+        if(line.isEmpty())
+        {
+            continue;
+        }
+        int space = line.indexOf(' ');
+        bool ok = false;
+        auto size = line.left(space).toLongLong(&ok);
+        if(space < 0 || !ok)
+        {
+            return false;
+        }
+        QFileInfo info(FS::PathCombine(folder, QString::fromUtf8(line.mid(space + 1))));
+        if(!info.isFile() || info.size() != size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString uniqueName(const QString &cacheRoot, const QString &key, const QString &kind)
+{
+    return FS::PathCombine(cacheRoot, key + '.' + kind + '-' + QUuid::createUuid().toString().remove('{').remove('}'));
+}
+}
+
+QString NativesCache::manifestPath(const QString &folder)
+{
+    return FS::PathCombine(folder, manifestName);
+}
+
+void NativesCache::removeLeftovers(const QString &cacheRoot, qint64 maxAgeMs)
+{
+    auto cutoff = QDateTime::currentMSecsSinceEpoch() - maxAgeMs;
+    QDir root(cacheRoot);
+    for(auto & info: root.entryInfoList({"*.part-*", "*.old-*"}, QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        // newer ones may still be in the works
+        if(info.lastModified().toMSecsSinceEpoch() < cutoff)
+        {
+            QDir(info.absoluteFilePath()).removeRecursively();
+        }
+    }
+}
+
+QString NativesCache::extract(const QString &cacheRoot, const QStringList &jars, const Options &options, QString &failedJar)
+{
+    return extract(cacheRoot, jars, QHash<QString, QByteArray>(), options, failedJar);
+}
+
+QString NativesCache::extract(const QString &cacheRoot, const QStringList &jars,
+                              const QHash<QString, QByteArray> &knownSha1, const Options &options, QString &failedJar)
+{
+    removeLeftovers(cacheRoot);
+    auto key = cacheKey(jars, knownSha1, options, failedJar);
+    if(key.isEmpty())
+    {
+        return QString();
+    }
+    auto folder = FS::PathCombine(cacheRoot, key);
+    if(isComplete(folder))
+    {
+        return folder;
+    }
+
+    auto staging = uniqueName(cacheRoot, key, "part");
+    if(!FS::ensureFolderPathExists(staging))
+    {
+        failedJar = jars.value(0);
+        return QString();
+    }
+    for(auto & jar: jars)
+    {
+        if(!unzipNatives(jar, staging, options.jnilibHack, options.useNativeOpenAL, options.useNativeGLFW))
+        {
+            QDir(staging).removeRecursively();
+            failedJar = jar;
+            return QString();
+        }
+    }
+    if(!writeManifest(staging))
+    {
+        QDir(staging).removeRecursively();
+        failedJar = jars.value(0);
+        return QString();
+    }
+    if(QDir().rename(staging, folder))
+    {
+        return folder;
+    }
+    if(!isComplete(folder))
+    {
+        // something in there is missing, an eviction that didn't go through or files deleted by hand.
+        // it goes aside as a whole, files that are still in use stay there until the leftovers are removed.
+        auto old = uniqueName(cacheRoot, key, "old");
+        if(QDir().rename(folder, old))
+        {
+            QDir(old).removeRecursively();
+        }
+        if(QDir().rename(staging, folder))
+        {
+            return folder;
+        }
+    }
+    // another launch of the same natives got there first
+    QDir(staging).removeRecursively();
+    if(!isComplete(folder))
+    {
+        qWarning() << "Couldn't move the extracted natives to" << folder;
+        failedJar = jars.value(0);
+        return QString();
+    }
+    return folder;
+}
@@ -0,0 +1,59 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Native libraries, extracted from their jars once and shared by all the instances that use the same ones.
+ *
+ * Each set of jars gets a folder named after the hashes of the jars and the options they were extracted with. Launches
+ * extract into a folder of their own and move it in place when done, so none of them ever sees a half extracted one,
+ * even when several launchers work with the same cache. A manifest of the extracted files and their sizes is written last,
+ * a folder is only used as it is if everything in it is still there.
+ */
+namespace NativesCache
+{
+struct Options
+{
+    /// rename .jnilib files to .dylib, Java 8 and newer only look for those
+    bool jnilibHack = false;
+    /// leave OpenAL out, the one of the system is used
+    bool useNativeOpenAL = false;
+    /// leave GLFW out, the one of the system is used
+    bool useNativeGLFW = false;
+};
+
+/**
+ * The folder in `cacheRoot` with the contents of `jars` in it, extracted in that order. They are extracted if no
+ * launch did that yet.
+ *
+ * Empty on failure, `failedJar` is the jar that couldn't be read or extracted then.
+ */
+QString extract(const QString &cacheRoot, const QStringList &jars, const Options &options, QString &failedJar);
+/// the same, with the SHA-1 (raw) of the jars where it is known already. Only the other jars are hashed.
+QString extract(const QString &cacheRoot, const QStringList &jars, const QHash<QString, QByteArray> &knownSha1,
+                const Options &options, QString &failedJar);
+
+/// the manifest of an extracted folder
+QString manifestPath(const QString &folder);
+
+/// delete what extractions that never finished left in `cacheRoot`, if it is older than `maxAgeMs`
+void removeLeftovers(const QString &cacheRoot, qint64 maxAgeMs = 60 * 60 * 1000);
+}
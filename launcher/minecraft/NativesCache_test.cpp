@@ -0,0 +1,210 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QtConcurrentRun>
+#include <QFuture>
+#include <QCryptographicHash>
+#include "TestUtil.h"
+
+#include <quazip.h>
+#include <quazipfile.h>
+
+#include "FileSystem.h"
+#include "minecraft/NativesCache.h"
+
+namespace {
+/// a jar at `path` with the files in `contents`
+bool makeJar(const QString & path, const QMap<QString, QByteArray> & contents)
+{
+    QuaZip zip(path);
+    if(!zip.open(QuaZip::mdCreate))
+    {
+        return false;
+    }
+    for(auto it = contents.begin(); it != contents.end(); ++it)
+    {
+        QuaZipFile file(&zip);
+        if(!file.open(QIODevice::WriteOnly, QuaZipNewInfo(it.key())))
+        {
+            return false;
+        }
+        file.write(it.value());
+        file.close();
+    }
+    zip.close();
+    return zip.getZipError() == 0;
+}
+}
+
+class NativesCacheTest : public QObject
+{
+    Q_OBJECT
+
+    QStringList makeJars(const QTemporaryDir & dir)
+    {
+        QMap<QString, QByteArray> lwjgl;
+        lwjgl.insert("liblwjgl.jnilib", "lwjgl");
+        lwjgl.insert("libopenal.so", "openal");
+        QMap<QString, QByteArray> glfw;
+        glfw.insert("libglfw.so", "glfw");
+        auto first = dir.filePath("lwjgl-natives.jar");
+        auto second = dir.filePath("glfw-natives.jar");
+        if(!makeJar(first, lwjgl) || !makeJar(second, glfw))
+        {
+            return QStringList();
+        }
+        return {first, second};
+    }
+
+private
+slots:
+    void test_extractsOnce()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto cacheRoot = dir.filePath("natives");
+
+        QString failed;
+        auto folder = NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed);
+        QVERIFY(!folder.isEmpty());
+        QCOMPARE(FS::read(FS::PathCombine(folder, "liblwjgl.jnilib")), QByteArray("lwjgl"));
+        QCOMPARE(FS::read(FS::PathCombine(folder, "libglfw.so")), QByteArray("glfw"));
+
+        // the second time, the folder is used as it is
+        FS::write(FS::PathCombine(folder, "marker"), "here");
+        QCOMPARE(NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed), folder);
+        QVERIFY(QFile::exists(FS::PathCombine(folder, "marker")));
+    }
+
+    void test_optionsGetTheirOwnFolder()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto cacheRoot = dir.filePath("natives");
+
+        QString failed;
+        auto plain = NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed);
+        NativesCache::Options options;
+        options.jnilibHack = true;
+        options.useNativeOpenAL = true;
+        options.useNativeGLFW = true;
+        auto system = NativesCache::extract(cacheRoot, jars, options, failed);
+        QVERIFY(!plain.isEmpty());
+        QVERIFY(!system.isEmpty());
+        QVERIFY(plain != system);
+        QVERIFY(QFile::exists(FS::PathCombine(system, "liblwjgl.dylib")));
+        QVERIFY(!QFile::exists(FS::PathCombine(system, "libopenal.so")));
+        QVERIFY(!QFile::exists(FS::PathCombine(system, "libglfw.so")));
+        QVERIFY(QFile::exists(FS::PathCombine(plain, "libopenal.so")));
+    }
+
+    void test_reportsBrokenJars()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto broken = dir.filePath("broken.jar");
+        FS::write(broken, "not a zip");
+        jars.append(broken);
+
+        QString failed;
+        QVERIFY(NativesCache::extract(dir.filePath("natives"), jars, NativesCache::Options(), failed).isEmpty());
+        QCOMPARE(failed, broken);
+        // nothing half done is left behind
+        QCOMPARE(QDir(dir.filePath("natives")).entryList(QDir::Dirs | QDir::NoDotAndDotDot).size(), 0);
+    }
+
+    void test_damagedFolderReplaced()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto cacheRoot = dir.filePath("natives");
+
+        QString failed;
+        auto folder = NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed);
+        QVERIFY(QFile::exists(NativesCache::manifestPath(folder)));
+
+        // a file went missing, another one was cut short
+        QVERIFY(QFile::remove(FS::PathCombine(folder, "libglfw.so")));
+        QCOMPARE(NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed), folder);
+        QCOMPARE(FS::read(FS::PathCombine(folder, "libglfw.so")), QByteArray("glfw"));
+        FS::write(FS::PathCombine(folder, "libopenal.so"), "open");
+        QCOMPARE(NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed), folder);
+        QCOMPARE(FS::read(FS::PathCombine(folder, "libopenal.so")), QByteArray("openal"));
+
+        // without a manifest it was never finished
+        QVERIFY(QFile::remove(NativesCache::manifestPath(folder)));
+        QCOMPARE(NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed), folder);
+        QVERIFY(QFile::exists(NativesCache::manifestPath(folder)));
+        QCOMPARE(QDir(cacheRoot).entryList(QDir::Dirs | QDir::NoDotAndDotDot), QStringList() << QFileInfo(folder).fileName());
+    }
+
+    void test_removesLeftovers()
+    {
+        QTemporaryDir dir;
+        auto cacheRoot = dir.filePath("natives");
+        FS::write(FS::PathCombine(cacheRoot, "abc.part-1", "liblwjgl.so"), "lwjgl");
+        FS::write(FS::PathCombine(cacheRoot, "abc.old-2", "liblwjgl.so"), "lwjgl");
+        FS::write(FS::PathCombine(cacheRoot, "abc", "liblwjgl.so"), "lwjgl");
+
+        // an extraction may still be working on them
+        NativesCache::removeLeftovers(cacheRoot);
+        QCOMPARE(QDir(cacheRoot).entryList(QDir::Dirs | QDir::NoDotAndDotDot).size(), 3);
+
+        QTest::qSleep(10);
+        NativesCache::removeLeftovers(cacheRoot, 0);
+        QCOMPARE(QDir(cacheRoot).entryList(QDir::Dirs | QDir::NoDotAndDotDot), QStringList() << "abc");
+    }
+
+    void test_knownDigests()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto cacheRoot = dir.filePath("natives");
+
+        QString failed;
+        auto folder = NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed);
+        QHash<QString, QByteArray> known;
+        known.insert(jars[0], QCryptographicHash::hash(FS::read(jars[0]), QCryptographicHash::Sha1));
+        QCOMPARE(NativesCache::extract(cacheRoot, jars, known, NativesCache::Options(), failed), folder);
+
+        // the known digest is taken as it is, without reading the jar
+        known.insert(jars[0], QCryptographicHash::hash("something else", QCryptographicHash::Sha1));
+        auto other = NativesCache::extract(cacheRoot, jars, known, NativesCache::Options(), failed);
+        QVERIFY(!other.isEmpty());
+        QVERIFY(other != folder);
+    }
+
+    void test_concurrentLaunches()
+    {
+        QTemporaryDir dir;
+        auto jars = makeJars(dir);
+        QCOMPARE(jars.size(), 2);
+        auto cacheRoot = dir.filePath("natives");
+
+        QList<QFuture<QString>> launches;
+        for(int i = 0; i < 8; i++)
+        {
+            launches.append(QtConcurrent::run([cacheRoot, jars]() -> QString
+            {
+                QString failed;
+                return NativesCache::extract(cacheRoot, jars, NativesCache::Options(), failed);
+            }));
+        }
+        auto folder = launches.first().result();
+        QVERIFY(!folder.isEmpty());
+        for(auto & launch: launches)
+        {
+            QCOMPARE(launch.result(), folder);
+        }
+        QCOMPARE(QDir(cacheRoot).entryList(QDir::Dirs | QDir::NoDotAndDotDot), QStringList() << QFileInfo(folder).fileName());
+        QCOMPARE(FS::read(FS::PathCombine(folder, "libglfw.so")), QByteArray("glfw"));
+    }
+};
+
+QTEST_GUILESS_MAIN(NativesCacheTest)
+
+#include "NativesCache_test.moc"
@@ -26,8 +26,10 @@
 
 #include "Exception.h"
 #include "minecraft/OneSixVersionFormat.h"
+#include "minecraft/LaunchProfileCache.h"
 #include "FileSystem.h"
 #include "meta/Index.h"
+#include "meta/Version.h"
 #include "minecraft/MinecraftInstance.h"
 #include "Json.h"
 
@@ -120,8 +122,7 @@ static ComponentPtr componentFromJsonV1(PackProfile * parent, const QString & co
     return component;
 }
 
-// Save the given component container data to a file
-static bool savePackProfile(const QString & filename, const ComponentContainer & container)
+static QJsonObject packProfileToJson(const ComponentContainer & container)
 {
     QJsonObject obj;
     obj.insert("formatVersion", currentComponentsFileVersion);
@@ -131,6 +132,13 @@ static bool savePackProfile(const QString & filename, const ComponentContainer &
         orderArray.append(componentToJsonV1(component));
     }
     obj.insert("components", orderArray);
+    return obj;
+}
+
+// Save the given component container data to a file
+static bool savePackProfile(const QString & filename, const ComponentContainer & container)
+{
+    auto obj = packProfileToJson(container);
     QSaveFile outFile(filename);
     if (!outFile.open(QFile::WriteOnly))
     {
@@ -256,6 +264,46 @@ QString PackProfile::patchesPattern() const
     return FS::PathCombine(d->m_instance->instanceRoot(), "patches", "%1.json");
 }
 
+QString PackProfile::launchProfileCachePath() const
+{
+    return FS::PathCombine(d->m_instance->instanceRoot(), "launchprofile.cache");
+}
+
+QByteArray PackProfile::launchProfileKey() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    // libraries that don't apply to this system are left out of the profile
+    hash.addData(OpSys_toString(currentSystem).toUtf8());
+    // the component list, as it is (or is about to be) saved in mmc-pack.json
+    hash.addData(QJsonDocument(packProfileToJson(d->components)).toJson(QJsonDocument::Compact));
+    for(auto component: d->components)
+    {
+        if(!component->isEnabled())
+        {
+            continue;
+        }
+        // the same file Component::getVersionFile gets its contents from
+        QString filename;
+        if(component->m_metaVersion)
+        {
+            filename = QDir("meta").absoluteFilePath(component->m_metaVersion->localFilename());
+        }
+        else if(component->m_file)
+        {
+            filename = component->getFilename();
+        }
+        QFile file(filename);
+        if(filename.isEmpty() || !file.open(QFile::ReadOnly))
+        {
+            return QByteArray();
+        }
+        hash.addData(component->m_uid.toUtf8());
+        hash.addData(QByteArray::number(file.size()));
+        hash.addData(&file);
+    }
+    return hash.result();
+}
+
 QString PackProfile::patchFilePathForUid(const QString& uid) const
 {
     return patchesPattern().arg(uid);
@@ -1155,6 +1203,16 @@ std::shared_ptr<LaunchProfile> PackProfile::getProfile() const
 {
     if(!d->m_profile)
     {
+        auto cachePath = launchProfileCachePath();
+        auto key = launchProfileKey();
+        if(!key.isEmpty())
+        {
+            d->m_profile = LaunchProfileCache::read(cachePath, key);
+            if(d->m_profile)
+            {
+                return d->m_profile;
+            }
+        }
         try
         {
             auto profile = std::make_shared<LaunchProfile>();
@@ -1164,6 +1222,11 @@ std::shared_ptr<LaunchProfile> PackProfile::getProfile() const
                 file->applyTo(profile.get());
             }
             d->m_profile = profile;
+            // broken profiles are put together again, the problems may go away once something is downloaded
+            if(!key.isEmpty() && profile->getProblemSeverity() != ProblemSeverity::Error)
+            {
+                LaunchProfileCache::write(cachePath, key, *profile);
+            }
         }
         catch (const Exception &error)
         {
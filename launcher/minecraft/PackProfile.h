@@ -129,6 +129,10 @@ private:
 
     QString componentsFilePath() const;
     QString patchesPattern() const;
+    QString launchProfileCachePath() const;
+
+    /// a hash of everything the launch profile is made of. Empty if some of it is not available locally.
+    QByteArray launchProfileKey() const;
 
 private slots:
     void save_internal();
@@ -0,0 +1,523 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProvisioningBundle.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#include <quazip.h>
+#include <quazipfile.h>
+
+#include "AssetsUtils.h"
+#include "FileSystem.h"
+#include "Hashing.h"
+#include "Json.h"
+#include "net/HttpMetaCache.h"
+
+namespace {
+const int formatVersion = 1;
+const char * manifestName = "manifest.json";
+// how long to wait before asking a reference source again, and how often
+const int retryDelayMs = 1000;
+const int maxSourceTries = 60;
+const qint64 chunkSize = 1024 * 1024;
+
+QString objectName(const QByteArray & sha1)
+{
+    return "objects/" + QString::fromLatin1(sha1.toHex());
+}
+
+/// relative, and staying inside the folder it is relative to
+bool isSafePath(const QString & path)
+{
+    if(path.isEmpty() || path.contains('\\') || QDir::isAbsolutePath(path))
+    {
+        return false;
+    }
+    auto clean = QDir::cleanPath(path);
+    return clean != ".." && !clean.startsWith("../");
+}
+
+/// copy `from` to `to` (if there is one), hashing what goes through. Returns false if reading or writing failed.
+bool copyHashing(QIODevice & from, QIODevice * to, QByteArray & sha1, QByteArray & md5, qint64 & size)
+{
+    Hashing::Hasher sha1Hasher(QCryptographicHash::Sha1);
+    QCryptographicHash md5Hasher(QCryptographicHash::Md5);
+    size = 0;
+    while(true)
+    {
+        auto chunk = from.read(chunkSize);
+        if(chunk.isEmpty())
+        {
+            break;
+        }
+        sha1Hasher.addData(chunk);
+        md5Hasher.addData(chunk);
+        if(to && to->write(chunk) != chunk.size())
+        {
+            return false;
+        }
+        size += chunk.size();
+    }
+    sha1 = sha1Hasher.result();
+    md5 = md5Hasher.result();
+    return from.atEnd();
+}
+
+bool hashFile(const QString & path, QByteArray & sha1, QByteArray & md5, qint64 & size)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    return copyHashing(file, nullptr, sha1, md5, size);
+}
+
+QJsonObject toJson(const ProvisioningBundle::File & file)
+{
+    QJsonObject result;
+    result.insert("base", file.base);
+    result.insert("path", file.path);
+    result.insert("sha1", QString::fromLatin1(file.sha1.toHex()));
+    result.insert("md5", QString::fromLatin1(file.md5.toHex()));
+    result.insert("size", double(file.size));
+    result.insert("cached", file.cached);
+    return result;
+}
+
+ProvisioningBundle::File fileFromJson(const QJsonObject & object)
+{
+    ProvisioningBundle::File file;
+    file.base = Json::requireString(object, "base");
+    file.path = Json::requireString(object, "path");
+    file.sha1 = QByteArray::fromHex(Json::requireString(object, "sha1").toLatin1());
+    file.md5 = QByteArray::fromHex(Json::ensureString(object, "md5").toLatin1());
+    file.size = qint64(Json::requireDouble(object, "size"));
+    file.cached = Json::ensureBoolean(object, "cached", true);
+    return file;
+}
+}
+
+ProvisioningExportTask::ProvisioningExportTask(HttpMetaCache* cache, QList<MetaCacheCollector::ReferenceSource> sources,
+                                               const QString& bundlePath)
+    : m_cache(cache), m_bundlePath(bundlePath)
+{
+    for(auto & source: sources)
+    {
+        m_pendingSources.append(qMakePair(source, 0));
+    }
+    connect(&m_watcher, &QFutureWatcher<ProvisioningBundle::Result>::finished, this, &ProvisioningExportTask::written);
+}
+
+void ProvisioningExportTask::executeTask()
+{
+    setStatus(tr("Finding the files the instances use"));
+    askSources();
+}
+
+void ProvisioningExportTask::askSources()
+{
+    while(!m_pendingSources.isEmpty())
+    {
+        auto source = m_pendingSources.takeFirst();
+        QList<MetaCacheCollector::Key> keys;
+        if(source.first(keys))
+        {
+            m_keys.append(keys);
+            continue;
+        }
+        // an instance that is still being loaded
+        if(++source.second >= maxSourceTries)
+        {
+            emitFailed(tr("Could not tell which files the instances use."));
+            return;
+        }
+        m_pendingSources.append(source);
+        QTimer::singleShot(retryDelayMs, this, &ProvisioningExportTask::askSources);
+        return;
+    }
+
+    std::vector<Candidate> candidates;
+    QSet<QString> seen;
+    for(auto & key: m_keys)
+    {
+        auto id = key.first + '/' + key.second;
+        auto basePath = m_cache->getBasePath(key.first);
+        if(seen.contains(id) || basePath.isEmpty())
+        {
+            continue;
+        }
+        seen.insert(id);
+        Candidate candidate;
+        candidate.file.base = key.first;
+        candidate.file.path = key.second;
+        candidate.fullPath = FS::PathCombine(basePath, key.second);
+        // what the file was when it was downloaded, it has to be the same now
+        auto entry = m_cache->getEntry(key.first, key.second);
+        if(entry && !entry->isStale())
+        {
+            candidate.file.sha1 = QByteArray::fromHex(entry->getDigest(QCryptographicHash::Sha1).toLatin1());
+            candidate.file.md5 = QByteArray::fromHex(entry->getMD5Sum().toLatin1());
+        }
+        candidates.push_back(candidate);
+    }
+    setStatus(tr("Writing %1").arg(m_bundlePath));
+    auto assetObjects = m_cache->getBasePath("asset_objects");
+    m_watcher.setFuture(QtConcurrent::run(&ProvisioningExportTask::writeBundle, std::move(candidates), assetObjects, m_bundlePath));
+}
+
+ProvisioningBundle::Result ProvisioningExportTask::writeBundle(std::vector<Candidate> candidates, QString assetObjects,
+                                                                QString bundlePath)
+{
+    ProvisioningBundle::Result result;
+
+    // asset indexes bring their objects along
+    std::vector<Candidate> all;
+    QSet<QString> objectHashes;
+    for(auto & candidate: candidates)
+    {
+        all.push_back(candidate);
+        if(candidate.file.base != "asset_indexes" || assetObjects.isEmpty())
+        {
+            continue;
+        }
+        AssetsIndex index;
+        if(!AssetsUtils::loadAssetsIndexJson(QFileInfo(candidate.file.path).completeBaseName(), candidate.fullPath, index))
+        {
+            continue;
+        }
+        for(auto object: index.objects)
+        {
+            if(objectHashes.contains(object.hash))
+            {
+                continue;
+            }
+            objectHashes.insert(object.hash);
+            Candidate objectCandidate;
+            objectCandidate.file.base = "asset_objects";
+            objectCandidate.file.path = object.getRelPath();
+            objectCandidate.file.sha1 = QByteArray::fromHex(object.hash.toLatin1());
+            objectCandidate.file.cached = false;
+            objectCandidate.fullPath = FS::PathCombine(assetObjects, objectCandidate.file.path);
+            all.push_back(objectCandidate);
+        }
+    }
+
+    auto partPath = bundlePath + ".part";
+    if(!FS::ensureFilePathExists(bundlePath))
+    {
+        result.error = QObject::tr("Could not create the folder for %1").arg(bundlePath);
+        return result;
+    }
+    QuaZip zip(partPath);
+    zip.setZip64Enabled(true);
+    if(!zip.open(QuaZip::mdCreate))
+    {
+        result.error = QObject::tr("Could not create %1").arg(partPath);
+        return result;
+    }
+    auto fail = [&](const QString & error) -> ProvisioningBundle::Result
+    {
+        result.error = error;
+        zip.close();
+        QFile::remove(partPath);
+        return result;
+    };
+
+    QSet<QByteArray> stored;
+    QJsonArray files;
+    for(auto & candidate: all)
+    {
+        auto & file = candidate.file;
+        auto name = file.base + '/' + file.path;
+        QByteArray sha1;
+        QByteArray md5;
+        qint64 size = 0;
+        if(!hashFile(candidate.fullPath, sha1, md5, size))
+        {
+            result.skipped.append(QObject::tr("%1 is missing").arg(name));
+            continue;
+        }
+        bool matches = file.sha1.isEmpty() ? (file.md5.isEmpty() || file.md5 == md5) : file.sha1 == sha1;
+        if(!matches)
+        {
+            result.skipped.append(QObject::tr("%1 does not match its checksum").arg(name));
+            continue;
+        }
+        file.sha1 = sha1;
+        file.md5 = md5;
+        file.size = size;
+        if(!stored.contains(sha1))
+        {
+            QFile input(candidate.fullPath);
+            QuaZipFile output(&zip);
+            // most of it is compressed already, storing it is a lot faster than trying again
+            if(!input.open(QIODevice::ReadOnly)
+               || !output.open(QIODevice::WriteOnly, QuaZipNewInfo(objectName(sha1)), nullptr, 0, 0, 0))
+            {
+                return fail(QObject::tr("Could not add %1 to the bundle").arg(name));
+            }
+            QByteArray writtenSha1;
+            QByteArray writtenMd5;
+            qint64 writtenSize = 0;
+            bool ok = copyHashing(input, &output, writtenSha1, writtenMd5, writtenSize);
+            output.close();
+            if(!ok || output.getZipError() != UNZ_OK)
+            {
+                return fail(QObject::tr("Could not add %1 to the bundle").arg(name));
+            }
+            if(writtenSha1 != sha1)
+            {
+                return fail(QObject::tr("%1 changed while it was being added to the bundle").arg(name));
+            }
+            stored.insert(sha1);
+            result.bytes += size;
+        }
+        files.append(toJson(file));
+        result.files.push_back(file);
+    }
+
+    QJsonObject manifest;
+    manifest.insert("formatVersion", formatVersion);
+    manifest.insert("files", files);
+    QuaZipFile manifestFile(&zip);
+    if(!manifestFile.open(QIODevice::WriteOnly, QuaZipNewInfo(manifestName)))
+    {
+        return fail(QObject::tr("Could not write the manifest of the bundle"));
+    }
+    auto manifestData = QJsonDocument(manifest).toJson();
+    bool manifestWritten = manifestFile.write(manifestData) == manifestData.size();
+    manifestFile.close();
+    if(!manifestWritten || manifestFile.getZipError() != UNZ_OK)
+    {
+        return fail(QObject::tr("Could not write the manifest of the bundle"));
+    }
+    zip.close();
+    if(zip.getZipError() != UNZ_OK || !FS::replaceFile(partPath, bundlePath))
+    {
+        QFile::remove(partPath);
+        result.error = QObject::tr("Could not write %1").arg(bundlePath);
+    }
+    return result;
+}
+
+void ProvisioningExportTask::written()
+{
+    auto result = m_watcher.result();
+    if(!result.error.isEmpty())
+    {
+        emitFailed(result.error);
+        return;
+    }
+    for(auto & skipped: result.skipped)
+    {
+        logWarning(skipped);
+    }
+    qDebug() << "Wrote" << result.files.size() << "files," << result.bytes << "bytes, to" << m_bundlePath;
+    emitSucceeded();
+}
+
+ProvisioningImportTask::ProvisioningImportTask(HttpMetaCache* cache, const QString& bundlePath)
+    : m_cache(cache), m_bundlePath(bundlePath)
+{
+    connect(&m_watcher, &QFutureWatcher<ProvisioningBundle::Result>::finished, this, &ProvisioningImportTask::unpacked);
+}
+
+void ProvisioningImportTask::executeTask()
+{
+    setStatus(tr("Reading %1").arg(m_bundlePath));
+    QByteArray manifestData;
+    {
+        QuaZip zip(m_bundlePath);
+        if(!zip.open(QuaZip::mdUnzip) || !zip.setCurrentFile(manifestName))
+        {
+            emitFailed(tr("%1 is not a provisioning bundle").arg(m_bundlePath));
+            return;
+        }
+        QuaZipFile manifestFile(&zip);
+        if(!manifestFile.open(QIODevice::ReadOnly))
+        {
+            emitFailed(tr("Could not read the manifest of %1").arg(m_bundlePath));
+            return;
+        }
+        manifestData = manifestFile.readAll();
+    }
+
+    std::vector<Target> targets;
+    try
+    {
+        auto manifest = Json::requireObject(Json::requireDocument(manifestData, manifestName), manifestName);
+        if(Json::requireInteger(manifest, "formatVersion") != formatVersion)
+        {
+            emitFailed(tr("%1 was made by a different version of the launcher").arg(m_bundlePath));
+            return;
+        }
+        for(auto value: Json::requireArray(manifest, "files"))
+        {
+            auto file = fileFromJson(Json::requireValueObject(value));
+            auto name = file.base + '/' + file.path;
+            auto basePath = m_cache->getBasePath(file.base);
+            if(basePath.isEmpty() || !isSafePath(file.path) || file.sha1.size() != 20)
+            {
+                logWarning(tr("%1 can't be imported").arg(name));
+                continue;
+            }
+            Target target;
+            target.file = file;
+            target.fullPath = FS::PathCombine(basePath, QDir::cleanPath(file.path));
+            // there already
+            if(file.cached)
+            {
+                auto entry = m_cache->getEntry(file.base, file.path);
+                bool known = entry && !entry->isStale()
+                    && QByteArray::fromHex(entry->getDigest(QCryptographicHash::Sha1).toLatin1()) == file.sha1;
+                if(known && QFileInfo(target.fullPath).isFile())
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                // asset objects are named by their hash, the size is all the launcher checks
+                QFileInfo info(target.fullPath);
+                if(info.isFile() && info.size() == file.size)
+                {
+                    continue;
+                }
+            }
+            targets.push_back(target);
+        }
+    }
+    catch (const Exception &e)
+    {
+        emitFailed(tr("The manifest of %1 is broken: %2").arg(m_bundlePath, e.cause()));
+        return;
+    }
+    setStatus(tr("Unpacking %1 files").arg(targets.size()));
+    m_watcher.setFuture(QtConcurrent::run(&ProvisioningImportTask::unpack, std::move(targets), m_bundlePath));
+}
+
+ProvisioningBundle::Result ProvisioningImportTask::unpack(std::vector<Target> targets, QString bundlePath)
+{
+    ProvisioningBundle::Result result;
+    QuaZip zip(bundlePath);
+    if(!zip.open(QuaZip::mdUnzip))
+    {
+        result.error = QObject::tr("Could not open %1").arg(bundlePath);
+        return result;
+    }
+    // where each object was unpacked first, later copies come from there
+    QHash<QByteArray, QString> unpackedAt;
+    for(auto & target: targets)
+    {
+        auto & file = target.file;
+        auto name = file.base + '/' + file.path;
+        auto partPath = target.fullPath + ".part";
+        if(!FS::ensureFilePathExists(target.fullPath))
+        {
+            result.skipped.append(QObject::tr("Could not create the folder for %1").arg(name));
+            continue;
+        }
+        QFile output(partPath);
+        if(!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            result.skipped.append(QObject::tr("Could not write %1").arg(name));
+            continue;
+        }
+        bool copied = false;
+        QByteArray sha1;
+        QByteArray md5;
+        qint64 size = 0;
+        if(unpackedAt.contains(file.sha1))
+        {
+            QFile input(unpackedAt[file.sha1]);
+            copied = input.open(QIODevice::ReadOnly) && copyHashing(input, &output, sha1, md5, size);
+        }
+        else if(zip.setCurrentFile(objectName(file.sha1)))
+        {
+            QuaZipFile input(&zip);
+            copied = input.open(QIODevice::ReadOnly) && copyHashing(input, &output, sha1, md5, size);
+        }
+        output.close();
+        if(!copied || sha1 != file.sha1)
+        {
+            QFile::remove(partPath);
+            result.skipped.append(copied ? QObject::tr("%1 does not match its checksum").arg(name)
+                                         : QObject::tr("Could not unpack %1").arg(name));
+            continue;
+        }
+        if(!FS::replaceFile(partPath, target.fullPath))
+        {
+            QFile::remove(partPath);
+            result.skipped.append(QObject::tr("Could not write %1").arg(name));
+            continue;
+        }
+        if(!unpackedAt.contains(file.sha1))
+        {
+            unpackedAt.insert(file.sha1, target.fullPath);
+        }
+        file.md5 = md5;
+        file.size = size;
+        result.files.push_back(file);
+        result.bytes += size;
+    }
+    return result;
+}
+
+void ProvisioningImportTask::unpacked()
+{
+    auto result = m_watcher.result();
+    if(!result.error.isEmpty())
+    {
+        emitFailed(result.error);
+        return;
+    }
+    for(auto & skipped: result.skipped)
+    {
+        logWarning(skipped);
+    }
+    // the downloads see these as cache hits now
+    for(auto & file: result.files)
+    {
+        if(!file.cached)
+        {
+            continue;
+        }
+        auto entry = m_cache->resolveEntry(file.base, file.path);
+        entry->setMD5Sum(QString::fromLatin1(file.md5.toHex()));
+        entry->clearDigests();
+        entry->setDigest(QCryptographicHash::Sha1, QString::fromLatin1(file.sha1.toHex()));
+        entry->setETag(QString());
+        entry->setLocalChangedTimestamp(QFileInfo(entry->getFullPath()).lastModified().toUTC().toMSecsSinceEpoch());
+        entry->setStale(false);
+        m_cache->updateEntry(entry);
+    }
+    m_cache->SaveNow();
+    qDebug() << "Imported" << result.files.size() << "files," << result.bytes << "bytes, from" << m_bundlePath;
+    emitSucceeded();
+}
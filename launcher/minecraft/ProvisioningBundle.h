@@ -0,0 +1,137 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tasks/Task.h"
+#include "net/MetaCacheCollector.h"
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+class HttpMetaCache;
+
+/*
+ * Provisioning bundles carry everything instances need to launch to machines that can't download it themselves.
+ *
+ * A bundle is a zip with a manifest.json and the files, stored once per SHA-1 as objects/<hex>. The manifest lists
+ * where each file goes - a metacache base and a path in it - with its SHA-1, MD5 and size. Files that the metacache
+ * keeps track of get an entry on import, so the downloads find them as cache hits. Asset objects are just put in place.
+ */
+namespace ProvisioningBundle
+{
+/// a file as the manifest has it
+struct File
+{
+    QString base;
+    QString path;
+    /// raw
+    QByteArray sha1;
+    /// raw
+    QByteArray md5;
+    qint64 size = 0;
+    /// true if it gets a metacache entry
+    bool cached = true;
+};
+
+/// what a worker thread did
+struct Result
+{
+    /// empty if it went well
+    QString error;
+    /// files that were left out, with the reason
+    QStringList skipped;
+    std::vector<File> files;
+    qint64 bytes = 0;
+};
+}
+
+/*
+ * Writes the files the instances use into a bundle.
+ *
+ * Reference sources name the metacache entries, like for MetaCacheCollector. Asset indexes among them bring their
+ * objects along. Every file is checked against the digests the metacache recorded for it, or the hash an asset object
+ * is named by - files that are missing or don't match are left out and reported as warnings.
+ */
+class ProvisioningExportTask : public Task
+{
+    Q_OBJECT
+public: /* con/des */
+    ProvisioningExportTask(HttpMetaCache * cache, QList<MetaCacheCollector::ReferenceSource> sources, const QString & bundlePath);
+    virtual ~ProvisioningExportTask() {};
+
+protected:
+    void executeTask() override;
+
+private slots:
+    void askSources();
+    void written();
+
+private: /* types */
+    struct Candidate
+    {
+        ProvisioningBundle::File file;
+        QString fullPath;
+    };
+
+private: /* methods */
+    static ProvisioningBundle::Result writeBundle(std::vector<Candidate> candidates, QString assetObjects, QString bundlePath);
+
+private: /* data */
+    HttpMetaCache * m_cache;
+    /// sources that still have to be asked, and how often they were asked already
+    QList<QPair<MetaCacheCollector::ReferenceSource, int>> m_pendingSources;
+    QList<MetaCacheCollector::Key> m_keys;
+    QString m_bundlePath;
+    QFutureWatcher<ProvisioningBundle::Result> m_watcher;
+};
+
+/*
+ * Puts the files of a bundle in place and adds their metacache entries.
+ *
+ * Every file is checked against its SHA-1 as it is unpacked. Files the metacache already has with the same SHA-1 are
+ * left alone, so importing the same bundle again is cheap.
+ */
+class ProvisioningImportTask : public Task
+{
+    Q_OBJECT
+public: /* con/des */
+    ProvisioningImportTask(HttpMetaCache * cache, const QString & bundlePath);
+    virtual ~ProvisioningImportTask() {};
+
+protected:
+    void executeTask() override;
+
+private slots:
+    void unpacked();
+
+private: /* types */
+    struct Target
+    {
+        ProvisioningBundle::File file;
+        QString fullPath;
+    };
+
+private: /* methods */
+    static ProvisioningBundle::Result unpack(std::vector<Target> targets, QString bundlePath);
+
+private: /* data */
+    HttpMetaCache * m_cache;
+    QString m_bundlePath;
+    QFutureWatcher<ProvisioningBundle::Result> m_watcher;
+};
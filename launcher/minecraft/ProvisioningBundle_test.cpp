@@ -0,0 +1,161 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QCryptographicHash>
+#include "TestUtil.h"
+
+#include <quazip.h>
+#include <quazipfile.h>
+
+#include "FileSystem.h"
+#include "minecraft/ProvisioningBundle.h"
+#include "net/MetaCacheIndex.h"
+#include "net/HttpMetaCache.h"
+
+namespace {
+QString hex(const QByteArray & data, QCryptographicHash::Algorithm algorithm)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, algorithm).toHex());
+}
+
+/// a cache in `root` with the bases bundles use here
+void setupCache(HttpMetaCache & cache, const QString & root)
+{
+    cache.addBase("libraries", FS::PathCombine(root, "libraries"));
+    cache.addBase("asset_indexes", FS::PathCombine(root, "assets/indexes"));
+    cache.addBase("asset_objects", FS::PathCombine(root, "assets/objects"));
+    cache.Load();
+}
+
+bool run(Task & task)
+{
+    QSignalSpy spy(&task, &Task::finished);
+    task.start();
+    return (spy.count() || spy.wait(10000)) && task.wasSuccessful();
+}
+}
+
+class ProvisioningBundleTest : public QObject
+{
+    Q_OBJECT
+
+    /// a libraries entry for a file with `contents`, recorded as having `recorded`
+    MetaCacheRecord addLibrary(const QString & root, const QString & path, const QByteArray & contents,
+                               const QByteArray & recorded)
+    {
+        FS::write(FS::PathCombine(root, "libraries", path), contents);
+        MetaCacheRecord result;
+        result.base = "libraries";
+        result.path = path;
+        result.md5sum = hex(recorded, QCryptographicHash::Md5);
+        QMap<QString, QString> digests;
+        digests.insert("sha1", hex(recorded, QCryptographicHash::Sha1));
+        result.digests = MetaEntry::encodeDigests(digests);
+        result.local_changed_timestamp = QFileInfo(FS::PathCombine(root, "libraries", path)).lastModified().toUTC().toMSecsSinceEpoch();
+        return result;
+    }
+
+private
+slots:
+    void test_roundTrip()
+    {
+        QTemporaryDir tempDir;
+        auto source = FS::PathCombine(tempDir.path(), "source");
+        auto target = FS::PathCombine(tempDir.path(), "target");
+        auto bundlePath = FS::PathCombine(tempDir.path(), "bundle.zip");
+
+        QByteArray library("library contents");
+        QByteArray object("asset object");
+        auto objectHash = hex(object, QCryptographicHash::Sha1);
+        FS::write(FS::PathCombine(source, "assets/objects", objectHash.left(2), objectHash), object);
+        FS::write(FS::PathCombine(source, "assets/indexes/1.json"),
+                  QString("{\"objects\": {\"a/b.ogg\": {\"hash\": \"%1\", \"size\": %2}}}").arg(objectHash).arg(object.size()).toUtf8());
+
+        QVector<MetaCacheRecord> records;
+        records.append(addLibrary(source, "a.jar", library, library));
+        // the same file in another place, it is only stored once
+        records.append(addLibrary(source, "b.jar", library, library));
+        // got damaged since it was downloaded
+        records.append(addLibrary(source, "broken.jar", "damaged", library));
+        QVERIFY(HttpMetaCache::writeSnapshot(FS::PathCombine(source, "metacache"), records));
+
+        {
+            HttpMetaCache cache(FS::PathCombine(source, "metacache"));
+            setupCache(cache, source);
+            QList<MetaCacheCollector::ReferenceSource> sources;
+            sources.append([](QList<MetaCacheCollector::Key> & keys) -> bool
+            {
+                keys.append(qMakePair(QString("libraries"), QString("a.jar")));
+                keys.append(qMakePair(QString("libraries"), QString("b.jar")));
+                keys.append(qMakePair(QString("libraries"), QString("broken.jar")));
+                keys.append(qMakePair(QString("libraries"), QString("missing.jar")));
+                keys.append(qMakePair(QString("asset_indexes"), QString("1.json")));
+                return true;
+            });
+            ProvisioningExportTask task(&cache, sources, bundlePath);
+            QVERIFY(run(task));
+            QCOMPARE(task.warnings().size(), 2);
+        }
+
+        QuaZip zip(bundlePath);
+        QVERIFY(zip.open(QuaZip::mdUnzip));
+        // the manifest, the library, the asset index and the asset object
+        QCOMPARE(zip.getEntriesCount(), 4);
+        zip.close();
+
+        HttpMetaCache cache(FS::PathCombine(target, "metacache"));
+        setupCache(cache, target);
+        {
+            ProvisioningImportTask task(&cache, bundlePath);
+            QVERIFY(run(task));
+            QCOMPARE(task.warnings().size(), 0);
+        }
+        QCOMPARE(FS::read(FS::PathCombine(target, "libraries/a.jar")), library);
+        QCOMPARE(FS::read(FS::PathCombine(target, "libraries/b.jar")), library);
+        QVERIFY(!QFile::exists(FS::PathCombine(target, "libraries/broken.jar")));
+        QCOMPARE(FS::read(FS::PathCombine(target, "assets/objects", objectHash.left(2), objectHash)), object);
+
+        // downloads find them as cache hits
+        auto entry = cache.resolveEntry("libraries", "b.jar");
+        QVERIFY(!entry->isStale());
+        QCOMPARE(entry->getDigest(QCryptographicHash::Sha1), hex(library, QCryptographicHash::Sha1));
+        QCOMPARE(entry->getMD5Sum(), hex(library, QCryptographicHash::Md5));
+        QVERIFY(!cache.resolveEntry("asset_indexes", "1.json")->isStale());
+
+        // nothing left to do the second time
+        ProvisioningImportTask again(&cache, bundlePath);
+        QVERIFY(run(again));
+    }
+
+    void test_rejectsEscapingPaths()
+    {
+        QTemporaryDir tempDir;
+        auto bundlePath = FS::PathCombine(tempDir.path(), "bundle.zip");
+        QByteArray contents("escape");
+        {
+            QuaZip zip(bundlePath);
+            QVERIFY(zip.open(QuaZip::mdCreate));
+            QuaZipFile manifest(&zip);
+            QVERIFY(manifest.open(QIODevice::WriteOnly, QuaZipNewInfo("manifest.json")));
+            manifest.write(QString("{\"formatVersion\": 1, \"files\": [{\"base\": \"libraries\", \"path\": \"../../../evil.jar\", "
+                                   "\"sha1\": \"%1\", \"size\": %2}]}")
+                           .arg(hex(contents, QCryptographicHash::Sha1)).arg(contents.size()).toUtf8());
+            manifest.close();
+            QuaZipFile object(&zip);
+            QVERIFY(object.open(QIODevice::WriteOnly, QuaZipNewInfo("objects/" + hex(contents, QCryptographicHash::Sha1))));
+            object.write(contents);
+            object.close();
+        }
+        auto target = FS::PathCombine(tempDir.path(), "a/b");
+        HttpMetaCache cache(FS::PathCombine(target, "metacache"));
+        setupCache(cache, target);
+        ProvisioningImportTask task(&cache, bundlePath);
+        QVERIFY(run(task));
+        QCOMPARE(task.warnings().size(), 1);
+        QVERIFY(!QFile::exists(FS::PathCombine(tempDir.path(), "evil.jar")));
+    }
+};
+
+QTEST_GUILESS_MAIN(ProvisioningBundleTest)
+
+#include "ProvisioningBundle_test.moc"
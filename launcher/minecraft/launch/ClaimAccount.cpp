@@ -6,6 +6,7 @@
 
 ClaimAccount::ClaimAccount(LaunchTask* parent, AuthSessionPtr session): LaunchStep(parent)
 {
+    declareResources({}, Account);
     m_playerName = session->player_name;
     if(session->status == AuthSession::Status::PlayableOnline && !session->demo)
     {
@@ -5,6 +5,7 @@
 
 CreateGameFolders::CreateGameFolders(LaunchTask* parent): LaunchStep(parent)
 {
+    declareResources({}, GameFolder);
 }
 
 void CreateGameFolders::executeTask()
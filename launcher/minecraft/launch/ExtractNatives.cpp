@@ -17,11 +17,13 @@
 #include <minecraft/MinecraftInstance.h>
 #include <launch/LaunchTask.h>
 
-#include <quazip.h>
-#include <quazipdir.h>
-#include "MMCZip.h"
-#include "FileSystem.h"
+#include <minecraft/NativesCache.h>
+#include <QCryptographicHash>
 #include <QDir>
+#include <QFileInfo>
+#include <QtConcurrentRun>
+
+#include "Application.h"
 
 #ifdef major
     #undef major
@@ -30,89 +32,85 @@
     #undef minor
 #endif
 
-static QString replaceSuffix (QString target, const QString &suffix, const QString &replacement)
+void ExtractNatives::executeTask()
 {
-    if (!target.endsWith(suffix))
+    auto instance = m_parent->instance();
+    std::shared_ptr<MinecraftInstance> minecraftInstance = std::dynamic_pointer_cast<MinecraftInstance>(instance);
+    auto toExtract = minecraftInstance->getNativeJars();
+    if(toExtract.isEmpty())
     {
-        return target;
+        emitSucceeded();
+        return;
     }
-    target.resize(target.length() - suffix.length());
-    return target + replacement;
-}
+    auto settings = minecraftInstance->settings();
+    NativesCache::Options options;
+    options.useNativeOpenAL = settings->get("UseNativeOpenAL").toBool();
+    options.useNativeGLFW = settings->get("UseNativeGLFW").toBool();
+    options.jnilibHack = minecraftInstance->getJavaVersion().major() >= 8;
 
-static bool unzipNatives(QString source, QString targetFolder, bool applyJnilibHack, bool nativeOpenAL, bool nativeGLFW)
-{
-    QuaZip zip(source);
-    if(!zip.open(QuaZip::mdUnzip))
-    {
-        return false;
-    }
-    QDir directory(targetFolder);
-    if (!zip.goToFirstFile())
+    // the jars that were downloaded have their SHA-1 in the metacache, they don't have to be read to find the folder
+    auto metacache = APPLICATION->metacache();
+    QDir libraries(metacache->getBasePath("libraries"));
+    QHash<QString, QByteArray> knownSha1;
+    for(auto & jar: toExtract)
     {
-        return false;
-    }
-    do
-    {
-        QString name = zip.getCurrentFileName();
-        auto lowercase = name.toLower();
-        if (nativeGLFW && name.contains("glfw")) {
-            continue;
-        }
-        if (nativeOpenAL && name.contains("openal")) {
-            continue;
-        }
-        if(applyJnilibHack)
+        auto path = libraries.relativeFilePath(jar);
+        if(path.startsWith(".."))
         {
-            name = replaceSuffix(name, ".jnilib", ".dylib");
+            continue;
         }
-        QString absFilePath = directory.absoluteFilePath(name);
-        if (!JlCompress::extractFile(&zip, "", absFilePath))
+        auto entry = metacache->resolveEntry("libraries", path);
+        auto sha1 = entry->isStale() ? QString() : entry->getDigest(QCryptographicHash::Sha1);
+        if(!sha1.isEmpty())
         {
-            return false;
+            knownSha1.insert(jar, QByteArray::fromHex(sha1.toLatin1()));
         }
-    } while (zip.goToNextFile());
-    zip.close();
-    if(zip.getZipError()!=0)
-    {
-        return false;
     }
-    return true;
+
+    // shared by all instances, the same jars are only ever extracted once
+    auto cachePath = metacache->getBasePath("natives");
+    m_cachePath = cachePath;
+    // the other launch steps go on while the jars are extracted
+    m_watcher.setFuture(QtConcurrent::run([cachePath, toExtract, knownSha1, options]() -> Extraction
+    {
+        Extraction result;
+        result.folder = NativesCache::extract(cachePath, toExtract, knownSha1, options, result.failedJar);
+        return result;
+    }));
 }
 
-void ExtractNatives::executeTask()
+void ExtractNatives::extractionFinished()
 {
-    auto instance = m_parent->instance();
-    std::shared_ptr<MinecraftInstance> minecraftInstance = std::dynamic_pointer_cast<MinecraftInstance>(instance);
-    auto toExtract = minecraftInstance->getNativeJars();
-    if(toExtract.isEmpty())
+    auto result = m_watcher.result();
+    if(result.folder.isEmpty())
     {
-        emitSucceeded();
+        const char *reason = QT_TR_NOOP("Couldn't extract native jar '%1' to destination '%2'");
+        emit logLine(QString(reason).arg(result.failedJar, m_cachePath), MessageLevel::Fatal);
+        emitFailed(tr(reason).arg(result.failedJar, m_cachePath));
         return;
     }
-    auto settings = minecraftInstance->settings();
-    bool nativeOpenAL = settings->get("UseNativeOpenAL").toBool();
-    bool nativeGLFW = settings->get("UseNativeGLFW").toBool();
-
-    auto outputPath  = minecraftInstance->getNativePath();
-    auto javaVersion = minecraftInstance->getJavaVersion();
-    bool jniHackEnabled = javaVersion.major() >= 8;
-    for(const auto &source: toExtract)
+    // the metacache collector keeps the cache within its budget, evicting folders nothing used for a while
+    auto metacache = APPLICATION->metacache();
+    auto manifestPath = QDir(m_cachePath).relativeFilePath(NativesCache::manifestPath(result.folder));
+    auto entry = metacache->resolveEntry("natives", manifestPath);
+    QFile manifest(entry->getFullPath());
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    if(entry->isStale() && manifest.open(QFile::ReadOnly) && md5.addData(&manifest))
     {
-        if(!unzipNatives(source, outputPath, jniHackEnabled, nativeOpenAL, nativeGLFW))
-        {
-            const char *reason = QT_TR_NOOP("Couldn't extract native jar '%1' to destination '%2'");
-            emit logLine(QString(reason).arg(source, outputPath), MessageLevel::Fatal);
-            emitFailed(tr(reason).arg(source, outputPath));
-        }
+        entry->setMD5Sum(QString::fromLatin1(md5.result().toHex()));
+        entry->setETag(QString());
+        entry->setLocalChangedTimestamp(QFileInfo(manifest).lastModified().toUTC().toMSecsSinceEpoch());
+        entry->setStale(false);
+        metacache->updateEntry(entry);
     }
+    auto minecraftInstance = std::dynamic_pointer_cast<MinecraftInstance>(m_parent->instance());
+    minecraftInstance->setNativePath(result.folder);
     emitSucceeded();
 }
 
 void ExtractNatives::finalize()
 {
-    auto instance = m_parent->instance();
-    QString target_dir = FS::PathCombine(instance->instanceRoot(), "natives/");
-    QDir dir(target_dir);
-    dir.removeRecursively();
+    // the extracted natives stay in the cache for the next launch
+    auto minecraftInstance = std::dynamic_pointer_cast<MinecraftInstance>(m_parent->instance());
+    minecraftInstance->setNativePath(QString());
 }
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <launch/LaunchStep.h>
+#include <QFutureWatcher>
 #include <memory>
 #include "minecraft/auth/AuthSession.h"
 
@@ -24,7 +25,11 @@ class ExtractNatives: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit ExtractNatives(LaunchTask *parent) : LaunchStep(parent){};
+    explicit ExtractNatives(LaunchTask *parent) : LaunchStep(parent)
+    {
+        declareResources(GameFiles | Java, Natives);
+        connect(&m_watcher, &QFutureWatcher<Extraction>::finished, this, &ExtractNatives::extractionFinished);
+    };
     virtual ~ExtractNatives(){};
 
     void executeTask() override;
@@ -33,6 +38,21 @@ public:
         return false;
     }
     void finalize() override;
+
+private slots:
+    void extractionFinished();
+
+private: /* types */
+    struct Extraction
+    {
+        /// the folder in the natives cache, empty if extracting failed
+        QString folder;
+        QString failedJar;
+    };
+
+private: /* data */
+    QFutureWatcher<Extraction> m_watcher;
+    QString m_cachePath;
 };
 
 
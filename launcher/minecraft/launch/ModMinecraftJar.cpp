@@ -21,6 +21,8 @@
 #include "minecraft/MinecraftInstance.h"
 #include "minecraft/PackProfile.h"
 
+#include <QtConcurrentRun>
+
 void ModMinecraftJar::executeTask()
 {
     auto m_inst = std::dynamic_pointer_cast<MinecraftInstance>(m_parent->instance());
@@ -34,12 +36,14 @@ void ModMinecraftJar::executeTask()
     if(!FS::ensureFolderPathExists(m_inst->binRoot()))
     {
         emitFailed(tr("Couldn't create the bin folder for Minecraft.jar"));
+        return;
     }
 
     auto finalJarPath = QDir(m_inst->binRoot()).absoluteFilePath("minecraft.jar");
     if(!removeJar())
     {
         emitFailed(tr("Couldn't remove stale jar file: %1").arg(finalJarPath));
+        return;
     }
 
     // create temporary modded jar, if needed
@@ -52,11 +56,19 @@ void ModMinecraftJar::executeTask()
         QStringList jars, temp1, temp2, temp3, temp4;
         mainJar->getApplicableFiles(currentSystem, jars, temp1, temp2, temp3, m_inst->getLocalLibraryPath());
         auto sourceJarPath = jars[0];
-        if(!MMCZip::createModdedJar(sourceJarPath, finalJarPath, jarMods))
-        {
-            emitFailed(tr("Failed to create the custom Minecraft jar file."));
-            return;
-        }
+        // the other launch steps go on while the jar is put together
+        m_watcher.setFuture(QtConcurrent::run(&MMCZip::createModdedJar, sourceJarPath, finalJarPath, jarMods));
+        return;
+    }
+    emitSucceeded();
+}
+
+void ModMinecraftJar::jarFinished()
+{
+    if(!m_watcher.result())
+    {
+        emitFailed(tr("Failed to create the custom Minecraft jar file."));
+        return;
     }
     emitSucceeded();
 }
@@ -16,13 +16,18 @@
 #pragma once
 
 #include <launch/LaunchStep.h>
+#include <QFutureWatcher>
 #include <memory>
 
 class ModMinecraftJar: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit ModMinecraftJar(LaunchTask *parent) : LaunchStep(parent) {};
+    explicit ModMinecraftJar(LaunchTask *parent) : LaunchStep(parent)
+    {
+        declareResources(GameFiles, ModdedJar);
+        connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &ModMinecraftJar::jarFinished);
+    };
     virtual ~ModMinecraftJar(){};
 
     virtual void executeTask() override;
@@ -31,6 +36,11 @@ public:
         return false;
     }
     void finalize() override;
+private slots:
+    void jarFinished();
 private:
     bool removeJar();
+
+private: /* data */
+    QFutureWatcher<bool> m_watcher;
 };
@@ -19,6 +19,8 @@
 #include "PrintInstanceInfo.h"
 #include <launch/LaunchTask.h>
 
+#include <QtConcurrentRun>
+
 #if defined(Q_OS_LINUX) || defined(Q_OS_FREEBSD)
 namespace {
 #if defined(Q_OS_LINUX)
@@ -128,20 +130,27 @@ void runGlxinfo(QStringList & log)
 
 void PrintInstanceInfo::executeTask()
 {
-    auto instance = m_parent->instance();
-    QStringList log;
-
+    // the tools asked about the hardware take their time, the other launch steps go on meanwhile
+    m_watcher.setFuture(QtConcurrent::run([]() -> QStringList
+    {
+        QStringList log;
 #if defined(Q_OS_LINUX)
-    ::probeProcCpuinfo(log);
-    ::runLspci(log);
-    ::runGlxinfo(log);
+        ::probeProcCpuinfo(log);
+        ::runLspci(log);
+        ::runGlxinfo(log);
 #elif defined(Q_OS_FREEBSD)
-    ::runSysctlHwModel(log);
-    ::runPciconf(log);
-    ::runGlxinfo(log);
+        ::runSysctlHwModel(log);
+        ::runPciconf(log);
+        ::runGlxinfo(log);
 #endif
+        return log;
+    }));
+}
 
-    logLines(log, MessageLevel::Launcher);
+void PrintInstanceInfo::probingFinished()
+{
+    auto instance = m_parent->instance();
+    logLines(m_watcher.result(), MessageLevel::Launcher);
     logLines(instance->verboseDescription(m_session, m_quickPlayTarget), MessageLevel::Launcher);
     emitSucceeded();
 }
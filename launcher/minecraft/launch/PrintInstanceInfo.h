@@ -16,6 +16,7 @@
 #pragma once
 
 #include <launch/LaunchStep.h>
+#include <QFutureWatcher>
 #include <memory>
 #include "minecraft/auth/AuthSession.h"
 #include "minecraft/launch/QuickPlayTarget.h"
@@ -26,7 +27,12 @@ class PrintInstanceInfo: public LaunchStep
     Q_OBJECT
 public:
     explicit PrintInstanceInfo(LaunchTask *parent, AuthSessionPtr session, QuickPlayTargetPtr quickPlayTarget) :
-        LaunchStep(parent), m_session(session), m_quickPlayTarget(quickPlayTarget) {};
+        LaunchStep(parent), m_session(session), m_quickPlayTarget(quickPlayTarget)
+    {
+        // only prints what the steps before it found out
+        declareResources(Java | GameFiles | Mods | ServerAddress | Natives, {});
+        connect(&m_watcher, &QFutureWatcher<QStringList>::finished, this, &PrintInstanceInfo::probingFinished);
+    };
     virtual ~PrintInstanceInfo(){};
 
     virtual void executeTask();
@@ -34,8 +40,12 @@ public:
     {
         return false;
     }
+private slots:
+    void probingFinished();
 private:
     AuthSessionPtr m_session;
     QuickPlayTargetPtr m_quickPlayTarget;
+    /// what is known about the hardware
+    QFutureWatcher<QStringList> m_watcher;
 };
 
@@ -19,6 +19,8 @@
 #include "minecraft/AssetsUtils.h"
 #include "launch/LaunchTask.h"
 
+#include <QtConcurrentRun>
+
 void ReconstructAssets::executeTask()
 {
     auto instance = m_parent->instance();
@@ -27,7 +29,13 @@ void ReconstructAssets::executeTask()
     auto profile = components->getProfile();
     auto assets = profile->getMinecraftAssets();
 
-    if(!AssetsUtils::reconstructAssets(assets->id, minecraftInstance->resourcesDir()))
+    // old versions get a copy of every asset, the other launch steps go on meanwhile
+    m_watcher.setFuture(QtConcurrent::run(&AssetsUtils::reconstructAssets, assets->id, minecraftInstance->resourcesDir()));
+}
+
+void ReconstructAssets::reconstructionFinished()
+{
+    if(!m_watcher.result())
     {
         emit logLine("Failed to reconstruct Minecraft assets.", MessageLevel::Error);
     }
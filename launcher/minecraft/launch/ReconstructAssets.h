@@ -16,13 +16,18 @@
 #pragma once
 
 #include <launch/LaunchStep.h>
+#include <QFutureWatcher>
 #include <memory>
 
 class ReconstructAssets: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit ReconstructAssets(LaunchTask *parent) : LaunchStep(parent){};
+    explicit ReconstructAssets(LaunchTask *parent) : LaunchStep(parent)
+    {
+        declareResources(GameFiles | GameFolder, LegacyAssets);
+        connect(&m_watcher, &QFutureWatcher<bool>::finished, this, &ReconstructAssets::reconstructionFinished);
+    };
     virtual ~ReconstructAssets(){};
 
     void executeTask() override;
@@ -30,4 +35,10 @@ public:
     {
         return false;
     }
+
+private slots:
+    void reconstructionFinished();
+
+private: /* data */
+    QFutureWatcher<bool> m_watcher;
 };
@@ -22,7 +22,10 @@ class ScanModFolders: public LaunchStep
 {
     Q_OBJECT
 public:
-    explicit ScanModFolders(LaunchTask *parent) : LaunchStep(parent) {};
+    explicit ScanModFolders(LaunchTask *parent) : LaunchStep(parent)
+    {
+        declareResources(GameFolder, Mods);
+    };
     virtual ~ScanModFolders(){};
 
     virtual void executeTask() override;
@@ -23,6 +23,7 @@ class VerifyJavaInstall : public LaunchStep {
 
 public:
     explicit VerifyJavaInstall(LaunchTask *parent) : LaunchStep(parent) {
+        declareResources(Java | GameFiles, {});
     };
     ~VerifyJavaInstall() override = default;
 
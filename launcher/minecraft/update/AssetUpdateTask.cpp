@@ -2,7 +2,6 @@
 
 #include "minecraft/MinecraftInstance.h"
 #include "minecraft/PackProfile.h"
-#include "net/ChecksumValidator.h"
 #include "minecraft/AssetsUtils.h"
 
 #include "Application.h"
@@ -28,6 +27,7 @@ void AssetUpdateTask::executeTask()
         tr("Asset index for %1").arg(m_inst->name()),
         APPLICATION->network()
     );
+    job->setPriority(Net::Priority::LaunchCritical);
 
     auto metacache = APPLICATION->metacache();
     auto entry = metacache->resolveEntry("asset_indexes", localPath);
@@ -36,7 +36,7 @@ void AssetUpdateTask::executeTask()
     qDebug() << "Asset index SHA1:" << hexSha1;
     auto dl = Net::Download::makeCached(indexUrl, entry);
     auto rawSha1 = QByteArray::fromHex(assets->sha1.toLatin1());
-    dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Sha1, rawSha1));
+    dl->addDigest(QCryptographicHash::Sha1, rawSha1);
     job->addNetAction(dl);
 
     downloadJob.reset(job);
@@ -11,6 +11,42 @@ LibrariesTask::LibrariesTask(MinecraftInstance * inst)
 }
 
 void LibrariesTask::executeTask()
+{
+    setStatus(tr("Checking the library files..."));
+    m_aborted = false;
+    auto profile = m_inst->getPackProfile()->getProfile();
+
+    // hash the files that changed on disk in the background, instead of one by one while building the downloads
+    QList<QPair<QString, QString>> entries;
+    QList<LibraryPtr> pool;
+    pool.append(profile->getLibraries());
+    pool.append(profile->getNativeLibraries());
+    pool.append(profile->getMavenFiles());
+    pool.append(profile->getMainJar());
+    pool.append(profile->getJarMods());
+    for (auto lib : pool)
+    {
+        if(!lib)
+        {
+            continue;
+        }
+        for (auto storage : lib->getCachedFiles(currentSystem))
+        {
+            entries.append(qMakePair(QString("libraries"), storage));
+        }
+    }
+    APPLICATION->metacache()->verifyEntries(entries, this, [this]()
+    {
+        if(m_aborted)
+        {
+            emitAborted();
+            return;
+        }
+        downloadLibraries();
+    });
+}
+
+void LibrariesTask::downloadLibraries()
 {
     setStatus(tr("Getting the library files from Mojang..."));
     qDebug() << m_inst->name() << ": downloading libraries";
@@ -21,6 +57,7 @@ void LibrariesTask::executeTask()
     auto profile = components->getProfile();
 
     auto job = new NetJob(tr("Libraries for instance %1").arg(inst->name()), APPLICATION->network());
+    job->setPriority(Net::Priority::LaunchCritical);
     downloadJob.reset(job);
 
     auto metacache = APPLICATION->metacache();
@@ -84,9 +121,7 @@ bool LibrariesTask::abort()
     {
         return downloadJob->abort();
     }
-    else
-    {
-        qWarning() << "Prematurely aborted LibrariesTask";
-    }
+    // still checking the files, stop once that is done
+    m_aborted = true;
     return true;
 }
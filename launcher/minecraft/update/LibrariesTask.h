@@ -17,10 +17,14 @@ public:
 private slots:
     void jarlibFailed(QString reason);
 
+private:
+    void downloadLibraries();
+
 public slots:
     bool abort() override;
 
 private:
     MinecraftInstance *m_inst;
     NetJob::Ptr downloadJob;
+    bool m_aborted = false;
 };
@@ -24,7 +24,6 @@
 #include "MMCZip.h"
 #include "minecraft/OneSixVersionFormat.h"
 #include "Version.h"
-#include "net/ChecksumValidator.h"
 #include "FileSystem.h"
 #include "Json.h"
 #include "minecraft/MinecraftInstance.h"
@@ -36,6 +35,7 @@
 
 #include "BuildConfig.h"
 #include "Application.h"
+#include "ArtifactStore.h"
 
 namespace ATLauncher {
 
@@ -464,7 +464,7 @@ void PackInstallTask::installConfigs()
     auto dl = Net::Download::makeCached(url, entry);
     if (!m_version.configs.sha1.isEmpty()) {
         auto rawSha1 = QByteArray::fromHex(m_version.configs.sha1.toLatin1());
-        dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Sha1, rawSha1));
+        dl->addDigest(QCryptographicHash::Sha1, rawSha1);
     }
     jobPtr->addNetAction(dl);
     archivePath = entry->getFullPath();
@@ -572,7 +572,7 @@ void PackInstallTask::downloadMods()
             auto dl = Net::Download::makeCached(url, entry);
             if (!mod.md5.isEmpty()) {
                 auto rawMd5 = QByteArray::fromHex(mod.md5.toLatin1());
-                dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Md5, rawMd5));
+                dl->addDigest(QCryptographicHash::Md5, rawMd5);
             }
             jobPtr->addNetAction(dl);
         }
@@ -584,7 +584,7 @@ void PackInstallTask::downloadMods()
             auto dl = Net::Download::makeCached(url, entry);
             if (!mod.md5.isEmpty()) {
                 auto rawMd5 = QByteArray::fromHex(mod.md5.toLatin1());
-                dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Md5, rawMd5));
+                dl->addDigest(QCryptographicHash::Md5, rawMd5);
             }
             jobPtr->addNetAction(dl);
         }
@@ -598,7 +598,7 @@ void PackInstallTask::downloadMods()
             auto dl = Net::Download::makeCached(url, entry);
             if (!mod.md5.isEmpty()) {
                 auto rawMd5 = QByteArray::fromHex(mod.md5.toLatin1());
-                dl->addValidator(new Net::ChecksumValidator(QCryptographicHash::Md5, rawMd5));
+                dl->addDigest(QCryptographicHash::Md5, rawMd5);
             }
             jobPtr->addNetAction(dl);
 
@@ -729,10 +729,15 @@ bool PackInstallTask::extractMods(
         }
     }
 
+    auto store = APPLICATION->artifactStore();
     for (auto iter = toCopy.begin(); iter != toCopy.end(); iter++) {
         auto &from = iter.key();
         auto &to = iter.value();
 
+        if (store->share(from, to)) {
+            continue;
+        }
+
         // If the file already exists, assume the mod is the correct copy - and remove
         // the copy from the Configs.zip
         QFileInfo fileInfo(to);
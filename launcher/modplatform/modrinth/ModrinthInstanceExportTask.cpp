@@ -12,6 +12,7 @@
 #include "Json.h"
 #include "ModrinthInstanceExportTask.h"
 #include "net/NetJob.h"
+#include "net/MultiDigestValidator.h"
 #include "Application.h"
 #include "ui/dialogs/ModrinthExportDialog.h"
 #include "JlCompress.h"
@@ -92,16 +93,14 @@ void InstanceExportTask::executeTask()
     setProgress(progress, filesToResolve.length());
     for (const QString &filePath: filesToResolve) {
         qDebug() << "Attempting to resolve file hash from Modrinth API: " << filePath;
-        QFile file(filePath);
+        Net::MultiDigestValidator hasher;
+        hasher.addDigest(QCryptographicHash::Sha512);
 
-        if (file.open(QFile::ReadOnly)) {
-            QByteArray contents = file.readAll();
-            QCryptographicHash hasher(QCryptographicHash::Sha512);
-            hasher.addData(contents);
-            QString hash = hasher.result().toHex();
+        if (hasher.hashFile(filePath)) {
+            QString hash = hasher.hash(QCryptographicHash::Sha512).toHex();
 
             hashes.append(HashLookupData {
-                QFileInfo(file),
+                QFileInfo(filePath),
                 hash
             });
 
@@ -11,6 +11,7 @@
 #include <QDirIterator>
 #include <QCryptographicHash>
 #include <QDebug>
+#include "Hashing.h"
 
 #ifndef Q_OS_WIN32
 #include <unistd.h>
@@ -240,6 +241,24 @@ Package Package::fromInspectedFolder(const QString& folderPath)
     QDir root(folderPath);
 
     Package out;
+
+    // small files are read in batches and hashed together, big ones are streamed
+    const qint64 batchFileLimit = 1024 * 1024;
+    const qint64 batchSizeLimit = 32 * 1024 * 1024;
+    QVector<QByteArray> batchContents;
+    std::vector<std::pair<Path, File>> batchFiles;
+    qint64 batchSize = 0;
+    auto hashBatch = [&]() {
+        auto hashes = Hashing::sha1Many(batchContents);
+        for(std::size_t i = 0; i < batchFiles.size(); i++) {
+            batchFiles[i].second.hash = hashes[int(i)].toHex().constData();
+            out.addFile(batchFiles[i].first, batchFiles[i].second);
+        }
+        batchContents.clear();
+        batchFiles.clear();
+        batchSize = 0;
+    };
+
     QDirIterator iterator(folderPath, QDir::NoDotAndDotDot | QDir::AllEntries | QDir::System | QDir::Hidden, QDirIterator::Subdirectories);
     while(iterator.hasNext()) {
         iterator.next();
@@ -268,14 +287,35 @@ Package Package::fromInspectedFolder(const QString& folderPath)
             File f;
             f.executable = fileInfo.isExecutable();
             f.size = fileInfo.size();
-            // FIXME: async / optimize the hashing
+            // FIXME: async
             QFile input(fileInfo.absoluteFilePath());
             if(!input.open(QIODevice::ReadOnly)) {
                 qCritical() << "Folder inspection: Failed to open file:" << fileInfo.absoluteFilePath();
                 out.valid = false;
                 break;
             }
-            f.hash = QCryptographicHash::hash(input.readAll(), QCryptographicHash::Sha1).toHex().constData();
+            if(fileInfo.size() <= batchFileLimit) {
+                auto contents = input.readAll();
+                if(contents.size() != fileInfo.size()) {
+                    qCritical() << "Folder inspection: Failed to read file:" << fileInfo.absoluteFilePath();
+                    out.valid = false;
+                    break;
+                }
+                batchContents.append(contents);
+                batchFiles.emplace_back(Path(relPath), f);
+                batchSize += fileInfo.size();
+                if(batchSize >= batchSizeLimit) {
+                    hashBatch();
+                }
+                continue;
+            }
+            Hashing::Hasher hasher(QCryptographicHash::Sha1);
+            if(!hasher.addData(&input)) {
+                qCritical() << "Folder inspection: Failed to read file:" << fileInfo.absoluteFilePath();
+                out.valid = false;
+                break;
+            }
+            f.hash = hasher.result().toHex().constData();
             out.addFile(relPath, f);
         }
         else {
@@ -285,8 +325,8 @@ Package Package::fromInspectedFolder(const QString& folderPath)
             break;
         }
     }
+    hashBatch();
     out.folders.insert(Path("."));
-    out.valid = true;
     return out;
 }
 
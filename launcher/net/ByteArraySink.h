@@ -29,6 +29,18 @@ public:
         return Job_Failed;
     };
 
+    JobStatus headersReceived(QNetworkReply & reply) override
+    {
+        // make room for the whole response at once, within reason
+        bool knownLength = false;
+        qint64 length = reply.header(QNetworkRequest::ContentLengthHeader).toLongLong(&knownLength);
+        if(knownLength && length > 0 && length <= maximumReserve)
+        {
+            m_output->reserve(int(length));
+        }
+        return Job_InProgress;
+    }
+
     JobStatus write(QByteArray & data) override
     {
         m_output->append(data);
@@ -57,6 +69,7 @@ public:
     }
 
 private:
+    static const qint64 maximumReserve = 256 * 1024 * 1024;
     QByteArray * m_output;
 };
 }
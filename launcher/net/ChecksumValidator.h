@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Validator.h"
+#include "Hashing.h"
 #include <QCryptographicHash>
 #include <memory>
 #include <QFile>
@@ -30,6 +31,10 @@ public: /* methods */
     {
         return true;
     }
+    bool canWriteInBackground() const override
+    {
+        return true;
+    }
     bool validate(QNetworkReply &) override
     {
         if(m_expected.size() && m_expected != hash())
@@ -49,7 +54,7 @@ public: /* methods */
     }
 
 private: /* data */
-    QCryptographicHash m_checksum;
+    Hashing::Hasher m_checksum;
     QByteArray m_expected;
 };
 }
\ No newline at end of file
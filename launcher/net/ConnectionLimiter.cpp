@@ -0,0 +1,257 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConnectionLimiter.h"
+
+#include <QDebug>
+#include <limits>
+
+namespace {
+// a round that got less than this fraction of the previous round's throughput counts as a drop
+const double throughputTolerance = 0.95;
+
+// see Limits::maxPerHost
+const int qnamConnectionsPerHost = 6;
+// the circuit breaker judges a host by this many outcomes at a time...
+const int breakerWindow = 20;
+// ... and opens when at least this many of them are failures, and at least half
+const int breakerFailures = 5;
+// how long an open breaker stays open, doubling every time the probe after it fails
+const unsigned breakerMinCooldownMs = 10 * 1000;
+const unsigned breakerMaxCooldownMs = 5 * 60 * 1000;
+}
+
+namespace Net {
+
+ConnectionLimiter::ConnectionLimiter() : ConnectionLimiter(Limits())
+{
+}
+
+ConnectionLimiter::ConnectionLimiter(const Limits & limits)
+{
+    setLimits(limits);
+    m_clock.start();
+}
+
+QString ConnectionLimiter::hostKey(const QUrl& url)
+{
+    return QString("%1://%2:%3").arg(url.scheme(), url.host().toLower()).arg(url.port(-1));
+}
+
+void ConnectionLimiter::setLimits(const Limits& limits)
+{
+    m_limits = limits;
+    // keep the limits sane, whatever is in the settings
+    clamp(m_limits.minPerHost, 1, qnamConnectionsPerHost);
+    clamp(m_limits.maxPerHost, m_limits.minPerHost, qnamConnectionsPerHost);
+    clamp(m_limits.initialPerHost, m_limits.minPerHost, m_limits.maxPerHost);
+    clamp(m_limits.maxTotal, m_limits.minPerHost, 1024);
+    clamp(m_limits.segmentsPerFile, 1, 16);
+    clamp(m_limits.segmentThreshold, qint64(1024 * 1024), std::numeric_limits<qint64>::max());
+    for(auto & host: m_hosts)
+    {
+        clampLimit(host);
+    }
+}
+
+qint64 ConnectionLimiter::now() const
+{
+    return m_clock.elapsed();
+}
+
+ConnectionLimiter::HostState & ConnectionLimiter::state(const QString& host)
+{
+    auto iter = m_hosts.find(host);
+    if(iter == m_hosts.end())
+    {
+        HostState newState;
+        newState.limit = m_limits.initialPerHost;
+        newState.cooldown = ExponentialSeries(breakerMinCooldownMs, breakerMaxCooldownMs);
+        iter = m_hosts.insert(host, newState);
+    }
+    return *iter;
+}
+
+bool ConnectionLimiter::canStart(const QString& host) const
+{
+    if(m_totalActive >= m_limits.maxTotal)
+    {
+        return false;
+    }
+    auto iter = m_hosts.find(host);
+    if(iter != m_hosts.end() && iter->openUntil >= 0)
+    {
+        // open, or waiting for the one probe part to come back
+        return now() >= iter->openUntil && iter->active == 0;
+    }
+    return active(host) < limit(host);
+}
+
+bool ConnectionLimiter::isTripped(const QString& host) const
+{
+    auto iter = m_hosts.find(host);
+    if(iter == m_hosts.end())
+    {
+        return false;
+    }
+    return iter->openUntil >= 0 && now() < iter->openUntil;
+}
+
+int ConnectionLimiter::limit(const QString& host) const
+{
+    auto iter = m_hosts.find(host);
+    if(iter == m_hosts.end())
+    {
+        return m_limits.initialPerHost;
+    }
+    return int(iter->limit);
+}
+
+int ConnectionLimiter::active(const QString& host) const
+{
+    auto iter = m_hosts.find(host);
+    if(iter == m_hosts.end())
+    {
+        return 0;
+    }
+    return iter->active;
+}
+
+void ConnectionLimiter::partStarted(const QString& host)
+{
+    auto & hostState = state(host);
+    if(hostState.roundStart < 0)
+    {
+        hostState.roundStart = now();
+    }
+    hostState.active++;
+    m_totalActive++;
+}
+
+void ConnectionLimiter::partSucceeded(const QString& host, qint64 bytes)
+{
+    auto & hostState = state(host);
+    release(hostState);
+    breakerSucceeded(hostState);
+    hostState.completedInRound++;
+    hostState.bytesInRound += qMax<qint64>(bytes, 0);
+    if(hostState.completedInRound < int(hostState.limit))
+    {
+        return;
+    }
+
+    // end of round, compare against the previous one
+    qint64 elapsed = qMax<qint64>(now() - hostState.roundStart, 1);
+    double throughput = double(hostState.bytesInRound) / double(elapsed);
+    if(throughput >= hostState.lastThroughput * throughputTolerance)
+    {
+        // additive increase - more connections did not hurt, so probe further
+        hostState.limit += 1;
+    }
+    else
+    {
+        // we are past the point where more connections help. step back.
+        hostState.limit -= 1;
+    }
+    clampLimit(hostState);
+    hostState.lastThroughput = throughput;
+    resetRound(hostState);
+}
+
+void ConnectionLimiter::partFailed(const QString& host)
+{
+    auto & hostState = state(host);
+    release(hostState);
+    // multiplicative decrease
+    hostState.limit /= 2;
+    clampLimit(hostState);
+    // the previous throughput was measured with more connections, it's not comparable anymore
+    hostState.lastThroughput = 0;
+    resetRound(hostState);
+    qDebug() << "Connection limit for" << host << "lowered to" << int(hostState.limit);
+    breakerFailed(host, hostState);
+}
+
+void ConnectionLimiter::partCancelled(const QString& host)
+{
+    release(state(host));
+}
+
+void ConnectionLimiter::release(HostState& state)
+{
+    if(state.active > 0)
+    {
+        state.active--;
+        m_totalActive--;
+    }
+}
+
+void ConnectionLimiter::resetRound(HostState& state)
+{
+    state.completedInRound = 0;
+    state.bytesInRound = 0;
+    state.roundStart = state.active ? now() : -1;
+}
+
+void ConnectionLimiter::clampLimit(HostState& state)
+{
+    clamp(state.limit, double(m_limits.minPerHost), double(m_limits.maxPerHost));
+}
+
+void ConnectionLimiter::breakerSucceeded(HostState& state)
+{
+    if(state.openUntil >= 0)
+    {
+        // parts that were already running when the breaker opened don't count, only the probe after the cooldown
+        if(now() >= state.openUntil)
+        {
+            state.openUntil = -1;
+            state.cooldown.reset();
+        }
+        return;
+    }
+    state.windowTotal++;
+    if(state.windowTotal >= breakerWindow)
+    {
+        state.windowTotal = state.windowFailures = 0;
+    }
+}
+
+void ConnectionLimiter::breakerFailed(const QString& host, HostState& state)
+{
+    if(state.openUntil >= 0)
+    {
+        if(now() >= state.openUntil)
+        {
+            state.openUntil = now() + state.cooldown();
+            qWarning() << host << "is still failing, not using it for" << state.openUntil - now() << "ms";
+        }
+        return;
+    }
+    state.windowTotal++;
+    state.windowFailures++;
+    if(state.windowFailures >= breakerFailures && state.windowFailures * 2 >= state.windowTotal)
+    {
+        state.openUntil = now() + state.cooldown();
+        state.windowTotal = state.windowFailures = 0;
+        qWarning() << host << "failed" << breakerFailures << "times recently, not using it for" << state.openUntil - now() << "ms";
+    }
+    else if(state.windowTotal >= breakerWindow)
+    {
+        state.windowTotal = state.windowFailures = 0;
+    }
+}
+
+}
@@ -0,0 +1,126 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QUrl>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include "ExponentialSeries.h"
+
+namespace Net {
+/*
+ * Decides how many connections may be open to each host at the same time.
+ *
+ * The per-host limit is tuned AIMD-style from what the parts report back:
+ * - every round of `limit` successfully completed parts that did not lower the host's throughput adds one connection
+ * - a round that made the throughput drop takes one connection away again
+ * - any failure halves the limit
+ *
+ * Each host also has a circuit breaker. When too many of its recent parts failed, the breaker opens and no parts
+ * are started for the host until a cooldown passes. Then a single probe part is let through - if it succeeds the
+ * breaker closes, otherwise it opens again for twice as long.
+ */
+class ConnectionLimiter
+{
+public: /* types */
+    struct Limits
+    {
+        int initialPerHost = 6;
+        int minPerHost = 2;
+        // QNetworkAccessManager never opens more than 6 connections to a host. Anything above that only queues
+        // requests inside of it, and the time they spend there would be mistaken for a slow host.
+        int maxPerHost = 6;
+        int maxTotal = 32;
+        // big files are split into this many parallel range requests...
+        int segmentsPerFile = 4;
+        // ... when they are at least this big
+        qint64 segmentThreshold = 16 * 1024 * 1024;
+    };
+
+public: /* con/des */
+    ConnectionLimiter();
+    explicit ConnectionLimiter(const Limits & limits);
+    virtual ~ConnectionLimiter() {};
+
+public: /* methods */
+    /// the key parts are grouped by - scheme, host and port of the URL
+    static QString hostKey(const QUrl & url);
+
+    void setLimits(const Limits & limits);
+    Limits limits() const
+    {
+        return m_limits;
+    }
+
+    /// is there a free connection slot for the host?
+    bool canStart(const QString & host) const;
+    /// is the host's circuit breaker open? Parts for it should fail right away, or go somewhere else.
+    bool isTripped(const QString & host) const;
+
+    /// a part started using a connection to the host
+    void partStarted(const QString & host);
+    /// a part finished transferring `bytes` from the host
+    void partSucceeded(const QString & host, qint64 bytes);
+    /// a part failed because of the host or the network
+    void partFailed(const QString & host);
+    /// a part ended without telling us anything about the host (cache hit, local error, abort)
+    void partCancelled(const QString & host);
+
+    int limit(const QString & host) const;
+    int active(const QString & host) const;
+    int totalActive() const
+    {
+        return m_totalActive;
+    }
+
+protected: /* methods */
+    /// monotonic time in milliseconds, overridable for testing
+    virtual qint64 now() const;
+
+private: /* types */
+    struct HostState
+    {
+        double limit = 0;
+        int active = 0;
+        int completedInRound = 0;
+        qint64 bytesInRound = 0;
+        qint64 roundStart = -1;
+        double lastThroughput = 0;
+
+        // circuit breaker - outcomes in the current window, and until when the breaker is open (-1 if closed)
+        int windowTotal = 0;
+        int windowFailures = 0;
+        qint64 openUntil = -1;
+        ExponentialSeries cooldown = ExponentialSeries(0, 0);
+    };
+
+private: /* methods */
+    HostState & state(const QString & host);
+    void release(HostState & state);
+    void resetRound(HostState & state);
+    void clampLimit(HostState & state);
+    void breakerSucceeded(HostState & state);
+    void breakerFailed(const QString & host, HostState & state);
+
+private: /* data */
+    Limits m_limits;
+    QHash<QString, HostState> m_hosts;
+    int m_totalActive = 0;
+    QElapsedTimer m_clock;
+};
+}
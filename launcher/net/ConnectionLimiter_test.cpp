@@ -0,0 +1,198 @@
+#include <QTest>
+#include "TestUtil.h"
+
+#include "net/ConnectionLimiter.h"
+
+class FakeClockLimiter : public Net::ConnectionLimiter
+{
+public:
+    explicit FakeClockLimiter(const Limits & limits) : Net::ConnectionLimiter(limits) {}
+    qint64 time = 0;
+protected:
+    qint64 now() const override
+    {
+        return time;
+    }
+};
+
+class ConnectionLimiterTest : public QObject
+{
+    Q_OBJECT
+
+    Net::ConnectionLimiter::Limits testLimits()
+    {
+        Net::ConnectionLimiter::Limits limits;
+        limits.initialPerHost = 4;
+        limits.minPerHost = 2;
+        limits.maxPerHost = 6;
+        limits.maxTotal = 10;
+        return limits;
+    }
+
+    // start `count` parts on the host and finish them all after `duration` ms, each with `bytes` bytes
+    void runRound(FakeClockLimiter & limiter, const QString & host, int count, qint64 duration, qint64 bytes)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            limiter.partStarted(host);
+        }
+        limiter.time += duration;
+        for(int i = 0; i < count; i++)
+        {
+            limiter.partSucceeded(host, bytes);
+        }
+    }
+
+private
+slots:
+    void test_hostKey()
+    {
+        QCOMPARE(Net::ConnectionLimiter::hostKey(QUrl("https://Libraries.minecraft.net/foo/bar.jar")),
+                 Net::ConnectionLimiter::hostKey(QUrl("https://libraries.minecraft.net/baz.jar")));
+        QVERIFY(Net::ConnectionLimiter::hostKey(QUrl("https://example.com/a"))
+                != Net::ConnectionLimiter::hostKey(QUrl("https://example.com:8443/a")));
+        QVERIFY(Net::ConnectionLimiter::hostKey(QUrl("https://example.com/a"))
+                != Net::ConnectionLimiter::hostKey(QUrl("https://example.org/a")));
+    }
+
+    void test_perHostLimit()
+    {
+        FakeClockLimiter limiter(testLimits());
+        for(int i = 0; i < 4; i++)
+        {
+            QVERIFY(limiter.canStart("a"));
+            limiter.partStarted("a");
+        }
+        QVERIFY(!limiter.canStart("a"));
+        // other hosts are not affected...
+        QVERIFY(limiter.canStart("b"));
+        for(int i = 0; i < 6; i++)
+        {
+            limiter.partStarted("b");
+        }
+        // ... until the total limit is reached
+        QVERIFY(!limiter.canStart("c"));
+        QCOMPARE(limiter.totalActive(), 10);
+        limiter.partCancelled("a");
+        QVERIFY(limiter.canStart("a"));
+        QCOMPARE(limiter.active("a"), 3);
+    }
+
+    void test_additiveIncrease()
+    {
+        FakeClockLimiter limiter(testLimits());
+        runRound(limiter, "a", 4, 100, 1000);
+        QCOMPARE(limiter.limit("a"), 5);
+        // same per-connection speed with more connections -> more throughput -> keep increasing
+        runRound(limiter, "a", 5, 100, 1000);
+        QCOMPARE(limiter.limit("a"), 6);
+        // never above the maximum
+        for(int i = 0; i < 10; i++)
+        {
+            runRound(limiter, "a", limiter.limit("a"), 100, 1000);
+        }
+        QCOMPARE(limiter.limit("a"), 6);
+    }
+
+    void test_throughputDrop()
+    {
+        FakeClockLimiter limiter(testLimits());
+        runRound(limiter, "a", 4, 100, 1000);
+        QCOMPARE(limiter.limit("a"), 5);
+        // the extra connection made everything slower, step back
+        runRound(limiter, "a", 5, 200, 1000);
+        QCOMPARE(limiter.limit("a"), 4);
+    }
+
+    void test_multiplicativeDecrease()
+    {
+        auto limits = testLimits();
+        limits.initialPerHost = 6;
+        FakeClockLimiter limiter(limits);
+        limiter.partStarted("a");
+        limiter.partFailed("a");
+        QCOMPARE(limiter.limit("a"), 3);
+        QCOMPARE(limiter.active("a"), 0);
+        limiter.partStarted("a");
+        limiter.partFailed("a");
+        limiter.partStarted("a");
+        limiter.partFailed("a");
+        // never below the minimum
+        QCOMPARE(limiter.limit("a"), 2);
+    }
+
+    void test_circuitBreaker()
+    {
+        FakeClockLimiter limiter(testLimits());
+        // a few failures among successes are within the budget
+        for(int i = 0; i < 10; i++)
+        {
+            limiter.partStarted("a");
+            if(i % 3 == 0)
+            {
+                limiter.partFailed("a");
+            }
+            else
+            {
+                limiter.partSucceeded("a", 1000);
+            }
+        }
+        QVERIFY(!limiter.isTripped("a"));
+
+        for(int i = 0; i < 5; i++)
+        {
+            limiter.partStarted("a");
+            limiter.partFailed("a");
+        }
+        QVERIFY(limiter.isTripped("a"));
+        QVERIFY(!limiter.canStart("a"));
+        QVERIFY(limiter.canStart("b"));
+
+        // after the cooldown, one probe goes through
+        limiter.time += 10 * 1000;
+        QVERIFY(!limiter.isTripped("a"));
+        QVERIFY(limiter.canStart("a"));
+        limiter.partStarted("a");
+        QVERIFY(!limiter.canStart("a"));
+        // it fails, so the breaker opens for longer
+        limiter.partFailed("a");
+        QVERIFY(limiter.isTripped("a"));
+        limiter.time += 10 * 1000;
+        QVERIFY(limiter.isTripped("a"));
+        limiter.time += 10 * 1000;
+        QVERIFY(limiter.canStart("a"));
+
+        // a successful probe closes it
+        limiter.partStarted("a");
+        limiter.partSucceeded("a", 1000);
+        QVERIFY(!limiter.isTripped("a"));
+        QVERIFY(limiter.canStart("a"));
+        limiter.partStarted("a");
+        QVERIFY(limiter.canStart("a"));
+    }
+
+    void test_sanitizeLimits()
+    {
+        Net::ConnectionLimiter::Limits limits;
+        limits.initialPerHost = 100;
+        limits.minPerHost = 0;
+        limits.maxPerHost = 3;
+        limits.maxTotal = 0;
+        Net::ConnectionLimiter limiter(limits);
+        QCOMPARE(limiter.limits().minPerHost, 1);
+        QCOMPARE(limiter.limits().initialPerHost, 3);
+        QCOMPARE(limiter.limits().maxTotal, 1);
+        QCOMPARE(limiter.limit("a"), 3);
+
+        // more than the network access manager opens would only queue in there
+        limits.minPerHost = 10;
+        limits.maxPerHost = 16;
+        limiter.setLimits(limits);
+        QCOMPARE(limiter.limits().maxPerHost, 6);
+        QCOMPARE(limiter.limits().minPerHost, 6);
+    }
+};
+
+QTEST_GUILESS_MAIN(ConnectionLimiterTest)
+
+#include "ConnectionLimiter_test.moc"
@@ -0,0 +1,108 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConnectionWarmer.h"
+#include "ConnectionLimiter.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSslConfiguration>
+#include <QSslSocket>
+
+namespace Net {
+
+namespace {
+// a connection opened this recently is probably still there, or in use
+const qint64 rewarmAfterMs = 60 * 1000;
+// servers can say how long their tickets last, and when they don't...
+const qint64 defaultTicketLifetimeS = 24 * 60 * 60;
+// ... and they aren't trusted with more than this either
+const qint64 maximumTicketLifetimeS = 7 * 24 * 60 * 60;
+}
+
+ConnectionWarmer::ConnectionWarmer(QNetworkAccessManager * network)
+    : QObject(network), m_network(network)
+{
+    if(QSslSocket::supportsSsl())
+    {
+        auto config = QSslConfiguration::defaultConfiguration();
+        config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+        QSslConfiguration::setDefaultConfiguration(config);
+    }
+    connect(m_network, &QNetworkAccessManager::finished, this, &ConnectionWarmer::replyFinished);
+}
+
+void ConnectionWarmer::warmUp(const QList<QUrl> & urls)
+{
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    for(auto & url: urls)
+    {
+        bool encrypted = url.scheme() == "https";
+        if(!encrypted && url.scheme() != "http")
+        {
+            continue;
+        }
+        auto key = ConnectionLimiter::hostKey(url);
+        if(key.isEmpty() || now - m_warmedAt.value(key, -rewarmAfterMs) < rewarmAfterMs)
+        {
+            continue;
+        }
+        m_warmedAt[key] = now;
+        // this also resolves the name, which Qt caches for the requests that follow
+        if(!encrypted)
+        {
+            m_network->connectToHost(url.host(), quint16(url.port(80)));
+            continue;
+        }
+        auto config = QSslConfiguration::defaultConfiguration();
+        auto session = m_sessions.find(key);
+        if(session != m_sessions.end() && session->expires > now)
+        {
+            config.setSessionTicket(session->ticket);
+        }
+        qDebug() << "Warming up connection to" << key;
+        m_network->connectToHostEncrypted(url.host(), quint16(url.port(443)), config);
+    }
+}
+
+void ConnectionWarmer::replyFinished(QNetworkReply * reply)
+{
+    if(reply->url().scheme() != "https" || reply->error() != QNetworkReply::NoError)
+    {
+        return;
+    }
+    auto config = reply->sslConfiguration();
+    auto ticket = config.sessionTicket();
+    if(ticket.isEmpty())
+    {
+        return;
+    }
+    auto key = ConnectionLimiter::hostKey(reply->url());
+    auto & session = m_sessions[key];
+    if(session.ticket == ticket)
+    {
+        return;
+    }
+    qint64 lifetime = config.sessionTicketLifeTimeHint();
+    if(lifetime <= 0)
+    {
+        lifetime = defaultTicketLifetimeS;
+    }
+    session.ticket = ticket;
+    session.expires = QDateTime::currentMSecsSinceEpoch() + qMin(lifetime, maximumTicketLifetimeS) * 1000;
+}
+}
@@ -0,0 +1,68 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+namespace Net {
+/*
+ * Opens connections to servers before anything is requested from them.
+ *
+ * Resolving the name and the TCP and TLS handshakes then happen while the user is still looking at things, and the
+ * downloads that follow find a connection ready in the network access manager.
+ *
+ * TLS session tickets the servers hand out are remembered, so a connection opened again after the old one was closed
+ * can resume the earlier session instead of doing a full handshake. To get the tickets at all, the warmer turns on
+ * session persistence in the default TLS configuration. The tickets are secrets and only kept in memory, they are only
+ * used for the connections opened here.
+ */
+class ConnectionWarmer : public QObject
+{
+    Q_OBJECT
+public: /* con/des */
+    /// the warmer belongs to `network`
+    explicit ConnectionWarmer(QNetworkAccessManager * network);
+    virtual ~ConnectionWarmer() = default;
+
+public: /* methods */
+    /// open a connection to the server of each URL, unless that was done recently
+    void warmUp(const QList<QUrl> & urls);
+
+private slots:
+    void replyFinished(QNetworkReply * reply);
+
+private: /* types */
+    struct Session
+    {
+        QByteArray ticket;
+        /// ms since epoch
+        qint64 expires = 0;
+    };
+
+private: /* data */
+    QNetworkAccessManager * m_network;
+    /// by ConnectionLimiter::hostKey
+    QHash<QString, Session> m_sessions;
+    /// when the connection to a host was last opened, by ConnectionLimiter::hostKey
+    QHash<QString, qint64> m_warmedAt;
+};
+}
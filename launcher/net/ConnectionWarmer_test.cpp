@@ -0,0 +1,60 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QNetworkAccessManager>
+#include <QDir>
+#include <QTemporaryDir>
+#include "TestUtil.h"
+
+#include "net/ConnectionWarmer.h"
+
+class ConnectionWarmerTest : public QObject
+{
+    Q_OBJECT
+
+private
+slots:
+    void test_warmUp()
+    {
+        QTcpServer server;
+        QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+        QSignalSpy connections(&server, &QTcpServer::newConnection);
+        QNetworkAccessManager network;
+        Net::ConnectionWarmer warmer(&network);
+
+        auto url = QUrl(QString("http://127.0.0.1:%1/").arg(server.serverPort()));
+        // one connection per server, and only for what can be fetched over HTTP
+        warmer.warmUp({url, url.resolved(QUrl("/other")), QUrl("file:///tmp/file"), QUrl("ftp://127.0.0.1/")});
+        QVERIFY(connections.wait(5000));
+        QTest::qWait(200);
+        QCOMPARE(connections.size(), 1);
+
+        // a recently warmed server is left alone
+        warmer.warmUp({url});
+        QTest::qWait(200);
+        QCOMPARE(connections.size(), 1);
+    }
+
+    void test_nothingWritten()
+    {
+        QTemporaryDir tempDir;
+        auto oldDir = QDir::currentPath();
+        QVERIFY(QDir::setCurrent(tempDir.path()));
+        QTcpServer server;
+        QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+        QSignalSpy connections(&server, &QTcpServer::newConnection);
+        {
+            QNetworkAccessManager network;
+            Net::ConnectionWarmer warmer(&network);
+            warmer.warmUp({QUrl(QString("http://127.0.0.1:%1/").arg(server.serverPort()))});
+            QVERIFY(connections.wait(5000));
+        }
+        QDir::setCurrent(oldDir);
+        // the session tickets are secrets, they don't go anywhere near the disk
+        QVERIFY(QDir(tempDir.path()).entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden).isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(ConnectionWarmerTest)
+
+#include "ConnectionWarmer_test.moc"
@@ -18,19 +18,64 @@
 #include <QFileInfo>
 #include <QDateTime>
 #include <QDebug>
+#include <QtConcurrentRun>
 
 #include "FileSystem.h"
 #include "ChecksumValidator.h"
 #include "MetaCacheSink.h"
 #include "ByteArraySink.h"
+#include "Scheduler.h"
+#include "PeerCache.h"
 
 #include "BuildConfig.h"
 
 namespace Net {
 
+namespace {
+// segments smaller than this are not worth the extra request
+const qint64 minimumSegmentSize = 4 * 1024 * 1024;
+// a download that got no data for this long is stuck, not just slow
+const qint64 stalledAfterMs = 5000;
+
+/// the Retry-After header in ms, -1 if there is none
+qint64 retryAfterMs(QNetworkReply & reply)
+{
+    auto value = QString::fromLatin1(reply.rawHeader("Retry-After")).trimmed();
+    if(value.isEmpty())
+    {
+        return -1;
+    }
+    bool ok = false;
+    qint64 seconds = value.toLongLong(&ok);
+    if(ok)
+    {
+        return qMax<qint64>(seconds, 0) * 1000;
+    }
+    // it can also be a HTTP date
+    value.replace(" GMT", " +0000");
+    auto date = QDateTime::fromString(value, Qt::RFC2822Date);
+    if(!date.isValid())
+    {
+        return -1;
+    }
+    return qMax<qint64>(QDateTime::currentDateTimeUtc().msecsTo(date), 0);
+}
+}
+
 Download::Download():NetAction()
 {
     m_status = Job_NotStarted;
+    connect(&m_catchUp, &QFutureWatcher<bool>::finished, this, &Download::catchUpFinished);
+}
+
+Download::~Download()
+{
+    // the worker uses the sink
+    m_catchUp.waitForFinished();
+    for(int i = 0; i < int(m_segments.size()); i++)
+    {
+        releaseSegment(i);
+    }
 }
 
 Download::Ptr Download::makeCached(QUrl url, MetaEntryPtr entry, Options options)
@@ -38,9 +83,11 @@ Download::Ptr Download::makeCached(QUrl url, MetaEntryPtr entry, Options options
     Download * dl = new Download();
     dl->m_url = url;
     dl->m_options = options;
-    auto md5Node = new ChecksumValidator(QCryptographicHash::Md5);
-    auto cachedNode = new MetaCacheSink(entry, md5Node);
+    auto digests = new MultiDigestValidator();
+    digests->addDigest(QCryptographicHash::Md5);
+    auto cachedNode = new MetaCacheSink(entry, digests);
     dl->m_sink.reset(cachedNode);
+    dl->m_digests = digests;
     dl->m_target_path = entry->getFullPath();
     return dl;
 }
@@ -58,6 +105,7 @@ Download::Ptr Download::makeFile(QUrl url, QString path, Options options)
 {
     Download * dl = new Download();
     dl->m_url = url;
+    dl->m_target_path = path;
     dl->m_options = options;
     dl->m_sink.reset(new FileSink(path));
     return dl;
@@ -68,6 +116,34 @@ void Download::addValidator(Validator * v)
     m_sink->addValidator(v);
 }
 
+void Download::addDigest(QCryptographicHash::Algorithm algorithm, QByteArray expected)
+{
+    if(!m_digests)
+    {
+        m_digests = new MultiDigestValidator();
+        m_sink->addValidator(m_digests);
+    }
+    m_digests->addDigest(algorithm, expected);
+    if(algorithm == QCryptographicHash::Sha1 && !expected.isEmpty())
+    {
+        m_sha1 = expected;
+    }
+}
+
+void Download::setMirrors(const QList<QUrl>& mirrors)
+{
+    m_sources.clear();
+    m_sources.append(m_url);
+    for(auto & mirror: mirrors)
+    {
+        if(mirror.isValid() && !m_sources.contains(mirror))
+        {
+            m_sources.append(mirror);
+        }
+    }
+    m_source = 0;
+}
+
 void Download::startImpl()
 {
     if(m_status == Job_Aborted)
@@ -76,11 +152,33 @@ void Download::startImpl()
         emit aborted(m_index_within_job);
         return;
     }
+    m_retryAfter = -1;
+    if(!m_sink->tryLock())
+    {
+        // another launcher (or job) is downloading the same file. once it's done, the sink can tell if it's enough.
+        // the job starts this again later, the connection it got for it can do something useful meanwhile.
+        m_status = Job_NotStarted;
+        emit lockContended(m_index_within_job);
+        return;
+    }
+    if(!m_hedge)
+    {
+        m_hedgeSource = m_source;
+    }
     QNetworkRequest request(m_url);
+    m_headersHandled = false;
     m_status = m_sink->init(request);
     switch(m_status)
     {
         case Job_Finished:
+            if(m_onPeer)
+            {
+                // somebody else got it in the meantime
+                m_onPeer = false;
+                m_peers.clear();
+                m_url = m_origin;
+            }
+            shareWithPeers();
             emit succeeded(m_index_within_job);
             qDebug() << "Download cache hit " << m_url.toString();
             return;
@@ -96,20 +194,53 @@ void Download::startImpl()
             return;
     }
 
+    // other launchers may have the file already. What they send is checked like anything else.
+    if(!m_peersLooked && !m_sha1.isEmpty())
+    {
+        m_peersLooked = true;
+        if(auto peers = PeerCache::find(m_network.get()))
+        {
+            m_peers = peers->sources(m_sha1);
+        }
+    }
+    if(!m_onPeer && !m_peers.isEmpty())
+    {
+        m_origin = m_url;
+        m_onPeer = true;
+    }
+    if(m_onPeer)
+    {
+        m_url = m_peers.takeFirst();
+        request.setUrl(m_url);
+        qDebug() << "Asking a peer for" << m_origin.toString() << "at" << m_url.toString();
+    }
+
     request.setHeader(QNetworkRequest::UserAgentHeader, BuildConfig.USER_AGENT);
+    m_request = request;
 
     QNetworkReply *rep = m_network->get(request);
 
     m_reply.reset(rep);
-    connect(rep, SIGNAL(downloadProgress(qint64, qint64)), SLOT(downloadProgress(qint64, qint64)));
-    connect(rep, SIGNAL(finished()), SLOT(downloadFinished()));
-    connect(rep, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(downloadError(QNetworkReply::NetworkError)));
-    connect(rep, &QNetworkReply::sslErrors, this, &Download::sslErrors);
-    connect(rep, &QNetworkReply::readyRead, this, &Download::downloadReadyRead);
+    connectReply(rep);
+    m_sinceData.start();
+}
+
+void Download::connectReply(QNetworkReply* reply)
+{
+    connect(reply, SIGNAL(downloadProgress(qint64, qint64)), SLOT(downloadProgress(qint64, qint64)));
+    connect(reply, SIGNAL(finished()), SLOT(downloadFinished()));
+    connect(reply, SIGNAL(error(QNetworkReply::NetworkError)), SLOT(downloadError(QNetworkReply::NetworkError)));
+    connect(reply, &QNetworkReply::sslErrors, this, &Download::sslErrors);
+    connect(reply, &QNetworkReply::readyRead, this, &Download::downloadReadyRead);
 }
 
 void Download::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 {
+    if(!m_segments.empty())
+    {
+        // the first request only covers the first segment now
+        return;
+    }
     m_total_progress = bytesTotal;
     m_progress = bytesReceived;
     emit netActionProgress(m_index_within_job, bytesReceived, bytesTotal);
@@ -117,6 +248,11 @@ void Download::downloadProgress(qint64 bytesReceived, qint64 bytesTotal)
 
 void Download::downloadError(QNetworkReply::NetworkError error)
 {
+    if(!m_segments.empty())
+    {
+        segmentError(0, error);
+        return;
+    }
     if(error == QNetworkReply::OperationCanceledError)
     {
         qCritical() << "Aborted " << m_url.toString();
@@ -150,6 +286,28 @@ void Download::sslErrors(const QList<QSslError> & errors)
     }
 }
 
+bool Download::isRedirect()
+{
+    int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return statusCode >= 300 && statusCode < 400 && m_reply->hasRawHeader("Location");
+}
+
+void Download::handleHeaders()
+{
+    // the body of a redirect is not what we are downloading, the sink doesn't need to know about it
+    if(m_headersHandled || isRedirect())
+    {
+        return;
+    }
+    m_headersHandled = true;
+    auto status = m_sink->headersReceived(*m_reply);
+    if(status == Job_Failed && m_status == Job_InProgress)
+    {
+        qCritical() << "Failed to process response headers for" << m_url.toString();
+        m_status = Job_Failed;
+    }
+}
+
 bool Download::handleRedirect()
 {
     QUrl redirect = m_reply->header(QNetworkRequest::LocationHeader).toUrl();
@@ -215,6 +373,27 @@ bool Download::handleRedirect()
 
 void Download::downloadFinished()
 {
+    if(!m_segments.empty())
+    {
+        segmentFinished(0);
+        return;
+    }
+
+    if(m_hedge)
+    {
+        if(m_status == Job_Failed || m_status == Job_Failed_Proceed)
+        {
+            qDebug() << "Download failed, the duplicate request takes over:" << m_url.toString();
+            adoptHedge();
+            return;
+        }
+        if(!isRedirect())
+        {
+            // the original request won the race
+            dropHedge();
+        }
+    }
+
     // handle HTTP redirection first
     if(handleRedirect())
     {
@@ -222,6 +401,15 @@ void Download::downloadFinished()
         return;
     }
 
+    // there may not have been any data to trigger this before
+    handleHeaders();
+
+    if(m_onPeer && (m_status == Job_Failed || m_status == Job_Failed_Proceed))
+    {
+        leavePeer();
+        return;
+    }
+
     // if the download failed before this point ...
     if (m_status == Job_Failed_Proceed)
     {
@@ -234,6 +422,7 @@ void Download::downloadFinished()
     else if (m_status == Job_Failed)
     {
         qDebug() << "Download failed in previous step:" << m_url.toString();
+        m_retryAfter = retryAfterMs(*m_reply);
         m_sink->abort();
         m_reply.reset();
         emit failed(m_index_within_job);
@@ -258,6 +447,12 @@ void Download::downloadFinished()
 
     // otherwise, finalize the whole graph
     m_status = m_sink->finalize(*m_reply.get());
+    if (m_status != Job_Finished && m_onPeer)
+    {
+        // most likely the peer had a different file
+        leavePeer();
+        return;
+    }
     if (m_status != Job_Finished)
     {
         qDebug() << "Download failed to finalize:" << m_url.toString();
@@ -268,6 +463,7 @@ void Download::downloadFinished()
     }
     m_reply.reset();
     qDebug() << "Download succeeded:" << m_url.toString();
+    shareWithPeers();
     emit succeeded(m_index_within_job);
 }
 
@@ -275,7 +471,28 @@ void Download::downloadReadyRead()
 {
     if(m_status == Job_InProgress)
     {
+        if(m_hedge && !isRedirect())
+        {
+            // the original request delivered first, it wins the race
+            dropHedge();
+        }
+        m_sinceData.restart();
+        bool firstData = !m_headersHandled;
+        handleHeaders();
+        if(firstData && m_headersHandled && m_status == Job_InProgress && !m_onPeer)
+        {
+            startSegments();
+        }
+        if(!m_segments.empty())
+        {
+            segmentReadyRead(0);
+            return;
+        }
         auto data = m_reply->readAll();
+        if(isRedirect() || m_status != Job_InProgress)
+        {
+            return;
+        }
         m_status = m_sink->write(data);
         if(m_status == Job_Failed)
         {
@@ -289,10 +506,586 @@ void Download::downloadReadyRead()
     }
 }
 
+
+bool Download::startSegments()
+{
+    auto limits = Scheduler::get(m_network.get())->limits();
+    if(limits.segmentsPerFile < 2)
+    {
+        return false;
+    }
+    int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(statusCode != 200)
+    {
+        return false;
+    }
+    // ranges are only usable if the server advertises them and they apply to the bytes we get
+    if(m_reply->rawHeader("Accept-Ranges").trimmed().toLower() != "bytes")
+    {
+        return false;
+    }
+    auto encoding = m_reply->rawHeader("Content-Encoding").trimmed().toLower();
+    if(!encoding.isEmpty() && encoding != "identity")
+    {
+        return false;
+    }
+    qint64 total = m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    if(total < limits.segmentThreshold)
+    {
+        return false;
+    }
+    // the segments must all come from the same version of the file
+    QByteArray ifRange = m_reply->rawHeader("ETag");
+    if(ifRange.isEmpty() || ifRange.startsWith("W/"))
+    {
+        ifRange = m_reply->rawHeader("Last-Modified");
+    }
+    if(ifRange.isEmpty())
+    {
+        return false;
+    }
+    int count = int(qMin<qint64>(limits.segmentsPerFile, total / minimumSegmentSize));
+    if(count < 2)
+    {
+        return false;
+    }
+    // every segment but the first needs a connection of its own, as many as the limits allow
+    auto scheduler = Scheduler::get(m_network.get());
+    auto host = ConnectionLimiter::hostKey(m_reply->url());
+    int reserved = 0;
+    while(reserved < count - 1 && scheduler->reserveExtra(host, m_priority))
+    {
+        reserved++;
+    }
+    count = reserved + 1;
+    if(count < 2 || !m_sink->beginSegments(total))
+    {
+        for(int i = 0; i < reserved; i++)
+        {
+            scheduler->partCancelled(host);
+        }
+        return false;
+    }
+
+    qDebug() << "Downloading" << m_url.toString() << "in" << count << "segments";
+    m_segmentsTotal = total;
+    qint64 segmentSize = total / count;
+    for(int i = 0; i < count; i++)
+    {
+        std::unique_ptr<Segment> segment(new Segment());
+        segment->start = segment->offset = i * segmentSize;
+        segment->end = (i == count - 1) ? total : (i + 1) * segmentSize;
+        if(i > 0)
+        {
+            segment->host = host;
+        }
+        m_segments.push_back(std::move(segment));
+    }
+    // the original request already covers the first segment, the rest gets new ones
+    m_segments[0]->responseChecked = true;
+    for(int i = 1; i < count; i++)
+    {
+        auto & segment = *m_segments[i];
+        QNetworkRequest request(m_reply->url());
+        request.setHeader(QNetworkRequest::UserAgentHeader, BuildConfig.USER_AGENT);
+        request.setRawHeader("Range", QString("bytes=%1-%2").arg(segment.start).arg(segment.end - 1).toLatin1());
+        request.setRawHeader("If-Range", ifRange);
+        auto rep = m_network->get(request);
+        segment.reply.reset(rep);
+        connect(rep, &QNetworkReply::readyRead, this, [this, i]() { segmentReadyRead(i); });
+        connect(rep, &QNetworkReply::finished, this, [this, i]() { segmentFinished(i); });
+        connect(rep, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error), this,
+            [this, i](QNetworkReply::NetworkError error) { segmentError(i, error); });
+    }
+    return true;
+}
+
+QNetworkReply * Download::segmentReply(int index)
+{
+    if(index == 0)
+    {
+        return m_reply.get();
+    }
+    return m_segments[index]->reply.get();
+}
+
+bool Download::checkSegmentResponse(int index)
+{
+    auto & segment = *m_segments[index];
+    if(segment.responseChecked)
+    {
+        return true;
+    }
+    segment.responseChecked = true;
+    auto reply = segmentReply(index);
+    int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    auto contentRange = QString::fromLatin1(reply->rawHeader("Content-Range"));
+    // anything else means the file changed in the meantime or the server doesn't do ranges after all
+    if(statusCode != 206 || !contentRange.startsWith(QString("bytes %1-").arg(segment.start)))
+    {
+        qWarning() << "Segment" << index << "of" << m_url.toString() << "got an unexpected response:" << statusCode << contentRange;
+        return false;
+    }
+    return true;
+}
+
+void Download::segmentReadyRead(int index)
+{
+    if(index >= int(m_segments.size()))
+    {
+        return;
+    }
+    auto & segment = *m_segments[index];
+    if(m_status != Job_InProgress || segment.failed)
+    {
+        segmentReply(index)->readAll();
+        return;
+    }
+    if(!checkSegmentResponse(index))
+    {
+        segment.failed = true;
+        failSegments();
+        return;
+    }
+    writeSegment(index);
+}
+
+void Download::writeSegment(int index)
+{
+    auto & segment = *m_segments[index];
+    auto reply = segmentReply(index);
+    auto data = reply->readAll();
+    // the first request is for the whole file, anything past its segment belongs to the others
+    qint64 wanted = segment.end - segment.offset;
+    if(data.size() > wanted)
+    {
+        data.truncate(int(wanted));
+    }
+    if(data.isEmpty())
+    {
+        return;
+    }
+    if(m_sink->writeAt(segment.offset, data) != Job_InProgress)
+    {
+        qCritical() << "Failed to write segment" << index << "of" << m_target_path;
+        segment.failed = true;
+        failSegments();
+        return;
+    }
+    segment.offset += data.size();
+    emitSegmentProgress();
+    if(index == 0 && segment.offset >= segment.end && !segment.replyDone)
+    {
+        // got the whole first segment, stop the original request from downloading the rest of the file
+        QMetaObject::invokeMethod(reply, "abort", Qt::QueuedConnection);
+    }
+}
+
+void Download::segmentError(int index, QNetworkReply::NetworkError error)
+{
+    if(index >= int(m_segments.size()))
+    {
+        return;
+    }
+    auto & segment = *m_segments[index];
+    // we cut the request short ourselves - either it was done, or everything is being stopped
+    if(error == QNetworkReply::OperationCanceledError && (segment.offset >= segment.end || m_status != Job_InProgress))
+    {
+        return;
+    }
+    qCritical() << "Segment" << index << "of" << m_url.toString() << "failed with reason" << error;
+    segment.failed = true;
+}
+
+void Download::segmentFinished(int index)
+{
+    if(index >= int(m_segments.size()))
+    {
+        return;
+    }
+    auto & segment = *m_segments[index];
+    if(segment.replyDone)
+    {
+        return;
+    }
+    segment.replyDone = true;
+    if(m_status == Job_InProgress && !segment.failed)
+    {
+        // make sure we got all the remaining data, if any
+        if(checkSegmentResponse(index))
+        {
+            writeSegment(index);
+        }
+        else
+        {
+            segment.failed = true;
+        }
+        if(!segment.failed && segment.offset < segment.end)
+        {
+            qWarning() << "Segment" << index << "of" << m_url.toString() << "ended early";
+            segment.failed = true;
+        }
+    }
+    releaseSegment(index);
+    if(segment.failed && m_status == Job_InProgress)
+    {
+        failSegments();
+    }
+    // wait for all the others
+    for(auto & other: m_segments)
+    {
+        if(!other->replyDone)
+        {
+            return;
+        }
+    }
+    finishSegmented();
+}
+
+void Download::releaseSegment(int index)
+{
+    auto & segment = *m_segments[index];
+    if(segment.host.isNull())
+    {
+        return;
+    }
+    auto scheduler = Scheduler::get(m_network.get());
+    if(segment.failed)
+    {
+        scheduler->partFailed(segment.host);
+    }
+    else if(segment.offset >= segment.end)
+    {
+        scheduler->partSucceeded(segment.host, segment.end - segment.start);
+    }
+    else
+    {
+        // stopped because of another segment, or an abort
+        scheduler->partCancelled(segment.host);
+    }
+    segment.host = QString();
+}
+
+void Download::stopSegments()
+{
+    for(int i = 0; i < int(m_segments.size()); i++)
+    {
+        if(!m_segments[i]->replyDone)
+        {
+            QMetaObject::invokeMethod(segmentReply(i), "abort", Qt::QueuedConnection);
+        }
+    }
+}
+
+void Download::failSegments()
+{
+    m_status = Job_Failed;
+    stopSegments();
+}
+
+void Download::finishSegmented()
+{
+    m_segments.clear();
+    if(m_status == Job_Aborted)
+    {
+        qDebug() << "Download aborted in previous step:" << m_url.toString();
+        m_sink->abort();
+        m_reply.reset();
+        emit aborted(m_index_within_job);
+        return;
+    }
+    if(m_status != Job_InProgress)
+    {
+        m_sink->abort();
+        m_reply.reset();
+        if((m_options & Option::AcceptLocalFiles) && m_sink->hasLocalData())
+        {
+            qDebug() << "Download failed but we are allowed to proceed:" << m_url.toString();
+            m_status = Job_Failed_Proceed;
+            emit succeeded(m_index_within_job);
+            return;
+        }
+        qDebug() << "Segmented download failed:" << m_url.toString();
+        m_status = Job_Failed;
+        emit failed(m_index_within_job);
+        return;
+    }
+    // reading the file back can take a while for the big files that are segmented, keep it off the GUI thread
+    if(m_sink->validatorsRunInBackground())
+    {
+        auto sink = m_sink.get();
+        m_catchUp.setFuture(QtConcurrent::run([sink]() -> bool
+        {
+            return sink->catchUpValidators();
+        }));
+        return;
+    }
+    finalizeSegmented();
+}
+
+void Download::catchUpFinished()
+{
+    if(m_status == Job_Aborted)
+    {
+        qDebug() << "Download aborted in previous step:" << m_url.toString();
+        m_sink->abort();
+        m_reply.reset();
+        emit aborted(m_index_within_job);
+        return;
+    }
+    if(!m_catchUp.result())
+    {
+        qDebug() << "Download failed to validate:" << m_url.toString();
+        m_sink->abort();
+        m_reply.reset();
+        m_status = Job_Failed;
+        emit failed(m_index_within_job);
+        return;
+    }
+    finalizeSegmented();
+}
+
+void Download::finalizeSegmented()
+{
+    m_status = m_sink->finalize(*m_reply.get());
+    if (m_status != Job_Finished)
+    {
+        qDebug() << "Download failed to finalize:" << m_url.toString();
+        m_sink->abort();
+        m_reply.reset();
+        emit failed(m_index_within_job);
+        return;
+    }
+    m_reply.reset();
+    qDebug() << "Download succeeded:" << m_url.toString();
+    shareWithPeers();
+    emit succeeded(m_index_within_job);
+}
+
+bool Download::hedge()
+{
+    if(m_catchUp.isRunning())
+    {
+        // all the data is there already
+        return false;
+    }
+    if(m_onPeer)
+    {
+        // a peer that stopped sending isn't worth waiting for, the origin is still there
+        if(m_status != Job_InProgress || !m_reply || m_sinceData.elapsed() < stalledAfterMs)
+        {
+            return false;
+        }
+        leavePeer();
+        return true;
+    }
+    if(m_status != Job_InProgress || !m_reply || m_hedge || !m_segments.empty() || m_sources.size() < 2)
+    {
+        return false;
+    }
+    if(m_headersHandled)
+    {
+        // the data is already going into the sink, a duplicate can't take over. If it stopped coming, move on.
+        if(m_sinceData.elapsed() < stalledAfterMs)
+        {
+            return false;
+        }
+        failOver();
+        return true;
+    }
+    auto target = hedgeTarget();
+    if(target.isEmpty())
+    {
+        // tried everything already
+        return false;
+    }
+    m_hedgeSource = (m_hedgeSource + 1) % m_sources.size();
+    QNetworkRequest request(m_request);
+    request.setUrl(target);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    qDebug() << "Download of" << m_url.toString() << "is slow, racing it against" << request.url().toString();
+    auto rep = m_network->get(request);
+    m_hedge.reset(rep);
+    connect(rep, &QNetworkReply::readyRead, this, &Download::hedgeReadyRead);
+    connect(rep, &QNetworkReply::finished, this, &Download::hedgeFinished);
+    connect(rep, &QNetworkReply::sslErrors, this, &Download::sslErrors);
+    return true;
+}
+
+QUrl Download::hedgeTarget() const
+{
+    if(m_catchUp.isRunning() || m_onPeer || m_status != Job_InProgress || !m_reply || m_hedge || m_headersHandled
+        || !m_segments.empty() || m_sources.size() < 2)
+    {
+        return QUrl();
+    }
+    int next = (m_hedgeSource + 1) % m_sources.size();
+    if(next == m_source)
+    {
+        return QUrl();
+    }
+    return m_sources[next];
+}
+
+bool Download::switchSource()
+{
+    if(m_sources.size() < 2 || isRunning())
+    {
+        return false;
+    }
+    m_source = (m_source + 1) % m_sources.size();
+    m_url = m_sources[m_source];
+    return true;
+}
+
+void Download::hedgeReadyRead()
+{
+    if(!m_hedge)
+    {
+        return;
+    }
+    int statusCode = m_hedge->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(statusCode < 200 || statusCode >= 300)
+    {
+        qWarning() << "Mirror" << m_hedge->url().toString() << "responded with" << statusCode;
+        dropHedge();
+        return;
+    }
+    qDebug() << "Mirror" << m_hedge->url().toString() << "answered first, switching to it";
+    adoptHedge();
+}
+
+void Download::hedgeFinished()
+{
+    if(!m_hedge)
+    {
+        return;
+    }
+    int statusCode = m_hedge->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    bool usable = (statusCode >= 200 && statusCode < 300) || statusCode == 304;
+    if(m_hedge->error() != QNetworkReply::NoError || !usable)
+    {
+        qWarning() << "Duplicate request to" << m_hedge->url().toString() << "failed:" << m_hedge->errorString();
+        dropHedge();
+        return;
+    }
+    adoptHedge();
+}
+
+void Download::dropHedge()
+{
+    if(!m_hedge)
+    {
+        return;
+    }
+    m_hedge->disconnect(this);
+    m_hedge->abort();
+    m_hedge.reset();
+    emit hedgeEnded(m_index_within_job, false);
+}
+
+void Download::adoptHedge()
+{
+    // nothing of the original response went into the sink, so the duplicate can simply replace it
+    if(m_reply)
+    {
+        m_reply->disconnect(this);
+        m_reply->abort();
+    }
+    m_reply = std::move(m_hedge);
+    m_reply->disconnect(this);
+    emit hedgeEnded(m_index_within_job, true);
+    m_source = m_hedgeSource;
+    m_url = m_reply->url();
+    m_status = Job_InProgress;
+    m_headersHandled = false;
+    connectReply(m_reply.get());
+    m_sinceData.restart();
+    if(m_reply->bytesAvailable())
+    {
+        downloadReadyRead();
+    }
+    if(m_reply && m_reply->isFinished())
+    {
+        downloadFinished();
+    }
+}
+
+void Download::failOver()
+{
+    int next = (m_source + 1) % m_sources.size();
+    qWarning() << "Download of" << m_url.toString() << "stalled, continuing from" << m_sources[next].toString();
+    m_reply->disconnect(this);
+    m_reply->abort();
+    m_reply.reset();
+    m_source = next;
+    m_url = m_sources[next];
+    // the sink keeps what it has and asks the next source for the rest
+    startImpl();
+}
+
+void Download::leavePeer()
+{
+    qDebug() << "Peer" << m_url.toString() << "could not provide" << m_origin.toString();
+    if(m_reply)
+    {
+        m_reply->disconnect(this);
+        m_reply->abort();
+        m_reply.reset();
+    }
+    m_sink->abort();
+    if(m_peers.isEmpty())
+    {
+        m_onPeer = false;
+        m_url = m_origin;
+    }
+    startImpl();
+}
+
+void Download::shareWithPeers()
+{
+    if(m_sha1.isEmpty())
+    {
+        return;
+    }
+    auto peers = PeerCache::find(m_network.get());
+    if(!peers)
+    {
+        return;
+    }
+    // whoever gets it from us can still revalidate it with the origin later
+    peers->addFile(m_sha1, m_target_path, m_sink->etag(), m_sink->lastModified());
+}
+
+void Download::emitSegmentProgress()
+{
+    qint64 done = 0;
+    for(auto & segment: m_segments)
+    {
+        done += segment->offset - segment->start;
+    }
+    m_total_progress = m_segmentsTotal;
+    m_progress = done;
+    emit netActionProgress(m_index_within_job, done, m_segmentsTotal);
+}
+
 }
 
 bool Net::Download::abort()
 {
+    if(m_catchUp.isRunning())
+    {
+        // it finishes with the abort once the worker is done
+        m_status = Job_Aborted;
+        return true;
+    }
+    dropHedge();
+    if(!m_segments.empty())
+    {
+        m_status = Job_Aborted;
+        stopSegments();
+        return true;
+    }
     if(m_reply)
     {
         m_reply->abort();
@@ -308,3 +1101,20 @@ bool Net::Download::canAbort()
 {
     return true;
 }
+
+bool Net::Download::commit()
+{
+    m_status = m_sink->commit();
+    if(m_status != Job_Finished)
+    {
+        qDebug() << "Download failed to commit:" << m_url.toString();
+        return false;
+    }
+    return true;
+}
+
+void Net::Download::discardStaged()
+{
+    m_sink->abort();
+    m_status = Job_Failed;
+}
@@ -18,10 +18,14 @@
 #include "NetAction.h"
 #include "HttpMetaCache.h"
 #include "Validator.h"
+#include "MultiDigestValidator.h"
 #include "Sink.h"
 
 #include "QObjectPtr.h"
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
 namespace Net {
 class Download : public NetAction
 {
@@ -39,7 +43,7 @@ public: /* types */
 protected: /* con/des */
     explicit Download();
 public:
-    virtual ~Download(){};
+    virtual ~Download();
     static Download::Ptr makeCached(QUrl url, MetaEntryPtr entry, Options options = Option::NoOptions);
     static Download::Ptr makeByteArray(QUrl url, QByteArray *output, Options options = Option::NoOptions);
     static Download::Ptr makeFile(QUrl url, QString path, Options options = Option::NoOptions);
@@ -50,11 +54,79 @@ public: /* methods */
         return m_target_path;
     }
     void addValidator(Validator * v);
+    /// compute the digest along with the others in one pass, checking it if `expected` isn't empty.
+    /// cached downloads record it in the metacache entry.
+    void addDigest(QCryptographicHash::Algorithm algorithm, QByteArray expected = QByteArray());
+    /// other places to get the same file from, in order of preference.
+    /// used when the download stalls or fails, the checksums have to make sure they really serve the same file.
+    void setMirrors(const QList<QUrl> & mirrors);
     bool abort() override;
     bool canAbort() override;
+    bool hedge() override;
+    QUrl hedgeTarget() const override;
+    bool switchSource() override;
+    qint64 retryAfter() const override
+    {
+        return m_retryAfter;
+    }
+    void deferCommit() override
+    {
+        m_sink->deferCommit();
+    }
+    QString stagedFile() const override
+    {
+        return m_sink ? m_sink->stagedFile() : QString();
+    }
+    QString targetPath() const override
+    {
+        return m_target_path;
+    }
+    bool commit() override;
+    void discardStaged() override;
+
+private: /* types */
+    /// a byte range of the file fetched by its own request
+    struct Segment
+    {
+        qint64 start = 0;
+        /// where the next byte of the segment goes
+        qint64 offset = 0;
+        /// one past the last byte of the segment
+        qint64 end = 0;
+        bool responseChecked = false;
+        bool failed = false;
+        bool replyDone = false;
+        /// the connection the segment took from the scheduler, empty for the first one. It uses the download's own.
+        QString host;
+        /// null for the first segment, it uses the original request
+        unique_qobject_ptr<QNetworkReply> reply;
+    };
 
 private: /* methods */
     bool handleRedirect();
+    bool isRedirect();
+    void handleHeaders();
+
+    bool startSegments();
+    QNetworkReply * segmentReply(int index);
+    bool checkSegmentResponse(int index);
+    void writeSegment(int index);
+    void stopSegments();
+    void failSegments();
+    void finishSegmented();
+    void finalizeSegmented();
+    void emitSegmentProgress();
+    /// give the segment's connection back to the scheduler
+    void releaseSegment(int index);
+
+    void connectReply(QNetworkReply * reply);
+    void dropHedge();
+    void adoptHedge();
+    void failOver();
+    /// give up on the current peer, going on with the next one or the origin
+    void leavePeer();
+    /// let other launchers have the file, if it is known by its SHA-1
+    void shareWithPeers();
 
 protected slots:
     void downloadProgress(qint64 bytesReceived, qint64 bytesTotal) override;
@@ -63,6 +135,14 @@ protected slots:
     void downloadFinished() override;
     void downloadReadyRead() override;
 
+    void segmentReadyRead(int index);
+    void segmentError(int index, QNetworkReply::NetworkError error);
+    void segmentFinished(int index);
+    void catchUpFinished();
+
+    void hedgeReadyRead();
+    void hedgeFinished();
+
 public slots:
     void startImpl() override;
 
@@ -70,7 +150,38 @@ private: /* data */
     // FIXME: remove this, it has no business being here.
     QString m_target_path;
     std::unique_ptr<Sink> m_sink;
+    /// owned by m_sink
+    MultiDigestValidator * m_digests = nullptr;
     Options m_options;
+    bool m_headersHandled = false;
+    /// empty unless the download was split into segments
+    std::vector<std::unique_ptr<Segment>> m_segments;
+    qint64 m_segmentsTotal = 0;
+    /// the validators going over the segments they didn't see yet
+    QFutureWatcher<bool> m_catchUp;
+
+    /// every URL the file can come from, the original one first
+    QList<QUrl> m_sources;
+    /// index of the source currently in use
+    int m_source = 0;
+    /// the request as the sink prepared it, duplicates are made from it
+    QNetworkRequest m_request;
+    /// a duplicate of the request sent to the next source. It races the original until one of them delivers data.
+    unique_qobject_ptr<QNetworkReply> m_hedge;
+    int m_hedgeSource = -1;
+    /// time since the last data arrived
+    QElapsedTimer m_sinceData;
+    /// from the Retry-After header of the last failed response
+    qint64 m_retryAfter = -1;
+
+    /// the expected SHA-1, raw. Other launchers are only asked for files known by it.
+    QByteArray m_sha1;
+    bool m_peersLooked = false;
+    /// peers that weren't asked yet
+    QList<QUrl> m_peers;
+    /// where the download goes once the peers are out of the picture
+    QUrl m_origin;
+    bool m_onPeer = false;
 };
 }
 
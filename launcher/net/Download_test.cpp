@@ -0,0 +1,445 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QElapsedTimer>
+#include <QLockFile>
+#include "TestUtil.h"
+
+#include "net/TestHttpServer.h"
+#include "net/NetJob.h"
+#include "net/Download.h"
+#include "net/Scheduler.h"
+#include "FileSystem.h"
+
+namespace {
+QByteArray sha1(const QByteArray & data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QByteArray makeContents(int size)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for(int i = 0; i < size; i++)
+    {
+        result[i] = char(i * 7 + i / 251);
+    }
+    return result;
+}
+
+/// run the job, true if it succeeded
+bool runJob(NetJob & job)
+{
+    QEventLoop loop;
+    QObject::connect(&job, &NetJob::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+    job.start();
+    loop.exec();
+    return job.wasSuccessful();
+}
+
+/// run a job with the download in it, true if it succeeded
+bool run(shared_qobject_ptr<QNetworkAccessManager> network, Net::Download::Ptr dl)
+{
+    NetJob job("DownloadTest", network);
+    job.addNetAction(dl);
+    return runJob(job);
+}
+
+/// the job only hedges once it knows how long its parts usually take. These parts teach it that.
+void addQuickParts(NetJob & job, TestHttpServer & server, QList<QByteArray> & outputs)
+{
+    for(int i = 0; i < 8; i++)
+    {
+        server.addFile(QString("/quick%1").arg(i), QByteArray(100, 'q'));
+        outputs.append(QByteArray());
+    }
+    for(int i = 0; i < 8; i++)
+    {
+        job.addNetAction(Net::Download::makeByteArray(server.url(QString("/quick%1").arg(i)), &outputs[i]));
+    }
+}
+
+/// split files of 8 MiB and more into 4 segments
+void segmentBigFiles(shared_qobject_ptr<QNetworkAccessManager> network)
+{
+    auto limits = Net::Scheduler::get(network.get())->limits();
+    limits.segmentsPerFile = 4;
+    limits.segmentThreshold = 8 * 1024 * 1024;
+    Net::Scheduler::get(network.get())->setLimits(limits);
+}
+
+/// what an interrupted download leaves behind: the data it got and what the server said about the file
+void leavePartial(const QString & target, const QByteArray & data, const QByteArray & etag)
+{
+    FS::write(target + ".part", data);
+    QJsonObject info;
+    info.insert("etag", QString::fromLatin1(etag));
+    info.insert("last_modified", QString());
+    FS::write(target + ".part.json", QJsonDocument(info).toJson(QJsonDocument::Compact));
+}
+}
+
+class DownloadTest : public QObject
+{
+    Q_OBJECT
+
+private
+slots:
+    void test_resume()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer server;
+        server.addFile("/file.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        leavePartial(target, contents.left(40000), server.etag("/file.bin"));
+        auto dl = Net::Download::makeFile(server.url("/file.bin"), target);
+        // the checksum covers what was there before too
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, dl));
+        QCOMPARE(FS::read(target), contents);
+        QCOMPARE(server.requests(), 1);
+        // only the rest was sent
+        QVERIFY(server.bytesSent() < 60000 + 1000);
+        QVERIFY(!QFile::exists(target + ".part"));
+        QVERIFY(!QFile::exists(target + ".part.json"));
+    }
+
+    void test_resumeChangedFile()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer server;
+        server.addFile("/file.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        // the partial data is from another version of the file, the server sends the whole new one
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        leavePartial(target, QByteArray(40000, 'o'), "\"old\"");
+        auto dl = Net::Download::makeFile(server.url("/file.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, dl));
+        QCOMPARE(FS::read(target), contents);
+        QCOMPARE(server.requests(), 1);
+        QVERIFY(server.bytesSent() >= contents.size());
+    }
+
+    void test_resumeUnsatisfiable()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer server;
+        server.addFile("/file.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        // more data than the file has. The range fails, the partial data is thrown away and the retry starts over.
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        leavePartial(target, makeContents(120000), server.etag("/file.bin"));
+        auto dl = Net::Download::makeFile(server.url("/file.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, dl));
+        QCOMPARE(FS::read(target), contents);
+        QCOMPARE(server.requests(), 2);
+    }
+
+    void test_segmented()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(16 * 1024 * 1024);
+        TestHttpServer server;
+        server.addFile("/big.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        segmentBigFiles(network);
+
+        auto target = FS::PathCombine(tempDir.path(), "big.bin");
+        auto dl = Net::Download::makeFile(server.url("/big.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, dl));
+        // the original request and three more for the other segments
+        QCOMPARE(server.requests(), 4);
+        QCOMPARE(FS::read(target), contents);
+        QVERIFY(!QFile::exists(target + ".part"));
+    }
+
+    void test_segmentsNeedConnections()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(16 * 1024 * 1024);
+        TestHttpServer server;
+        server.addFile("/big.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        segmentBigFiles(network);
+        auto limits = Net::Scheduler::get(network.get())->limits();
+        limits.initialPerHost = 2;
+        limits.minPerHost = 2;
+        limits.maxPerHost = 2;
+        Net::Scheduler::get(network.get())->setLimits(limits);
+
+        // only one more connection to the host is allowed, so there are only two segments
+        auto target = FS::PathCombine(tempDir.path(), "big.bin");
+        auto dl = Net::Download::makeFile(server.url("/big.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, dl));
+        QCOMPARE(server.requests(), 2);
+        QVERIFY(server.peakInFlight() <= 2);
+        QCOMPARE(FS::read(target), contents);
+        // and the connections were given back, or this one would never start
+        server.addFile("/small.bin", makeContents(1000));
+        QVERIFY(run(network, Net::Download::makeFile(server.url("/small.bin"), FS::PathCombine(tempDir.path(), "small.bin"))));
+    }
+
+    void test_segmentedChecksumMismatch()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(16 * 1024 * 1024);
+        TestHttpServer server;
+        server.addFile("/big.bin", contents);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        segmentBigFiles(network);
+
+        // the segments that arrived out of order are checked too
+        auto target = FS::PathCombine(tempDir.path(), "big.bin");
+        auto dl = Net::Download::makeFile(server.url("/big.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1("not the file"));
+        QVERIFY(!run(network, dl));
+        QVERIFY(!QFile::exists(target));
+        QVERIFY(!QFile::exists(target + ".part"));
+    }
+
+    void test_abortKeepsBufferedData()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(4 * 1024 * 1024);
+        TestHttpServer server;
+        server.addFile("/file.bin", contents);
+        server.setBandwidth(4 * 1024 * 1024);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        auto dl = Net::Download::makeFile(server.url("/file.bin"), target);
+        NetJob job("DownloadTest", network);
+        job.addNetAction(dl);
+        qint64 received = 0;
+        QObject::connect(dl.get(), &NetAction::netActionProgress, &job, [&](int, qint64 current, qint64)
+        {
+            if(!received && current > 1536 * 1024)
+            {
+                received = current;
+                job.abort();
+            }
+        });
+        QVERIFY(!runJob(job));
+        QVERIFY(received > 0);
+
+        // what was still in the write buffer went into the partial file too
+        auto partial = FS::read(target + ".part");
+        QVERIFY(partial.size() >= received);
+        QCOMPARE(partial, contents.left(partial.size()));
+        QVERIFY(!QFile::exists(target));
+
+        server.resetCounters();
+        auto again = Net::Download::makeFile(server.url("/file.bin"), target);
+        again->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        QVERIFY(run(network, again));
+        QCOMPARE(FS::read(target), contents);
+        QVERIFY(server.bytesSent() < contents.size() - partial.size() + 1000);
+    }
+
+    void test_filesReplacedWithTheJob()
+    {
+        QTemporaryDir tempDir;
+        TestHttpServer server;
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        NetJob job("DownloadTest", network);
+        QStringList targets;
+        int inPlaceEarly = 0;
+        for(int i = 0; i < 3; i++)
+        {
+            auto path = QString("/file%1.bin").arg(i);
+            server.addFile(path, makeContents(1000 + i));
+            auto target = FS::PathCombine(tempDir.path(), QString("file%1.bin").arg(i));
+            FS::write(target, "old contents");
+            targets.append(target);
+            auto dl = Net::Download::makeFile(server.url(path), target);
+            QObject::connect(dl.get(), &NetAction::succeeded, &job, [&, target](int)
+            {
+                if(FS::read(target) != "old contents" || !QFile::exists(target + ".part"))
+                {
+                    inPlaceEarly++;
+                }
+            });
+            job.addNetAction(dl);
+        }
+
+        // a finished download waits next to its target until the job has synced it
+        QVERIFY(runJob(job));
+        QCOMPARE(inPlaceEarly, 0);
+        for(int i = 0; i < 3; i++)
+        {
+            QCOMPARE(FS::read(targets[i]), makeContents(1000 + i));
+            QVERIFY(!QFile::exists(targets[i] + ".part"));
+        }
+    }
+
+    void test_sameFileTwiceInAJob()
+    {
+        QTemporaryDir tempDir;
+        TestHttpServer server;
+        server.addFile("/object", makeContents(1000));
+        server.addFile("/other.bin", makeContents(2000));
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        // like two assets with the same hash, the second one named another way
+        auto target = FS::PathCombine(tempDir.path(), "objects", "object");
+        NetJob job("DownloadTest", network);
+        job.addNetAction(Net::Download::makeFile(server.url("/object"), target));
+        job.addNetAction(Net::Download::makeFile(server.url("/other.bin"), FS::PathCombine(tempDir.path(), "other.bin")));
+        job.addNetAction(Net::Download::makeFile(server.url("/object"), tempDir.path() + "/objects/../objects/object"));
+
+        // the job doesn't wait for its own lock on the file
+        QVERIFY(runJob(job));
+        QCOMPARE(FS::read(target), makeContents(1000));
+        QCOMPARE(server.requestLog().count("/object"), 1);
+        QVERIFY(!QFile::exists(target + ".lock"));
+    }
+
+    void test_lockWaitLeavesTheConnection()
+    {
+        QTemporaryDir tempDir;
+        TestHttpServer server;
+        server.addFile("/locked.bin", makeContents(1000));
+        server.addFile("/other.bin", makeContents(2000));
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto limits = Net::Scheduler::get(network.get())->limits();
+        limits.initialPerHost = 1;
+        limits.minPerHost = 1;
+        limits.maxPerHost = 1;
+        limits.maxTotal = 1;
+        Net::Scheduler::get(network.get())->setLimits(limits);
+
+        // somebody else is downloading the first file
+        auto locked = FS::PathCombine(tempDir.path(), "locked.bin");
+        QLockFile lock(locked + ".lock");
+        QVERIFY(lock.tryLock(0));
+        NetJob job("DownloadTest", network);
+        job.addNetAction(Net::Download::makeFile(server.url("/locked.bin"), locked));
+        auto other = Net::Download::makeFile(server.url("/other.bin"), FS::PathCombine(tempDir.path(), "other.bin"));
+        QObject::connect(other.get(), &NetAction::succeeded, &job, [&](int)
+        {
+            lock.unlock();
+        });
+        job.addNetAction(other);
+
+        // waiting for it leaves the only connection to the other download
+        QVERIFY(runJob(job));
+        QCOMPARE(server.requestLog(), QStringList({"/other.bin", "/locked.bin"}));
+        QCOMPARE(FS::read(locked), makeContents(1000));
+    }
+
+    void test_mirrorFailover()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer origin;
+        TestHttpServer mirror;
+        mirror.addFile("/file.bin", contents);
+        QVERIFY(origin.listen());
+        QVERIFY(mirror.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        // the origin doesn't have the file, the retry goes to the mirror
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        auto dl = Net::Download::makeFile(origin.url("/file.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        dl->setMirrors({mirror.url("/file.bin")});
+        QVERIFY(run(network, dl));
+        QCOMPARE(FS::read(target), contents);
+        QCOMPARE(origin.requests(), 1);
+        QCOMPARE(mirror.requests(), 1);
+    }
+
+    void test_hedgeSlowSource()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer slow;
+        TestHttpServer fast;
+        slow.addFile("/file.bin", contents);
+        slow.setLatency(20000);
+        fast.addFile("/file.bin", contents);
+        QVERIFY(slow.listen());
+        QVERIFY(fast.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+
+        NetJob job("DownloadTest", network);
+        QList<QByteArray> outputs;
+        addQuickParts(job, fast, outputs);
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        auto dl = Net::Download::makeFile(slow.url("/file.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        dl->setMirrors({fast.url("/file.bin")});
+        job.addNetAction(dl);
+
+        // a couple of seconds in, the mirror is asked too and wins the race
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(runJob(job));
+        QVERIFY(timer.elapsed() < 10000);
+        QCOMPARE(FS::read(target), contents);
+        QVERIFY(fast.requestLog().contains("/file.bin"));
+    }
+
+    void test_hedgeNeedsAConnection()
+    {
+        QTemporaryDir tempDir;
+        auto contents = makeContents(100000);
+        TestHttpServer slow;
+        TestHttpServer fast;
+        slow.addFile("/file.bin", contents);
+        slow.setLatency(4000);
+        fast.addFile("/file.bin", contents);
+        QVERIFY(slow.listen());
+        QVERIFY(fast.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto limits = Net::Scheduler::get(network.get())->limits();
+        limits.maxTotal = 1;
+        Net::Scheduler::get(network.get())->setLimits(limits);
+
+        NetJob job("DownloadTest", network);
+        QList<QByteArray> outputs;
+        addQuickParts(job, fast, outputs);
+        auto target = FS::PathCombine(tempDir.path(), "file.bin");
+        auto dl = Net::Download::makeFile(slow.url("/file.bin"), target);
+        dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+        dl->setMirrors({fast.url("/file.bin")});
+        job.addNetAction(dl);
+
+        // the slow download holds the only connection there is, so there is no duplicate request
+        QVERIFY(runJob(job));
+        QCOMPARE(FS::read(target), contents);
+        QVERIFY(!fast.requestLog().contains("/file.bin"));
+        QCOMPARE(slow.requests(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(DownloadTest)
+
+#include "Download_test.moc"
@@ -1,10 +1,24 @@
 #include "FileSink.h"
 #include <QFile>
 #include <QFileInfo>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include "FileSystem.h"
 
 namespace Net {
 
+namespace {
+// how much of a partial file is fed to the validators at once when they have to catch up with it
+const qint64 catchUpChunkSize = 1024 * 1024;
+// data is collected until there is this much of it...
+const int writeBufferSize = 1024 * 1024;
+// ... and written up to a multiple of this, the rest waits for more
+const qint64 writeAlignment = 64 * 1024;
+// a lock left behind by a launcher on another machine is only ignored after this long, downloads can take a while
+const int lockStaleMs = 15 * 60 * 1000;
+}
+
 FileSink::FileSink(QString filename)
     :m_filename(filename)
 {
@@ -13,7 +27,48 @@ FileSink::FileSink(QString filename)
 
 FileSink::~FileSink()
 {
-    // nil
+    if(m_staged)
+    {
+        // never committed, it may not be on the disk
+        discardPartial();
+    }
+}
+
+QString FileSink::partialPath() const
+{
+    return m_filename + ".part";
+}
+
+QString FileSink::partialInfoPath() const
+{
+    return m_filename + ".part.json";
+}
+
+bool FileSink::tryLock()
+{
+    if(m_lock)
+    {
+        return true;
+    }
+    if (!FS::ensureFilePathExists(m_filename))
+    {
+        // init will fail on its own
+        return true;
+    }
+    std::unique_ptr<QLockFile> lock(new QLockFile(m_filename + ".lock"));
+    lock->setStaleLockTime(lockStaleMs);
+    if(!lock->tryLock(0))
+    {
+        if(lock->error() != QLockFile::LockFailedError)
+        {
+            // can't lock at all here, a read-only folder for example. carry on alone.
+            return true;
+        }
+        m_lockContended = true;
+        return false;
+    }
+    m_lock = std::move(lock);
+    return true;
 }
 
 JobStatus FileSink::init(QNetworkRequest& request)
@@ -21,55 +76,347 @@ JobStatus FileSink::init(QNetworkRequest& request)
     auto result = initCache(request);
     if(result != Job_InProgress)
     {
+        m_lock.reset();
         return result;
     }
-    // create a new save file and open it for writing
+    m_staged = false;
+    // starting over in the middle of a download, what we have so far can be resumed
+    if(m_output_file && !m_segmented && !flushBuffer(true))
+    {
+        discardPartial();
+    }
+    // create a new partial file or continue the old one
     if (!FS::ensureFilePathExists(m_filename))
     {
         qCritical() << "Could not create folder for " + m_filename;
         return Job_Failed;
     }
     wroteAnyData = false;
-    m_output_file.reset(new QSaveFile(m_filename));
-    if (!m_output_file->open(QIODevice::WriteOnly))
+    m_segmented = false;
+    m_output_file.reset();
+    bool resuming = prepareResume(request);
+    if(!resuming)
+    {
+        discardPartial();
+    }
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    mode |= resuming ? QIODevice::Append : QIODevice::Truncate;
+    m_output_file.reset(new QFile(partialPath()));
+    if (!m_output_file->open(mode))
     {
-        qCritical() << "Could not open " + m_filename + " for writing";
+        qCritical() << "Could not open " + partialPath() + " for writing";
         return Job_Failed;
     }
 
-    if(initAllValidators(request))
+    if(resuming && m_validatedBytes == m_resumeFrom)
+    {
+        // the validators have seen exactly the data we have, they can keep going from there
+        return Job_InProgress;
+    }
+    if(restartValidators(request))
         return Job_InProgress;
     return Job_Failed;
 }
 
+bool FileSink::prepareResume(QNetworkRequest& request)
+{
+    m_resumeFrom = 0;
+    QFileInfo partial(partialPath());
+    if(!partial.isFile() || partial.size() == 0)
+    {
+        return false;
+    }
+    QFile infoFile(partialInfoPath());
+    if(!infoFile.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    auto info = QJsonDocument::fromJson(infoFile.readAll()).object();
+    auto etag = info.value("etag").toString();
+    auto lastModified = info.value("last_modified").toString();
+    QString ifRange;
+    // If-Range only works with strong entity tags
+    if(!etag.isEmpty() && !etag.startsWith("W/"))
+    {
+        ifRange = etag;
+    }
+    else if(!lastModified.isEmpty())
+    {
+        ifRange = lastModified;
+    }
+    else
+    {
+        return false;
+    }
+    m_resumeFrom = partial.size();
+    request.setRawHeader("Range", QString("bytes=%1-").arg(m_resumeFrom).toLatin1());
+    request.setRawHeader("If-Range", ifRange.toLatin1());
+    qDebug() << "Resuming download of" << m_filename << "from byte" << m_resumeFrom;
+    return true;
+}
+
+bool FileSink::restartValidators(QNetworkRequest& request)
+{
+    m_validatedBytes = -1;
+    if(!initAllValidators(request))
+    {
+        return false;
+    }
+    m_validatedBytes = 0;
+    // feed the validators what we already have
+    return feedValidators(m_resumeFrom);
+}
+
+bool FileSink::feedValidators(qint64 until)
+{
+    if(m_validatedBytes >= until)
+    {
+        return true;
+    }
+    QFile partial(partialPath());
+    if(!partial.open(QIODevice::ReadOnly) || !partial.seek(m_validatedBytes))
+    {
+        m_validatedBytes = -1;
+        return false;
+    }
+    while(m_validatedBytes < until)
+    {
+        auto chunk = partial.read(qMin(catchUpChunkSize, until - m_validatedBytes));
+        if(chunk.isEmpty() || !writeAllValidators(chunk))
+        {
+            m_validatedBytes = -1;
+            return false;
+        }
+        m_validatedBytes += chunk.size();
+    }
+    return true;
+}
+
+void FileSink::discardPartial()
+{
+    m_buffer.clear();
+    m_output_file.reset();
+    QFile::remove(partialPath());
+    QFile::remove(partialInfoPath());
+    m_resumeFrom = 0;
+    m_validatedBytes = -1;
+    m_segmented = false;
+    m_staged = false;
+}
+
 JobStatus FileSink::initCache(QNetworkRequest &)
 {
     return Job_InProgress;
 }
 
+JobStatus FileSink::headersReceived(QNetworkReply& reply)
+{
+    int statusCode = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(m_resumeFrom > 0)
+    {
+        if(statusCode == 206)
+        {
+            // make sure the server continues where we stopped
+            auto contentRange = QString::fromLatin1(reply.rawHeader("Content-Range"));
+            if(!contentRange.startsWith(QString("bytes %1-").arg(m_resumeFrom)))
+            {
+                qWarning() << "Cannot resume" << m_filename << "- unexpected content range" << contentRange;
+                discardPartial();
+                return Job_Failed;
+            }
+            // what we had before counts as written now
+            wroteAnyData = true;
+        }
+        else if(statusCode == 416)
+        {
+            qWarning() << "Cannot resume" << m_filename << "- the partial data does not match the remote file";
+            discardPartial();
+            return Job_Failed;
+        }
+        else
+        {
+            // the file changed or the server ignored the range, start from scratch
+            qDebug() << "Server did not resume" << m_filename << "- downloading the whole file";
+            m_resumeFrom = 0;
+            if(!m_output_file->resize(0))
+            {
+                qCritical() << "Failed to truncate" << partialPath();
+                return Job_Failed;
+            }
+            QNetworkRequest request = reply.request();
+            if(!restartValidators(request))
+            {
+                return Job_Failed;
+            }
+        }
+    }
+
+    // remember what is needed to resume the download, in case it breaks
+    if(statusCode == 200 || statusCode == 206)
+    {
+        bool knownLength = false;
+        qint64 length = reply.header(QNetworkRequest::ContentLengthHeader).toLongLong(&knownLength);
+        if(knownLength && length > 0 && !FS::preallocate(*m_output_file, m_resumeFrom + length))
+        {
+            qDebug() << "Could not reserve space for" << m_filename;
+        }
+
+        QJsonObject info;
+        info.insert("etag", QString::fromLatin1(reply.rawHeader("ETag")));
+        info.insert("last_modified", QString::fromLatin1(reply.rawHeader("Last-Modified")));
+        try
+        {
+            FS::write(partialInfoPath(), QJsonDocument(info).toJson(QJsonDocument::Compact));
+        }
+        catch (const Exception &e)
+        {
+            qWarning() << "Download of" << m_filename << "will not be resumable:" << e.what();
+        }
+    }
+    else
+    {
+        QFile::remove(partialInfoPath());
+    }
+    return Job_InProgress;
+}
+
 JobStatus FileSink::write(QByteArray& data)
 {
-    if (!writeAllValidators(data) || m_output_file->write(data) != data.size())
+    if (!writeAllValidators(data))
     {
-        qCritical() << "Failed writing into " + m_filename;
-        m_output_file->cancelWriting();
-        m_output_file.reset();
+        qCritical() << "Failed writing into " + partialPath();
+        discardPartial();
+        wroteAnyData = false;
+        return Job_Failed;
+    }
+    if(m_buffer.capacity() < writeBufferSize)
+    {
+        m_buffer.reserve(writeBufferSize);
+    }
+    m_buffer.append(data);
+    m_validatedBytes += data.size();
+    wroteAnyData = true;
+    if(m_buffer.size() >= writeBufferSize && !flushBuffer(false))
+    {
+        qCritical() << "Failed writing into " + partialPath();
+        discardPartial();
+        wroteAnyData = false;
+        return Job_Failed;
+    }
+    return Job_InProgress;
+}
+
+bool FileSink::flushBuffer(bool all)
+{
+    if(m_buffer.isEmpty())
+    {
+        return true;
+    }
+    qint64 amount = m_buffer.size();
+    if(!all)
+    {
+        qint64 position = m_output_file->size();
+        amount = (position + amount) / writeAlignment * writeAlignment - position;
+        if(amount <= 0)
+        {
+            return true;
+        }
+    }
+    if(m_output_file->write(m_buffer.constData(), amount) != amount)
+    {
+        return false;
+    }
+    m_buffer.remove(0, int(amount));
+    return true;
+}
+
+bool FileSink::beginSegments(qint64 size)
+{
+    if(m_resumeFrom > 0 || wroteAnyData || !m_output_file)
+    {
+        return false;
+    }
+    if(!m_output_file->resize(size))
+    {
+        qWarning() << "Could not preallocate" << size << "bytes for" << m_filename;
+        return false;
+    }
+    // a file with holes in it can't be resumed
+    QFile::remove(partialInfoPath());
+    m_segmented = true;
+    return true;
+}
+
+JobStatus FileSink::writeAt(qint64 offset, QByteArray& data)
+{
+    if (!m_segmented || !m_output_file->seek(offset) || m_output_file->write(data) != data.size())
+    {
+        qCritical() << "Failed writing into " + partialPath();
+        discardPartial();
         wroteAnyData = false;
         return Job_Failed;
     }
+    // data right where the validators are goes to them now, the rest has to wait for catchUpValidators
+    if(offset == m_validatedBytes)
+    {
+        if(!writeAllValidators(data))
+        {
+            qCritical() << "Failed writing into " + partialPath();
+            discardPartial();
+            wroteAnyData = false;
+            return Job_Failed;
+        }
+        m_validatedBytes += data.size();
+    }
     wroteAnyData = true;
     return Job_InProgress;
 }
 
+bool FileSink::catchUpValidators()
+{
+    if(!m_segmented)
+    {
+        return true;
+    }
+    if(m_validatedBytes < 0 || !m_output_file || !m_output_file->flush())
+    {
+        return false;
+    }
+    return feedValidators(m_output_file->size());
+}
+
 JobStatus FileSink::abort()
 {
-    m_output_file->cancelWriting();
+    // let go once everything is cleaned up
+    auto lock = std::move(m_lock);
+    if(m_staged || m_segmented)
+    {
+        discardPartial();
+        failAllValidators();
+        return Job_Failed;
+    }
+    // keep the partial file around, the next attempt can continue it
+    if(m_output_file)
+    {
+        if(!flushBuffer(true))
+        {
+            discardPartial();
+            failAllValidators();
+            return Job_Failed;
+        }
+        m_output_file->close();
+        m_output_file.reset();
+    }
     failAllValidators();
     return Job_Failed;
 }
 
 JobStatus FileSink::finalize(QNetworkReply& reply)
 {
+    // let go once the file and its cache entry are in place, or something went wrong
+    auto lock = std::move(m_lock);
+    m_etag = reply.rawHeader("ETag");
+    m_lastModified = reply.rawHeader("Last-Modified");
     bool gotFile = false;
     QVariant statusCodeV = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute);
     bool validStatus = false;
@@ -77,31 +424,81 @@ JobStatus FileSink::finalize(QNetworkReply& reply)
     if(validStatus)
     {
         // this leaves out 304 Not Modified
-        gotFile = statusCode == 200 || statusCode == 203;
+        gotFile = statusCode == 200 || statusCode == 203 || statusCode == 206;
     }
-    // if we wrote any data to the save file, we try to commit the data to the real file.
+    // if we wrote any data to the partial file, we try to move it over the real file.
     // if it actually got a proper file, we write it even if it was empty
     if (gotFile || wroteAnyData)
     {
+        if (!flushBuffer(true) || !m_output_file->flush())
+        {
+            qCritical() << "Failed to write " << partialPath();
+            discardPartial();
+            return Job_Failed;
+        }
+        // usually done on a worker thread already, see Download
+        if(m_segmented && !catchUpValidators())
+        {
+            discardPartial();
+            return Job_Failed;
+        }
         // ask validators for data consistency
         // we only do this for actual downloads, not 'your data is still the same' cache hits
         if(!finalizeAllValidators(reply))
+        {
+            discardPartial();
             return Job_Failed;
+        }
         // nothing went wrong...
-        if (!m_output_file->commit())
+        m_output_file->close();
+        m_staged = true;
+        if(m_deferCommit)
+        {
+            // nobody else may touch the file until it is committed
+            m_lock = std::move(lock);
+            return Job_Finished;
+        }
+        // a crash right after the rename must not leave a target with data that never made it to the disk
+        if(!FS::syncFiles({partialPath()}))
+        {
+            qCritical() << "Failed to sync " << partialPath();
+            discardPartial();
+            return Job_Failed;
+        }
+    }
+    m_lock = std::move(lock);
+    return commit();
+}
+
+void FileSink::deferCommit()
+{
+    m_deferCommit = true;
+}
+
+QString FileSink::stagedFile() const
+{
+    return m_staged ? partialPath() : QString();
+}
+
+JobStatus FileSink::commit()
+{
+    auto lock = std::move(m_lock);
+    if(m_staged)
+    {
+        if (!FS::replaceFile(partialPath(), m_filename))
         {
             qCritical() << "Failed to commit changes to " << m_filename;
-            m_output_file->cancelWriting();
+            discardPartial();
             return Job_Failed;
         }
     }
-    // then get rid of the save file
-    m_output_file.reset();
+    // then get rid of the partial file
+    discardPartial();
 
-    return finalizeCache(reply);
+    return finalizeCache();
 }
 
-JobStatus FileSink::finalizeCache(QNetworkReply &)
+JobStatus FileSink::finalizeCache()
 {
     return Job_Finished;
 }
@@ -1,8 +1,26 @@
 #pragma once
 #include "Sink.h"
-#include <QSaveFile>
+#include <QFile>
+#include <QLockFile>
 
 namespace Net {
+/*
+ * Sink that writes into a file.
+ *
+ * Data goes into a `.part` file next to the target, which replaces the target once the download is complete and valid.
+ * If the download fails, the partial data is kept along with the HTTP validators (ETag, Last-Modified) of the response,
+ * so the next attempt can resume it with a Range request.
+ *
+ * Segmented downloads write into a partial file preallocated to the full size. The validators get the data that arrives
+ * in order right away, the rest is read back from the file at the end.
+ *
+ * Otherwise the data is collected in a buffer and written in big pieces that end on aligned offsets. When the response
+ * says how big it is, the disk space is reserved up front. The finished file is synced before it replaces the target.
+ * With deferCommit, it waits for commit() instead, so NetJob can sync the files of a job in batches.
+ *
+ * While the download runs, a `.lock` file next to the target keeps other launchers sharing the folder from fetching the
+ * same file at the same time.
+ */
 class FileSink : public Sink
 {
 public: /* con/des */
@@ -10,19 +28,70 @@ public: /* con/des */
     virtual ~FileSink();
 
 public: /* methods */
+    bool tryLock() override;
     JobStatus init(QNetworkRequest & request) override;
+    JobStatus headersReceived(QNetworkReply & reply) override;
     JobStatus write(QByteArray & data) override;
+    bool beginSegments(qint64 size) override;
+    JobStatus writeAt(qint64 offset, QByteArray & data) override;
+    bool catchUpValidators() override;
     JobStatus abort() override;
     JobStatus finalize(QNetworkReply & reply) override;
     bool hasLocalData() override;
+    void deferCommit() override;
+    QString stagedFile() const override;
+    JobStatus commit() override;
+    QByteArray etag() const override
+    {
+        return m_etag;
+    }
+    QByteArray lastModified() const override
+    {
+        return m_lastModified;
+    }
 
 protected: /* methods */
     virtual JobStatus initCache(QNetworkRequest &);
-    virtual JobStatus finalizeCache(QNetworkReply &reply);
+    /// the file is in place, the HTTP validators of the response are in m_etag and m_lastModified
+    virtual JobStatus finalizeCache();
+    /// tryLock had to wait for someone else, they may have left the file behind
+    bool lockWasContended() const
+    {
+        return m_lockContended;
+    }
+
+private: /* methods */
+    QString partialPath() const;
+    QString partialInfoPath() const;
+    bool prepareResume(QNetworkRequest & request);
+    bool restartValidators(QNetworkRequest & request);
+    /// feed the validators the partial file from where they are up to `until`
+    bool feedValidators(qint64 until);
+    void discardPartial();
+    /// write out the buffered data. Unless `all` is set, only up to the last aligned offset.
+    bool flushBuffer(bool all);
 
 protected: /* data */
     QString m_filename;
     bool wroteAnyData = false;
-    std::unique_ptr<QSaveFile> m_output_file;
+    std::unique_ptr<QFile> m_output_file;
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+
+private: /* data */
+    /// where the requested range starts, 0 when downloading the whole file
+    qint64 m_resumeFrom = 0;
+    /// how many bytes of the partial file the validators have seen since they were last initialized
+    qint64 m_validatedBytes = -1;
+    /// the data arrives in segments, the partial file has holes until the download is complete
+    bool m_segmented = false;
+    /// data that isn't in the partial file yet
+    QByteArray m_buffer;
+    bool m_deferCommit = false;
+    /// the partial file is complete and valid, waiting to replace the target
+    bool m_staged = false;
+    /// held from tryLock until the download is committed or aborted
+    std::unique_ptr<QLockFile> m_lock;
+    bool m_lockContended = false;
 };
 }
@@ -18,6 +18,7 @@
 
 #include <QFileInfo>
 #include <QFile>
+#include <QDir>
 #include <QDateTime>
 #include <QCryptographicHash>
 
@@ -26,6 +27,36 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QDataStream>
+#include <QFutureWatcher>
+#include <QLockFile>
+#include <QThread>
+#include <QtConcurrentRun>
+
+namespace {
+// 'MMCJ'
+const quint32 journalMagic = 0x4D4D434A;
+// 2 added the snapshot generation the journal goes with
+const quint32 journalVersion = 2;
+// the journal is folded into the snapshot once it has this many records, or a quarter of the snapshot size
+const int minCompactionRecords = 1024;
+// files are hashed in pieces of this size, so big files don't end up in memory as a whole
+const qint64 hashChunkSize = 1024 * 1024;
+// hashing is mostly waiting for the disk, more threads than this don't help
+const int maxVerifyThreads = 4;
+// access times are only recorded this precisely, so using an entry doesn't write to the journal every time
+const qint64 accessGranularityMs = 60 * 60 * 1000;
+// other launchers sharing the cache only hold the index lock for a moment...
+const int indexLockTimeoutMs = 10 * 1000;
+// ... and this is how often we look for what they changed, if they aren't holding it
+const int reloadIntervalMs = 5 * 1000;
+
+enum JournalOp : quint8
+{
+    JournalPut = 1,
+    JournalRemove = 2
+};
+}
 
 QString MetaEntry::getFullPath()
 {
@@ -33,17 +64,106 @@ QString MetaEntry::getFullPath()
     return FS::PathCombine(basePath, relativePath);
 }
 
+namespace {
+QString digestName(QCryptographicHash::Algorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case QCryptographicHash::Sha1:
+            return "sha1";
+        case QCryptographicHash::Sha256:
+            return "sha256";
+        case QCryptographicHash::Sha512:
+            return "sha512";
+        default:
+            return QString();
+    }
+}
+}
+
+QString MetaEntry::getDigest(QCryptographicHash::Algorithm algorithm)
+{
+    if (algorithm == QCryptographicHash::Md5)
+    {
+        return md5sum;
+    }
+    return digests.value(digestName(algorithm));
+}
+
+void MetaEntry::setDigest(QCryptographicHash::Algorithm algorithm, QString digest)
+{
+    if (algorithm == QCryptographicHash::Md5)
+    {
+        md5sum = digest;
+        return;
+    }
+    auto name = digestName(algorithm);
+    if (name.isEmpty())
+    {
+        return;
+    }
+    if (digest.isEmpty())
+    {
+        digests.remove(name);
+    }
+    else
+    {
+        digests.insert(name, digest);
+    }
+}
+
+void MetaEntry::clearDigests()
+{
+    digests.clear();
+}
+
+QString MetaEntry::encodeDigests(const QMap<QString, QString> &digests)
+{
+    QStringList parts;
+    for (auto iter = digests.begin(); iter != digests.end(); iter++)
+    {
+        parts.append(iter.key() + ':' + iter.value());
+    }
+    return parts.join(' ');
+}
+
+QMap<QString, QString> MetaEntry::decodeDigests(const QString &encoded)
+{
+    QMap<QString, QString> digests;
+    for (auto &part : encoded.split(' ', QString::SkipEmptyParts))
+    {
+        int separator = part.indexOf(':');
+        if (separator > 0)
+        {
+            digests.insert(part.left(separator), part.mid(separator + 1));
+        }
+    }
+    return digests;
+}
+
 HttpMetaCache::HttpMetaCache(QString path) : QObject()
 {
     m_index_file = path;
     saveBatchingTimer.setSingleShot(true);
     saveBatchingTimer.setTimerType(Qt::VeryCoarseTimer);
     connect(&saveBatchingTimer, SIGNAL(timeout()), SLOT(SaveNow()));
+    // everything changed until control goes back to the event loop is saved together
+    saveSoonTimer.setSingleShot(true);
+    saveSoonTimer.setInterval(0);
+    connect(&saveSoonTimer, &QTimer::timeout, this, &HttpMetaCache::SaveNow);
+    reloadTimer.setInterval(reloadIntervalMs);
+    reloadTimer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&reloadTimer, &QTimer::timeout, this, &HttpMetaCache::reloadIfChanged);
+    m_verifyPool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), maxVerifyThreads));
 }
 
 HttpMetaCache::~HttpMetaCache()
 {
+    m_verifyPool.clear();
+    m_verifyPool.waitForDone();
+    reloadTimer.stop();
     saveBatchingTimer.stop();
+    saveSoonTimer.stop();
     SaveNow();
 }
 
@@ -56,11 +176,30 @@ MetaEntryPtr HttpMetaCache::getEntry(QString base, QString resource_path)
         return MetaEntryPtr();
     }
     EntryMap &map = m_entries[base];
-    if (map.entry_list.contains(resource_path))
+    auto iter = map.entry_list.find(resource_path);
+    if (iter != map.entry_list.end())
     {
-        return map.entry_list[resource_path];
+        return *iter;
     }
-    return MetaEntryPtr();
+    MetaCacheRecord record;
+    if (!m_snapshot.find(base, resource_path, record))
+    {
+        return MetaEntryPtr();
+    }
+    auto foo = new MetaEntry();
+    foo->baseId = base;
+    foo->basePath = map.base_path;
+    foo->relativePath = resource_path;
+    foo->md5sum = record.md5sum;
+    foo->digests = MetaEntry::decodeDigests(record.digests);
+    foo->etag = record.etag;
+    foo->local_changed_timestamp = record.local_changed_timestamp;
+    foo->remote_changed_timestamp = record.remote_changed_timestamp;
+    foo->last_access = record.last_access;
+    foo->stale = false;
+    MetaEntryPtr entry(foo);
+    map.entry_list.insert(resource_path, entry);
+    return entry;
 }
 
 MetaEntryPtr HttpMetaCache::resolveEntry(QString base, QString resource_path, QString expected_etag)
@@ -80,14 +219,14 @@ MetaEntryPtr HttpMetaCache::resolveEntry(QString base, QString resource_path, QS
     if (!finfo.isFile() || !finfo.isReadable())
     {
         // if the file doesn't exist, we disown the entry
-        selected_base.entry_list.remove(resource_path);
+        removeEntry(base, resource_path);
         return staleEntry(base, resource_path);
     }
 
     if (!expected_etag.isEmpty() && expected_etag != entry->etag)
     {
         // if the etag doesn't match expected, we disown the entry
-        selected_base.entry_list.remove(resource_path);
+        removeEntry(base, resource_path);
         return staleEntry(base, resource_path);
     }
 
@@ -95,26 +234,123 @@ MetaEntryPtr HttpMetaCache::resolveEntry(QString base, QString resource_path, QS
     qint64 file_last_changed = finfo.lastModified().toUTC().toMSecsSinceEpoch();
     if (file_last_changed != entry->local_changed_timestamp)
     {
-        QFile input(real_path);
-        input.open(QIODevice::ReadOnly);
-        QString md5sum = QCryptographicHash::hash(input.readAll(), QCryptographicHash::Md5)
-                             .toHex()
-                             .constData();
-        if (entry->md5sum != md5sum)
+        QString md5sum;
+        if (!knownHash(real_path, finfo, md5sum))
+        {
+            auto verified = hashFile(real_path);
+            m_verified.insert(real_path, verified);
+            md5sum = verified.md5sum;
+        }
+        if (md5sum.isEmpty() || entry->md5sum != md5sum)
         {
-            selected_base.entry_list.remove(resource_path);
+            removeEntry(base, resource_path);
             return staleEntry(base, resource_path);
         }
         // md5sums matched... keep entry and save the new state to file
         entry->local_changed_timestamp = file_last_changed;
+        markDirty(base, resource_path);
         SaveEventually();
     }
 
     // entry passed all the checks we cared about.
     entry->basePath = getBasePath(base);
+    entry->cache = this;
+    touch(entry);
     return entry;
 }
 
+void HttpMetaCache::verifyEntries(const QList<QPair<QString, QString>> &entries, QObject *context,
+                                  std::function<void()> done)
+{
+    QSet<QString> toHash;
+    for (const auto &request : entries)
+    {
+        auto entry = getEntry(request.first, request.second);
+        if (!entry || entry->stale)
+            continue;
+        QString real_path = FS::PathCombine(getBasePath(request.first), request.second);
+        QFileInfo finfo(real_path);
+        if (!finfo.isFile() || !finfo.isReadable())
+            continue;
+        if (finfo.lastModified().toUTC().toMSecsSinceEpoch() == entry->local_changed_timestamp)
+            continue;
+        QString md5sum;
+        if (knownHash(real_path, finfo, md5sum))
+            continue;
+        toHash.insert(real_path);
+    }
+
+    QPointer<QObject> guard(context);
+    if (toHash.isEmpty())
+    {
+        QTimer::singleShot(0, context, done);
+        return;
+    }
+    qDebug() << "Verifying" << toHash.size() << "changed files in the metacache";
+    auto pending = std::make_shared<int>(toHash.size());
+    for (const auto &path : toHash)
+    {
+        auto watcher = new QFutureWatcher<VerifiedFile>(this);
+        connect(watcher, &QFutureWatcher<VerifiedFile>::finished, this, [this, watcher, path, pending, guard, done]()
+        {
+            if (!watcher->isCanceled())
+            {
+                m_verified.insert(path, watcher->result());
+            }
+            watcher->deleteLater();
+            if (--(*pending) == 0 && guard)
+            {
+                done();
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(&m_verifyPool, &HttpMetaCache::hashFile, path));
+    }
+}
+
+HttpMetaCache::VerifiedFile HttpMetaCache::hashFile(const QString &path)
+{
+    VerifiedFile result;
+    QFileInfo before(path);
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly))
+    {
+        return result;
+    }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    QByteArray chunk;
+    while (!(chunk = input.read(hashChunkSize)).isEmpty())
+    {
+        hash.addData(chunk);
+    }
+    if (input.error() != QFileDevice::NoError)
+    {
+        return result;
+    }
+    // if the file changed while we were reading it, the hash is worthless
+    QFileInfo after(path);
+    qint64 last_changed = before.lastModified().toUTC().toMSecsSinceEpoch();
+    if (after.size() != before.size() || after.lastModified().toUTC().toMSecsSinceEpoch() != last_changed)
+    {
+        return result;
+    }
+    result.size = before.size();
+    result.last_changed = last_changed;
+    result.md5sum = hash.result().toHex().constData();
+    return result;
+}
+
+bool HttpMetaCache::knownHash(const QString &path, const QFileInfo &info, QString &md5sum) const
+{
+    auto iter = m_verified.find(path);
+    if (iter == m_verified.end() || iter->size != info.size()
+        || iter->last_changed != info.lastModified().toUTC().toMSecsSinceEpoch())
+    {
+        return false;
+    }
+    md5sum = iter->md5sum;
+    return true;
+}
+
 bool HttpMetaCache::updateEntry(MetaEntryPtr stale_entry)
 {
     if (!m_entries.contains(stale_entry->baseId))
@@ -128,7 +364,9 @@ bool HttpMetaCache::updateEntry(MetaEntryPtr stale_entry)
         qCritical() << "Cannot add stale entry: " << stale_entry->getFullPath().toLocal8Bit();
         return false;
     }
+    stale_entry->last_access = QDateTime::currentMSecsSinceEpoch();
     m_entries[stale_entry->baseId].entry_list[stale_entry->relativePath] = stale_entry;
+    markDirty(stale_entry->baseId, stale_entry->relativePath);
     SaveEventually();
     return true;
 }
@@ -138,12 +376,40 @@ bool HttpMetaCache::evictEntry(MetaEntryPtr entry)
     if(entry)
     {
         entry->stale = true;
+        markDirty(entry->baseId, entry->relativePath);
         SaveEventually();
         return true;
     }
     return false;
 }
 
+bool HttpMetaCache::refreshEntry(MetaEntryPtr entry)
+{
+    if (!entry || !m_entries.contains(entry->baseId))
+        return false;
+    if (!m_index_file.isNull())
+    {
+        auto lock = lockIndex(indexLockTimeoutMs);
+        if (!lock)
+            return false;
+        refresh();
+    }
+    auto current = resolveEntry(entry->baseId, entry->relativePath);
+    if (current == entry || current->stale)
+        return false;
+    entry->basePath = current->basePath;
+    entry->md5sum = current->md5sum;
+    entry->digests = current->digests;
+    entry->etag = current->etag;
+    entry->local_changed_timestamp = current->local_changed_timestamp;
+    entry->remote_changed_timestamp = current->remote_changed_timestamp;
+    entry->last_access = current->last_access;
+    entry->stale = false;
+    entry->cache = this;
+    m_entries[entry->baseId].entry_list[entry->relativePath] = entry;
+    return true;
+}
+
 MetaEntryPtr HttpMetaCache::staleEntry(QString base, QString resource_path)
 {
     auto foo = new MetaEntry();
@@ -151,9 +417,115 @@ MetaEntryPtr HttpMetaCache::staleEntry(QString base, QString resource_path)
     foo->basePath = getBasePath(base);
     foo->relativePath = resource_path;
     foo->stale = true;
+    foo->cache = this;
     return MetaEntryPtr(foo);
 }
 
+void HttpMetaCache::removeEntry(const QString &base, const QString &resource_path)
+{
+    m_entries[base].entry_list[resource_path] = MetaEntryPtr();
+    markDirty(base, resource_path);
+}
+
+void HttpMetaCache::markDirty(const QString &base, const QString &resource_path)
+{
+    m_dirty[base].insert(resource_path);
+}
+
+void HttpMetaCache::touch(MetaEntryPtr entry)
+{
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    if (now - entry->last_access < accessGranularityMs)
+        return;
+    entry->last_access = now;
+    markDirty(entry->baseId, entry->relativePath);
+    SaveEventually();
+}
+
+QList<QPair<QString, qint64>> HttpMetaCache::listEntries(const QString &base)
+{
+    QList<QPair<QString, qint64>> result;
+    auto iter = m_entries.find(base);
+    if (iter == m_entries.end())
+        return result;
+    const auto &entry_list = iter->entry_list;
+    // what's in the snapshot and wasn't touched since
+    for (int i = 0; i < m_snapshot.size(); i++)
+    {
+        auto record = m_snapshot.at(i);
+        if (record.base != base || entry_list.contains(record.path))
+            continue;
+        result.append(qMakePair(record.path, record.last_access));
+    }
+    // what's in memory
+    for (auto entry : entry_list)
+    {
+        if (!entry || entry->stale)
+            continue;
+        result.append(qMakePair(entry->relativePath, entry->last_access));
+    }
+    return result;
+}
+
+void HttpMetaCache::listDigests(const QString &base, QCryptographicHash::Algorithm algorithm, QObject *context,
+                                std::function<void(QList<DigestListing>)> done)
+{
+    // what's in memory is listed right away, the snapshot entries it replaces are skipped later
+    QList<DigestListing> inMemory;
+    QSet<QString> changed;
+    auto iter = m_entries.find(base);
+    if (iter != m_entries.end())
+    {
+        for (auto entry = iter->entry_list.begin(); entry != iter->entry_list.end(); entry++)
+        {
+            changed.insert(entry.key());
+            if (!*entry || (*entry)->stale)
+                continue;
+            auto digest = (*entry)->getDigest(algorithm);
+            if (!digest.isEmpty())
+                inMemory.append({entry.key(), QByteArray::fromHex(digest.toLatin1()), (*entry)->etag,
+                                 (*entry)->remote_changed_timestamp});
+        }
+    }
+    QString snapshot;
+    if (iter != m_entries.end() && m_snapshotGeneration != 0)
+        snapshot = snapshotPath(m_index_file, m_snapshotGeneration);
+
+    // the worker maps the snapshot itself, ours is replaced when another launcher writes a new one
+    auto list = [snapshot, base, algorithm, changed, inMemory]()
+    {
+        QList<DigestListing> result;
+        MetaCacheIndex index;
+        if (!snapshot.isEmpty() && index.open(snapshot))
+        {
+            auto name = digestName(algorithm);
+            for (int i = 0; i < index.size(); i++)
+            {
+                auto record = index.at(i);
+                if (record.base != base || changed.contains(record.path))
+                    continue;
+                auto digest = algorithm == QCryptographicHash::Md5
+                                  ? record.md5sum
+                                  : MetaEntry::decodeDigests(record.digests).value(name);
+                if (!digest.isEmpty())
+                    result.append({record.path, QByteArray::fromHex(digest.toLatin1()), record.etag,
+                                   record.remote_changed_timestamp});
+            }
+        }
+        return result + inMemory;
+    };
+    QPointer<QObject> guard(context);
+    auto watcher = new QFutureWatcher<QList<DigestListing>>(this);
+    connect(watcher, &QFutureWatcher<QList<DigestListing>>::finished, this, [watcher, guard, done]()
+    {
+        auto result = watcher->result();
+        watcher->deleteLater();
+        if (guard)
+            done(result);
+    });
+    watcher->setFuture(QtConcurrent::run(&m_verifyPool, list));
+}
+
 void HttpMetaCache::addBase(QString base, QString base_root)
 {
     // TODO: report error
@@ -174,11 +546,147 @@ QString HttpMetaCache::getBasePath(QString base)
     return QString();
 }
 
+QString HttpMetaCache::snapshotPath(const QString &path, quint32 generation)
+{
+    return path + ".index." + QString::number(generation);
+}
+
+QString HttpMetaCache::snapshotPointerPath(const QString &path)
+{
+    return path + ".snapshot";
+}
+
+quint32 HttpMetaCache::currentSnapshot(const QString &path)
+{
+    QFile pointer(snapshotPointerPath(path));
+    if (!pointer.open(QIODevice::ReadOnly))
+        return 0;
+    return pointer.readAll().trimmed().toUInt();
+}
+
+quint32 HttpMetaCache::writeSnapshot(const QString &path, const QVector<MetaCacheRecord> &records)
+{
+    auto generation = currentSnapshot(path) + 1;
+    auto snapshot = snapshotPath(path, generation);
+    if (!MetaCacheIndex::write(snapshot, records))
+        return 0;
+    try
+    {
+        FS::write(snapshotPointerPath(path), QByteArray::number(generation));
+    }
+    catch (const Exception &e)
+    {
+        qWarning() << "Could not switch to the new metacache snapshot" << snapshot << ":" << e.cause();
+        QFile::remove(snapshot);
+        return 0;
+    }
+    return generation;
+}
+
+void HttpMetaCache::removeOldSnapshots()
+{
+    QFileInfo index(m_index_file);
+    auto prefix = index.fileName() + ".index.";
+    auto current = QFileInfo(snapshotPath(m_index_file, m_snapshotGeneration)).fileName();
+    for (auto &name : index.dir().entryList({prefix + "*"}, QDir::Files))
+    {
+        if (name != current)
+            QFile::remove(index.dir().filePath(name));
+    }
+}
+
+QString HttpMetaCache::journalPath() const
+{
+    return m_index_file + ".journal";
+}
+
 void HttpMetaCache::Load()
 {
     if(m_index_file.isNull())
         return;
 
+    // without the lock, nothing that other launchers may be writing right now is touched
+    auto lock = lockIndex(indexLockTimeoutMs);
+    m_snapshotGeneration = currentSnapshot(m_index_file);
+    bool opened = m_snapshotGeneration != 0 && m_snapshot.open(snapshotPath(m_index_file, m_snapshotGeneration));
+    if (!opened && lock && QFile::exists(m_index_file))
+    {
+        // one-time migration from the JSON index
+        qDebug() << "Migrating metacache index" << m_index_file;
+        loadLegacy();
+        if (compact())
+        {
+            QFile::remove(m_index_file);
+        }
+    }
+    else if (lock)
+    {
+        // left behind while others still had them mapped
+        removeOldSnapshots();
+    }
+    m_journalOffset = 0;
+    replayJournal(lock != nullptr);
+    reloadTimer.start();
+}
+
+std::unique_ptr<QLockFile> HttpMetaCache::lockIndex(int timeoutMs)
+{
+    std::unique_ptr<QLockFile> lock(new QLockFile(m_index_file + ".lock"));
+    if (!lock->tryLock(timeoutMs))
+    {
+        if (timeoutMs > 0)
+            qWarning() << "Could not lock the metacache index" << m_index_file << ", error" << lock->error();
+        return nullptr;
+    }
+    return lock;
+}
+
+void HttpMetaCache::reloadIfChanged()
+{
+    if (m_index_file.isNull())
+        return;
+    // someone is writing or folding the journal right now. the next tick will see what they did.
+    auto lock = lockIndex(0);
+    if (!lock)
+        return;
+    refresh();
+}
+
+void HttpMetaCache::refresh()
+{
+    if (m_index_file.isNull())
+        return;
+
+    auto generation = currentSnapshot(m_index_file);
+    if (generation != m_snapshotGeneration)
+    {
+        // another launcher folded the journal into a new snapshot. what we didn't change ourselves is read from that.
+        auto snapshot = snapshotPath(m_index_file, generation);
+        qDebug() << "Metacache snapshot changed to" << snapshot << ", reloading";
+        if (!m_snapshot.open(snapshot))
+            qWarning() << "Could not open the metacache snapshot" << snapshot;
+        m_snapshotGeneration = generation;
+        for (auto iter = m_entries.begin(); iter != m_entries.end(); iter++)
+        {
+            const auto dirty = m_dirty.value(iter.key());
+            auto &entry_list = iter->entry_list;
+            auto entry = entry_list.begin();
+            while (entry != entry_list.end())
+            {
+                if (dirty.contains(entry.key()))
+                    entry++;
+                else
+                    entry = entry_list.erase(entry);
+            }
+        }
+        m_journalOffset = 0;
+        m_journalRecords = 0;
+    }
+    replayJournal(true);
+}
+
+void HttpMetaCache::loadLegacy()
+{
     QFile index(m_index_file);
     if (!index.open(QIODevice::ReadOnly))
         return;
@@ -222,6 +730,177 @@ void HttpMetaCache::Load()
     }
 }
 
+void HttpMetaCache::replayJournal(bool repair)
+{
+    QFile journal(journalPath());
+    if (!journal.open(QIODevice::ReadOnly))
+    {
+        m_journalOffset = 0;
+        return;
+    }
+    if (m_journalOffset != 0 && journal.size() <= m_journalOffset)
+        return;
+
+    QDataStream in(&journal);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 generation = 0;
+    in >> magic >> version >> generation;
+    if (in.status() != QDataStream::Ok || magic != journalMagic || version != journalVersion)
+    {
+        // it may be a header another launcher is writing right now
+        if (!repair)
+            return;
+        qWarning() << "Ignoring invalid metacache journal" << journalPath();
+        journal.close();
+        QFile::remove(journalPath());
+        m_journalOffset = 0;
+        return;
+    }
+    if (generation != m_snapshotGeneration)
+    {
+        // the journal goes with another snapshot. an older one is already folded into ours, it is only still there
+        // because whoever folded it went away before deleting it. a newer one is read once we have its snapshot.
+        m_journalOffset = 0;
+        if (repair && generation < m_snapshotGeneration)
+        {
+            qWarning() << "Removing metacache journal" << journalPath() << "of old snapshot" << generation;
+            journal.close();
+            QFile::remove(journalPath());
+        }
+        return;
+    }
+    if (m_journalOffset > journal.pos())
+    {
+        // the records before that were read already
+        journal.seek(m_journalOffset);
+    }
+    else
+    {
+        m_journalRecords = 0;
+    }
+    qint64 validEnd = journal.pos();
+    while (!in.atEnd())
+    {
+        QByteArray payload;
+        in >> payload;
+        if (in.status() != QDataStream::Ok)
+            break;
+
+        QDataStream record(payload);
+        record.setVersion(QDataStream::Qt_5_0);
+        quint8 op = 0;
+        QString base, path, md5sum, etag, remote_changed_timestamp, digests;
+        qint64 local_changed_timestamp = 0;
+        qint64 last_access = 0;
+        record >> op >> base >> path >> md5sum >> etag >> remote_changed_timestamp >> local_changed_timestamp
+               >> digests >> last_access;
+        if (record.status() != QDataStream::Ok || (op != JournalPut && op != JournalRemove))
+            break;
+
+        validEnd = journal.pos();
+        m_journalRecords++;
+        // our own changes are newer, they go into the journal after this
+        if (!m_entries.contains(base) || m_dirty.value(base).contains(path))
+            continue;
+        auto &entrymap = m_entries[base];
+        if (op == JournalRemove)
+        {
+            entrymap.entry_list[path] = MetaEntryPtr();
+            continue;
+        }
+        auto foo = new MetaEntry();
+        foo->baseId = base;
+        foo->basePath = entrymap.base_path;
+        foo->relativePath = path;
+        foo->md5sum = md5sum;
+        foo->digests = MetaEntry::decodeDigests(digests);
+        foo->etag = etag;
+        foo->local_changed_timestamp = local_changed_timestamp;
+        foo->remote_changed_timestamp = remote_changed_timestamp;
+        foo->last_access = last_access;
+        foo->stale = false;
+        entrymap.entry_list[path] = MetaEntryPtr(foo);
+    }
+    m_journalOffset = validEnd;
+    if (!repair)
+        return;
+    if (validEnd < journal.size())
+    {
+        // the launcher went away in the middle of a write. drop the torn record, so new ones can follow the good ones.
+        qWarning() << "Metacache journal" << journalPath() << "has a torn record at" << validEnd << ", truncating";
+        journal.close();
+        QFile::resize(journalPath(), validEnd);
+    }
+}
+
+bool HttpMetaCache::compact()
+{
+    QVector<MetaCacheRecord> records;
+    records.reserve(m_snapshot.size());
+    // what's in the snapshot and wasn't touched since
+    for (int i = 0; i < m_snapshot.size(); i++)
+    {
+        auto record = m_snapshot.at(i);
+        auto iter = m_entries.find(record.base);
+        if (iter == m_entries.end() || iter->entry_list.contains(record.path))
+            continue;
+        records.append(record);
+    }
+    // what's in memory
+    for (auto group : m_entries)
+    {
+        for (auto entry : group.entry_list)
+        {
+            // do not save stale entries. they are dead.
+            if (!entry || entry->stale)
+            {
+                continue;
+            }
+            MetaCacheRecord record;
+            record.base = entry->baseId;
+            record.path = entry->relativePath;
+            record.md5sum = entry->md5sum;
+            record.digests = MetaEntry::encodeDigests(entry->digests);
+            record.etag = entry->etag;
+            record.remote_changed_timestamp = entry->remote_changed_timestamp;
+            record.local_changed_timestamp = entry->local_changed_timestamp;
+            record.last_access = entry->last_access;
+            records.append(record);
+        }
+    }
+
+    // a new file, the old one stays as it is for whoever still has it mapped
+    auto generation = writeSnapshot(m_index_file, records);
+    if (!generation)
+        return false;
+    if (!m_snapshot.open(snapshotPath(m_index_file, generation)))
+    {
+        qWarning() << "Could not open the new metacache snapshot" << snapshotPath(m_index_file, generation);
+    }
+    m_snapshotGeneration = generation;
+    QFile::remove(journalPath());
+    removeOldSnapshots();
+    m_journalOffset = 0;
+    m_journalRecords = 0;
+    m_dirty.clear();
+
+    // removed entries are not in the new snapshot, no need to remember them
+    for (auto &group : m_entries)
+    {
+        auto iter = group.entry_list.begin();
+        while (iter != group.entry_list.end())
+        {
+            if (*iter)
+                iter++;
+            else
+                iter = group.entry_list.erase(iter);
+        }
+    }
+    return true;
+}
+
 void HttpMetaCache::SaveEventually()
 {
     // reset the save timer
@@ -229,44 +908,82 @@ void HttpMetaCache::SaveEventually()
     saveBatchingTimer.start(30000);
 }
 
+void HttpMetaCache::SaveSoon()
+{
+    if (!saveSoonTimer.isActive())
+        saveSoonTimer.start();
+}
+
 void HttpMetaCache::SaveNow()
 {
     if(m_index_file.isNull())
         return;
-    QJsonObject toplevel;
-    toplevel.insert("version", QJsonValue(QString("1")));
-    QJsonArray entriesArr;
-    for (auto group : m_entries)
+    if(m_dirty.isEmpty())
+        return;
+
+    auto lock = lockIndex(indexLockTimeoutMs);
+    if (!lock)
     {
-        for (auto entry : group.entry_list)
+        SaveEventually();
+        return;
+    }
+    // take in what other launchers wrote first, so folding the journal into the snapshot doesn't lose it
+    refresh();
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    int count = 0;
+    for (auto iter = m_dirty.begin(); iter != m_dirty.end(); iter++)
+    {
+        const auto &base = iter.key();
+        for (const auto &path : iter.value())
         {
+            auto entry = m_entries[base].entry_list.value(path);
+            QByteArray payload;
+            QDataStream record(&payload, QIODevice::WriteOnly);
+            record.setVersion(QDataStream::Qt_5_0);
             // do not save stale entries. they are dead.
-            if(entry->stale)
+            if (entry && !entry->stale)
             {
-                continue;
+                record << quint8(JournalPut) << base << path << entry->md5sum << entry->etag
+                       << entry->remote_changed_timestamp << entry->local_changed_timestamp
+                       << MetaEntry::encodeDigests(entry->digests) << entry->last_access;
+            }
+            else
+            {
+                record << quint8(JournalRemove) << base << path << QString() << QString() << QString()
+                       << qint64(0) << QString() << qint64(0);
             }
-            QJsonObject entryObj;
-            entryObj.insert("base", QJsonValue(entry->baseId));
-            entryObj.insert("path", QJsonValue(entry->relativePath));
-            entryObj.insert("md5sum", QJsonValue(entry->md5sum));
-            entryObj.insert("etag", QJsonValue(entry->etag));
-            entryObj.insert("last_changed_timestamp",
-                            QJsonValue(double(entry->local_changed_timestamp)));
-            if (!entry->remote_changed_timestamp.isEmpty())
-                entryObj.insert("remote_changed_timestamp",
-                                QJsonValue(entry->remote_changed_timestamp));
-            entriesArr.append(entryObj);
+            out << payload;
+            count++;
         }
     }
-    toplevel.insert("entries", entriesArr);
 
-    QJsonDocument doc(toplevel);
-    try
+    QFile journal(journalPath());
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append))
     {
-        FS::write(m_index_file, doc.toJson());
+        qWarning() << "Could not open metacache journal" << journalPath() << ":" << journal.errorString();
+        return;
     }
-    catch (const Exception &e)
+    if (journal.size() == 0)
+    {
+        QDataStream header(&journal);
+        header.setVersion(QDataStream::Qt_5_0);
+        header << journalMagic << journalVersion << m_snapshotGeneration;
+    }
+    if (journal.write(data) != data.size() || !journal.flush())
+    {
+        qWarning() << "Failed to write metacache journal" << journalPath() << ":" << journal.errorString();
+        return;
+    }
+    m_journalOffset = journal.size();
+    journal.close();
+    m_dirty.clear();
+    m_journalRecords += count;
+
+    if (m_journalRecords > qMax(minCompactionRecords, m_snapshot.size() / 4))
     {
-        qWarning() << e.what();
+        compact();
     }
 }
@@ -16,10 +16,21 @@
 #pragma once
 #include <QString>
 #include <QMap>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QSet>
+#include <QHash>
+#include <QPair>
+#include <QPointer>
+#include <QThreadPool>
 #include <qtimer.h>
 #include <memory>
+#include <functional>
+
+#include "MetaCacheIndex.h"
 
 class HttpMetaCache;
+class QLockFile;
 
 class MetaEntry
 {
@@ -64,6 +75,26 @@ public:
     {
         this->md5sum = md5sum;
     }
+    // hex digest of the file, as recorded when it was downloaded. Empty if unknown.
+    QString getDigest(QCryptographicHash::Algorithm algorithm);
+    void setDigest(QCryptographicHash::Algorithm algorithm, QString digest);
+    // forget all the digests except MD5, for when the file changes
+    void clearDigests();
+
+    // when the entry was last resolved or updated, ms since epoch. 0 if unknown.
+    qint64 getLastAccess()
+    {
+        return last_access;
+    }
+
+    // the cache that gave out this entry, changes go back there
+    HttpMetaCache *getCache()
+    {
+        return cache;
+    }
+
+    static QString encodeDigests(const QMap<QString, QString> &digests);
+    static QMap<QString, QString> decodeDigests(const QString &encoded);
 protected:
     QString baseId;
     QString basePath;
@@ -72,11 +103,29 @@ protected:
     QString etag;
     qint64 local_changed_timestamp = 0;
     QString remote_changed_timestamp; // QString for now, RFC 2822 encoded time
+    // digests other than MD5 (hex), by algorithm name
+    QMap<QString, QString> digests;
+    qint64 last_access = 0;
     bool stale = true;
+    HttpMetaCache *cache = nullptr;
 };
 
 typedef std::shared_ptr<MetaEntry> MetaEntryPtr;
 
+/*
+ * Keeps track of downloaded files, so they don't have to be downloaded again.
+ *
+ * The entries live in a memory-mapped snapshot (see MetaCacheIndex) that is only read when an entry is looked up.
+ * Changes are appended to a journal next to it, which is folded into a new snapshot once it grows big enough.
+ * Snapshots are numbered and never replaced, a small pointer file says which one is current. That way nobody has to
+ * replace a file others may still have mapped, which Windows doesn't allow. Old snapshots are deleted once they can be.
+ *
+ * Several launchers can share one cache. Journal records are complete entries, the last one for a path wins, so the
+ * journal merges what everyone wrote without anybody rewriting it. Appending and folding take a lock file next to the
+ * index, and so does reading it, which then never sees a journal in the middle of being folded. The journal also
+ * carries the number of the snapshot it goes with, a journal left over from an older snapshot is never read. Every
+ * launcher looks for new records and a new snapshot now and then, and before it writes its own changes.
+ */
 class HttpMetaCache : public QObject
 {
     Q_OBJECT
@@ -93,31 +142,113 @@ public:
     MetaEntryPtr resolveEntry(QString base, QString resource_path,
                               QString expected_etag = QString());
 
+    // check the files of many entries (base, path) without blocking.
+    // files that changed since they were cached are hashed on a worker pool, then `done` is called on `context`'s thread.
+    // resolveEntry on those entries doesn't have to read the files again after that.
+    void verifyEntries(const QList<QPair<QString, QString>> &entries, QObject *context, std::function<void()> done);
+
     // add a previously resolved stale entry
     bool updateEntry(MetaEntryPtr stale_entry);
 
     // evict selected entry from cache
     bool evictEntry(MetaEntryPtr entry);
 
+    // another launcher may have just downloaded the file of this stale entry. if the cache has it now, take that.
+    bool refreshEntry(MetaEntryPtr entry);
+
+    // paths of all the entries of the base, with when they were last used (0 if unknown)
+    QList<QPair<QString, qint64>> listEntries(const QString &base);
+
+    struct DigestListing
+    {
+        QString path;
+        // raw
+        QByteArray digest;
+        // what the server said about the file
+        QString etag;
+        QString remote_changed_timestamp;
+    };
+    // the entries of the base with a known digest of this kind.
+    // that means reading the whole snapshot, so it's done on a worker thread. then `done` is called on `context`'s thread.
+    void listDigests(const QString &base, QCryptographicHash::Algorithm algorithm, QObject *context,
+                     std::function<void(QList<DigestListing>)> done);
+
     void addBase(QString base, QString base_root);
 
+    // start the index at `path` with these entries, as the current snapshot. Only for indexes nobody has loaded.
+    // returns the number of the new snapshot, 0 if it couldn't be written.
+    static quint32 writeSnapshot(const QString &path, const QVector<MetaCacheRecord> &records);
+
     // (re)start a timer that calls SaveNow later.
     void SaveEventually();
+    // call SaveNow once the current batch of changes is done, for changes other launchers may be waiting for.
+    void SaveSoon();
     void Load();
     QString getBasePath(QString base);
 public
 slots:
     void SaveNow();
+    // read what other launchers sharing the cache changed since we last looked
+    void reloadIfChanged();
 
 private:
     // create a new stale entry, given the parameters
     MetaEntryPtr staleEntry(QString base, QString resource_path);
+    // forget the entry, both in memory and on disk
+    void removeEntry(const QString &base, const QString &resource_path);
+    void markDirty(const QString &base, const QString &resource_path);
+    // remember that the entry was used now
+    void touch(MetaEntryPtr entry);
+
+    // result of hashing a file on disk
+    struct VerifiedFile
+    {
+        qint64 size = -1;
+        qint64 last_changed = 0;
+        QString md5sum;
+    };
+    static VerifiedFile hashFile(const QString &path);
+    // md5sum of the file, if it was already hashed this session and did not change since
+    bool knownHash(const QString &path, const QFileInfo &info, QString &md5sum) const;
+
+    static QString snapshotPath(const QString &path, quint32 generation);
+    static QString snapshotPointerPath(const QString &path);
+    // the number of the current snapshot of the index at `path`, 0 if there is none
+    static quint32 currentSnapshot(const QString &path);
+    QString journalPath() const;
+    // read the old JSON index into memory
+    void loadLegacy();
+    // read the journal from where we left off. `repair` means the index is locked and broken parts may be fixed.
+    void replayJournal(bool repair);
+    // take in a new snapshot and new journal records. only with the index locked.
+    void refresh();
+    // null if the lock can't be had within `timeoutMs`
+    std::unique_ptr<QLockFile> lockIndex(int timeoutMs);
+    // write all the current entries into a new snapshot and start a new journal
+    bool compact();
+    // delete the snapshots that aren't current. The ones others still have mapped may not go on some systems.
+    void removeOldSnapshots();
+
     struct EntryMap
     {
         QString base_path;
+        // entries that were looked up or changed since the snapshot was written. null if removed.
         QMap<QString, MetaEntryPtr> entry_list;
     };
     QMap<QString, EntryMap> m_entries;
+    // entries that changed since the last save, by base
+    QMap<QString, QSet<QString>> m_dirty;
+    MetaCacheIndex m_snapshot;
+    // the number of the mapped snapshot, to tell when another launcher wrote a new one
+    quint32 m_snapshotGeneration = 0;
+    int m_journalRecords = 0;
+    // how much of the journal was read
+    qint64 m_journalOffset = 0;
+    // files hashed in this session, by full path
+    QHash<QString, VerifiedFile> m_verified;
+    QThreadPool m_verifyPool;
     QString m_index_file;
     QTimer saveBatchingTimer;
+    QTimer saveSoonTimer;
+    QTimer reloadTimer;
 };
@@ -0,0 +1,314 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MetaCacheCollector.h"
+#include "HttpMetaCache.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+#include <algorithm>
+
+#include "FileSystem.h"
+
+namespace {
+// entries used this recently may be in use right now
+const qint64 keepRecentMs = 60 * 60 * 1000;
+// how long to wait before asking a reference source again
+const int retryDelayMs = 1000;
+// a source that can't tell after this many tries stops the collection, better to keep too much than too little
+const int maxSourceTries = 60;
+// entries evicted in one go, so the event loop doesn't stall
+const size_t evictionsPerStep = 64;
+}
+
+MetaCacheCollector::MetaCacheCollector(HttpMetaCache * cache) : QObject(cache), m_cache(cache)
+{
+    m_stepTimer.setSingleShot(true);
+    connect(&m_stepTimer, &QTimer::timeout, this, &MetaCacheCollector::step);
+    m_scheduleTimer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&m_scheduleTimer, &QTimer::timeout, this, [this]()
+    {
+        m_scheduleTimer.setInterval(m_interval);
+        start();
+    });
+}
+
+void MetaCacheCollector::setBudget(const QString & base, qint64 bytes)
+{
+    if(bytes > 0)
+    {
+        m_budgets.insert(base, bytes);
+    }
+    else
+    {
+        m_budgets.remove(base);
+    }
+}
+
+void MetaCacheCollector::setWholeFolders(const QString & base)
+{
+    m_folderBases.insert(base);
+}
+
+void MetaCacheCollector::setReferenceSources(std::function<QList<ReferenceSource>()> sources)
+{
+    m_sources = sources;
+}
+
+void MetaCacheCollector::schedule(int firstDelayMs, int intervalMs)
+{
+    m_interval = intervalMs;
+    m_scheduleTimer.start(firstDelayMs);
+}
+
+void MetaCacheCollector::start()
+{
+    if(isRunning() || m_budgets.isEmpty())
+    {
+        return;
+    }
+    m_phase = Phase::References;
+    m_pendingSources.clear();
+    if(m_sources)
+    {
+        for(auto & source: m_sources())
+        {
+            m_pendingSources.append(qMakePair(source, 0));
+        }
+    }
+    m_referenced.clear();
+    m_candidates.clear();
+    m_doomed.clear();
+    m_nextDoomed = 0;
+    m_freed = 0;
+    nextStep();
+}
+
+void MetaCacheCollector::nextStep(int delayMs)
+{
+    m_stepTimer.start(delayMs);
+}
+
+void MetaCacheCollector::step()
+{
+    switch(m_phase)
+    {
+        case Phase::Idle:
+        case Phase::Measuring:
+        {
+            return;
+        }
+        case Phase::References:
+        {
+            if(m_pendingSources.isEmpty())
+            {
+                m_phase = Phase::Listing;
+                m_pendingBases = m_budgets.keys();
+                nextStep();
+                return;
+            }
+            auto source = m_pendingSources.takeFirst();
+            QList<Key> keys;
+            if(source.first(keys))
+            {
+                for(auto & key: keys)
+                {
+                    m_referenced.insert(key.first + '/' + key.second);
+                }
+                nextStep();
+                return;
+            }
+            if(++source.second >= maxSourceTries)
+            {
+                qWarning() << "Metacache collection stopped, could not tell which entries are still used";
+                done();
+                return;
+            }
+            m_pendingSources.append(source);
+            nextStep(retryDelayMs);
+            return;
+        }
+        case Phase::Listing:
+        {
+            if(m_pendingBases.isEmpty())
+            {
+                m_phase = Phase::Measuring;
+                auto watcher = new QFutureWatcher<std::vector<Candidate>>(this);
+                connect(watcher, &QFutureWatcher<std::vector<Candidate>>::finished, this, [this, watcher]()
+                {
+                    m_candidates = watcher->result();
+                    watcher->deleteLater();
+                    m_phase = Phase::Planning;
+                    m_pendingBases = m_budgets.keys();
+                    nextStep();
+                });
+                watcher->setFuture(QtConcurrent::run(&MetaCacheCollector::measure, std::move(m_candidates)));
+                m_candidates.clear();
+                return;
+            }
+            auto base = m_pendingBases.takeFirst();
+            auto basePath = m_cache->getBasePath(base);
+            for(auto & entry: m_cache->listEntries(base))
+            {
+                Candidate candidate;
+                candidate.base = base;
+                candidate.path = entry.first;
+                candidate.fullPath = FS::PathCombine(basePath, entry.first);
+                candidate.lastAccess = entry.second;
+                candidate.wholeFolder = m_folderBases.contains(base);
+                m_candidates.push_back(candidate);
+            }
+            nextStep();
+            return;
+        }
+        case Phase::Planning:
+        {
+            if(m_pendingBases.isEmpty())
+            {
+                m_candidates.clear();
+                m_phase = Phase::Evicting;
+                nextStep();
+                return;
+            }
+            plan(m_pendingBases.takeFirst());
+            nextStep();
+            return;
+        }
+        case Phase::Evicting:
+        {
+            if(m_nextDoomed >= m_doomed.size())
+            {
+                done();
+                return;
+            }
+            evictSome();
+            nextStep();
+            return;
+        }
+    }
+}
+
+void MetaCacheCollector::plan(const QString & base)
+{
+    std::vector<Candidate> candidates;
+    qint64 total = 0;
+    for(auto & candidate: m_candidates)
+    {
+        if(candidate.base == base)
+        {
+            candidates.push_back(candidate);
+            total += candidate.size;
+        }
+    }
+    qint64 budget = m_budgets.value(base);
+    if(total <= budget)
+    {
+        return;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b)
+    {
+        return a.lastUsed < b.lastUsed;
+    });
+    auto cutoff = QDateTime::currentMSecsSinceEpoch() - keepRecentMs;
+    int count = 0;
+    for(auto & candidate: candidates)
+    {
+        if(total <= budget || candidate.lastUsed >= cutoff)
+        {
+            break;
+        }
+        if(m_referenced.contains(base + '/' + candidate.path))
+        {
+            continue;
+        }
+        m_doomed.push_back(candidate);
+        total -= candidate.size;
+        count++;
+    }
+    qDebug() << "Metacache base" << base << "is over its budget," << count << "entries will be evicted";
+}
+
+void MetaCacheCollector::evictSome()
+{
+    auto end = std::min(m_doomed.size(), m_nextDoomed + evictionsPerStep);
+    for(; m_nextDoomed < end; m_nextDoomed++)
+    {
+        const auto & candidate = m_doomed[m_nextDoomed];
+        // somebody used it since the collection started
+        auto entry = m_cache->getEntry(candidate.base, candidate.path);
+        if(!entry || entry->isStale() || entry->getLastAccess() != candidate.lastAccess)
+        {
+            continue;
+        }
+        m_cache->evictEntry(entry);
+        // the file goes first, so a folder that can't be deleted completely isn't mistaken for a complete one
+        if(QFile::remove(candidate.fullPath))
+        {
+            if(candidate.wholeFolder)
+            {
+                QDir(QFileInfo(candidate.fullPath).path()).removeRecursively();
+            }
+            m_freed += candidate.size;
+        }
+    }
+}
+
+void MetaCacheCollector::done()
+{
+    m_stepTimer.stop();
+    m_phase = Phase::Idle;
+    m_pendingSources.clear();
+    m_referenced.clear();
+    m_candidates.clear();
+    m_doomed.clear();
+    m_nextDoomed = 0;
+    if(m_freed)
+    {
+        qDebug() << "Metacache collection freed" << m_freed << "bytes";
+    }
+    emit finished(m_freed);
+}
+
+std::vector<MetaCacheCollector::Candidate> MetaCacheCollector::measure(std::vector<Candidate> candidates)
+{
+    for(auto & candidate: candidates)
+    {
+        QFileInfo info(candidate.fullPath);
+        if(!info.isFile())
+        {
+            continue;
+        }
+        candidate.size = info.size();
+        if(candidate.wholeFolder)
+        {
+            candidate.size = 0;
+            QDirIterator iter(info.path(), QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+            while(iter.hasNext())
+            {
+                iter.next();
+                candidate.size += iter.fileInfo().size();
+            }
+        }
+        // entries from before access times were recorded
+        candidate.lastUsed = candidate.lastAccess ? candidate.lastAccess : info.lastModified().toMSecsSinceEpoch();
+    }
+    return candidates;
+}
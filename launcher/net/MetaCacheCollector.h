@@ -0,0 +1,132 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+#include <vector>
+
+class HttpMetaCache;
+
+/*
+ * Keeps the bases of a HttpMetaCache within a size budget.
+ *
+ * When a base holds more than its budget, the entries that were used the longest time ago are evicted and their files
+ * deleted, until it fits again. Entries something still refers to are never evicted - the reference sources list them,
+ * usually one source per instance. Entries used in the last hour are left alone as well, they may be in use right now.
+ *
+ * A collection is done in small steps on the event loop and the files are measured on a worker thread.
+ * Only files the cache knows about count towards the budget.
+ */
+class MetaCacheCollector : public QObject
+{
+    Q_OBJECT
+public: /* types */
+    /// base and path of an entry
+    typedef QPair<QString, QString> Key;
+    /// adds the entries something uses to the list. Returns false if it can't tell yet, it is asked again later.
+    typedef std::function<bool(QList<Key> &)> ReferenceSource;
+
+public: /* con/des */
+    /// the collector belongs to the cache
+    explicit MetaCacheCollector(HttpMetaCache * cache);
+    virtual ~MetaCacheCollector() {};
+
+public: /* methods */
+    /// keep the base at or below this many bytes, 0 to not limit it
+    void setBudget(const QString & base, qint64 bytes);
+    /// the entries of the base stand for the folders their files are in, those are measured and deleted as a whole
+    void setWholeFolders(const QString & base);
+    /// called at the start of each collection
+    void setReferenceSources(std::function<QList<ReferenceSource>()> sources);
+    /// collect after `firstDelayMs`, then every `intervalMs`
+    void schedule(int firstDelayMs, int intervalMs);
+
+    bool isRunning() const
+    {
+        return m_phase != Phase::Idle;
+    }
+
+public slots:
+    /// start a collection, unless one is running already
+    void start();
+
+signals:
+    /// a collection is done, `freed` bytes were deleted
+    void finished(qint64 freed);
+
+private: /* types */
+    enum class Phase
+    {
+        Idle,
+        References,
+        Listing,
+        Measuring,
+        Planning,
+        Evicting
+    };
+    struct Candidate
+    {
+        QString base;
+        QString path;
+        QString fullPath;
+        /// as the cache had it when the collection started
+        qint64 lastAccess = 0;
+        /// the access time, or the file's modification time if that isn't known
+        qint64 lastUsed = 0;
+        qint64 size = 0;
+        /// the folder the file is in goes with it
+        bool wholeFolder = false;
+    };
+
+private slots:
+    void step();
+
+private: /* methods */
+    void nextStep(int delayMs = 0);
+    void plan(const QString & base);
+    void evictSome();
+    void done();
+    static std::vector<Candidate> measure(std::vector<Candidate> candidates);
+
+private: /* data */
+    HttpMetaCache * m_cache;
+    QMap<QString, qint64> m_budgets;
+    QSet<QString> m_folderBases;
+    std::function<QList<ReferenceSource>()> m_sources;
+    QTimer m_scheduleTimer;
+    int m_interval = 0;
+    QTimer m_stepTimer;
+
+    Phase m_phase = Phase::Idle;
+    /// sources that still have to be asked, and how often they were asked already
+    QList<QPair<ReferenceSource, int>> m_pendingSources;
+    /// base + '/' + path of the entries that are still used
+    QSet<QString> m_referenced;
+    QStringList m_pendingBases;
+    std::vector<Candidate> m_candidates;
+    /// what's going to be evicted, in order
+    std::vector<Candidate> m_doomed;
+    size_t m_nextDoomed = 0;
+    qint64 m_freed = 0;
+};
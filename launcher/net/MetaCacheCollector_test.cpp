@@ -0,0 +1,144 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QDateTime>
+#include "TestUtil.h"
+
+#include "FileSystem.h"
+#include "net/MetaCacheCollector.h"
+#include "net/MetaCacheIndex.h"
+#include "net/HttpMetaCache.h"
+
+class MetaCacheCollectorTest : public QObject
+{
+    Q_OBJECT
+
+    /// a file of `size` bytes in the libraries base, last used `ageMs` ago
+    MetaCacheRecord addFile(const QString & root, const QString & path, int size, qint64 ageMs)
+    {
+        FS::write(FS::PathCombine(root, path), QByteArray(size, 'x'));
+        MetaCacheRecord result;
+        result.base = "libraries";
+        result.path = path;
+        result.md5sum = "aa";
+        result.local_changed_timestamp = 1234;
+        result.last_access = QDateTime::currentMSecsSinceEpoch() - ageMs;
+        return result;
+    }
+
+private
+slots:
+    void test_evictsLeastRecentlyUsed()
+    {
+        const qint64 day = 24 * 60 * 60 * 1000;
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        QVector<MetaCacheRecord> records;
+        records.append(addFile(basePath, "oldest.jar", 1000, 3 * day));
+        records.append(addFile(basePath, "old.jar", 1000, 2 * day));
+        records.append(addFile(basePath, "recent.jar", 1000, day));
+        records.append(addFile(basePath, "in-use.jar", 1000, 60 * 1000));
+        QVERIFY(HttpMetaCache::writeSnapshot(indexPath, records));
+
+        HttpMetaCache cache(indexPath);
+        cache.addBase("libraries", basePath);
+        cache.Load();
+
+        auto collector = new MetaCacheCollector(&cache);
+        collector->setBudget("libraries", 2500);
+        int asked = 0;
+        collector->setReferenceSources([&asked]()
+        {
+            QList<MetaCacheCollector::ReferenceSource> sources;
+            // can't tell the first time it's asked, like an instance that is still loading
+            sources.append([&asked](QList<MetaCacheCollector::Key> & keys) -> bool
+            {
+                if(asked++ == 0)
+                {
+                    return false;
+                }
+                keys.append(qMakePair(QString("libraries"), QString("oldest.jar")));
+                return true;
+            });
+            return sources;
+        });
+        QSignalSpy spy(collector, &MetaCacheCollector::finished);
+        collector->start();
+        QVERIFY(collector->isRunning());
+        QVERIFY(spy.wait(10000));
+        QCOMPARE(asked, 2);
+        QCOMPARE(spy.first().first().toLongLong(), qint64(2000));
+
+        // referenced, evicted, evicted, used too recently
+        QVERIFY(QFile::exists(FS::PathCombine(basePath, "oldest.jar")));
+        QVERIFY(!QFile::exists(FS::PathCombine(basePath, "old.jar")));
+        QVERIFY(!QFile::exists(FS::PathCombine(basePath, "recent.jar")));
+        QVERIFY(QFile::exists(FS::PathCombine(basePath, "in-use.jar")));
+        QVERIFY(cache.getEntry("libraries", "old.jar")->isStale());
+        QVERIFY(!cache.getEntry("libraries", "in-use.jar")->isStale());
+        QCOMPARE(cache.listEntries("libraries").size(), 2);
+    }
+
+    void test_withinBudget()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        QVector<MetaCacheRecord> records;
+        records.append(addFile(basePath, "a.jar", 1000, 0));
+        records.append(addFile(basePath, "b.jar", 1000, 0));
+        // predates access times, so it counts as used when it was written
+        records.append(addFile(basePath, "c.jar", 1000, 0));
+        records.last().last_access = 0;
+        QVERIFY(HttpMetaCache::writeSnapshot(indexPath, records));
+
+        HttpMetaCache cache(indexPath);
+        cache.addBase("libraries", basePath);
+        cache.Load();
+
+        auto collector = new MetaCacheCollector(&cache);
+        collector->setBudget("libraries", 10000);
+        QSignalSpy spy(collector, &MetaCacheCollector::finished);
+        collector->start();
+        QVERIFY(spy.wait(10000));
+        QCOMPARE(spy.first().first().toLongLong(), qint64(0));
+        QCOMPARE(cache.listEntries("libraries").size(), 3);
+    }
+
+    void test_wholeFolders()
+    {
+        const qint64 day = 24 * 60 * 60 * 1000;
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "natives");
+        // the entries are the manifests, the rest of the folders counts as well
+        QVector<MetaCacheRecord> records;
+        for(auto name: {"old", "recent"})
+        {
+            records.append(addFile(basePath, QString(name) + "/natives.manifest", 100, QString(name) == "old" ? day : 0));
+            records.last().base = "natives";
+            FS::write(FS::PathCombine(basePath, name, "lib", "liblwjgl.so"), QByteArray(1000, 'n'));
+        }
+        QVERIFY(HttpMetaCache::writeSnapshot(indexPath, records));
+
+        HttpMetaCache cache(indexPath);
+        cache.addBase("natives", basePath);
+        cache.Load();
+
+        auto collector = new MetaCacheCollector(&cache);
+        collector->setBudget("natives", 1500);
+        collector->setWholeFolders("natives");
+        QSignalSpy spy(collector, &MetaCacheCollector::finished);
+        collector->start();
+        QVERIFY(spy.wait(10000));
+        QCOMPARE(spy.first().first().toLongLong(), qint64(1100));
+        QVERIFY(!QFileInfo(FS::PathCombine(basePath, "old")).exists());
+        QVERIFY(QFile::exists(FS::PathCombine(basePath, "recent", "lib", "liblwjgl.so")));
+        QCOMPARE(cache.listEntries("natives").size(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(MetaCacheCollectorTest)
+
+#include "MetaCacheCollector_test.moc"
@@ -0,0 +1,404 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MetaCacheIndex.h"
+
+#include <QtEndian>
+#include <QHash>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+#include "FileSystem.h"
+
+/*
+ * File layout, all numbers little endian:
+ *
+ * header:
+ *     char[4] magic "MMCI"
+ *     u32 version - 1
+ *     u32 string count
+ *     u32 record count
+ *     u64 offset of the records
+ *     u64 offset of the string offset table
+ *     u64 offset of the string data
+ * records, sorted by base, folder and file name:
+ *     u32 base, u32 folder (or noString), u32 file name, u32 md5sum, u32 etag, u32 remote timestamp, u32 digests - string ids
+ *     u32 padding
+ *     i64 local timestamp
+ *     i64 last access, ms since epoch
+ * string offset table:
+ *     u32 offset of the string in the string data, one per string id
+ * string data:
+ *     u32 length, followed by that many bytes of UTF-8
+ */
+
+namespace {
+const char indexMagic[4] = {'M', 'M', 'C', 'I'};
+const quint32 indexVersion = 1;
+const qint64 headerSize = 40;
+const qint64 recordSize = 48;
+const qint64 timestampOffset = 32;
+const qint64 lastAccessOffset = 40;
+const quint32 noString = 0xFFFFFFFF;
+
+enum RecordField
+{
+    BaseField,
+    FolderField,
+    NameField,
+    MD5Field,
+    ETagField,
+    RemoteTimestampField,
+    DigestsField
+};
+
+struct SplitPath
+{
+    bool hasFolder = false;
+    QByteArray folder;
+    QByteArray name;
+};
+
+SplitPath splitPath(const QString & path)
+{
+    SplitPath result;
+    int slash = path.lastIndexOf('/');
+    if(slash < 0)
+    {
+        result.name = path.toUtf8();
+        return result;
+    }
+    result.hasFolder = true;
+    result.folder = path.left(slash).toUtf8();
+    result.name = path.mid(slash + 1).toUtf8();
+    return result;
+}
+
+int compareBytes(const QByteArray & a, const QByteArray & b)
+{
+    int common = qMin(a.size(), b.size());
+    int result = common ? memcmp(a.constData(), b.constData(), common) : 0;
+    if(result != 0)
+    {
+        return result;
+    }
+    return a.size() - b.size();
+}
+
+struct SortKey
+{
+    QByteArray base;
+    SplitPath path;
+    int record;
+};
+
+int compareKeys(const SortKey & a, const SortKey & b)
+{
+    int result = compareBytes(a.base, b.base);
+    if(result != 0)
+    {
+        return result;
+    }
+    if(a.path.hasFolder != b.path.hasFolder)
+    {
+        // paths without a folder go first
+        return a.path.hasFolder ? 1 : -1;
+    }
+    result = compareBytes(a.path.folder, b.path.folder);
+    if(result != 0)
+    {
+        return result;
+    }
+    return compareBytes(a.path.name, b.path.name);
+}
+
+void appendU32(QByteArray & out, quint32 value)
+{
+    uchar buffer[4];
+    qToLittleEndian<quint32>(value, buffer);
+    out.append(reinterpret_cast<const char *>(buffer), 4);
+}
+
+void appendU64(QByteArray & out, quint64 value)
+{
+    uchar buffer[8];
+    qToLittleEndian<quint64>(value, buffer);
+    out.append(reinterpret_cast<const char *>(buffer), 8);
+}
+}
+
+MetaCacheIndex::~MetaCacheIndex()
+{
+    close();
+}
+
+bool MetaCacheIndex::open(const QString& path)
+{
+    close();
+    std::unique_ptr<QFile> file(new QFile(path));
+    if(!file->open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    qint64 size = file->size();
+    if(size < headerSize)
+    {
+        qWarning() << "Metacache index" << path << "is truncated";
+        return false;
+    }
+    const uchar * data = file->map(0, size);
+    if(!data)
+    {
+        qWarning() << "Could not map metacache index" << path << ":" << file->errorString();
+        return false;
+    }
+    quint32 version = qFromLittleEndian<quint32>(data + 4);
+    if(memcmp(data, indexMagic, 4) != 0 || version != indexVersion)
+    {
+        qWarning() << "Metacache index" << path << "has an unknown format";
+        return false;
+    }
+    quint32 stringCount = qFromLittleEndian<quint32>(data + 8);
+    quint32 recordCount = qFromLittleEndian<quint32>(data + 12);
+    qint64 recordsOffset = qint64(qFromLittleEndian<quint64>(data + 16));
+    qint64 stringsOffset = qint64(qFromLittleEndian<quint64>(data + 24));
+    qint64 blobOffset = qint64(qFromLittleEndian<quint64>(data + 32));
+    bool valid = recordsOffset >= headerSize && recordsOffset + qint64(recordCount) * recordSize <= size
+        && stringsOffset >= headerSize && stringsOffset + qint64(stringCount) * 4 <= size
+        && blobOffset >= headerSize && blobOffset <= size;
+    if(!valid)
+    {
+        qWarning() << "Metacache index" << path << "is corrupted";
+        return false;
+    }
+    m_file = std::move(file);
+    m_data = data;
+    m_size = size;
+    m_stringCount = stringCount;
+    m_recordCount = recordCount;
+    m_recordsOffset = recordsOffset;
+    m_stringsOffset = stringsOffset;
+    m_blobOffset = blobOffset;
+    return true;
+}
+
+void MetaCacheIndex::close()
+{
+    if(m_file)
+    {
+        if(m_data)
+        {
+            m_file->unmap(const_cast<uchar *>(m_data));
+        }
+        m_file.reset();
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_stringCount = 0;
+    m_recordCount = 0;
+}
+
+QByteArray MetaCacheIndex::stringBytes(quint32 id) const
+{
+    if(id >= m_stringCount)
+    {
+        return QByteArray();
+    }
+    qint64 offset = m_blobOffset + qFromLittleEndian<quint32>(m_data + m_stringsOffset + qint64(id) * 4);
+    if(offset + 4 > m_size)
+    {
+        return QByteArray();
+    }
+    quint32 length = qFromLittleEndian<quint32>(m_data + offset);
+    if(offset + 4 + length > m_size)
+    {
+        return QByteArray();
+    }
+    // no copy, the data stays mapped for as long as we need it
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data + offset + 4), int(length));
+}
+
+QString MetaCacheIndex::string(quint32 id) const
+{
+    auto bytes = stringBytes(id);
+    return QString::fromUtf8(bytes.constData(), bytes.size());
+}
+
+quint32 MetaCacheIndex::field(int index, int field) const
+{
+    return qFromLittleEndian<quint32>(m_data + m_recordsOffset + qint64(index) * recordSize + field * 4);
+}
+
+MetaCacheRecord MetaCacheIndex::at(int index) const
+{
+    MetaCacheRecord record;
+    record.base = string(field(index, BaseField));
+    auto folder = field(index, FolderField);
+    auto name = string(field(index, NameField));
+    record.path = folder == noString ? name : string(folder) + '/' + name;
+    record.md5sum = string(field(index, MD5Field));
+    record.etag = string(field(index, ETagField));
+    record.remote_changed_timestamp = string(field(index, RemoteTimestampField));
+    record.digests = string(field(index, DigestsField));
+    const uchar * data = m_data + m_recordsOffset + qint64(index) * recordSize;
+    record.local_changed_timestamp = qFromLittleEndian<qint64>(data + timestampOffset);
+    record.last_access = qFromLittleEndian<qint64>(data + lastAccessOffset);
+    return record;
+}
+
+int MetaCacheIndex::compare(int index, const QByteArray& base, const QByteArray* folder, const QByteArray& name) const
+{
+    int result = compareBytes(stringBytes(field(index, BaseField)), base);
+    if(result != 0)
+    {
+        return result;
+    }
+    auto recordFolder = field(index, FolderField);
+    bool recordHasFolder = recordFolder != noString;
+    if(recordHasFolder != (folder != nullptr))
+    {
+        return recordHasFolder ? 1 : -1;
+    }
+    if(folder)
+    {
+        result = compareBytes(stringBytes(recordFolder), *folder);
+        if(result != 0)
+        {
+            return result;
+        }
+    }
+    return compareBytes(stringBytes(field(index, NameField)), name);
+}
+
+bool MetaCacheIndex::find(const QString& base, const QString& path, MetaCacheRecord& out) const
+{
+    if(!isOpen())
+    {
+        return false;
+    }
+    auto baseBytes = base.toUtf8();
+    auto split = splitPath(path);
+    const QByteArray * folder = split.hasFolder ? &split.folder : nullptr;
+    int low = 0;
+    int high = int(m_recordCount) - 1;
+    while(low <= high)
+    {
+        int middle = low + (high - low) / 2;
+        int result = compare(middle, baseBytes, folder, split.name);
+        if(result == 0)
+        {
+            out = at(middle);
+            return true;
+        }
+        if(result < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return false;
+}
+
+bool MetaCacheIndex::write(const QString& path, QVector<MetaCacheRecord> records)
+{
+    std::vector<SortKey> keys;
+    keys.reserve(records.size());
+    for(int i = 0; i < records.size(); i++)
+    {
+        SortKey key;
+        key.base = records[i].base.toUtf8();
+        key.path = splitPath(records[i].path);
+        key.record = i;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(), [](const SortKey & a, const SortKey & b)
+    {
+        return compareKeys(a, b) < 0;
+    });
+
+    QHash<QByteArray, quint32> stringIds;
+    QByteArray offsets;
+    QByteArray blob;
+    auto intern = [&](const QByteArray & string) -> quint32
+    {
+        auto iter = stringIds.find(string);
+        if(iter != stringIds.end())
+        {
+            return *iter;
+        }
+        quint32 id = quint32(stringIds.size());
+        stringIds.insert(string, id);
+        appendU32(offsets, quint32(blob.size()));
+        appendU32(blob, quint32(string.size()));
+        blob.append(string);
+        return id;
+    };
+
+    QByteArray recordData;
+    quint32 recordCount = 0;
+    const SortKey * previous = nullptr;
+    for(auto & key: keys)
+    {
+        if(previous && compareKeys(*previous, key) == 0)
+        {
+            qWarning() << "Skipping duplicate metacache entry" << records[key.record].base << records[key.record].path;
+            continue;
+        }
+        previous = &key;
+        auto & record = records[key.record];
+        appendU32(recordData, intern(key.base));
+        appendU32(recordData, key.path.hasFolder ? intern(key.path.folder) : noString);
+        appendU32(recordData, intern(key.path.name));
+        appendU32(recordData, intern(record.md5sum.toUtf8()));
+        appendU32(recordData, intern(record.etag.toUtf8()));
+        appendU32(recordData, intern(record.remote_changed_timestamp.toUtf8()));
+        appendU32(recordData, intern(record.digests.toUtf8()));
+        appendU32(recordData, 0);
+        appendU64(recordData, quint64(record.local_changed_timestamp));
+        appendU64(recordData, quint64(record.last_access));
+        recordCount++;
+    }
+
+    qint64 recordsOffset = headerSize;
+    qint64 stringsOffset = recordsOffset + recordData.size();
+    qint64 blobOffset = stringsOffset + offsets.size();
+
+    QByteArray out;
+    out.reserve(int(blobOffset + blob.size()));
+    out.append(indexMagic, 4);
+    appendU32(out, indexVersion);
+    appendU32(out, quint32(stringIds.size()));
+    appendU32(out, recordCount);
+    appendU64(out, quint64(recordsOffset));
+    appendU64(out, quint64(stringsOffset));
+    appendU64(out, quint64(blobOffset));
+    out.append(recordData);
+    out.append(offsets);
+    out.append(blob);
+    try
+    {
+        FS::write(path, out);
+    }
+    catch (const Exception &e)
+    {
+        qWarning() << "Failed to write metacache index:" << e.what();
+        return false;
+    }
+    return true;
+}
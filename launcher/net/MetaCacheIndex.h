@@ -0,0 +1,85 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <memory>
+
+/// one entry of the metacache, as stored on disk
+struct MetaCacheRecord
+{
+    QString base;
+    QString path;
+    QString md5sum;
+    QString etag;
+    QString remote_changed_timestamp;
+    /// digests other than MD5, see MetaEntry
+    QString digests;
+    qint64 local_changed_timestamp = 0;
+    /// when the entry was last used, ms since epoch. 0 if unknown.
+    qint64 last_access = 0;
+};
+
+/*
+ * Read-only, memory-mapped snapshot of the metacache.
+ *
+ * The file holds fixed size records sorted by base and path, and a table of interned strings the records refer to.
+ * Paths are split into the folder and the file name, so the folders are only stored once.
+ * Lookups are a binary search over the mapped records - nothing is parsed up front.
+ */
+class MetaCacheIndex
+{
+public: /* con/des */
+    MetaCacheIndex() {};
+    ~MetaCacheIndex();
+
+public: /* methods */
+    /// map the index file. Returns false if it doesn't exist or isn't a valid index.
+    bool open(const QString & path);
+    void close();
+    bool isOpen() const
+    {
+        return m_data != nullptr;
+    }
+
+    int size() const
+    {
+        return int(m_recordCount);
+    }
+    MetaCacheRecord at(int index) const;
+    bool find(const QString & base, const QString & path, MetaCacheRecord & out) const;
+
+    /// write a new index file with the records in it. Records must have unique base and path pairs.
+    static bool write(const QString & path, QVector<MetaCacheRecord> records);
+
+private: /* methods */
+    QByteArray stringBytes(quint32 id) const;
+    QString string(quint32 id) const;
+    quint32 field(int index, int field) const;
+    int compare(int index, const QByteArray & base, const QByteArray * dir, const QByteArray & name) const;
+
+private: /* data */
+    std::unique_ptr<QFile> m_file;
+    const uchar * m_data = nullptr;
+    qint64 m_size = 0;
+    quint32 m_stringCount = 0;
+    quint32 m_recordCount = 0;
+    qint64 m_recordsOffset = 0;
+    qint64 m_stringsOffset = 0;
+    qint64 m_blobOffset = 0;
+};
@@ -0,0 +1,317 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include "TestUtil.h"
+
+#include "FileSystem.h"
+#include "net/MetaCacheIndex.h"
+#include "net/HttpMetaCache.h"
+
+class MetaCacheIndexTest : public QObject
+{
+    Q_OBJECT
+
+    MetaCacheRecord record(const QString & base, const QString & path, const QString & md5sum)
+    {
+        MetaCacheRecord result;
+        result.base = base;
+        result.path = path;
+        result.md5sum = md5sum;
+        result.etag = "\"" + md5sum + "\"";
+        result.digests = "sha1:" + md5sum;
+        result.local_changed_timestamp = 1234;
+        result.last_access = 5678;
+        return result;
+    }
+
+private
+slots:
+    void test_roundTrip()
+    {
+        QTemporaryDir tempDir;
+        QString path = FS::PathCombine(tempDir.path(), "metacache.index");
+        QVector<MetaCacheRecord> records;
+        records.append(record("libraries", "org/lwjgl/lwjgl/2.9.4/lwjgl-2.9.4.jar", "aa"));
+        records.append(record("libraries", "org/lwjgl/lwjgl/2.9.4/lwjgl-platform-2.9.4.jar", "bb"));
+        records.append(record("asset_indexes", "1.19.json", "cc"));
+        records.append(record("libraries", "top-level.jar", "dd"));
+        QVERIFY(MetaCacheIndex::write(path, records));
+
+        MetaCacheIndex index;
+        QVERIFY(index.open(path));
+        QCOMPARE(index.size(), 4);
+        for(auto & expected: records)
+        {
+            MetaCacheRecord found;
+            QVERIFY(index.find(expected.base, expected.path, found));
+            QCOMPARE(found.base, expected.base);
+            QCOMPARE(found.path, expected.path);
+            QCOMPARE(found.md5sum, expected.md5sum);
+            QCOMPARE(found.etag, expected.etag);
+            QCOMPARE(found.digests, expected.digests);
+            QCOMPARE(found.local_changed_timestamp, expected.local_changed_timestamp);
+            QCOMPARE(found.last_access, expected.last_access);
+        }
+        MetaCacheRecord missing;
+        QVERIFY(!index.find("libraries", "1.19.json", missing));
+        QVERIFY(!index.find("asset_indexes", "org/lwjgl/lwjgl/2.9.4/lwjgl-2.9.4.jar", missing));
+        QVERIFY(!index.find("libraries", "org/lwjgl/lwjgl/2.9.4", missing));
+    }
+
+    void test_rejectsGarbage()
+    {
+        QTemporaryDir tempDir;
+        QString path = FS::PathCombine(tempDir.path(), "metacache.index");
+        FS::write(path, QByteArray("definitely not an index, but long enough to have a header"));
+        MetaCacheIndex index;
+        QVERIFY(!index.open(path));
+        QVERIFY(!index.isOpen());
+    }
+
+    void test_journalAndMigration()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+
+        // the old JSON format
+        QJsonObject entry;
+        entry.insert("base", QString("libraries"));
+        entry.insert("path", QString("old.jar"));
+        entry.insert("md5sum", QString("aa"));
+        entry.insert("etag", QString("\"aa\""));
+        entry.insert("last_changed_timestamp", 1234.0);
+        QJsonArray entries;
+        entries.append(entry);
+        QJsonObject root;
+        root.insert("version", QString("1"));
+        root.insert("entries", entries);
+        FS::write(indexPath, QJsonDocument(root).toJson());
+
+        {
+            HttpMetaCache cache(indexPath);
+            cache.addBase("libraries", basePath);
+            cache.Load();
+            QVERIFY(!QFile::exists(indexPath));
+            QVERIFY(QFile::exists(indexPath + ".index.1"));
+            auto old = cache.getEntry("libraries", "old.jar");
+            QVERIFY(old);
+            QCOMPARE(old->getMD5Sum(), QString("aa"));
+
+            auto added = cache.resolveEntry("libraries", "new.jar");
+            QVERIFY(added->isStale());
+            added->setMD5Sum("bb");
+            added->setDigest(QCryptographicHash::Sha1, "cc");
+            added->setStale(false);
+            QVERIFY(cache.updateEntry(added));
+            QVERIFY(cache.evictEntry(old));
+        }
+        QVERIFY(QFile::exists(indexPath + ".journal"));
+
+        HttpMetaCache cache(indexPath);
+        cache.addBase("libraries", basePath);
+        cache.Load();
+        QVERIFY(!cache.getEntry("libraries", "old.jar"));
+        auto added = cache.getEntry("libraries", "new.jar");
+        QVERIFY(added);
+        QCOMPARE(added->getMD5Sum(), QString("bb"));
+        QCOMPARE(added->getDigest(QCryptographicHash::Sha1), QString("cc"));
+        QVERIFY(added->getLastAccess() > 0);
+    }
+
+    void test_listDigests()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        QVector<MetaCacheRecord> records;
+        records.append(record("libraries", "a.jar", "aa"));
+        records.append(record("libraries", "b.jar", "bb"));
+        records.append(record("asset_indexes", "1.19.json", "cc"));
+        QVERIFY(HttpMetaCache::writeSnapshot(indexPath, records));
+
+        HttpMetaCache cache(indexPath);
+        cache.addBase("libraries", basePath);
+        cache.addBase("asset_indexes", FS::PathCombine(tempDir.path(), "asset_indexes"));
+        cache.Load();
+        // changes in memory win over the snapshot
+        auto changed = cache.getEntry("libraries", "b.jar");
+        QVERIFY(changed);
+        changed->setDigest(QCryptographicHash::Sha1, "dd");
+        QVERIFY(cache.updateEntry(changed));
+
+        QMap<QString, QByteArray> listed;
+        bool done = false;
+        cache.listDigests("libraries", QCryptographicHash::Sha1, this,
+            [&](QList<HttpMetaCache::DigestListing> digests)
+            {
+                for(auto & digest: digests)
+                {
+                    QVERIFY(!listed.contains(digest.path));
+                    listed.insert(digest.path, digest.digest);
+                }
+                done = true;
+            });
+        QTRY_VERIFY(done);
+        QCOMPARE(listed.size(), 2);
+        QCOMPARE(listed.value("a.jar"), QByteArray::fromHex("aa"));
+        QCOMPARE(listed.value("b.jar"), QByteArray::fromHex("dd"));
+    }
+
+    void test_saveSoon()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        HttpMetaCache cache(indexPath);
+        cache.addBase("libraries", basePath);
+        cache.Load();
+        for(int i = 0; i < 3; i++)
+        {
+            auto entry = cache.resolveEntry("libraries", QString("%1.jar").arg(i));
+            entry->setMD5Sum("aa");
+            entry->setStale(false);
+            QVERIFY(cache.updateEntry(entry));
+            cache.SaveSoon();
+        }
+        // written together, once the changes are done
+        QVERIFY(!QFile::exists(indexPath + ".journal"));
+        QTRY_VERIFY(QFile::exists(indexPath + ".journal"));
+
+        HttpMetaCache other(indexPath);
+        other.addBase("libraries", basePath);
+        other.Load();
+        QVERIFY(other.getEntry("libraries", "0.jar"));
+        QVERIFY(other.getEntry("libraries", "2.jar"));
+    }
+
+    /// two caches on the same files, as two launchers sharing a folder would have them
+    void test_sharedIndex()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        auto add = [](HttpMetaCache & cache, const QString & path, const QString & md5sum)
+        {
+            auto entry = cache.resolveEntry("libraries", path);
+            entry->setMD5Sum(md5sum);
+            entry->setStale(false);
+            QVERIFY(cache.updateEntry(entry));
+        };
+
+        HttpMetaCache first(indexPath);
+        first.addBase("libraries", basePath);
+        first.Load();
+        HttpMetaCache second(indexPath);
+        second.addBase("libraries", basePath);
+        second.Load();
+
+        add(first, "first.jar", "aa");
+        first.SaveNow();
+        second.reloadIfChanged();
+        auto seen = second.getEntry("libraries", "first.jar");
+        QVERIFY(seen);
+        QCOMPARE(seen->getMD5Sum(), QString("aa"));
+
+        // an unsaved change survives the other one folding the journal into a new snapshot
+        add(second, "second.jar", "bb");
+        for(int i = 0; i < 1100; i++)
+        {
+            add(first, QString("many/%1.jar").arg(i), "cc");
+        }
+        first.SaveNow();
+        QVERIFY(!QFile::exists(indexPath + ".journal"));
+        second.reloadIfChanged();
+        QVERIFY(second.getEntry("libraries", "many/500.jar"));
+        QVERIFY(second.getEntry("libraries", "first.jar"));
+        QCOMPARE(second.getEntry("libraries", "second.jar")->getMD5Sum(), QString("bb"));
+
+        second.SaveNow();
+        first.reloadIfChanged();
+        auto other = first.getEntry("libraries", "second.jar");
+        QVERIFY(other);
+        QCOMPARE(other->getMD5Sum(), QString("bb"));
+
+        // folding the journal again writes another snapshot, the one the first cache has mapped stays as it is
+        QVERIFY(QFile::exists(indexPath + ".index.1"));
+        for(int i = 0; i < 1100; i++)
+        {
+            add(second, QString("more/%1.jar").arg(i), "dd");
+        }
+        second.SaveNow();
+        QVERIFY(QFile::exists(indexPath + ".index.2"));
+        first.reloadIfChanged();
+        QVERIFY(first.getEntry("libraries", "more/500.jar"));
+        QVERIFY(first.getEntry("libraries", "many/500.jar"));
+
+        // once nobody uses the old one, it goes
+        HttpMetaCache third(indexPath);
+        third.addBase("libraries", basePath);
+        third.Load();
+        QVERIFY(!QFile::exists(indexPath + ".index.1"));
+        QVERIFY(third.getEntry("libraries", "more/500.jar"));
+    }
+
+    /// the journal of the old snapshot can still be there when the pointer already names the new one
+    void test_oldJournalAfterCompaction()
+    {
+        QTemporaryDir tempDir;
+        QString indexPath = FS::PathCombine(tempDir.path(), "metacache");
+        QString basePath = FS::PathCombine(tempDir.path(), "libraries");
+        auto add = [](HttpMetaCache & cache, const QString & path, const QString & md5sum)
+        {
+            auto entry = cache.resolveEntry("libraries", path);
+            entry->setMD5Sum(md5sum);
+            entry->setStale(false);
+            QVERIFY(cache.updateEntry(entry));
+        };
+
+        HttpMetaCache first(indexPath);
+        first.addBase("libraries", basePath);
+        first.Load();
+        HttpMetaCache second(indexPath);
+        second.addBase("libraries", basePath);
+        second.Load();
+
+        // a big journal, folded into a new snapshot. keep it, as if the folding launcher hadn't deleted it yet.
+        for(int i = 0; i < 1100; i++)
+        {
+            add(first, QString("many/%1.jar").arg(i), "aa");
+        }
+        first.SaveNow();
+        QVERIFY(!QFile::exists(indexPath + ".journal"));
+        for(int i = 0; i < 10; i++)
+        {
+            add(first, QString("old/%1.jar").arg(i), "bb");
+        }
+        first.SaveNow();
+        QVERIFY(QFile::copy(indexPath + ".journal", indexPath + ".journal.old"));
+        for(int i = 0; i < 1100; i++)
+        {
+            add(first, QString("more/%1.jar").arg(i), "cc");
+        }
+        first.SaveNow();
+        QVERIFY(!QFile::exists(indexPath + ".journal"));
+        QVERIFY(QFile::rename(indexPath + ".journal.old", indexPath + ".journal"));
+
+        // the second cache takes the new snapshot and leaves the old journal alone...
+        second.reloadIfChanged();
+        QVERIFY(second.getEntry("libraries", "more/500.jar"));
+        QVERIFY(second.getEntry("libraries", "old/5.jar"));
+        QVERIFY(!QFile::exists(indexPath + ".journal"));
+
+        // ... so it doesn't skip the start of the new one
+        add(first, "new.jar", "dd");
+        first.SaveNow();
+        second.reloadIfChanged();
+        auto seen = second.getEntry("libraries", "new.jar");
+        QVERIFY(seen);
+        QCOMPARE(seen->getMD5Sum(), QString("dd"));
+    }
+};
+
+QTEST_GUILESS_MAIN(MetaCacheIndexTest)
+
+#include "MetaCacheIndex_test.moc"
@@ -2,14 +2,13 @@
 #include <QFile>
 #include <QFileInfo>
 #include "FileSystem.h"
-#include "Application.h"
 
 namespace Net {
 
-MetaCacheSink::MetaCacheSink(MetaEntryPtr entry, ChecksumValidator * md5sum)
-    :Net::FileSink(entry->getFullPath()), m_entry(entry), m_md5Node(md5sum)
+MetaCacheSink::MetaCacheSink(MetaEntryPtr entry, MultiDigestValidator * digests)
+    :Net::FileSink(entry->getFullPath()), m_entry(entry), m_digests(digests)
 {
-    addValidator(md5sum);
+    addValidator(digests);
 }
 
 MetaCacheSink::~MetaCacheSink()
@@ -23,6 +22,12 @@ JobStatus MetaCacheSink::initCache(QNetworkRequest& request)
     {
         return Job_Finished;
     }
+    // another launcher sharing the cache was getting the same file
+    auto cache = m_entry->getCache();
+    if (lockWasContended() && cache && cache->refreshEntry(m_entry))
+    {
+        return Job_Finished;
+    }
     // check if file exists, if it does, use its information for the request
     QFile current(m_filename);
     if(current.exists() && current.size() != 0)
@@ -39,24 +44,46 @@ JobStatus MetaCacheSink::initCache(QNetworkRequest& request)
     return Job_InProgress;
 }
 
-JobStatus MetaCacheSink::finalizeCache(QNetworkReply & reply)
+JobStatus MetaCacheSink::finalizeCache()
 {
     QFileInfo output_file_info(m_filename);
     if(wroteAnyData)
     {
-        m_entry->setMD5Sum(m_md5Node->hash().toHex().constData());
+        // record every digest we got for free, so nobody has to hash the file again
+        m_entry->clearDigests();
+        for(auto algorithm: m_digests->algorithms())
+        {
+            m_entry->setDigest(algorithm, m_digests->hash(algorithm).toHex().constData());
+        }
     }
-    m_entry->setETag(reply.rawHeader("ETag").constData());
-    if (reply.hasRawHeader("Last-Modified"))
+    m_entry->setETag(m_etag.constData());
+    if (!m_lastModified.isEmpty())
     {
-        m_entry->setRemoteChangedTimestamp(reply.rawHeader("Last-Modified").constData());
+        m_entry->setRemoteChangedTimestamp(m_lastModified.constData());
     }
     m_entry->setLocalChangedTimestamp(output_file_info.lastModified().toUTC().toMSecsSinceEpoch());
     m_entry->setStale(false);
-    APPLICATION->metacache()->updateEntry(m_entry);
+    if(auto cache = m_entry->getCache())
+    {
+        cache->updateEntry(m_entry);
+        // launchers waiting for this file look for it in the journal. The downloads a job commits together are
+        // written there together.
+        cache->SaveSoon();
+    }
     return Job_Finished;
 }
 
+QByteArray MetaCacheSink::etag() const
+{
+    // also known for files that didn't have to be downloaded
+    return m_entry->getETag().toLatin1();
+}
+
+QByteArray MetaCacheSink::lastModified() const
+{
+    return m_entry->getRemoteChangedTimestamp().toLatin1();
+}
+
 bool MetaCacheSink::hasLocalData()
 {
     QFileInfo info(m_filename);
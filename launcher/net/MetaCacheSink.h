@@ -1,22 +1,25 @@
 #pragma once
 #include "FileSink.h"
-#include "ChecksumValidator.h"
+#include "MultiDigestValidator.h"
 #include "net/HttpMetaCache.h"
 
 namespace Net {
 class MetaCacheSink : public FileSink
 {
 public: /* con/des */
-    MetaCacheSink(MetaEntryPtr entry, ChecksumValidator * md5sum);
+    MetaCacheSink(MetaEntryPtr entry, MultiDigestValidator * digests);
     virtual ~MetaCacheSink();
     bool hasLocalData() override;
+    QByteArray etag() const override;
+    QByteArray lastModified() const override;
 
 protected: /* methods */
     JobStatus initCache(QNetworkRequest & request) override;
-    JobStatus finalizeCache(QNetworkReply & reply) override;
+    JobStatus finalizeCache() override;
 
 private: /* data */
     MetaEntryPtr m_entry;
-    ChecksumValidator * m_md5Node;
+    /// computes the MD5 sum and whatever other digests the download was asked for
+    MultiDigestValidator * m_digests;
 };
 }
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Validator.h"
+#include "Hashing.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFile>
+#include <memory>
+#include <vector>
+
+namespace Net {
+/*
+ * Computes several digests of the same data in one pass.
+ *
+ * Digests with an expected value are checked when the download is validated, the others are just there to be recorded.
+ * Can also be fed from a local file, for when files are scanned rather than downloaded.
+ */
+class MultiDigestValidator: public Validator
+{
+public: /* con/des */
+    MultiDigestValidator() {};
+    virtual ~MultiDigestValidator() {};
+
+public: /* methods */
+    /// compute this digest too. If `expected` isn't empty, the data has to match it.
+    void addDigest(QCryptographicHash::Algorithm algorithm, QByteArray expected = QByteArray())
+    {
+        for(auto & digest: m_digests)
+        {
+            if(digest.algorithm == algorithm)
+            {
+                if(expected.size())
+                {
+                    digest.expected = expected;
+                }
+                return;
+            }
+        }
+        Digest digest;
+        digest.algorithm = algorithm;
+        digest.hash.reset(new Hashing::Hasher(algorithm));
+        digest.expected = expected;
+        m_digests.push_back(std::move(digest));
+    }
+    bool init(QNetworkRequest &) override
+    {
+        reset();
+        return true;
+    }
+    bool write(QByteArray & data) override
+    {
+        for(auto & digest: m_digests)
+        {
+            digest.hash->addData(data);
+        }
+        return true;
+    }
+    bool abort() override
+    {
+        return true;
+    }
+    bool canWriteInBackground() const override
+    {
+        return true;
+    }
+    bool validate(QNetworkReply &) override
+    {
+        for(auto & digest: m_digests)
+        {
+            if(digest.expected.size() && digest.expected != digest.hash->result())
+            {
+                qWarning() << "Checksum mismatch, download is bad.";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// feed the whole file through all the digests, in chunks
+    bool hashFile(const QString & path)
+    {
+        reset();
+        QFile input(path);
+        if(!input.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+        QByteArray chunk;
+        while(!(chunk = input.read(1024 * 1024)).isEmpty())
+        {
+            write(chunk);
+        }
+        return input.error() == QFileDevice::NoError;
+    }
+
+    bool hasDigest(QCryptographicHash::Algorithm algorithm) const
+    {
+        for(auto & digest: m_digests)
+        {
+            if(digest.algorithm == algorithm)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    /// the raw digest, empty if it's not being computed
+    QByteArray hash(QCryptographicHash::Algorithm algorithm) const
+    {
+        for(auto & digest: m_digests)
+        {
+            if(digest.algorithm == algorithm)
+            {
+                return digest.hash->result();
+            }
+        }
+        return QByteArray();
+    }
+    std::vector<QCryptographicHash::Algorithm> algorithms() const
+    {
+        std::vector<QCryptographicHash::Algorithm> result;
+        for(auto & digest: m_digests)
+        {
+            result.push_back(digest.algorithm);
+        }
+        return result;
+    }
+
+private: /* methods */
+    void reset()
+    {
+        for(auto & digest: m_digests)
+        {
+            digest.hash->reset();
+        }
+    }
+
+private: /* data */
+    struct Digest
+    {
+        QCryptographicHash::Algorithm algorithm;
+        std::unique_ptr<Hashing::Hasher> hash;
+        QByteArray expected;
+    };
+    std::vector<Digest> m_digests;
+};
+}
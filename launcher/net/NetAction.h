@@ -21,6 +21,8 @@
 #include <QNetworkReply>
 #include <QObjectPtr.h>
 
+#include "Scheduler.h"
+
 enum JobStatus
 {
     Job_NotStarted,
@@ -75,6 +77,50 @@ public:
     {
         return false;
     }
+    /// the action is taking too long, try another source for it in parallel if there is one.
+    /// returns false if there's nothing else to try.
+    virtual bool hedge()
+    {
+        return false;
+    }
+    /// where the duplicate request would go if hedge() was called now. Empty if it wouldn't make one.
+    virtual QUrl hedgeTarget() const
+    {
+        return QUrl();
+    }
+    /// use the next source the next time the action starts. Returns false if there is no other source.
+    virtual bool switchSource()
+    {
+        return false;
+    }
+    /// how long the server asked us to wait before trying again after the last failure, in ms. -1 if it didn't.
+    virtual qint64 retryAfter() const
+    {
+        return -1;
+    }
+    /// leave the finished file next to its target until commit(), instead of putting it in place right away
+    virtual void deferCommit()
+    {
+    }
+    /// the finished file waiting for commit(), if any
+    virtual QString stagedFile() const
+    {
+        return QString();
+    }
+    /// the file the action writes to, empty if it doesn't write to one
+    virtual QString targetPath() const
+    {
+        return QString();
+    }
+    /// put the staged file in place. Returns false if that failed.
+    virtual bool commit()
+    {
+        return true;
+    }
+    /// throw the staged file away, it never replaces the target
+    virtual void discardStaged()
+    {
+    }
     QUrl url()
     {
         return m_url;
@@ -86,6 +132,10 @@ signals:
     void succeeded(int index);
     void failed(int index);
     void aborted(int index);
+    /// the duplicate request made by hedge() is gone. If it was `adopted`, it replaced the original one.
+    void hedgeEnded(int index, bool adopted);
+    /// somebody else is getting the same file. The action stopped before using the network, start it again later.
+    void lockContended(int index);
 
 protected slots:
     virtual void downloadProgress(qint64 bytesReceived, qint64 bytesTotal) = 0;
@@ -114,6 +164,9 @@ public:
     /// source URL
     QUrl m_url;
 
+    /// of the job the action is in. Connections the action takes beyond its own are asked for with it.
+    Net::Priority m_priority = Net::Priority::Background;
+
     qint64 m_progress = 0;
     qint64 m_total_progress = 1;
 
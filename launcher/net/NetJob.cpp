@@ -17,6 +17,42 @@
 #include "Download.h"
 
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <random>
+
+#include "FileSystem.h"
+
+namespace {
+// parts slower than this fraction of the finished ones get a duplicate request to another source
+const double hedgePercentile = 0.95;
+// the percentile means nothing with fewer samples than this
+const int minimumLatencySamples = 8;
+// never hedge parts that haven't been running for at least this long
+const qint64 minimumHedgeDelayMs = 2000;
+const int hedgeCheckIntervalMs = 500;
+// finished files are synced and put in place in batches of this many. Each one holds its lock file open until then.
+const int commitBatchSize = 32;
+// servers asking for a longer break than this are not waited for, the part fails
+const qint64 maximumRetryAfterMs = 5 * 60 * 1000;
+// how often to check if another process is done with a file we want too
+const int lockPollMs = 250;
+
+/// the same for every spelling of the path
+QString targetKey(const QString & path)
+{
+    return path.isEmpty() ? QString() : QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+}
+
+qint64 randomBelow(qint64 bound)
+{
+    static std::default_random_engine engine((std::random_device())());
+    std::uniform_int_distribution<qint64> distribution(0, qMax<qint64>(bound - 1, 0));
+    return distribution(engine);
+}
+}
 
 void NetJob::partSucceeded(int index)
 {
@@ -24,16 +60,45 @@ void NetJob::partSucceeded(int index)
     auto &slot = parts_progress[index];
     partProgress(index, slot.total_progress, slot.total_progress);
 
-    m_doing.remove(index);
+    bool wasActive = m_doing.remove(index);
     m_done.insert(index);
     downloads[index].get()->disconnect(this);
+    releaseHedge(index);
+    if(!downloads[index]->stagedFile().isEmpty())
+    {
+        m_staged.append(index);
+        if(m_staged.size() >= commitBatchSize)
+        {
+            commitStaged();
+        }
+    }
+    if(wasActive && m_scheduler)
+    {
+        if(slot.starting)
+        {
+            // cache hit, nothing was transferred
+            m_scheduler->partCancelled(slot.host);
+        }
+        else
+        {
+            m_scheduler->partSucceeded(slot.host, downloads[index]->currentProgress());
+        }
+    }
+    if(wasActive && !slot.starting && slot.running.isValid())
+    {
+        m_latencies.append(slot.running.elapsed());
+    }
     startMoreParts();
 }
 
 void NetJob::partFailed(int index)
 {
-    m_doing.remove(index);
     auto &slot = parts_progress[index];
+    bool wasActive = m_doing.remove(index);
+    downloads[index].get()->disconnect(this);
+    releaseHedge(index);
+    // the retry can go to another host
+    auto host = slot.host;
     if (slot.failures == 3)
     {
         m_failed.insert(index);
@@ -41,21 +106,124 @@ void NetJob::partFailed(int index)
     else
     {
         slot.failures++;
-        m_todo.enqueue(index);
+        retryPart(index);
+    }
+    if(wasActive && m_scheduler)
+    {
+        if(slot.starting)
+        {
+            // failed before it even got to the network, not the host's fault
+            m_scheduler->partCancelled(host);
+        }
+        else
+        {
+            m_scheduler->partFailed(host);
+        }
     }
-    downloads[index].get()->disconnect(this);
     startMoreParts();
 }
 
 void NetJob::partAborted(int index)
 {
     m_aborted = true;
-    m_doing.remove(index);
+    bool wasActive = m_doing.remove(index);
     m_failed.insert(index);
     downloads[index].get()->disconnect(this);
+    releaseHedge(index);
+    if(wasActive && m_scheduler)
+    {
+        m_scheduler->partCancelled(parts_progress[index].host);
+    }
+    startMoreParts();
+}
+
+void NetJob::partLockContended(int index)
+{
+    // waiting doesn't need a connection, it goes back to the scheduler
+    bool wasActive = m_doing.remove(index);
+    downloads[index].get()->disconnect(this);
+    releaseHedge(index);
+    if(wasActive && m_scheduler)
+    {
+        m_scheduler->partCancelled(parts_progress[index].host);
+    }
+    // the lock may be our own, held until the job commits the file
+    int holder = stagedPartWithTarget(index);
+    if(holder >= 0)
+    {
+        m_sameFile.insert(index, holder);
+    }
+    else
+    {
+        enqueuePartLater(index, lockPollMs);
+    }
     startMoreParts();
 }
 
+int NetJob::stagedPartWithTarget(int index) const
+{
+    auto target = targetKey(downloads[index]->targetPath());
+    if(target.isEmpty())
+    {
+        return -1;
+    }
+    for(auto & batch: {m_staged, m_committing})
+    {
+        for(auto other: batch)
+        {
+            if(other != index && targetKey(downloads[other]->targetPath()) == target)
+            {
+                return other;
+            }
+        }
+    }
+    return -1;
+}
+
+void NetJob::settleSameFileParts()
+{
+    for(auto iter = m_sameFile.begin(); iter != m_sameFile.end(); iter++)
+    {
+        if(m_failed.contains(iter.value()))
+        {
+            m_failed.insert(iter.key());
+        }
+        else
+        {
+            m_done.insert(iter.key());
+        }
+    }
+    m_sameFile.clear();
+}
+
+void NetJob::partHedgeEnded(int index, bool adopted)
+{
+    auto &slot = parts_progress[index];
+    if(adopted && !slot.hedgeHost.isNull() && m_scheduler)
+    {
+        // the duplicate is the part's connection now, the original one is closed
+        m_scheduler->partCancelled(slot.host);
+        slot.host = slot.hedgeHost;
+        slot.hedgeHost = QString();
+        return;
+    }
+    releaseHedge(index);
+}
+
+void NetJob::releaseHedge(int index)
+{
+    auto &slot = parts_progress[index];
+    if(slot.hedgeHost.isNull())
+    {
+        return;
+    }
+    if(m_scheduler)
+    {
+        m_scheduler->partCancelled(slot.hedgeHost);
+    }
+    slot.hedgeHost = QString();
+}
+
 void NetJob::partProgress(int index, qint64 bytesReceived, qint64 bytesTotal)
 {
     auto &slot = parts_progress[index];
@@ -98,12 +266,21 @@ void NetJob::partProgress(int index, qint64 bytesReceived, qint64 bytesTotal)
 
 void NetJob::executeTask()
 {
+    m_scheduler = Net::Scheduler::get(m_network.get());
+    m_hedgeTimer.setInterval(hedgeCheckIntervalMs);
+    connect(&m_hedgeTimer, &QTimer::timeout, this, &NetJob::hedgeStragglers, Qt::UniqueConnection);
+    connect(&m_syncWatcher, &QFutureWatcher<bool>::finished, this, &NetJob::syncFinished, Qt::UniqueConnection);
     // hack that delays early failures so they can be caught easier
     QMetaObject::invokeMethod(this, "startMoreParts", Qt::QueuedConnection);
 }
 
 void NetJob::startMoreParts()
 {
+    if(m_doing.isEmpty())
+    {
+        // nothing to hedge until parts run again
+        m_hedgeTimer.stop();
+    }
     if(!isRunning())
     {
         // this actually makes sense. You can put running downloads into a NetJob and then not start it until much later.
@@ -111,10 +288,28 @@ void NetJob::startMoreParts()
     }
     // OK. We are actively processing tasks, proceed.
     // Check for final conditions if there's nothing in the queue.
-    if(!m_todo.size())
+    if(!todoCount())
     {
-        if(!m_doing.size())
+        if(!m_doing.size() && !m_staged.isEmpty())
         {
+            // nothing else is downloading, the files don't wait for a full batch anymore. parts waiting for a lock
+            // may be waiting for one of them.
+            commitStaged();
+        }
+        if(!m_doing.size() && m_waiting.isEmpty())
+        {
+            if(!m_staged.isEmpty() || m_syncWatcher.isRunning())
+            {
+                // the last files still have to get onto the disk
+                return;
+            }
+            settleSameFileParts();
+            m_scheduler->withdraw(this);
+            if(m_latencies.size() >= minimumLatencySamples)
+            {
+                qDebug() << "Job" << objectName() << "part latencies: median" << latencyPercentile(0.5) << "ms, p95"
+                         << latencyPercentile(0.95) << "ms, max" << latencyPercentile(1.0) << "ms";
+            }
             if(!m_failed.size())
             {
                 emitSucceeded();
@@ -130,24 +325,274 @@ void NetJob::startMoreParts()
         }
         return;
     }
-    // There's work to do, try to start more parts.
-    while (m_doing.size() < 6)
+    // There's work to do, the scheduler decides when the parts get their connections.
+    m_scheduler->submit(this);
+}
+
+bool NetJob::startNextPart(Net::ConnectionLimiter & limiter)
+{
+    if(!isRunning())
+    {
+        return false;
+    }
+    bool failedFast = false;
+    for(auto & candidate: QStringList(m_hosts))
+    {
+        if(!m_todo[candidate].isEmpty() && limiter.isTripped(candidate))
+        {
+            failTrippedHost(candidate, limiter);
+            failedFast = true;
+        }
+    }
+    if(failedFast)
+    {
+        // the job may be done now
+        QMetaObject::invokeMethod(this, "startMoreParts", Qt::QueuedConnection);
+    }
+    QString host;
+    for(auto & candidate: m_hosts)
+    {
+        if(!m_todo[candidate].isEmpty() && limiter.canStart(candidate))
+        {
+            host = candidate;
+            break;
+        }
+    }
+    if(host.isNull())
+    {
+        return false;
+    }
+    // NOTE: starting a part can finish it right away and re-enter the job. Do not hold on to anything across the start.
+    int doThis = m_todo[host].dequeue();
+    m_doing.insert(doThis);
+    auto part = downloads[doThis];
+    // connect signals :D
+    connect(part.get(), SIGNAL(succeeded(int)), SLOT(partSucceeded(int)));
+    connect(part.get(), SIGNAL(failed(int)), SLOT(partFailed(int)));
+    connect(part.get(), SIGNAL(aborted(int)), SLOT(partAborted(int)));
+    connect(part.get(), SIGNAL(netActionProgress(int, qint64, qint64)),
+            SLOT(partProgress(int, qint64, qint64)));
+    connect(part.get(), SIGNAL(hedgeEnded(int, bool)), SLOT(partHedgeEnded(int, bool)));
+    connect(part.get(), SIGNAL(lockContended(int)), SLOT(partLockContended(int)));
+    limiter.partStarted(host);
+    if(!m_hedgeTimer.isActive())
+    {
+        m_hedgeTimer.start();
+    }
+    parts_progress[doThis].running.start();
+    parts_progress[doThis].hedges = 0;
+    parts_progress[doThis].starting = true;
+    part->m_priority = m_priority;
+    part->start(m_network);
+    parts_progress[doThis].starting = false;
+    return true;
+}
+
+void NetJob::enqueuePart(int index)
+{
+    auto &slot = parts_progress[index];
+    // the part may have moved to another source
+    slot.host = Net::ConnectionLimiter::hostKey(downloads[index]->url());
+    if(!m_todo.contains(slot.host))
+    {
+        m_hosts.append(slot.host);
+    }
+    m_todo[slot.host].enqueue(index);
+}
+
+void NetJob::retryPart(int index)
+{
+    auto &slot = parts_progress[index];
+    auto part = downloads[index];
+    // another host can be tried right away, the same one gets some time to recover first
+    if(part->switchSource() && Net::ConnectionLimiter::hostKey(part->url()) != slot.host)
+    {
+        qDebug() << "Retrying" << part->url().toString();
+        enqueuePart(index);
+        return;
+    }
+    qint64 delay = part->retryAfter();
+    if(delay > maximumRetryAfterMs)
     {
-        if(!m_todo.size())
+        qWarning() << "Not retrying" << part->url().toString() << "- the server asked to wait" << delay << "ms";
+        m_failed.insert(index);
+        return;
+    }
+    if(delay < 0)
+    {
+        // half of the delay is random, so parts that failed together don't all come back at the same time
+        qint64 base = slot.backoff();
+        delay = base / 2 + randomBelow(base / 2 + 1);
+    }
+    qDebug() << "Retrying" << part->url().toString() << "in" << delay << "ms";
+    enqueuePartLater(index, delay);
+}
+
+void NetJob::enqueuePartLater(int index, qint64 delayMs)
+{
+    m_waiting.insert(index);
+    QTimer::singleShot(int(delayMs), this, [this, index]()
+    {
+        // aborted in the meantime
+        if(!m_waiting.remove(index))
+        {
             return;
-        int doThis = m_todo.dequeue();
-        m_doing.insert(doThis);
-        auto part = downloads[doThis];
-        // connect signals :D
-        connect(part.get(), SIGNAL(succeeded(int)), SLOT(partSucceeded(int)));
-        connect(part.get(), SIGNAL(failed(int)), SLOT(partFailed(int)));
-        connect(part.get(), SIGNAL(aborted(int)), SLOT(partAborted(int)));
-        connect(part.get(), SIGNAL(netActionProgress(int, qint64, qint64)),
-                SLOT(partProgress(int, qint64, qint64)));
-        part->start(m_network);
+        }
+        enqueuePart(index);
+        startMoreParts();
+    });
+}
+
+void NetJob::failTrippedHost(const QString& host, Net::ConnectionLimiter& limiter)
+{
+    auto queue = m_todo.take(host);
+    m_hosts.removeAll(host);
+    for(auto index: queue)
+    {
+        auto part = downloads[index];
+        bool moved = false;
+        // NOTE: the sources go around in a circle, this ends at the original one at the latest
+        for(int tries = 0; tries < 8 && part->switchSource(); tries++)
+        {
+            auto newHost = Net::ConnectionLimiter::hostKey(part->url());
+            if(newHost != host && !limiter.isTripped(newHost))
+            {
+                moved = true;
+                break;
+            }
+        }
+        if(moved)
+        {
+            qDebug() << host << "is failing, downloading" << part->url().toString() << "instead";
+            enqueuePart(index);
+            continue;
+        }
+        qWarning() << "Not downloading" << part->url().toString() << "-" << host << "is failing too much";
+        m_failed.insert(index);
+    }
+}
+
+void NetJob::commitStaged()
+{
+    if(m_syncWatcher.isRunning() || m_staged.isEmpty())
+    {
+        return;
+    }
+    m_committing = m_staged.mid(0, commitBatchSize);
+    m_staged = m_staged.mid(m_committing.size());
+    QStringList files;
+    for(auto index: m_committing)
+    {
+        files.append(downloads[index]->stagedFile());
     }
+    m_syncWatcher.setFuture(QtConcurrent::run(&FS::syncFiles, files));
 }
 
+void NetJob::syncFinished()
+{
+    // a file that may not be on the disk must not replace a good one, those downloads fail
+    bool synced = m_syncWatcher.result();
+    if(!synced)
+    {
+        qWarning() << "Job" << objectName() << "could not get the downloaded files onto the disk";
+    }
+    for(auto index: m_committing)
+    {
+        auto part = downloads[index];
+        if(!synced)
+        {
+            part->discardStaged();
+        }
+        else if(part->commit())
+        {
+            continue;
+        }
+        m_done.remove(index);
+        m_failed.insert(index);
+    }
+    m_committing.clear();
+    if(m_staged.size() >= commitBatchSize)
+    {
+        commitStaged();
+    }
+    startMoreParts();
+}
+
+int NetJob::todoCount() const
+{
+    int count = 0;
+    for(auto & queue: m_todo)
+    {
+        count += queue.size();
+    }
+    return count;
+}
+
+
+qint64 NetJob::latencyPercentile(double fraction) const
+{
+    if(m_latencies.isEmpty())
+    {
+        return -1;
+    }
+    auto sorted = m_latencies;
+    std::sort(sorted.begin(), sorted.end());
+    int index = qBound(0, int(fraction * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted[index];
+}
+
+void NetJob::hedgeStragglers()
+{
+    // only the tail of the job, while there's queued work the connections have better things to do
+    if(!isRunning() || todoCount() || m_latencies.size() < minimumLatencySamples)
+    {
+        return;
+    }
+    qint64 threshold = qMax(latencyPercentile(hedgePercentile), minimumHedgeDelayMs);
+    // NOTE: hedging can finish or fail the part right away, which changes m_doing
+    for(auto index: m_doing.toList())
+    {
+        if(!m_doing.contains(index))
+        {
+            continue;
+        }
+        auto & slot = parts_progress[index];
+        // every further duplicate waits another threshold
+        if(slot.running.elapsed() < threshold * (slot.hedges + 1))
+        {
+            continue;
+        }
+        auto part = downloads[index];
+        auto target = part->hedgeTarget();
+        if(!target.isEmpty())
+        {
+            // the duplicate request needs a connection like any other
+            auto hedgeHost = Net::ConnectionLimiter::hostKey(target);
+            if(!m_scheduler->reserveExtra(hedgeHost, m_priority))
+            {
+                continue;
+            }
+            slot.hedgeHost = hedgeHost;
+        }
+        if(!part->hedge())
+        {
+            releaseHedge(index);
+            continue;
+        }
+        slot.hedges++;
+        if(!m_doing.contains(index) || !target.isEmpty())
+        {
+            continue;
+        }
+        // the part gave up on its source and went on with the next one
+        auto host = Net::ConnectionLimiter::hostKey(part->url());
+        if(host != slot.host)
+        {
+            m_scheduler->partMoved(slot.host, host);
+            slot.host = host;
+        }
+    }
+}
 
 QStringList NetJob::getFailedFiles()
 {
@@ -164,10 +609,13 @@ bool NetJob::canAbort() const
 {
     bool canFullyAbort = true;
     // can abort the waiting?
-    for(auto index: m_todo)
+    for(auto & queue: m_todo)
     {
-        auto part = downloads[index];
-        canFullyAbort &= part->canAbort();
+        for(auto index: queue)
+        {
+            auto part = downloads[index];
+            canFullyAbort &= part->canAbort();
+        }
     }
     // can abort the active?
     for(auto index: m_doing)
@@ -182,8 +630,16 @@ bool NetJob::abort()
 {
     bool fullyAborted = true;
     // fail all waiting
-    m_failed.unite(m_todo.toSet());
+    for(auto & queue: m_todo)
+    {
+        m_failed.unite(queue.toSet());
+    }
     m_todo.clear();
+    m_hosts.clear();
+    // and the ones waiting for a retry
+    m_failed.unite(m_waiting);
+    m_waiting.clear();
+    m_aborted = true;
     // abort active
     auto toKill = m_doing.toList();
     for(auto index: toKill)
@@ -191,6 +647,11 @@ bool NetJob::abort()
         auto part = downloads[index];
         fullyAborted &= part->abort();
     }
+    if(m_doing.isEmpty())
+    {
+        // no part is going to report back, finish from here
+        QMetaObject::invokeMethod(this, "startMoreParts", Qt::QueuedConnection);
+    }
     return fullyAborted;
 }
 
@@ -199,6 +660,7 @@ bool NetJob::addNetAction(NetAction::Ptr action)
     action->m_index_within_job = downloads.size();
     downloads.append(action);
     part_info pi;
+    pi.host = Net::ConnectionLimiter::hostKey(action->url());
     parts_progress.append(pi);
     partProgress(parts_progress.count() - 1, action->currentProgress(), action->totalProgress());
 
@@ -210,9 +672,35 @@ bool NetJob::addNetAction(NetAction::Ptr action)
     }
     else
     {
-        m_todo.append(parts_progress.size() - 1);
+        int index = parts_progress.size() - 1;
+        auto target = targetKey(action->targetPath());
+        if(!target.isEmpty() && m_targets.contains(target))
+        {
+            // both would wait for the other's lock on the file. the first one gets it for both.
+            m_sameFile.insert(index, m_targets.value(target));
+            return true;
+        }
+        if(!target.isEmpty())
+        {
+            m_targets.insert(target, index);
+        }
+        // the job syncs the files in batches before they replace anything
+        action->deferCommit();
+        enqueuePart(index);
     }
     return true;
 }
 
-NetJob::~NetJob() = default;
+NetJob::~NetJob()
+{
+    if(m_scheduler)
+    {
+        m_scheduler->withdraw(this);
+        // give back the connections of parts that are still running
+        for(auto index: m_doing)
+        {
+            m_scheduler->partCancelled(parts_progress[index].host);
+            releaseHedge(index);
+        }
+    }
+}
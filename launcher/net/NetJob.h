@@ -15,11 +15,16 @@
 
 #pragma once
 #include <QtNetwork>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QFutureWatcher>
 #include "NetAction.h"
 #include "Download.h"
 #include "HttpMetaCache.h"
+#include "Scheduler.h"
 #include "tasks/Task.h"
 #include "QObjectPtr.h"
+#include "ExponentialSeries.h"
 
 class NetJob;
 
@@ -59,8 +64,24 @@ public:
 
     bool canAbort() const override;
 
+    /// how urgent the job is compared to other jobs running at the same time. Set before starting the job.
+    void setPriority(Net::Priority priority)
+    {
+        m_priority = priority;
+    }
+    Net::Priority priority() const
+    {
+        return m_priority;
+    }
+
+    /// how long it took to finish the parts that went to the network, in ms. `fraction` is between 0 and 1.
+    /// returns -1 if no parts finished yet.
+    qint64 latencyPercentile(double fraction) const;
+
 private slots:
     void startMoreParts();
+    void hedgeStragglers();
+    void syncFinished();
 
 public slots:
     virtual void executeTask() override;
@@ -71,6 +92,34 @@ private slots:
     void partSucceeded(int index);
     void partFailed(int index);
     void partAborted(int index);
+    void partHedgeEnded(int index, bool adopted);
+    void partLockContended(int index);
+
+private:
+    friend class Net::Scheduler;
+    /// start the next waiting part the limiter allows. Returns false if there's no such part.
+    bool startNextPart(Net::ConnectionLimiter & limiter);
+    int activeParts() const
+    {
+        return m_doing.size();
+    }
+
+    void enqueuePart(int index);
+    /// put a failed part back in the queue, after a while if it goes to the same host again
+    void retryPart(int index);
+    /// put the part back in the queue after `delayMs`
+    void enqueuePartLater(int index, qint64 delayMs);
+    /// fail the waiting parts for a host whose circuit breaker is open, or move them to other sources
+    void failTrippedHost(const QString & host, Net::ConnectionLimiter & limiter);
+    int todoCount() const;
+    /// give back the connection of the part's duplicate request, if it has one
+    void releaseHedge(int index);
+    /// sync the next batch of finished files on a worker thread, then put them in place
+    void commitStaged();
+    /// the staged part that writes the same file as this one, -1 if there is none
+    int stagedPartWithTarget(int index) const;
+    /// parts that got the same file as another one end the way that one did
+    void settleSameFileParts();
 
 private:
     shared_qobject_ptr<QNetworkAccessManager> m_network;
@@ -80,13 +129,39 @@ private:
         qint64 current_progress = 0;
         qint64 total_progress = 1;
         int failures = 0;
+        QString host;
+        // set while the part is being started - anything it reports in the meantime did not touch the network
+        bool starting = false;
+        QElapsedTimer running;
+        int hedges = 0;
+        // the host the part's duplicate request has a connection to, null if there is none
+        QString hedgeHost;
+        // delays before retrying the part, in ms. Jitter is added on top.
+        ExponentialSeries backoff = ExponentialSeries(1000, 60000);
     };
     QList<NetAction::Ptr> downloads;
     QList<part_info> parts_progress;
-    QQueue<int> m_todo;
+    // parts waiting to be started, grouped by host. hosts are kept in order of first appearance.
+    QStringList m_hosts;
+    QHash<QString, QQueue<int>> m_todo;
     QSet<int> m_doing;
+    // parts waiting to be retried, or for somebody else to finish the same file
+    QSet<int> m_waiting;
     QSet<int> m_done;
     QSet<int> m_failed;
+    // finished parts whose files wait to be synced and put in place, and the batch being synced right now
+    QList<int> m_staged;
+    QList<int> m_committing;
+    // the parts writing to each file, by absolute path
+    QHash<QString, int> m_targets;
+    // parts that aren't downloaded on their own, another part gets the same file. to the index of that part.
+    QHash<int, int> m_sameFile;
     qint64 m_current_progress = 0;
     bool m_aborted = false;
+    Net::Priority m_priority = Net::Priority::Background;
+    QPointer<Net::Scheduler> m_scheduler;
+    /// how long the finished parts took, in ms
+    QVector<qint64> m_latencies;
+    QTimer m_hedgeTimer;
+    QFutureWatcher<bool> m_syncWatcher;
 };
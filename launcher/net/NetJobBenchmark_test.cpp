@@ -0,0 +1,270 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "TestUtil.h"
+
+#include "net/TestHttpServer.h"
+#include "net/NetJob.h"
+#include "net/HttpMetaCache.h"
+#include "minecraft/AssetsUtils.h"
+#include "FileSystem.h"
+
+#include <ctime>
+#include <random>
+
+/*
+ * Throughput of the network code against a local server, under a few kinds of network conditions.
+ *
+ * Reports files/s, MB/s, the 99th percentile of the time parts took and the CPU time per MB. It only runs when
+ * NET_BENCHMARK_SCALE is set, to the number the amount of data is multiplied by. 1 takes a few seconds.
+ */
+namespace {
+int scale()
+{
+    return qMax(1, qEnvironmentVariableIntValue("NET_BENCHMARK_SCALE"));
+}
+
+QByteArray randomBytes(int size, std::default_random_engine & engine)
+{
+    QByteArray result(size, Qt::Uninitialized);
+    for(int i = 0; i < size; i++)
+    {
+        result[i] = char(engine());
+    }
+    return result;
+}
+
+struct Measurement
+{
+    Measurement()
+    {
+        wall.start();
+        cpu = std::clock();
+    }
+    /// print the numbers and hand the throughput to QTest
+    void report(const QString & what, int files, qint64 bytes, const NetJob & job)
+    {
+        double seconds = qMax<qint64>(wall.elapsed(), 1) / 1000.0;
+        double cpuMs = double(std::clock() - cpu) * 1000.0 / CLOCKS_PER_SEC;
+        double megabytes = bytes / (1024.0 * 1024.0);
+        qInfo().noquote() << QString("%1: %2 files/s, %3 MB/s, p99 part latency %4 ms, %5 ms CPU per MB")
+            .arg(what)
+            .arg(files / seconds, 0, 'f', 1)
+            .arg(megabytes / seconds, 0, 'f', 2)
+            .arg(job.latencyPercentile(0.99))
+            .arg(megabytes > 0 ? cpuMs / megabytes : 0.0, 0, 'f', 2);
+        QTest::setBenchmarkResult(bytes / seconds, QTest::BytesPerSecond);
+    }
+
+    QElapsedTimer wall;
+    std::clock_t cpu;
+};
+
+/// run the job to the end, returns true if it succeeded
+bool runJob(NetJob & job)
+{
+    QEventLoop loop;
+    bool success = false;
+    QObject::connect(&job, &NetJob::succeeded, [&]() { success = true; });
+    QObject::connect(&job, &NetJob::finished, &loop, &QEventLoop::quit);
+    // don't hang the test run if something goes wrong
+    QTimer::singleShot(10 * 60 * 1000, &loop, &QEventLoop::quit);
+    job.start();
+    loop.exec();
+    return success;
+}
+}
+
+class NetJobBenchmark : public QObject
+{
+    Q_OBJECT
+
+    void addConditions()
+    {
+        QTest::addColumn<int>("latency");
+        QTest::addColumn<qint64>("bandwidth");
+        QTest::addColumn<double>("errorRate");
+        QTest::newRow("local") << 0 << qint64(0) << 0.0;
+        QTest::newRow("30ms latency") << 30 << qint64(0) << 0.0;
+        QTest::newRow("30ms latency, 4 MB/s per connection") << 30 << qint64(4 * 1024 * 1024) << 0.0;
+        QTest::newRow("10ms latency, 3% errors") << 10 << qint64(0) << 0.03;
+    }
+
+    void setUpServer(TestHttpServer & server)
+    {
+        QFETCH(int, latency);
+        QFETCH(qint64, bandwidth);
+        QFETCH(double, errorRate);
+        server.setLatency(latency);
+        server.setBandwidth(bandwidth);
+        server.setErrorRate(errorRate);
+        QVERIFY(server.listen());
+    }
+
+private
+slots:
+    void initTestCase()
+    {
+        if(!qEnvironmentVariableIsSet("NET_BENCHMARK_SCALE"))
+        {
+            QSKIP("Set NET_BENCHMARK_SCALE to run the benchmark");
+        }
+        QVERIFY(m_temp.isValid());
+        // asset objects go to a path relative to the working directory
+        QVERIFY(QDir::setCurrent(m_temp.path()));
+        m_network.reset(new QNetworkAccessManager());
+    }
+
+    void benchmark_assetUpdate_data()
+    {
+        addConditions();
+    }
+    /// what AssetUpdateTask does: get the index through the cache, then all the objects in it
+    void benchmark_assetUpdate()
+    {
+        TestHttpServer server;
+        setUpServer(server);
+        FS::deletePath("assets");
+        std::default_random_engine engine(5);
+        // most assets are sounds and textures of a few KiB, some are much bigger
+        std::lognormal_distribution<double> sizes(9.0, 1.2);
+        QJsonObject objects;
+        qint64 totalBytes = 0;
+        int count = 500 * scale();
+        for(int i = 0; i < count; i++)
+        {
+            auto contents = randomBytes(qBound(16, int(sizes(engine)), 4 * 1024 * 1024), engine);
+            auto hash = QString::fromLatin1(QCryptographicHash::hash(contents, QCryptographicHash::Sha1).toHex());
+            server.addFile("/objects/" + hash.left(2) + "/" + hash, contents);
+            QJsonObject object;
+            object.insert("hash", hash);
+            object.insert("size", contents.size());
+            objects.insert(QString("minecraft/sounds/bench/%1.ogg").arg(i), object);
+            totalBytes += contents.size();
+        }
+        QJsonObject root;
+        root.insert("objects", objects);
+        auto indexData = QJsonDocument(root).toJson(QJsonDocument::Compact);
+        server.addFile("/indexes/bench.json", indexData);
+
+        HttpMetaCache cache(m_temp.filePath("metacache"));
+        cache.addBase("asset_indexes", QDir("assets/indexes").absolutePath());
+        cache.Load();
+
+        Measurement measurement;
+        NetJob::Ptr indexJob(new NetJob("Asset index", m_network));
+        auto entry = cache.resolveEntry("asset_indexes", "bench.json");
+        entry->setStale(true);
+        auto indexDownload = Net::Download::makeCached(server.url("/indexes/bench.json"), entry);
+        indexDownload->addDigest(QCryptographicHash::Sha1, QCryptographicHash::hash(indexData, QCryptographicHash::Sha1));
+        indexJob->addNetAction(indexDownload);
+        QVERIFY(runJob(*indexJob));
+
+        AssetsIndex index;
+        QVERIFY(AssetsUtils::loadAssetsIndexJson("bench", "assets/indexes/bench.json", index));
+        auto objectsJob = index.getDownloadJob(m_network, server.url("/objects/").toString());
+        QVERIFY(objectsJob);
+        QCOMPARE(objectsJob->size(), count);
+        QVERIFY(runJob(*objectsJob));
+        measurement.report("assets", count + 1, totalBytes + indexData.size(), *objectsJob);
+        qInfo() << "requests:" << server.requests() << "injected errors:" << server.errors();
+    }
+
+    void benchmark_largeFiles_data()
+    {
+        addConditions();
+    }
+    /// a few big files, like the game jar and the bigger libraries
+    void benchmark_largeFiles()
+    {
+        TestHttpServer server;
+        setUpServer(server);
+        std::default_random_engine engine(6);
+        NetJob::Ptr job(new NetJob("Large files", m_network));
+        int count = 4 * scale();
+        qint64 totalBytes = 0;
+        for(int i = 0; i < count; i++)
+        {
+            auto contents = randomBytes(16 * 1024 * 1024, engine);
+            auto path = QString("/large/%1.jar").arg(i);
+            server.addFile(path, contents);
+            auto target = m_temp.filePath(QString("large/%1.jar").arg(i));
+            QFile::remove(target);
+            auto dl = Net::Download::makeFile(server.url(path), target);
+            dl->addDigest(QCryptographicHash::Sha1, QCryptographicHash::hash(contents, QCryptographicHash::Sha1));
+            job->addNetAction(dl);
+            totalBytes += contents.size();
+        }
+        Measurement measurement;
+        QVERIFY(runJob(*job));
+        measurement.report("large files", count, totalBytes, *job);
+    }
+
+    void benchmark_metaCache_data()
+    {
+        addConditions();
+    }
+    /// library-like files through the cache, first fetched and then revalidated with ETags
+    void benchmark_metaCache()
+    {
+        TestHttpServer server;
+        setUpServer(server);
+        FS::deletePath(m_temp.filePath("libraries"));
+        HttpMetaCache cache(m_temp.filePath("metacache"));
+        cache.addBase("libraries", m_temp.filePath("libraries"));
+        cache.Load();
+
+        std::default_random_engine engine(7);
+        std::uniform_int_distribution<int> sizes(4 * 1024, 512 * 1024);
+        int count = 200 * scale();
+        qint64 totalBytes = 0;
+        QStringList paths;
+        for(int i = 0; i < count; i++)
+        {
+            auto contents = randomBytes(sizes(engine), engine);
+            auto path = QString("org/bench/lib%1/1.0/lib%1-1.0.jar").arg(i);
+            server.addFile("/maven/" + path, contents);
+            paths.append(path);
+            totalBytes += contents.size();
+        }
+
+        auto makeJob = [&](const QString & name)
+        {
+            NetJob::Ptr job(new NetJob(name, m_network));
+            for(auto & path: paths)
+            {
+                auto entry = cache.resolveEntry("libraries", path);
+                entry->setStale(true);
+                job->addNetAction(Net::Download::makeCached(server.url("/maven/" + path), entry));
+            }
+            return job;
+        };
+
+        {
+            auto job = makeJob("Libraries");
+            Measurement measurement;
+            QVERIFY(runJob(*job));
+            measurement.report("metacache, first fetch", count, totalBytes, *job);
+        }
+        server.resetCounters();
+        server.setErrorRate(0.0);
+        {
+            auto job = makeJob("Libraries again");
+            Measurement measurement;
+            QVERIFY(runJob(*job));
+            measurement.report("metacache, revalidation", count, 0, *job);
+        }
+        QCOMPARE(server.notModified(), count);
+    }
+
+private:
+    QTemporaryDir m_temp;
+    shared_qobject_ptr<QNetworkAccessManager> m_network;
+};
+
+QTEST_GUILESS_MAIN(NetJobBenchmark)
+
+#include "NetJobBenchmark_test.moc"
@@ -0,0 +1,393 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PeerCache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QRegularExpression>
+#include <QTcpSocket>
+#include <QUuid>
+#include <algorithm>
+
+#include "FileSystem.h"
+
+namespace Net {
+
+namespace {
+// where the announcements go. The group is only routed within the local network.
+const char * discoveryGroup = "239.255.77.77";
+const quint16 discoveryPort = 47842;
+const int announceIntervalMs = 5 * 1000;
+// a peer that wasn't heard from for this long is gone
+const qint64 peerTimeoutMs = 4 * announceIntervalMs;
+// asking more peers than this costs more than going to the origin
+const int maxPeersPerFile = 3;
+// more uploads than this are turned away, the downloads then go to the origin instead
+const int maxUploads = 8;
+const qint64 uploadChunkSize = 256 * 1024;
+const int maxRequestSize = 8 * 1024;
+// connections that don't send a complete request in time are dropped, so they can't pile up
+const int requestTimeoutMs = 5 * 1000;
+// connections beyond this are closed right away, whatever they are for
+const int maxConnections = 32;
+
+QByteArray statusLine(int status, const QByteArray & reason)
+{
+    return "HTTP/1.1 " + QByteArray::number(status) + " " + reason + "\r\n";
+}
+}
+
+PeerCache::PeerCache(QNetworkAccessManager * network)
+    : QObject(network), m_id(QUuid::createUuid().toString())
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &PeerCache::newConnection);
+    connect(&m_discovery, &QUdpSocket::readyRead, this, &PeerCache::readAnnouncements);
+    m_announceTimer.setInterval(announceIntervalMs);
+    connect(&m_announceTimer, &QTimer::timeout, this, &PeerCache::announce);
+}
+
+PeerCache::~PeerCache()
+{
+    stop();
+}
+
+PeerCache * PeerCache::find(QNetworkAccessManager * network)
+{
+    return network->findChild<PeerCache *>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+bool PeerCache::start(quint16 port)
+{
+    if(isRunning())
+    {
+        return true;
+    }
+    if(!m_server.listen(QHostAddress::Any, port))
+    {
+        qWarning() << "Peer cache can't listen on port" << port << ":" << m_server.errorString();
+        return false;
+    }
+    // without discovery, the peers that were added by hand still work
+    auto mode = QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint;
+    if(m_discovery.bind(QHostAddress::AnyIPv4, discoveryPort, mode)
+       && m_discovery.joinMulticastGroup(QHostAddress(discoveryGroup)))
+    {
+        // other launchers on this machine need to hear us too
+        m_discovery.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+        announce();
+        m_announceTimer.start();
+    }
+    else
+    {
+        qWarning() << "Peer cache can't announce itself:" << m_discovery.errorString();
+    }
+    qDebug() << "Peer cache serving on port" << m_server.serverPort();
+    return true;
+}
+
+void PeerCache::stop()
+{
+    m_announceTimer.stop();
+    m_discovery.close();
+    m_server.close();
+    for(auto socket: m_uploads.keys())
+    {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_uploads.clear();
+}
+
+QUrl PeerCache::url() const
+{
+    QUrl result;
+    result.setScheme("http");
+    result.setHost("127.0.0.1");
+    result.setPort(m_server.serverPort());
+    result.setPath("/");
+    return result;
+}
+
+void PeerCache::addContentAddressedFolder(const QString& path)
+{
+    if(!m_folders.contains(path))
+    {
+        m_folders.append(path);
+    }
+}
+
+void PeerCache::addFile(const QByteArray& sha1, const QString& path, const QByteArray& etag,
+                        const QByteArray& lastModified)
+{
+    if(sha1.size() == 20 && !path.isEmpty())
+    {
+        m_files.insert(sha1.toHex(), {path, etag, lastModified});
+    }
+}
+
+QString PeerCache::lookup(const QByteArray& sha1) const
+{
+    return find(sha1).path;
+}
+
+PeerCache::SharedFile PeerCache::find(const QByteArray& sha1) const
+{
+    auto hex = sha1.toHex();
+    auto file = m_files.value(hex);
+    if(!file.path.isEmpty() && QFileInfo(file.path).isFile())
+    {
+        return file;
+    }
+    auto name = QString::fromLatin1(hex);
+    for(auto & folder: m_folders)
+    {
+        auto candidate = FS::PathCombine(folder, name.left(2), name);
+        if(QFileInfo(candidate).isFile())
+        {
+            // the folders are filled by name, nothing is known about where the files came from
+            return {candidate, QByteArray(), QByteArray()};
+        }
+    }
+    return SharedFile();
+}
+
+void PeerCache::addPeer(const QUrl& url)
+{
+    Peer peer;
+    peer.url = url;
+    m_peers.insert(url.toString(), peer);
+}
+
+QList<QUrl> PeerCache::sources(const QByteArray& sha1) const
+{
+    auto now = QDateTime::currentMSecsSinceEpoch();
+    auto hex = sha1.toHex();
+    // every file has its own order of peers, so the load spreads over all of them
+    QList<QPair<QByteArray, QUrl>> ranked;
+    for(auto iter = m_peers.begin(); iter != m_peers.end(); iter++)
+    {
+        if(iter->lastSeen && now - iter->lastSeen > peerTimeoutMs)
+        {
+            continue;
+        }
+        auto rank = QCryptographicHash::hash(iter.key().toUtf8() + hex, QCryptographicHash::Md5);
+        ranked.append(qMakePair(rank, iter->url.resolved(QUrl("sha1/" + QString::fromLatin1(hex)))));
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const QPair<QByteArray, QUrl> & a, const QPair<QByteArray, QUrl> & b)
+    {
+        return a.first < b.first;
+    });
+    QList<QUrl> result;
+    for(int i = 0; i < ranked.size() && i < maxPeersPerFile; i++)
+    {
+        result.append(ranked[i].second);
+    }
+    return result;
+}
+
+void PeerCache::announce()
+{
+    QJsonObject announcement;
+    announcement.insert("peer", m_id);
+    announcement.insert("port", int(m_server.serverPort()));
+    auto data = QJsonDocument(announcement).toJson(QJsonDocument::Compact);
+    m_discovery.writeDatagram(data, QHostAddress(discoveryGroup), discoveryPort);
+}
+
+void PeerCache::readAnnouncements()
+{
+    while(m_discovery.hasPendingDatagrams())
+    {
+        QByteArray data(int(m_discovery.pendingDatagramSize()), Qt::Uninitialized);
+        QHostAddress sender;
+        if(m_discovery.readDatagram(data.data(), data.size(), &sender) < 0)
+        {
+            continue;
+        }
+        auto announcement = QJsonDocument::fromJson(data).object();
+        auto id = announcement.value("peer").toString();
+        int port = announcement.value("port").toInt();
+        if(id.isEmpty() || id == m_id || port <= 0 || port > 65535)
+        {
+            continue;
+        }
+        auto & peer = m_peers[id];
+        if(!peer.lastSeen)
+        {
+            qDebug() << "Found a peer cache at" << sender.toString() << "port" << port;
+        }
+        peer.url.setScheme("http");
+        peer.url.setHost(sender.toString());
+        peer.url.setPort(port);
+        peer.url.setPath("/");
+        peer.lastSeen = QDateTime::currentMSecsSinceEpoch();
+    }
+}
+
+void PeerCache::newConnection()
+{
+    while(m_server.hasPendingConnections())
+    {
+        auto socket = m_server.nextPendingConnection();
+        if(m_uploads.size() >= maxConnections)
+        {
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        m_uploads.insert(socket, Upload());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+        {
+            readRequest(socket);
+        });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]()
+        {
+            sendMore(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            m_uploads.remove(socket);
+            socket->deleteLater();
+        });
+        QTimer::singleShot(requestTimeoutMs, socket, [this, socket]()
+        {
+            auto iter = m_uploads.find(socket);
+            if(iter != m_uploads.end() && !iter->answered)
+            {
+                socket->abort();
+            }
+        });
+    }
+}
+
+void PeerCache::readRequest(QTcpSocket* socket)
+{
+    auto & upload = m_uploads[socket];
+    upload.request.append(socket->readAll());
+    if(upload.file)
+    {
+        // one request per connection, anything after it is ignored
+        return;
+    }
+    int end = upload.request.indexOf("\r\n\r\n");
+    if(end < 0)
+    {
+        if(upload.request.size() > maxRequestSize)
+        {
+            upload.answered = true;
+            respond(socket, 400, "Bad Request");
+        }
+        return;
+    }
+    auto requestLine = upload.request.left(upload.request.indexOf("\r\n")).split(' ');
+    upload.request.clear();
+    upload.answered = true;
+    if(requestLine.size() < 2 || (requestLine[0] != "GET" && requestLine[0] != "HEAD"))
+    {
+        respond(socket, 405, "Method Not Allowed");
+        return;
+    }
+    static const QRegularExpression pathPattern("^/sha1/([0-9a-f]{40})$");
+    auto match = pathPattern.match(QString::fromLatin1(requestLine[1]));
+    if(!match.hasMatch())
+    {
+        respond(socket, 404, "Not Found");
+        return;
+    }
+    auto shared = find(QByteArray::fromHex(match.captured(1).toLatin1()));
+    if(shared.path.isEmpty())
+    {
+        respond(socket, 404, "Not Found");
+        return;
+    }
+    int uploads = 0;
+    for(auto & other: m_uploads)
+    {
+        uploads += other.file ? 1 : 0;
+    }
+    if(uploads >= maxUploads)
+    {
+        respond(socket, 503, "Service Unavailable");
+        return;
+    }
+    std::shared_ptr<QFile> file(new QFile(shared.path));
+    if(!file->open(QIODevice::ReadOnly))
+    {
+        respond(socket, 404, "Not Found");
+        return;
+    }
+    QByteArray header = statusLine(200, "OK");
+    header += "Content-Length: " + QByteArray::number(file->size()) + "\r\n";
+    header += "Content-Type: application/octet-stream\r\n";
+    // the downloader keeps these to check with the origin later, as if it had gotten the file from there
+    auto isHeaderValue = [](const QByteArray & value)
+    {
+        return !value.isEmpty() && !value.contains('\r') && !value.contains('\n');
+    };
+    if(isHeaderValue(shared.etag))
+    {
+        header += "ETag: " + shared.etag + "\r\n";
+    }
+    if(isHeaderValue(shared.lastModified))
+    {
+        header += "Last-Modified: " + shared.lastModified + "\r\n";
+    }
+    header += "Connection: close\r\n\r\n";
+    socket->write(header);
+    if(requestLine[0] == "HEAD")
+    {
+        socket->disconnectFromHost();
+        return;
+    }
+    upload.file = file;
+    sendMore(socket);
+}
+
+void PeerCache::respond(QTcpSocket* socket, int status, const QByteArray& reason)
+{
+    socket->write(statusLine(status, reason) + "Content-Length: 0\r\nConnection: close\r\n\r\n");
+    socket->disconnectFromHost();
+}
+
+void PeerCache::sendMore(QTcpSocket* socket)
+{
+    auto iter = m_uploads.find(socket);
+    if(iter == m_uploads.end() || !iter->file)
+    {
+        return;
+    }
+    auto & file = iter->file;
+    // keep a little data queued, without reading the whole file into memory
+    while(socket->bytesToWrite() < uploadChunkSize)
+    {
+        auto data = file->read(uploadChunkSize);
+        if(data.isEmpty())
+        {
+            file.reset();
+            socket->disconnectFromHost();
+            return;
+        }
+        socket->write(data);
+    }
+}
+}
@@ -0,0 +1,127 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QUrl>
+#include <memory>
+
+class QFile;
+class QNetworkAccessManager;
+class QTcpSocket;
+
+namespace Net {
+/*
+ * Shares downloaded files with other launchers on the local network.
+ *
+ * Files are known by their SHA-1: content-addressed folders (asset objects, the artifact store) are looked up by name,
+ * other files are added one by one as they are downloaded. A small HTTP server hands them out as /sha1/<hex>.
+ *
+ * Launchers announce themselves with a multicast datagram every few seconds, on loopback as well, so several of them
+ * on one machine find each other too. Peers can also be added by hand. A Download with an expected SHA-1 asks a few
+ * of the peers before it goes to the origin, and checks what it gets like any other download.
+ */
+class PeerCache : public QObject
+{
+    Q_OBJECT
+public: /* con/des */
+    /// the peer cache belongs to `network`, downloads using it will ask the peers
+    explicit PeerCache(QNetworkAccessManager * network);
+    virtual ~PeerCache();
+
+public: /* methods */
+    /// the peer cache attached to the network access manager, if there is one
+    static PeerCache * find(QNetworkAccessManager * network);
+
+    /// start serving files and announcing them. `port` 0 picks a free one.
+    bool start(quint16 port = 0);
+    void stop();
+    bool isRunning() const
+    {
+        return m_server.isListening();
+    }
+    /// where this launcher serves its files
+    QUrl url() const;
+
+    /// serve files named by their hex SHA-1, in subfolders named by the first two digits
+    void addContentAddressedFolder(const QString & path);
+    /// serve the file as the one with this SHA-1 (raw bytes). The caller is responsible for it having that hash.
+    /// `etag` and `lastModified` are what the origin sent with it, they are passed on to whoever downloads it.
+    void addFile(const QByteArray & sha1, const QString & path, const QByteArray & etag = QByteArray(),
+                 const QByteArray & lastModified = QByteArray());
+    /// the file with that SHA-1, empty if there's none to serve
+    QString lookup(const QByteArray & sha1) const;
+
+    /// ask this launcher too, regardless of announcements
+    void addPeer(const QUrl & url);
+    /// the URLs to ask for the file with this SHA-1, best first
+    QList<QUrl> sources(const QByteArray & sha1) const;
+
+private slots:
+    void newConnection();
+    void readAnnouncements();
+    void announce();
+
+private: /* types */
+    struct Peer
+    {
+        QUrl url;
+        /// ms since epoch, 0 for peers that were added by hand and don't expire
+        qint64 lastSeen = 0;
+    };
+    struct SharedFile
+    {
+        QString path;
+        QByteArray etag;
+        QByteArray lastModified;
+    };
+    struct Upload
+    {
+        /// a complete request came in, the connection isn't idle anymore
+        bool answered = false;
+        /// received data that isn't a complete request yet
+        QByteArray request;
+        /// the file being sent, null until there is one
+        std::shared_ptr<QFile> file;
+    };
+
+private: /* methods */
+    /// the file with that SHA-1 and what the origin said about it, empty path if there's none to serve
+    SharedFile find(const QByteArray & sha1) const;
+    void readRequest(QTcpSocket * socket);
+    void respond(QTcpSocket * socket, int status, const QByteArray & reason);
+    void sendMore(QTcpSocket * socket);
+
+private: /* data */
+    /// identifies this launcher in the announcements, so it doesn't talk to itself
+    QString m_id;
+    QTcpServer m_server;
+    QUdpSocket m_discovery;
+    QTimer m_announceTimer;
+    QStringList m_folders;
+    /// hex SHA-1 to file
+    QHash<QByteArray, SharedFile> m_files;
+    /// by peer id, or URL for the ones added by hand
+    QHash<QString, Peer> m_peers;
+    QHash<QTcpSocket *, Upload> m_uploads;
+};
+}
@@ -0,0 +1,233 @@
+#include <QTest>
+#include <QTemporaryDir>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QNetworkAccessManager>
+#include <QTcpSocket>
+#include "TestUtil.h"
+
+#include "net/TestHttpServer.h"
+#include "net/PeerCache.h"
+#include "net/NetJob.h"
+#include "net/Download.h"
+#include "net/HttpMetaCache.h"
+#include "FileSystem.h"
+
+namespace {
+QByteArray sha1(const QByteArray & data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+/// run the download, expecting the SHA-1 of `contents`
+bool download(shared_qobject_ptr<QNetworkAccessManager> network, Net::Download::Ptr dl, const QByteArray & contents)
+{
+    NetJob job("PeerCacheTest", network);
+    dl->addDigest(QCryptographicHash::Sha1, sha1(contents));
+    job.addNetAction(dl);
+    QEventLoop loop;
+    bool success = false;
+    QObject::connect(&job, &NetJob::succeeded, [&]() { success = true; });
+    QObject::connect(&job, &NetJob::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+    job.start();
+    loop.exec();
+    return success;
+}
+
+/// download the file from the origin into `path`, expecting the SHA-1 of `contents`
+bool download(shared_qobject_ptr<QNetworkAccessManager> network, const QUrl & url, const QString & path,
+              const QByteArray & contents)
+{
+    return download(network, Net::Download::makeFile(url, path), contents);
+}
+}
+
+class PeerCacheTest : public QObject
+{
+    Q_OBJECT
+
+private
+slots:
+    void test_servedByPeer()
+    {
+        QTemporaryDir tempDir;
+        QByteArray contents(100000, 'p');
+        auto hex = QString::fromLatin1(sha1(contents).toHex());
+
+        TestHttpServer origin;
+        QVERIFY(origin.listen());
+        origin.addFile("/file.jar", contents);
+
+        // the other launcher has it in a content-addressed folder
+        shared_qobject_ptr<QNetworkAccessManager> otherNetwork(new QNetworkAccessManager());
+        auto other = new Net::PeerCache(otherNetwork.get());
+        auto objects = FS::PathCombine(tempDir.path(), "objects");
+        FS::write(FS::PathCombine(objects, hex.left(2), hex), contents);
+        other->addContentAddressedFolder(objects);
+        QVERIFY(other->start());
+
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto peers = new Net::PeerCache(network.get());
+        QCOMPARE(Net::PeerCache::find(network.get()), peers);
+        peers->addPeer(other->url());
+
+        auto target = FS::PathCombine(tempDir.path(), "file.jar");
+        QVERIFY(download(network, origin.url("/file.jar"), target, contents));
+        QCOMPARE(origin.requests(), 0);
+        QCOMPARE(FS::read(target), contents);
+        // and it can pass it on now
+        QCOMPARE(peers->lookup(sha1(contents)), target);
+    }
+
+    void test_peerDoesNotHaveIt()
+    {
+        QTemporaryDir tempDir;
+        QByteArray contents(1000, 'o');
+
+        TestHttpServer origin;
+        QVERIFY(origin.listen());
+        origin.addFile("/file.jar", contents);
+
+        shared_qobject_ptr<QNetworkAccessManager> otherNetwork(new QNetworkAccessManager());
+        auto other = new Net::PeerCache(otherNetwork.get());
+        QVERIFY(other->start());
+
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto peers = new Net::PeerCache(network.get());
+        peers->addPeer(other->url());
+        // nobody listens there
+        peers->addPeer(QUrl("http://127.0.0.1:1/"));
+
+        auto target = FS::PathCombine(tempDir.path(), "file.jar");
+        QVERIFY(download(network, origin.url("/file.jar"), target, contents));
+        QCOMPARE(origin.requests(), 1);
+        QCOMPARE(FS::read(target), contents);
+    }
+
+    void test_peerHasWrongFile()
+    {
+        QTemporaryDir tempDir;
+        QByteArray contents(1000, 'o');
+
+        TestHttpServer origin;
+        QVERIFY(origin.listen());
+        origin.addFile("/file.jar", contents);
+
+        // claims to have the file, but it's something else
+        shared_qobject_ptr<QNetworkAccessManager> otherNetwork(new QNetworkAccessManager());
+        auto other = new Net::PeerCache(otherNetwork.get());
+        auto bogus = FS::PathCombine(tempDir.path(), "bogus.jar");
+        FS::write(bogus, QByteArray(1000, 'x'));
+        other->addFile(sha1(contents), bogus);
+        QVERIFY(other->start());
+
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto peers = new Net::PeerCache(network.get());
+        peers->addPeer(other->url());
+
+        auto target = FS::PathCombine(tempDir.path(), "file.jar");
+        QVERIFY(download(network, origin.url("/file.jar"), target, contents));
+        QCOMPARE(origin.requests(), 1);
+        QCOMPARE(FS::read(target), contents);
+    }
+
+    void test_keepsOriginValidators()
+    {
+        QTemporaryDir tempDir;
+        QByteArray contents(1000, 'v');
+
+        TestHttpServer origin;
+        QVERIFY(origin.listen());
+        origin.addFile("/file.jar", contents);
+
+        // the other launcher got it from the origin
+        shared_qobject_ptr<QNetworkAccessManager> otherNetwork(new QNetworkAccessManager());
+        auto other = new Net::PeerCache(otherNetwork.get());
+        QVERIFY(other->start());
+        HttpMetaCache otherCache(FS::PathCombine(tempDir.path(), "other", "metacache"));
+        otherCache.addBase("libraries", FS::PathCombine(tempDir.path(), "other", "libraries"));
+        otherCache.Load();
+        auto otherEntry = otherCache.resolveEntry("libraries", "file.jar");
+        QVERIFY(download(otherNetwork, Net::Download::makeCached(origin.url("/file.jar"), otherEntry), contents));
+        QCOMPARE(otherEntry->getETag().toLatin1(), origin.etag("/file.jar"));
+
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto peers = new Net::PeerCache(network.get());
+        peers->addPeer(other->url());
+        HttpMetaCache cache(FS::PathCombine(tempDir.path(), "metacache"));
+        cache.addBase("libraries", FS::PathCombine(tempDir.path(), "libraries"));
+        cache.Load();
+        auto entry = cache.resolveEntry("libraries", "file.jar");
+        QVERIFY(download(network, Net::Download::makeCached(origin.url("/file.jar"), entry), contents));
+        QCOMPARE(origin.requests(), 1);
+
+        // the entry can be revalidated with the origin as if the file came from there
+        QCOMPARE(entry->getETag(), otherEntry->getETag());
+        QCOMPARE(entry->getRemoteChangedTimestamp(), otherEntry->getRemoteChangedTimestamp());
+        QVERIFY(!entry->getRemoteChangedTimestamp().isEmpty());
+    }
+
+    void test_idleConnectionsClosed()
+    {
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        auto peers = new Net::PeerCache(network.get());
+        QVERIFY(peers->start());
+
+        // more connections than the peer cache takes, none of them saying anything
+        std::vector<std::unique_ptr<QTcpSocket>> sockets;
+        for(int i = 0; i < 40; i++)
+        {
+            sockets.emplace_back(new QTcpSocket());
+            sockets.back()->connectToHost(QHostAddress::LocalHost, peers->url().port());
+            QVERIFY(sockets.back()->waitForConnected(5000));
+        }
+        auto connected = [&]()
+        {
+            int count = 0;
+            for(auto & socket: sockets)
+            {
+                count += socket->state() == QAbstractSocket::ConnectedState ? 1 : 0;
+            }
+            return count;
+        };
+        QTRY_COMPARE_WITH_TIMEOUT(connected(), 32, 2000);
+
+        // and after a while, the rest goes too
+        QTRY_COMPARE_WITH_TIMEOUT(connected(), 0, 10000);
+    }
+
+    void test_discovery()
+    {
+        shared_qobject_ptr<QNetworkAccessManager> firstNetwork(new QNetworkAccessManager());
+        auto first = new Net::PeerCache(firstNetwork.get());
+        QVERIFY(first->start());
+        shared_qobject_ptr<QNetworkAccessManager> secondNetwork(new QNetworkAccessManager());
+        auto second = new Net::PeerCache(secondNetwork.get());
+        QVERIFY(second->start());
+
+        auto hash = sha1("anything");
+        QElapsedTimer timer;
+        timer.start();
+        while(first->sources(hash).isEmpty() && timer.elapsed() < 15000)
+        {
+            QTest::qWait(100);
+        }
+        if(first->sources(hash).isEmpty())
+        {
+            QSKIP("Multicast doesn't work here");
+        }
+        // there may be other launchers around
+        bool found = false;
+        for(auto & source: first->sources(hash))
+        {
+            found |= source.port() == second->url().port();
+        }
+        QVERIFY(found);
+    }
+};
+
+QTEST_GUILESS_MAIN(PeerCacheTest)
+
+#include "PeerCache_test.moc"
@@ -0,0 +1,170 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Scheduler.h"
+
+#include <QNetworkAccessManager>
+#include <algorithm>
+
+#include "NetJob.h"
+
+namespace Net {
+
+Scheduler::Scheduler(QNetworkAccessManager * network) : QObject(network)
+{
+}
+
+Scheduler * Scheduler::get(QNetworkAccessManager * network)
+{
+    auto scheduler = network->findChild<Scheduler *>(QString(), Qt::FindDirectChildrenOnly);
+    if(!scheduler)
+    {
+        scheduler = new Scheduler(network);
+    }
+    return scheduler;
+}
+
+void Scheduler::setLimits(const ConnectionLimiter::Limits& limits)
+{
+    m_limiter.setLimits(limits);
+    schedule();
+}
+
+void Scheduler::submit(NetJob* job)
+{
+    auto & jobs = m_jobs[int(job->priority())];
+    if(!jobs.contains(job))
+    {
+        jobs.append(job);
+    }
+    schedule();
+}
+
+void Scheduler::withdraw(NetJob* job)
+{
+    for(auto & jobs: m_jobs)
+    {
+        jobs.removeAll(job);
+        jobs.removeAll(nullptr);
+    }
+}
+
+void Scheduler::partSucceeded(const QString& host, qint64 bytes)
+{
+    m_limiter.partSucceeded(host, bytes);
+    schedule();
+}
+
+void Scheduler::partFailed(const QString& host)
+{
+    m_limiter.partFailed(host);
+    schedule();
+}
+
+void Scheduler::partCancelled(const QString& host)
+{
+    m_limiter.partCancelled(host);
+    schedule();
+}
+
+bool Scheduler::reserveExtra(const QString& host, Priority priority)
+{
+    if(!m_limiter.canStart(host))
+    {
+        return false;
+    }
+    if(priority == Priority::Background && m_limiter.totalActive() >= backgroundBudget())
+    {
+        return false;
+    }
+    m_limiter.partStarted(host);
+    return true;
+}
+
+void Scheduler::partMoved(const QString& from, const QString& to)
+{
+    m_limiter.partCancelled(from);
+    m_limiter.partStarted(to);
+    schedule();
+}
+
+void Scheduler::schedule()
+{
+    // starting a part can finish it right away and land us back here. Let the outer call do the work.
+    if(m_scheduling)
+    {
+        m_rescheduleRequested = true;
+        return;
+    }
+    m_scheduling = true;
+    do
+    {
+        m_rescheduleRequested = false;
+        while(startOne())
+        {
+        }
+    } while (m_rescheduleRequested);
+    m_scheduling = false;
+}
+
+int Scheduler::backgroundBudget() const
+{
+    // keep a quarter of the connections free for the more important jobs
+    auto maxTotal = m_limiter.limits().maxTotal;
+    return qMax(1, maxTotal - qMax(1, maxTotal / 4));
+}
+
+bool Scheduler::startOne()
+{
+    if(m_limiter.totalActive() >= m_limiter.limits().maxTotal)
+    {
+        return false;
+    }
+    for(int priority = int(Priority::Interactive); priority <= int(Priority::Background); priority++)
+    {
+        if(priority == int(Priority::Background) && m_limiter.totalActive() >= backgroundBudget())
+        {
+            return false;
+        }
+        auto & jobs = m_jobs[priority];
+        // the job with the fewest active parts goes first. Ties are broken by the round-robin order of the list.
+        auto candidates = jobs;
+        std::stable_sort(candidates.begin(), candidates.end(), [](const QPointer<NetJob> & a, const QPointer<NetJob> & b)
+        {
+            int activeA = a ? a->activeParts() : 0;
+            int activeB = b ? b->activeParts() : 0;
+            return activeA < activeB;
+        });
+        for(auto & job: candidates)
+        {
+            if(!job)
+            {
+                continue;
+            }
+            if(job->startNextPart(m_limiter))
+            {
+                // move it to the back of the line, unless it already finished and withdrew
+                if(jobs.removeOne(job))
+                {
+                    jobs.append(job);
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+}
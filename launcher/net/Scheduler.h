@@ -0,0 +1,94 @@
+/* Copyright 2013-2023 MultiMC Contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QList>
+
+#include "ConnectionLimiter.h"
+
+class NetJob;
+class QNetworkAccessManager;
+
+namespace Net {
+
+enum class Priority
+{
+    // something the user is looking at right now - search results, icons, changelogs
+    Interactive,
+    // something a launch is waiting for - libraries, assets, metadata
+    LaunchCritical,
+    // everything else
+    Background
+};
+
+/*
+ * Hands out connections to all the NetJobs sharing a network access manager.
+ *
+ * Jobs with waiting parts register here and the scheduler decides whose part starts next:
+ * - higher priority jobs go first, background jobs can never take the whole connection budget
+ * - jobs of the same priority share the connections fairly, the one with the fewest active parts goes next
+ * - per-host and global connection limits are enforced by a shared ConnectionLimiter
+ */
+class Scheduler : public QObject
+{
+    Q_OBJECT
+public: /* con/des */
+    explicit Scheduler(QNetworkAccessManager * network);
+    virtual ~Scheduler() {};
+
+public: /* methods */
+    /// the scheduler attached to the network access manager. One is created if there isn't any yet.
+    static Scheduler * get(QNetworkAccessManager * network);
+
+    void setLimits(const ConnectionLimiter::Limits & limits);
+    ConnectionLimiter::Limits limits() const
+    {
+        return m_limiter.limits();
+    }
+
+    /// register a job that has waiting parts and try to start some
+    void submit(NetJob * job);
+    /// forget about a job - it finished or it is going away
+    void withdraw(NetJob * job);
+
+    /// a connection to the host was released, see ConnectionLimiter for details
+    void partSucceeded(const QString & host, qint64 bytes);
+    void partFailed(const QString & host);
+    void partCancelled(const QString & host);
+
+    /// take a connection to the host for another request of a running part, a duplicate or a segment of the file,
+    /// if the limits allow it. It is given back with partSucceeded, partFailed or partCancelled.
+    bool reserveExtra(const QString & host, Priority priority);
+    /// a running part gave up its connection to one host for one to another
+    void partMoved(const QString & from, const QString & to);
+
+public slots:
+    /// start as many waiting parts as the limits allow
+    void schedule();
+
+private: /* methods */
+    bool startOne();
+    int backgroundBudget() const;
+
+private: /* data */
+    ConnectionLimiter m_limiter;
+    QList<QPointer<NetJob>> m_jobs[3];
+    bool m_scheduling = false;
+    bool m_rescheduleRequested = false;
+};
+}
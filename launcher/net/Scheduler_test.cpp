@@ -0,0 +1,154 @@
+#include <QTest>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include "TestUtil.h"
+
+#include "net/TestHttpServer.h"
+#include "net/NetJob.h"
+#include "net/Download.h"
+#include "net/Scheduler.h"
+
+namespace {
+/// a job downloading `count` files named `prefix`0, `prefix`1 and so on into `outputs`
+NetJob::Ptr makeJob(shared_qobject_ptr<QNetworkAccessManager> network, TestHttpServer & server, const QString & prefix,
+                    int count, Net::Priority priority, QList<QByteArray> & outputs)
+{
+    NetJob::Ptr job(new NetJob("SchedulerTest " + prefix, network));
+    job->setPriority(priority);
+    for(int i = 0; i < count; i++)
+    {
+        auto path = QString("/%1%2").arg(prefix).arg(i);
+        server.addFile(path, QByteArray(1000, 'x'));
+        outputs.append(QByteArray());
+    }
+    // the list doesn't move anymore, the downloads can point into it
+    for(int i = 0; i < count; i++)
+    {
+        job->addNetAction(Net::Download::makeByteArray(server.url(QString("/%1%2").arg(prefix).arg(i)), &outputs[i]));
+    }
+    return job;
+}
+
+/// wait for all the jobs to finish, true if they all succeeded
+bool waitFor(const QList<NetJob::Ptr> & jobs)
+{
+    QEventLoop loop;
+    int remaining = jobs.size();
+    for(auto & job: jobs)
+    {
+        QObject::connect(job.get(), &NetJob::finished, &loop, [&]()
+        {
+            if(--remaining == 0)
+            {
+                loop.quit();
+            }
+        });
+    }
+    QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+    loop.exec();
+    for(auto & job: jobs)
+    {
+        if(!job->wasSuccessful())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Net::ConnectionLimiter::Limits limits(int perHost, int total)
+{
+    Net::ConnectionLimiter::Limits result;
+    result.initialPerHost = perHost;
+    result.minPerHost = perHost;
+    result.maxPerHost = perHost;
+    result.maxTotal = total;
+    return result;
+}
+}
+
+class SchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private
+slots:
+    void test_priorityOrder()
+    {
+        TestHttpServer server;
+        server.setLatency(20);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        Net::Scheduler::get(network.get())->setLimits(limits(1, 1));
+
+        QList<QByteArray> backgroundOutputs;
+        QList<QByteArray> interactiveOutputs;
+        auto background = makeJob(network, server, "b", 3, Net::Priority::Background, backgroundOutputs);
+        auto interactive = makeJob(network, server, "i", 2, Net::Priority::Interactive, interactiveOutputs);
+        background->start();
+        interactive->start();
+        QVERIFY(waitFor({background, interactive}));
+
+        // the background job got the only connection first, after that the interactive one goes ahead of it
+        QCOMPARE(server.requestLog(), QStringList({"/b0", "/i0", "/i1", "/b1", "/b2"}));
+    }
+
+    void test_backgroundReserve()
+    {
+        TestHttpServer server;
+        server.setLatency(100);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        Net::Scheduler::get(network.get())->setLimits(limits(8, 4));
+
+        // a quarter of the connections is kept from background jobs...
+        QList<QByteArray> outputs;
+        auto background = makeJob(network, server, "b", 8, Net::Priority::Background, outputs);
+        background->start();
+        QVERIFY(waitFor({background}));
+        QCOMPARE(server.peakInFlight(), 3);
+
+        // ... for the more important ones
+        server.resetCounters();
+        QList<QByteArray> moreOutputs;
+        QList<QByteArray> interactiveOutputs;
+        auto again = makeJob(network, server, "c", 8, Net::Priority::Background, moreOutputs);
+        auto interactive = makeJob(network, server, "i", 2, Net::Priority::Interactive, interactiveOutputs);
+        again->start();
+        interactive->start();
+        QVERIFY(waitFor({again, interactive}));
+        QCOMPARE(server.peakInFlight(), 4);
+        // the interactive job didn't wait for the background one
+        QVERIFY(server.requestLog().indexOf("/i0") < 4);
+    }
+
+    void test_fairShare()
+    {
+        TestHttpServer server;
+        server.setLatency(20);
+        QVERIFY(server.listen());
+        shared_qobject_ptr<QNetworkAccessManager> network(new QNetworkAccessManager());
+        Net::Scheduler::get(network.get())->setLimits(limits(2, 2));
+
+        QList<QByteArray> firstOutputs;
+        QList<QByteArray> secondOutputs;
+        auto first = makeJob(network, server, "a", 4, Net::Priority::Interactive, firstOutputs);
+        auto second = makeJob(network, server, "b", 4, Net::Priority::Interactive, secondOutputs);
+        first->start();
+        second->start();
+        QVERIFY(waitFor({first, second}));
+
+        auto log = server.requestLog();
+        QCOMPARE(log.size(), 8);
+        // the first job took both connections before the second one showed up. The first one to free up goes to
+        // the second job, which has fewer parts running, the next one back to the first job.
+        QCOMPARE(log.mid(0, 4), QStringList({"/a0", "/a1", "/b0", "/a2"}));
+        // from there on they take turns, whichever part finishes first
+        QVERIFY(log.mid(4, 2).contains("/a3"));
+        QVERIFY(log.mid(4, 2).contains("/b1"));
+    }
+};
+
+QTEST_GUILESS_MAIN(SchedulerTest)
+
+#include "Scheduler_test.moc"
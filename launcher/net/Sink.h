@@ -3,6 +3,7 @@
 #include "net/NetAction.h"
 
 #include "Validator.h"
+#include "ValidationPipeline.h"
 
 namespace Net {
 class Sink
@@ -12,11 +13,65 @@ public: /* con/des */
     virtual ~Sink() {};
 
 public: /* methods */
+    /// keep other processes from downloading the same thing at the same time, before init.
+    /// returns false if one is doing that right now, the download then waits and tries again.
+    virtual bool tryLock()
+    {
+        return true;
+    }
     virtual JobStatus init(QNetworkRequest & request) = 0;
+    /// called once the response headers are known, before any data is written
+    virtual JobStatus headersReceived(QNetworkReply &)
+    {
+        return Job_InProgress;
+    }
     virtual JobStatus write(QByteArray & data) = 0;
+    /// switch to taking the data in segments that can arrive out of order. The validators only run at the end.
+    /// returns false if the sink can't do that, the data then keeps coming in order through write()
+    virtual bool beginSegments(qint64)
+    {
+        return false;
+    }
+    virtual JobStatus writeAt(qint64, QByteArray &)
+    {
+        return Job_Failed;
+    }
+    /// give the validators the segments they didn't see yet, once they are all in. Runs before finalize, on a worker
+    /// thread if validatorsRunInBackground() - nothing else may touch the sink then.
+    virtual bool catchUpValidators()
+    {
+        return true;
+    }
+    bool validatorsRunInBackground() const
+    {
+        return ValidationPipeline::canRun(validators);
+    }
     virtual JobStatus abort() = 0;
     virtual JobStatus finalize(QNetworkReply & reply) = 0;
     virtual bool hasLocalData() = 0;
+    /// leave the finished file next to the target until commit(), so it can be synced together with others first
+    virtual void deferCommit()
+    {
+    }
+    /// the finished file waiting for commit(), if any. abort() throws it away.
+    virtual QString stagedFile() const
+    {
+        return QString();
+    }
+    /// put the staged file in place
+    virtual JobStatus commit()
+    {
+        return Job_Finished;
+    }
+    /// the ETag and Last-Modified the origin sent with the file, empty if unknown
+    virtual QByteArray etag() const
+    {
+        return QByteArray();
+    }
+    virtual QByteArray lastModified() const
+    {
+        return QByteArray();
+    }
 
     void addValidator(Validator * validator)
     {
@@ -29,6 +84,10 @@ public: /* methods */
 protected: /* methods */
     bool finalizeAllValidators(QNetworkReply & reply)
     {
+        if(m_pipeline && !m_pipeline->drain())
+        {
+            return false;
+        }
         for(auto & validator: validators)
         {
             if(!validator->validate(reply))
@@ -38,6 +97,11 @@ protected: /* methods */
     }
     bool failAllValidators()
     {
+        // a resumed download continues with the validators as they are, so they still have to see everything queued
+        if(m_pipeline)
+        {
+            m_pipeline->drain();
+        }
         bool success = true;
         for(auto & validator: validators)
         {
@@ -47,15 +111,26 @@ protected: /* methods */
     }
     bool initAllValidators(QNetworkRequest & request)
     {
+        // the validators start over, whatever was still queued for them doesn't matter anymore
+        m_pipeline.reset();
         for(auto & validator: validators)
         {
             if(!validator->init(request))
                 return false;
         }
+        if(ValidationPipeline::canRun(validators))
+        {
+            m_pipeline.reset(new ValidationPipeline(validators));
+        }
         return true;
     }
+    /// with a pipeline, the data is only queued here and a rejected chunk shows up in later calls or when finalizing
     bool writeAllValidators(QByteArray & data)
     {
+        if(m_pipeline)
+        {
+            return m_pipeline->write(data);
+        }
         for(auto & validator: validators)
         {
             if(!validator->write(data))
@@ -66,5 +141,9 @@ protected: /* methods */
 
 protected: /* data */
     std::vector<std::shared_ptr<Validator>> validators;
+
+private: /* data */
+    /// feeds the validators on a worker thread, if they can all do that
+    std::unique_ptr<ValidationPipeline> m_pipeline;
 };
 }
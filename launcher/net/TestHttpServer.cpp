@@ -0,0 +1,330 @@
+#include "TestHttpServer.h"
+
+#include <QCryptographicHash>
+#include <QTcpSocket>
+
+namespace {
+// how often throttled connections get their share of the bandwidth
+const int pumpIntervalMs = 10;
+const char * lastModified = "Thu, 01 Jan 2015 00:00:00 GMT";
+
+QByteArray statusText(int status)
+{
+    switch(status)
+    {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 304: return "Not Modified";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+/// parse `bytes=first-[last]`. Returns false if it isn't a single range of that form.
+bool parseRange(const QByteArray & header, qint64 size, qint64 & first, qint64 & last)
+{
+    if(!header.startsWith("bytes=") || header.contains(','))
+    {
+        return false;
+    }
+    auto parts = header.mid(6).split('-');
+    if(parts.size() != 2)
+    {
+        return false;
+    }
+    bool ok = false;
+    first = parts[0].trimmed().toLongLong(&ok);
+    if(!ok)
+    {
+        return false;
+    }
+    last = size - 1;
+    if(!parts[1].trimmed().isEmpty())
+    {
+        last = qMin(parts[1].trimmed().toLongLong(&ok), size - 1);
+        if(!ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+TestHttpServer::TestHttpServer(QObject * parent) : QObject(parent)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &TestHttpServer::newConnection);
+    m_pumpTimer.setInterval(pumpIntervalMs);
+    connect(&m_pumpTimer, &QTimer::timeout, this, &TestHttpServer::pump);
+}
+
+TestHttpServer::~TestHttpServer()
+{
+    for(auto socket: m_connections.keys())
+    {
+        socket->disconnect(this);
+        socket->abort();
+    }
+    m_server.close();
+}
+
+bool TestHttpServer::listen()
+{
+    return m_server.listen(QHostAddress::LocalHost, 0);
+}
+
+QUrl TestHttpServer::url(const QString & path) const
+{
+    QUrl result;
+    result.setScheme("http");
+    result.setHost("127.0.0.1");
+    result.setPort(m_server.serverPort());
+    result.setPath(path.startsWith('/') ? path : "/" + path);
+    return result;
+}
+
+void TestHttpServer::addFile(const QString & path, const QByteArray & contents)
+{
+    auto key = path.startsWith('/') ? path : "/" + path;
+    m_files.insert(key, contents);
+    m_etags.insert(key, "\"" + QCryptographicHash::hash(contents, QCryptographicHash::Md5).toHex() + "\"");
+}
+
+void TestHttpServer::resetCounters()
+{
+    m_requests = 0;
+    m_notModified = 0;
+    m_errors = 0;
+    m_bytesSent = 0;
+    m_requestLog.clear();
+    m_peakInFlight = m_inFlight;
+}
+
+void TestHttpServer::newConnection()
+{
+    while(m_server.hasPendingConnections())
+    {
+        auto socket = m_server.nextPendingConnection();
+        m_connections.insert(socket, Connection());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+        {
+            m_connections[socket].input.append(socket->readAll());
+            readRequests(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            if(m_connections.value(socket).busy)
+            {
+                // the client gave up on the request
+                m_inFlight--;
+            }
+            m_connections.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void TestHttpServer::readRequests(QTcpSocket * socket)
+{
+    auto & connection = m_connections[socket];
+    if(connection.busy)
+    {
+        return;
+    }
+    int end = connection.input.indexOf("\r\n\r\n");
+    if(end < 0)
+    {
+        return;
+    }
+    auto lines = connection.input.left(end).split('\n');
+    connection.input.remove(0, end + 4);
+
+    Request request;
+    auto requestLine = lines.takeFirst().trimmed().split(' ');
+    if(requestLine.size() >= 2)
+    {
+        request.method = requestLine[0];
+        request.path = QUrl::fromEncoded(requestLine[1]).path();
+    }
+    for(auto & line: lines)
+    {
+        int colon = line.indexOf(':');
+        if(colon > 0)
+        {
+            request.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+    }
+
+    connection.busy = true;
+    m_requestLog.append(request.path);
+    m_inFlight++;
+    m_peakInFlight = qMax(m_peakInFlight, m_inFlight);
+    if(m_latency > 0)
+    {
+        QTimer::singleShot(m_latency, socket, [this, socket, request]()
+        {
+            respond(socket, request);
+        });
+    }
+    else
+    {
+        respond(socket, request);
+    }
+}
+
+void TestHttpServer::respond(QTcpSocket * socket, const Request & request)
+{
+    bool close = false;
+    auto data = response(request, close);
+    m_connections[socket].closeWhenDone = close;
+    send(socket, data);
+}
+
+QByteArray TestHttpServer::response(const Request & request, bool & close)
+{
+    m_requests++;
+    close = request.headers.value("connection").toLower() == "close";
+
+    int status = 200;
+    QByteArray body;
+    QList<QByteArray> headers;
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if(m_errorRate > 0.0 && chance(m_random) < m_errorRate)
+    {
+        m_errors++;
+        status = m_errorStatus;
+    }
+    else if(request.method != "GET" && request.method != "HEAD")
+    {
+        status = 405;
+    }
+    else if(!m_files.contains(request.path))
+    {
+        status = 404;
+    }
+    else
+    {
+        const auto & contents = m_files[request.path];
+        const auto & etag = m_etags[request.path];
+        headers << "ETag: " + etag;
+        headers << QByteArray("Last-Modified: ") + lastModified;
+        headers << "Accept-Ranges: bytes";
+        qint64 first = 0;
+        qint64 last = 0;
+        auto ifRange = request.headers.value("if-range");
+        bool rangeApplies = ifRange.isEmpty() || ifRange == etag || ifRange == lastModified;
+        if(m_conditional && request.headers.value("if-none-match") == etag)
+        {
+            m_notModified++;
+            status = 304;
+        }
+        else if(request.headers.contains("range") && rangeApplies
+                && parseRange(request.headers.value("range"), contents.size(), first, last))
+        {
+            if(first >= contents.size() || first > last)
+            {
+                status = 416;
+                headers << "Content-Range: bytes */" + QByteArray::number(contents.size());
+            }
+            else
+            {
+                status = 206;
+                body = contents.mid(int(first), int(last - first + 1));
+                headers << "Content-Range: bytes " + QByteArray::number(first) + "-" + QByteArray::number(last) + "/"
+                        + QByteArray::number(contents.size());
+            }
+        }
+        else
+        {
+            body = contents;
+        }
+    }
+
+    QByteArray result = "HTTP/1.1 " + QByteArray::number(status) + " " + statusText(status) + "\r\n";
+    if(status != 304)
+    {
+        headers << "Content-Length: " + QByteArray::number(body.size());
+        headers << "Content-Type: application/octet-stream";
+    }
+    if(close)
+    {
+        headers << "Connection: close";
+    }
+    for(auto & header: headers)
+    {
+        result += header + "\r\n";
+    }
+    result += "\r\n";
+    if(request.method != "HEAD")
+    {
+        result += body;
+    }
+    return result;
+}
+
+void TestHttpServer::send(QTcpSocket * socket, const QByteArray & data)
+{
+    if(m_bandwidth <= 0)
+    {
+        socket->write(data);
+        m_bytesSent += data.size();
+        responseSent(socket);
+        return;
+    }
+    m_connections[socket].output.append(data);
+    if(!m_pumpTimer.isActive())
+    {
+        m_pumpTimer.start();
+    }
+}
+
+void TestHttpServer::pump()
+{
+    qint64 allowance = qMax<qint64>(1, m_bandwidth * pumpIntervalMs / 1000);
+    bool pending = false;
+    // answering the next request can close the socket, so don't iterate over the connections themselves
+    for(auto socket: m_connections.keys())
+    {
+        if(!m_connections.contains(socket))
+        {
+            continue;
+        }
+        auto & output = m_connections[socket].output;
+        if(output.isEmpty())
+        {
+            continue;
+        }
+        auto amount = int(qMin<qint64>(allowance, output.size()));
+        socket->write(output.constData(), amount);
+        m_bytesSent += amount;
+        output.remove(0, amount);
+        if(output.isEmpty())
+        {
+            responseSent(socket);
+        }
+        pending |= m_connections.contains(socket) && !m_connections[socket].output.isEmpty();
+    }
+    if(!pending)
+    {
+        m_pumpTimer.stop();
+    }
+}
+
+void TestHttpServer::responseSent(QTcpSocket * socket)
+{
+    auto & connection = m_connections[socket];
+    connection.busy = false;
+    m_inFlight--;
+    if(connection.closeWhenDone)
+    {
+        socket->disconnectFromHost();
+        return;
+    }
+    // the client may have sent the next request already
+    readRequests(socket);
+}
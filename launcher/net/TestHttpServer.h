@@ -0,0 +1,140 @@
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTimer>
+#include <QUrl>
+#include <random>
+
+class QTcpSocket;
+
+/*
+ * A small HTTP/1.1 server on localhost, only for tests and benchmarks.
+ *
+ * Serves files from memory with persistent connections, ETags, conditional requests and byte ranges, which is all the
+ * launcher's network code uses. Latency, bandwidth and failures can be dialed in to make the conditions reproducible.
+ */
+class TestHttpServer : public QObject
+{
+    Q_OBJECT
+public: /* con/des */
+    explicit TestHttpServer(QObject * parent = nullptr);
+    virtual ~TestHttpServer();
+
+public: /* methods */
+    /// start listening on a free port of 127.0.0.1
+    bool listen();
+    /// the URL of the path on this server
+    QUrl url(const QString & path = QString()) const;
+
+    void addFile(const QString & path, const QByteArray & contents);
+    /// the entity tag the file is served with
+    QByteArray etag(const QString & path) const
+    {
+        return m_etags.value(path.startsWith('/') ? path : "/" + path);
+    }
+
+    /// wait this long before answering each request
+    void setLatency(int ms)
+    {
+        m_latency = ms;
+    }
+    /// send at most this many bytes per second on each connection, 0 for as fast as possible
+    void setBandwidth(qint64 bytesPerSecond)
+    {
+        m_bandwidth = bytesPerSecond;
+    }
+    /// answer this fraction of the requests with `status` instead of the file. The choice is random, but repeatable.
+    void setErrorRate(double fraction, int status = 503, unsigned seed = 1)
+    {
+        m_errorRate = fraction;
+        m_errorStatus = status;
+        m_random.seed(seed);
+    }
+    /// answer If-None-Match with 304 Not Modified when the ETag matches
+    void setConditionalRequests(bool enabled)
+    {
+        m_conditional = enabled;
+    }
+
+    int requests() const
+    {
+        return m_requests;
+    }
+    int notModified() const
+    {
+        return m_notModified;
+    }
+    int errors() const
+    {
+        return m_errors;
+    }
+    qint64 bytesSent() const
+    {
+        return m_bytesSent;
+    }
+    /// the paths of the requests, in the order they arrived
+    QStringList requestLog() const
+    {
+        return m_requestLog;
+    }
+    /// the most requests that were being answered at the same time
+    int peakInFlight() const
+    {
+        return m_peakInFlight;
+    }
+    void resetCounters();
+
+private: /* types */
+    struct Connection
+    {
+        /// received data that isn't a complete request yet
+        QByteArray input;
+        /// response data waiting for bandwidth
+        QByteArray output;
+        /// a request is being answered, the next one has to wait
+        bool busy = false;
+        bool closeWhenDone = false;
+    };
+    struct Request
+    {
+        QByteArray method;
+        QString path;
+        QHash<QByteArray, QByteArray> headers;
+    };
+
+private slots:
+    void newConnection();
+    void pump();
+
+private: /* methods */
+    void readRequests(QTcpSocket * socket);
+    void respond(QTcpSocket * socket, const Request & request);
+    QByteArray response(const Request & request, bool & close);
+    void send(QTcpSocket * socket, const QByteArray & data);
+    void responseSent(QTcpSocket * socket);
+
+private: /* data */
+    QTcpServer m_server;
+    QTimer m_pumpTimer;
+    QHash<QTcpSocket *, Connection> m_connections;
+    QHash<QString, QByteArray> m_files;
+    QHash<QString, QByteArray> m_etags;
+
+    int m_latency = 0;
+    qint64 m_bandwidth = 0;
+    double m_errorRate = 0.0;
+    int m_errorStatus = 503;
+    bool m_conditional = true;
+    std::default_random_engine m_random;
+
+    int m_requests = 0;
+    int m_notModified = 0;
+    int m_errors = 0;
+    qint64 m_bytesSent = 0;
+    QStringList m_requestLog;
+    int m_inFlight = 0;
+    int m_peakInFlight = 0;
+};
@@ -0,0 +1,122 @@
+#include "ValidationPipeline.h"
+#include "Validator.h"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+namespace Net {
+
+namespace {
+// how much data may wait for the validators before writing blocks
+const qint64 maximumQueuedBytes = 4 * 1024 * 1024;
+// one thread hashes at around 1 GB/s, more than a few only compete with everything else
+const int maximumThreads = 4;
+
+class ValidationPool : public QThreadPool
+{
+public:
+    ValidationPool()
+    {
+        setMaxThreadCount(qBound(1, QThread::idealThreadCount(), maximumThreads));
+    }
+};
+
+QThreadPool * validationPool()
+{
+    static ValidationPool pool;
+    return &pool;
+}
+}
+
+ValidationPipeline::ValidationPipeline(std::vector<std::shared_ptr<Validator>> validators)
+    :m_validators(std::move(validators))
+{
+    // nil
+}
+
+ValidationPipeline::~ValidationPipeline()
+{
+    drain();
+}
+
+bool ValidationPipeline::canRun(const std::vector<std::shared_ptr<Validator>> & validators)
+{
+    if(validators.empty())
+    {
+        return false;
+    }
+    for(auto & validator: validators)
+    {
+        if(!validator->canWriteInBackground())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ValidationPipeline::write(const QByteArray & data)
+{
+    if(data.isEmpty())
+    {
+        return true;
+    }
+    QMutexLocker locker(&m_mutex);
+    while(!m_failed && m_queuedBytes >= maximumQueuedBytes)
+    {
+        m_changed.wait(&m_mutex);
+    }
+    if(m_failed)
+    {
+        return false;
+    }
+    m_queue.push_back(data);
+    m_queuedBytes += data.size();
+    if(!m_working)
+    {
+        m_working = true;
+        QtConcurrent::run(validationPool(), [this]()
+        {
+            work();
+        });
+    }
+    return true;
+}
+
+bool ValidationPipeline::drain()
+{
+    QMutexLocker locker(&m_mutex);
+    while(m_working)
+    {
+        m_changed.wait(&m_mutex);
+    }
+    return !m_failed;
+}
+
+void ValidationPipeline::work()
+{
+    QMutexLocker locker(&m_mutex);
+    while(!m_queue.empty())
+    {
+        QByteArray chunk = m_queue.front();
+        m_queue.pop_front();
+        bool failed = m_failed;
+        locker.unlock();
+        for(auto & validator: m_validators)
+        {
+            if(failed)
+            {
+                break;
+            }
+            failed = !validator->write(chunk);
+        }
+        locker.relock();
+        m_failed = failed;
+        m_queuedBytes -= chunk.size();
+        m_changed.wakeAll();
+    }
+    m_working = false;
+    m_changed.wakeAll();
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace Net {
+class Validator;
+
+/*
+ * Feeds downloaded data to validators on a worker thread, so hashing doesn't hold up the network and the UI.
+ *
+ * The data waits in a queue of bounded size, writing blocks while it is full. The worker takes the chunks in order,
+ * one pipeline never has more than one worker at a time. Only write() of the validators runs on the worker, everything
+ * else has to wait for the queue to drain first.
+ */
+class ValidationPipeline
+{
+public: /* con/des */
+    explicit ValidationPipeline(std::vector<std::shared_ptr<Validator>> validators);
+    /// waits for the worker
+    ~ValidationPipeline();
+
+public: /* methods */
+    /// true if all the validators can take their data on another thread
+    static bool canRun(const std::vector<std::shared_ptr<Validator>> & validators);
+
+    /// queue the data for the validators. Returns false if an earlier chunk was rejected.
+    bool write(const QByteArray & data);
+    /// wait until the validators have seen everything. Returns false if any chunk was rejected.
+    bool drain();
+
+private: /* methods */
+    void work();
+
+private: /* data */
+    std::vector<std::shared_ptr<Validator>> m_validators;
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    std::deque<QByteArray> m_queue;
+    qint64 m_queuedBytes = 0;
+    bool m_working = false;
+    bool m_failed = false;
+};
+}
@@ -0,0 +1,82 @@
+#include <QTest>
+#include "TestUtil.h"
+
+#include "net/ValidationPipeline.h"
+#include "net/ChecksumValidator.h"
+
+namespace {
+/// takes a number of chunks, then rejects the rest
+class RejectingValidator : public Net::Validator
+{
+public:
+    explicit RejectingValidator(int accepted) : m_accepted(accepted) {}
+    bool init(QNetworkRequest &) override
+    {
+        return true;
+    }
+    bool write(QByteArray &) override
+    {
+        return m_accepted-- > 0;
+    }
+    bool abort() override
+    {
+        return true;
+    }
+    bool validate(QNetworkReply &) override
+    {
+        return true;
+    }
+    bool canWriteInBackground() const override
+    {
+        return true;
+    }
+
+private:
+    int m_accepted;
+};
+}
+
+class ValidationPipelineTest : public QObject
+{
+    Q_OBJECT
+private
+slots:
+    void test_inOrder()
+    {
+        auto checksum = std::make_shared<Net::ChecksumValidator>(QCryptographicHash::Sha1);
+        QCryptographicHash expected(QCryptographicHash::Sha1);
+        {
+            Net::ValidationPipeline pipeline({checksum});
+            // more than fits in the queue, so writing has to wait for the worker at some point
+            for(int i = 0; i < 2000; i++)
+            {
+                QByteArray chunk(16 * 1024 + i, char(i));
+                expected.addData(chunk);
+                QVERIFY(pipeline.write(chunk));
+            }
+            QVERIFY(pipeline.drain());
+            QCOMPARE(checksum->hash(), expected.result());
+        }
+    }
+
+    void test_rejected()
+    {
+        Net::ValidationPipeline pipeline({std::make_shared<RejectingValidator>(3)});
+        for(int i = 0; i < 5; i++)
+        {
+            pipeline.write(QByteArray(100, 'x'));
+        }
+        QVERIFY(!pipeline.drain());
+        QVERIFY(!pipeline.write(QByteArray(100, 'x')));
+    }
+
+    void test_canRun()
+    {
+        QVERIFY(!Net::ValidationPipeline::canRun({}));
+        QVERIFY(Net::ValidationPipeline::canRun({std::make_shared<Net::ChecksumValidator>(QCryptographicHash::Md5)}));
+    }
+};
+
+QTEST_GUILESS_MAIN(ValidationPipelineTest)
+
+#include "ValidationPipeline_test.moc"
@@ -14,5 +14,10 @@ public: /* methods */
     virtual bool write(QByteArray & data) = 0;
     virtual bool abort() = 0;
     virtual bool validate(QNetworkReply & reply) = 0;
+    /// true if write() may run on a worker thread. The other methods are only called once it is done.
+    virtual bool canWriteInBackground() const
+    {
+        return false;
+    }
 };
 }
@@ -51,11 +51,12 @@ void NotificationChecker::checkForNotifications()
     auto entry = APPLICATION->metacache()->resolveEntry("root", "notifications.json");
     entry->setStale(true);
     m_checkJob->addNetAction(m_download = Net::Download::makeCached(m_notificationsUrl, entry));
-    connect(m_download.get(), &Net::Download::succeeded, this, &NotificationChecker::downloadSucceeded);
+    // the file is only in place once the whole job is done
+    connect(m_checkJob.get(), &NetJob::succeeded, this, &NotificationChecker::downloadSucceeded);
     m_checkJob->start();
 }
 
-void NotificationChecker::downloadSucceeded(int)
+void NotificationChecker::downloadSucceeded()
 {
     m_entries.clear();
 
@@ -40,7 +40,7 @@ slots:
 
 private
 slots:
-    void downloadSucceeded(int);
+    void downloadSucceeded();
 
 signals:
     void notificationCheckFinished();
@@ -17,6 +17,7 @@
  * limitations under the License.
  */
 #include "Application.h"
+#include "net/ConnectionWarmer.h"
 #include "BuildConfig.h"
 
 #include "MainWindow.h"
@@ -1918,6 +1919,9 @@ void MainWindow::instanceChanged(const QModelIndex &current, const QModelIndex &
 
         updateToolsMenu();
 
+        // launching it is likely next
+        APPLICATION->connectionWarmer()->warmUp(m_selectedInstance->updateServers());
+
         APPLICATION->settings()->set("SelectedInstance", m_selectedInstance->id());
     }
     else
@@ -135,6 +135,7 @@ AboutDialog::~AboutDialog()
 void AboutDialog::loadPatronList()
 {
     netJob = new NetJob("Patreon Patron List", APPLICATION->network());
+    netJob->setPriority(Net::Priority::Interactive);
     netJob->addNetAction(Net::Download::makeByteArray(QUrl("https://files.multimc.org/patrons.txt"), &dataSink));
     connect(netJob.get(), &NetJob::succeeded, this, &AboutDialog::patronListLoaded);
     netJob->start();
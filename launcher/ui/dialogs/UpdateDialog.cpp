@@ -33,6 +33,7 @@ UpdateDialog::~UpdateDialog()
 void UpdateDialog::loadChangelog()
 {
     dljob = new NetJob("Changelog", APPLICATION->network());
+    dljob->setPriority(Net::Priority::Interactive);
     QString url;
     url = QString("https://api.github.com/repos/MultiMC/Launcher/compare/%1...develop").arg(BuildConfig.GIT_COMMIT);
     m_changelogType = CHANGELOG_COMMITS;
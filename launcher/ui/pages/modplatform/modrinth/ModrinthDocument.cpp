@@ -54,6 +54,7 @@ void Modrinth::ModrinthDocument::requestResource(const QUrl& url) {
 
     ImageLoad *load = new ImageLoad;
     load->job = new NetJob(QString("Modrinth Image Download %1").arg(key), APPLICATION->network());
+    load->job->setPriority(Net::Priority::Interactive);
     load->job->addNetAction(Net::Download::makeByteArray(url, &load->output));
     load->key = key;
 
@@ -106,6 +106,7 @@ void Modrinth::ListModel::searchWithTerm(const QString& term, const QString &sor
 void Modrinth::ListModel::performPaginatedSearch()
 {
     auto *netJob = new NetJob("Modrinth::Search", APPLICATION->network());
+    netJob->setPriority(Net::Priority::Interactive);
     QString searchUrl = "";
     if (currentSearchTerm.isEmpty()) {
         searchUrl = QString("https://api.modrinth.com/v2/search?facets=[[%22project_type:modpack%22]]&index=%1&limit=25&offset=%2").arg(currentSort).arg(nextSearchOffset);
@@ -234,6 +235,7 @@ void Modrinth::ListModel::requestLogo(const QString &logo, const QUrl &url)
 
     MetaEntryPtr entry = APPLICATION->metacache()->resolveEntry("ModrinthPacks", QString("logos/%1").arg(logo.section(".", 0, 0)));
     auto *job = new NetJob(QString("Modrinth Icon Download %1").arg(logo), APPLICATION->network());
+    job->setPriority(Net::Priority::Interactive);
     job->addNetAction(Net::Download::makeCached(url, entry));
 
     auto fullPath = entry->getFullPath();
@@ -283,6 +285,7 @@ void Modrinth::ListModel::getPackDetails(const QString& id)
     if(modpack.detailsLoaded != LoadState::Loaded)
     {
         auto *netJob = new NetJob("Modrinth::PackDetails", APPLICATION->network());
+        netJob->setPriority(Net::Priority::Interactive);
         netJob->addNetAction(Net::Download::makeByteArray(QUrl(detailsUrl), &detailsResponse));
         detailsPtr = netJob;
         detailsPtr->start();
@@ -294,6 +297,7 @@ void Modrinth::ListModel::getPackDetails(const QString& id)
     if(modpack.versionsLoaded != LoadState::Loaded)
     {
         auto *netJob = new NetJob("Modrinth::PackVersions", APPLICATION->network());
+        netJob->setPriority(Net::Priority::Interactive);
         netJob->addNetAction(Net::Download::makeByteArray(QUrl(versionsUrl), &versionsResponse));
         versionsPtr = netJob;
         versionsPtr->start();
@@ -94,6 +94,7 @@ void Technic::ListModel::searchWithTerm(const QString& term)
 void Technic::ListModel::performSearch()
 {
     NetJob *netJob = new NetJob("Technic::Search", APPLICATION->network());
+    netJob->setPriority(Net::Priority::Interactive);
     QString searchUrl = "";
     if (currentSearchTerm.isEmpty()) {
         searchUrl = QString("%1trending?build=%2")
@@ -262,6 +263,7 @@ void Technic::ListModel::requestLogo(QString logo, QString url)
 
     MetaEntryPtr entry = APPLICATION->metacache()->resolveEntry("TechnicPacks", QString("logos/%1").arg(logo));
     NetJob *job = new NetJob(QString("Technic Icon Download %1").arg(logo), APPLICATION->network());
+    job->setPriority(Net::Priority::Interactive);
     job->addNetAction(Net::Download::makeCached(QUrl(url), entry));
 
     auto fullPath = entry->getFullPath();
@@ -119,6 +119,7 @@ void TechnicPage::suggestCurrent()
     }
 
     NetJob *netJob = new NetJob(QString("Technic::PackMeta(%1)").arg(current.name), APPLICATION->network());
+    netJob->setPriority(Net::Priority::Interactive);
     QString slug = current.slug;
     netJob->addNetAction(Net::Download::makeByteArray(QString("%1modpack/%2?build=%3").arg(BuildConfig.TECHNIC_API_BASE_URL, slug, BuildConfig.TECHNIC_API_BUILD), &response));
     QObject::connect(netJob, &NetJob::succeeded, this, [this, slug]
@@ -225,6 +226,7 @@ void TechnicPage::metadataLoaded()
         ui->versionSelectionBox->addItem(current.currentVersion);
 
         auto* netJob = new NetJob(QString("Technic::SolderMeta(%1)").arg(current.name), APPLICATION->network());
+        netJob->setPriority(Net::Priority::Interactive);
         auto url = QString("%1/modpack/%2").arg(current.url, current.slug);
         netJob->addNetAction(Net::Download::makeByteArray(QUrl(url), &response));
 
@@ -3,6 +3,7 @@
 #include <QProgressBar>
 #include <QVBoxLayout>
 #include <QHeaderView>
+#include <QDebug>
 
 #include "VersionListView.h"
 #include "VersionProxyModel.h"
@@ -110,6 +111,11 @@ void VersionSelectWidget::loadList()
         loadTask->start();
     }
     sneakyProgressBar->setHidden(false);
+    // lists with a local copy show it while they check for a newer one
+    if(m_vlist->isLoaded())
+    {
+        preselect();
+    }
 }
 
 void VersionSelectWidget::onTaskSucceeded()
@@ -125,6 +131,12 @@ void VersionSelectWidget::onTaskSucceeded()
 
 void VersionSelectWidget::onTaskFailed(const QString& reason)
 {
+    if(m_vlist->isLoaded())
+    {
+        qWarning() << "Version list update failed, showing what we had:" << reason;
+        onTaskSucceeded();
+        return;
+    }
     CustomMessageBox::selectable(this, tr("Error"), tr("List update failed:\n%1").arg(reason), QMessageBox::Warning)->show();
     onTaskSucceeded();
 }